@@ -65,6 +65,211 @@ typedef uint32_t ESYS_TR;
 
 typedef struct ESYS_CONTEXT ESYS_CONTEXT;
 
+/*
+ * Callback delivering the input of the stream functions. On entry *size is
+ * the number of bytes buffer can take, on return it is the number of bytes
+ * written to buffer. A size of 0 signals the end of the data.
+ */
+typedef TSS2_RC (*ESYS_READ_CB)(
+    void *userdata,
+    uint8_t *buffer,
+    size_t *size);
+
+/*
+ * Callback receiving the output of the stream functions. All size bytes of
+ * buffer have to be consumed.
+ */
+typedef TSS2_RC (*ESYS_WRITE_CB)(
+    void *userdata,
+    const uint8_t *buffer,
+    size_t size);
+
+/*
+ * Allocator for the transient memory of an ESYS_CONTEXT; see
+ * Esys_SetAllocator. The allocation callback returns size bytes or NULL,
+ * the free callback releases memory returned by the allocation callback.
+ */
+typedef void *(*ESYS_ALLOC_CB)(
+    void *userdata,
+    size_t size);
+
+typedef void (*ESYS_FREE_CB)(
+    void *userdata,
+    void *ptr);
+
+typedef struct ESYS_LOOP ESYS_LOOP;
+
+/*
+ * Completion callback of an ESYS_LOOP. rc is TSS2_RC_SUCCESS if the response
+ * of the context can be fetched with the _Finish function of the command, or
+ * TSS2_ESYS_RC_TRY_AGAIN if it did not arrive in time.
+ */
+typedef void (*ESYS_COMPLETION_CB)(
+    ESYS_CONTEXT *esys_context,
+    TSS2_RC rc,
+    void *userdata);
+
+typedef struct ESYS_POOL ESYS_POOL;
+
+/*
+ * Next action for a command driven with Esys_Step. NEED_READ: wait until a
+ * poll handle is readable and step again. NEED_WRITE: the TPM asked for the
+ * command to be resubmitted; call the _Finish function, which sends it again
+ * and returns TSS2_ESYS_RC_TRY_AGAIN, and step again. DONE: call the _Finish
+ * function, which does not block. ERROR: the step failed.
+ */
+typedef uint32_t ESYS_STEP;
+#define ESYS_STEP_NEED_READ  1U
+#define ESYS_STEP_NEED_WRITE 2U
+#define ESYS_STEP_DONE       3U
+#define ESYS_STEP_ERROR      4U
+
+/*
+ * Time in microseconds spent in the phases of the last command; see
+ * Esys_GetTimings. prepare: host side work of the _Async function (sessions,
+ * parameter encryption, marshaling). tpm: waiting for the TPM, summed over
+ * resubmissions. verify: checking the response HMACs and decrypting the
+ * response parameters.
+ */
+typedef struct {
+    uint64_t prepare;
+    uint64_t tpm;
+    uint64_t verify;
+} ESYS_TIMINGS;
+
+/*
+ * Resubmission rule for one TPM response code; see Esys_SetRetryPolicy. A
+ * command is submitted at most maxSubmissions times. Before the n-th
+ * resubmission ESYS waits initialDelay * 2^(n-1) ms, but no more than
+ * maxDelay ms, less a random share of up to jitter percent of the wait.
+ */
+typedef struct {
+    UINT32 maxSubmissions;
+    UINT32 initialDelay;
+    UINT32 maxDelay;
+    UINT32 jitter;
+} ESYS_RETRY_RULE;
+
+typedef struct {
+    ESYS_RETRY_RULE retry;      /* TPM2_RC_RETRY */
+    ESYS_RETRY_RULE yielded;    /* TPM2_RC_YIELDED */
+    ESYS_RETRY_RULE testing;    /* TPM2_RC_TESTING */
+} ESYS_RETRY_POLICY;
+
+/*
+ * Resubmissions of one command code; see Esys_GetRetryStats. delay is the
+ * wait before the resubmissions in ms, exhausted the number of commands that
+ * failed because maxSubmissions was reached.
+ */
+typedef struct {
+    UINT64 retries;
+    UINT64 delay;
+    UINT64 exhausted;
+} ESYS_RETRY_STATS;
+
+/*
+ * One measurement of Esys_PCR_ExtendBatch. If hashEvent is set, eventData is
+ * hashed by the TPM (TPM2_PCR_Event), otherwise digests are extended
+ * (TPM2_PCR_Extend). eventType and eventData go into the event log.
+ */
+typedef struct {
+    ESYS_TR pcrHandle;
+    UINT32 eventType;
+    TPMI_YES_NO hashEvent;
+    TPML_DIGEST_VALUES digests;
+    TPM2B_EVENT eventData;
+} ESYS_PCR_EXTEND_ENTRY;
+
+/*
+ * An entity referenced by a policy. The name is used to compute the policy
+ * digest; if its size is 0, it is taken from handle. handle is used to
+ * execute the policy.
+ */
+typedef struct {
+    ESYS_TR handle;
+    TPM2B_NAME name;
+} ESYS_POLICY_ENTITY;
+
+typedef struct ESYS_POLICY_ELEMENT ESYS_POLICY_ELEMENT;
+
+/* A list of policy commands as used by Esys_PolicyCalculate. */
+typedef struct {
+    const ESYS_POLICY_ELEMENT *elements;
+    size_t count;
+} ESYS_POLICY;
+
+/*
+ * One policy command of an ESYS_POLICY. commandCode selects the command
+ * (TPM2_CC_PolicyPCR, ...) and the member of args holding its parameters.
+ * The branches of a TPM2_CC_PolicyOR continue the policy digest of the
+ * preceding elements; selected is the branch taken by Esys_PolicyExecute.
+ * Members only needed to execute the policy are marked as such.
+ */
+struct ESYS_POLICY_ELEMENT {
+    TPM2_CC commandCode;
+    union {
+        struct {
+            TPML_PCR_SELECTION pcrs;
+            TPM2B_DIGEST pcrDigest;
+        } policyPCR;
+        struct {
+            TPM2_CC code;
+        } policyCommandCode;
+        struct {
+            TPMA_LOCALITY locality;
+        } policyLocality;
+        struct {
+            TPM2B_DIGEST digest;
+        } policyCpHash, policyNameHash, policyTemplate;
+        struct {
+            TPMI_YES_NO writtenSet;
+        } policyNvWritten;
+        struct {
+            ESYS_POLICY_ENTITY authObject;
+            TPM2B_NONCE policyRef;
+            ESYS_TR authSession;            /* execution only */
+        } policySecret;
+        struct {
+            ESYS_POLICY_ENTITY authObject;
+            TPM2B_NONCE policyRef;
+            TPMT_SIGNATURE auth;            /* execution only */
+        } policySigned;
+        struct {
+            ESYS_POLICY_ENTITY nvIndex;
+            TPM2B_OPERAND operandB;
+            UINT16 offset;
+            TPM2_EO operation;
+            ESYS_TR authHandle;             /* execution only */
+            ESYS_TR authSession;            /* execution only */
+        } policyNV;
+        struct {
+            TPM2B_OPERAND operandB;
+            UINT16 offset;
+            TPM2_EO operation;
+        } policyCounterTimer;
+        struct {
+            TPM2B_NAME objectName;
+            TPM2B_NAME newParentName;
+            TPMI_YES_NO includeObject;
+        } policyDuplicationSelect;
+        struct {
+            ESYS_POLICY_ENTITY keySign;
+            TPM2B_NONCE policyRef;
+            TPMT_TK_VERIFIED checkTicket;   /* execution only */
+        } policyAuthorize;
+        struct {
+            ESYS_POLICY_ENTITY nvIndex;
+            ESYS_TR authHandle;             /* execution only */
+            ESYS_TR authSession;            /* execution only */
+        } policyAuthorizeNV;
+        struct {
+            const ESYS_POLICY *branches;
+            UINT32 count;
+            UINT32 selected;                /* execution only */
+        } policyOR;
+    } args;
+};
+
 /*
  * TPM 2.0 ESAPI Functions
  */
@@ -79,6 +284,18 @@ void
 Esys_Finalize(
     ESYS_CONTEXT **context);
 
+TSS2_RC
+Esys_Clone(
+    ESYS_CONTEXT *esys_context,
+    TSS2_TCTI_CONTEXT *tcti,
+    ESYS_CONTEXT **clone);
+
+TSS2_RC
+Esys_AfterFork(
+    ESYS_CONTEXT *esys_context,
+    TSS2_TCTI_CONTEXT *tcti,
+    TSS2_TCTI_CONTEXT **tcti_inherited);
+
 TSS2_RC
 Esys_GetTcti(
     ESYS_CONTEXT *esys_context,
@@ -95,6 +312,106 @@ Esys_SetTimeout(
     ESYS_CONTEXT *esys_context,
     int32_t timeout);
 
+TSS2_RC
+Esys_Step(
+    ESYS_CONTEXT *esys_context,
+    ESYS_STEP *step,
+    TSS2_TCTI_POLL_HANDLE *handles,
+    size_t *count);
+
+TSS2_RC
+Esys_SetDeadline(
+    ESYS_CONTEXT *esys_context,
+    int32_t timeout);
+
+TSS2_RC
+Esys_GetTimings(
+    ESYS_CONTEXT *esys_context,
+    ESYS_TIMINGS *timings);
+
+TSS2_RC
+Esys_SetRetryPolicy(
+    ESYS_CONTEXT *esys_context,
+    const ESYS_RETRY_POLICY *policy);
+
+TSS2_RC
+Esys_GetRetryStats(
+    ESYS_CONTEXT *esys_context,
+    TPM2_CC commandCode,
+    ESYS_RETRY_STATS *stats);
+
+TSS2_RC
+Esys_SetOutputBuffer(
+    ESYS_CONTEXT *esys_context,
+    void *buffer,
+    size_t size);
+
+void
+Esys_FreeOutput(
+    ESYS_CONTEXT *esys_context,
+    void *ptr);
+
+TSS2_RC
+Esys_SetAllocator(
+    ESYS_CONTEXT *esys_context,
+    ESYS_ALLOC_CB allocCb,
+    ESYS_FREE_CB freeCb,
+    void *userdata);
+
+TSS2_RC
+Esys_Loop_Initialize(
+    ESYS_LOOP **loop);
+
+void
+Esys_Loop_Finalize(
+    ESYS_LOOP **loop);
+
+TSS2_RC
+Esys_Loop_Add(
+    ESYS_LOOP *loop,
+    ESYS_CONTEXT *esys_context,
+    int32_t timeout,
+    ESYS_COMPLETION_CB callback,
+    void *userdata);
+
+TSS2_RC
+Esys_Loop_Run(
+    ESYS_LOOP *loop,
+    int32_t timeout);
+
+TSS2_RC
+Esys_Pool_Initialize(
+    ESYS_POOL **pool,
+    size_t count,
+    size_t maxObjects,
+    const char *tctiConf,
+    TSS2_ABI_VERSION *abiVersion);
+
+void
+Esys_Pool_Finalize(
+    ESYS_POOL **pool);
+
+TSS2_RC
+Esys_Pool_Acquire(
+    ESYS_POOL *pool,
+    ESYS_CONTEXT **esys_context);
+
+TSS2_RC
+Esys_Pool_Release(
+    ESYS_POOL *pool,
+    ESYS_CONTEXT *esys_context);
+
+TSS2_RC
+Esys_Pool_Share(
+    ESYS_POOL *pool,
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR object,
+    ESYS_TR *poolHandle);
+
+TSS2_RC
+Esys_AdjustBufferSizes(
+    ESYS_CONTEXT *esys_context);
+
 TSS2_RC
 Esys_TR_Serialize(
     ESYS_CONTEXT *esys_context,
@@ -131,6 +448,25 @@ Esys_TR_FromTPMPublic(
     ESYS_TR optionalSession3,
     ESYS_TR *object);
 
+TSS2_RC
+Esys_TR_FromTPMPublicList(
+    ESYS_CONTEXT *esysContext,
+    ESYS_CONTEXT *const *shards,
+    size_t shardCount,
+    const TPM2_HANDLE *tpmHandles,
+    size_t count,
+    ESYS_TR *objects);
+
+TSS2_RC
+Esys_TR_FromTPMHandleRange(
+    ESYS_CONTEXT *esysContext,
+    ESYS_CONTEXT *const *shards,
+    size_t shardCount,
+    TPM2_HANDLE firstHandle,
+    UINT32 maxCount,
+    ESYS_TR **objects,
+    size_t *count);
+
 TSS2_RC
 Esys_TR_Close(
     ESYS_CONTEXT *esys_context,
@@ -939,6 +1275,22 @@ Esys_EncryptDecrypt2_Finish(
     TPM2B_MAX_BUFFER **outData,
     TPM2B_IV **ivOut);
 
+TSS2_RC
+Esys_EncryptDecryptStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR keyHandle,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    TPMI_YES_NO decrypt,
+    TPMI_ALG_SYM_MODE mode,
+    const TPM2B_IV *ivIn,
+    ESYS_READ_CB read,
+    void *readUserdata,
+    ESYS_WRITE_CB write,
+    void *writeUserdata,
+    TPM2B_IV **ivOut);
+
 /* Table 62 - TPM2_Hash Command */
 
 TSS2_RC
@@ -1021,6 +1373,21 @@ Esys_GetRandom_Finish(
     ESYS_CONTEXT *esysContext,
     TPM2B_DIGEST **randomBytes);
 
+TSS2_RC
+Esys_GetRandomBytes(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    size_t size,
+    uint8_t *data);
+
+TSS2_RC
+Esys_SetRandomReservoir(
+    ESYS_CONTEXT *esysContext,
+    size_t size,
+    size_t lowWater);
+
 /* Table 68 - TPM2_StirRandom Command */
 
 TSS2_RC
@@ -1151,6 +1518,31 @@ Esys_SequenceComplete_Finish(
     TPM2B_DIGEST **result,
     TPMT_TK_HASHCHECK **validation);
 
+TSS2_RC
+Esys_HashStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    TPMI_ALG_HASH hashAlg,
+    TPMI_RH_HIERARCHY hierarchy,
+    ESYS_READ_CB read,
+    void *userdata,
+    TPM2B_DIGEST **result,
+    TPMT_TK_HASHCHECK **validation);
+
+TSS2_RC
+Esys_HMACStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR handle,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    TPMI_ALG_HASH hashAlg,
+    ESYS_READ_CB read,
+    void *userdata,
+    TPM2B_DIGEST **result);
+
 /* Table 79 - TPM2_EventSequenceComplete Command */
 
 TSS2_RC
@@ -1467,6 +1859,17 @@ Esys_VerifySignature_Finish(
     ESYS_CONTEXT *esysContext,
     TPMT_TK_VERIFIED **validation);
 
+TSS2_RC
+Esys_VerifySignatureLocal(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR keyHandle,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const TPM2B_DIGEST *digest,
+    const TPMT_SIGNATURE *signature,
+    TPMT_TK_VERIFIED **validation);
+
 /* Table 99 - TPM2_Sign Command */
 
 TSS2_RC
@@ -1497,6 +1900,20 @@ Esys_Sign_Finish(
     ESYS_CONTEXT *esysContext,
     TPMT_SIGNATURE **signature);
 
+TSS2_RC
+Esys_SignBatch(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR keyHandle,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const TPM2B_DIGEST *digests,
+    size_t count,
+    const TPMT_SIG_SCHEME *inScheme,
+    const TPMT_TK_HASHCHECK *validation,
+    TPMT_SIGNATURE *signatures,
+    size_t *signedCount);
+
 /* Table 101 - TPM2_SetCommandCodeAuditStatus Command */
 
 TSS2_RC
@@ -1575,6 +1992,19 @@ Esys_PCR_Event_Finish(
     ESYS_CONTEXT *esysContext,
     TPML_DIGEST_VALUES **digests);
 
+TSS2_RC
+Esys_PCR_ExtendBatch(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const ESYS_PCR_EXTEND_ENTRY *entries,
+    size_t count,
+    TSS2_RC *results,
+    uint8_t *eventLog,
+    size_t eventLogSize,
+    size_t *eventLogOffset);
+
 /* Table 107 - TPM2_PCR_Read Command */
 
 TSS2_RC
@@ -1603,6 +2033,18 @@ Esys_PCR_Read_Finish(
     TPML_PCR_SELECTION **pcrSelectionOut,
     TPML_DIGEST **pcrValues);
 
+TSS2_RC
+Esys_PCR_ReadSnapshot(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const TPML_PCR_SELECTION *pcrSelectionIn,
+    UINT32 *pcrUpdateCounter,
+    TPML_PCR_SELECTION **pcrSelectionOut,
+    TPM2B_DIGEST **pcrValues,
+    size_t *pcrValuesCount);
+
 /* Table 109 - TPM2_PCR_Allocate Command */
 
 TSS2_RC
@@ -2243,6 +2685,19 @@ TSS2_RC
 Esys_PolicyAuthorizeNV_Finish(
     ESYS_CONTEXT *esysContext);
 
+TSS2_RC
+Esys_PolicyCalculate(
+    ESYS_CONTEXT *esysContext,
+    const ESYS_POLICY *policy,
+    TPMI_ALG_HASH hashAlg,
+    TPM2B_DIGEST *policyDigest);
+
+TSS2_RC
+Esys_PolicyExecute(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR policySession,
+    const ESYS_POLICY *policy);
+
 /* Table 157 - TPM2_CreatePrimary Command */
 
 TSS2_RC
@@ -2944,6 +3399,18 @@ Esys_NV_Write(
     const TPM2B_MAX_NV_BUFFER *data,
     UINT16 offset);
 
+TSS2_RC
+Esys_NV_WriteStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    UINT16 offset,
+    size_t size,
+    const uint8_t *data);
+
 TSS2_RC
 Esys_NV_Write_Async(
     ESYS_CONTEXT *esysContext,
@@ -3095,6 +3562,18 @@ Esys_NV_Read(
     UINT16 offset,
     TPM2B_MAX_NV_BUFFER **data);
 
+TSS2_RC
+Esys_NV_ReadStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    UINT16 offset,
+    size_t size,
+    uint8_t *data);
+
 TSS2_RC
 Esys_NV_Read_Async(
     ESYS_CONTEXT *esysContext,
@@ -1995,6 +1995,484 @@ Tss2_MU_TPMS_EMPTY_Unmarshal(
     size_t          *offset,
     TPMS_EMPTY      *out);
 
+/*
+ * Worst-case marshaled sizes of the TPM types handled by this library.
+ *
+ * TSS2_MU_<type>_MAX_SIZE is the largest number of bytes that
+ * Tss2_MU_<type>_Marshal can write for any valid value of the type. It is
+ * the size on the wire and independent of the padding and alignment of
+ * the C structure, so it may be smaller than sizeof(<type>).
+ * TSS2_MU_<type>_FIXED_SIZE is 1 if every value of the type marshals to
+ * exactly TSS2_MU_<type>_MAX_SIZE bytes, 0 otherwise.
+ *
+ * All values are integer constant expressions and may be used to size
+ * static buffers.
+ */
+#define TSS2_MU_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define TSS2_MU_MEMBER_SIZE(type, member) (sizeof(((type *)0)->member))
+#define TSS2_MU_ARRAY_LEN(type, member) \
+    (TSS2_MU_MEMBER_SIZE(type, member) / TSS2_MU_MEMBER_SIZE(type, member[0]))
+
+/* Base types */
+#define TSS2_MU_BYTE_MAX_SIZE sizeof(BYTE)
+#define TSS2_MU_BYTE_FIXED_SIZE 1
+#define TSS2_MU_INT8_MAX_SIZE sizeof(INT8)
+#define TSS2_MU_INT8_FIXED_SIZE 1
+#define TSS2_MU_INT16_MAX_SIZE sizeof(INT16)
+#define TSS2_MU_INT16_FIXED_SIZE 1
+#define TSS2_MU_INT32_MAX_SIZE sizeof(INT32)
+#define TSS2_MU_INT32_FIXED_SIZE 1
+#define TSS2_MU_INT64_MAX_SIZE sizeof(INT64)
+#define TSS2_MU_INT64_FIXED_SIZE 1
+#define TSS2_MU_UINT8_MAX_SIZE sizeof(UINT8)
+#define TSS2_MU_UINT8_FIXED_SIZE 1
+#define TSS2_MU_UINT16_MAX_SIZE sizeof(UINT16)
+#define TSS2_MU_UINT16_FIXED_SIZE 1
+#define TSS2_MU_UINT32_MAX_SIZE sizeof(UINT32)
+#define TSS2_MU_UINT32_FIXED_SIZE 1
+#define TSS2_MU_UINT64_MAX_SIZE sizeof(UINT64)
+#define TSS2_MU_UINT64_FIXED_SIZE 1
+#define TSS2_MU_TPM2_CC_MAX_SIZE sizeof(TPM2_CC)
+#define TSS2_MU_TPM2_CC_FIXED_SIZE 1
+#define TSS2_MU_TPM2_ST_MAX_SIZE sizeof(TPM2_ST)
+#define TSS2_MU_TPM2_ST_FIXED_SIZE 1
+#define TSS2_MU_TPM2_SE_MAX_SIZE sizeof(TPM2_SE)
+#define TSS2_MU_TPM2_SE_FIXED_SIZE 1
+#define TSS2_MU_TPM2_NT_MAX_SIZE sizeof(TPM2_NT)
+#define TSS2_MU_TPM2_NT_FIXED_SIZE 1
+#define TSS2_MU_TPM2_HANDLE_MAX_SIZE sizeof(TPM2_HANDLE)
+#define TSS2_MU_TPM2_HANDLE_FIXED_SIZE 1
+#define TSS2_MU_TPMI_ALG_HASH_MAX_SIZE sizeof(TPMI_ALG_HASH)
+#define TSS2_MU_TPMI_ALG_HASH_FIXED_SIZE 1
+
+/* Attribute types */
+#define TSS2_MU_TPMA_ALGORITHM_MAX_SIZE sizeof(TPMA_ALGORITHM)
+#define TSS2_MU_TPMA_ALGORITHM_FIXED_SIZE 1
+#define TSS2_MU_TPMA_CC_MAX_SIZE sizeof(TPMA_CC)
+#define TSS2_MU_TPMA_CC_FIXED_SIZE 1
+#define TSS2_MU_TPMA_LOCALITY_MAX_SIZE sizeof(TPMA_LOCALITY)
+#define TSS2_MU_TPMA_LOCALITY_FIXED_SIZE 1
+#define TSS2_MU_TPMA_NV_MAX_SIZE sizeof(TPMA_NV)
+#define TSS2_MU_TPMA_NV_FIXED_SIZE 1
+#define TSS2_MU_TPMA_OBJECT_MAX_SIZE sizeof(TPMA_OBJECT)
+#define TSS2_MU_TPMA_OBJECT_FIXED_SIZE 1
+#define TSS2_MU_TPMA_PERMANENT_MAX_SIZE sizeof(TPMA_PERMANENT)
+#define TSS2_MU_TPMA_PERMANENT_FIXED_SIZE 1
+#define TSS2_MU_TPMA_SESSION_MAX_SIZE sizeof(TPMA_SESSION)
+#define TSS2_MU_TPMA_SESSION_FIXED_SIZE 1
+#define TSS2_MU_TPMA_STARTUP_CLEAR_MAX_SIZE sizeof(TPMA_STARTUP_CLEAR)
+#define TSS2_MU_TPMA_STARTUP_CLEAR_FIXED_SIZE 1
+
+/* Sized buffers: the size field plus the largest payload accepted by MU */
+#define TSS2_MU_TPM2B_DIGEST_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_DIGEST, buffer))
+#define TSS2_MU_TPM2B_DIGEST_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_DATA_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_DATA, buffer))
+#define TSS2_MU_TPM2B_DATA_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_EVENT_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_EVENT, buffer))
+#define TSS2_MU_TPM2B_EVENT_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_MAX_BUFFER_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_MAX_BUFFER, buffer))
+#define TSS2_MU_TPM2B_MAX_BUFFER_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_MAX_NV_BUFFER_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_MAX_NV_BUFFER, buffer))
+#define TSS2_MU_TPM2B_MAX_NV_BUFFER_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_IV_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_IV, buffer))
+#define TSS2_MU_TPM2B_IV_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_NAME_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_NAME, name))
+#define TSS2_MU_TPM2B_NAME_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_ATTEST_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_ATTEST, attestationData))
+#define TSS2_MU_TPM2B_ATTEST_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_SYM_KEY_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_SYM_KEY, buffer))
+#define TSS2_MU_TPM2B_SYM_KEY_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_SENSITIVE_DATA_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_SENSITIVE_DATA, buffer))
+#define TSS2_MU_TPM2B_SENSITIVE_DATA_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_PUBLIC_KEY_RSA_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_PUBLIC_KEY_RSA, buffer))
+#define TSS2_MU_TPM2B_PUBLIC_KEY_RSA_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_PRIVATE_KEY_RSA_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_PRIVATE_KEY_RSA, buffer))
+#define TSS2_MU_TPM2B_PRIVATE_KEY_RSA_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_ECC_PARAMETER_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_ECC_PARAMETER, buffer))
+#define TSS2_MU_TPM2B_ECC_PARAMETER_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_ENCRYPTED_SECRET_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_ENCRYPTED_SECRET, secret))
+#define TSS2_MU_TPM2B_ENCRYPTED_SECRET_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_PRIVATE_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_PRIVATE, buffer))
+#define TSS2_MU_TPM2B_PRIVATE_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_ID_OBJECT_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_ID_OBJECT, credential))
+#define TSS2_MU_TPM2B_ID_OBJECT_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_CONTEXT_SENSITIVE_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_CONTEXT_SENSITIVE, buffer))
+#define TSS2_MU_TPM2B_CONTEXT_SENSITIVE_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_CONTEXT_DATA_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_CONTEXT_DATA, buffer))
+#define TSS2_MU_TPM2B_CONTEXT_DATA_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_TEMPLATE_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_MEMBER_SIZE(TPM2B_TEMPLATE, buffer))
+#define TSS2_MU_TPM2B_TEMPLATE_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_NONCE_MAX_SIZE TSS2_MU_TPM2B_DIGEST_MAX_SIZE
+#define TSS2_MU_TPM2B_NONCE_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_AUTH_MAX_SIZE TSS2_MU_TPM2B_DIGEST_MAX_SIZE
+#define TSS2_MU_TPM2B_AUTH_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_OPERAND_MAX_SIZE TSS2_MU_TPM2B_DIGEST_MAX_SIZE
+#define TSS2_MU_TPM2B_OPERAND_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_TIMEOUT_MAX_SIZE TSS2_MU_TPM2B_DIGEST_MAX_SIZE
+#define TSS2_MU_TPM2B_TIMEOUT_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMS_ECC_POINT_MAX_SIZE)
+#define TSS2_MU_TPM2B_ECC_POINT_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_NV_PUBLIC_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMS_NV_PUBLIC_MAX_SIZE)
+#define TSS2_MU_TPM2B_NV_PUBLIC_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_SENSITIVE_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMT_SENSITIVE_MAX_SIZE)
+#define TSS2_MU_TPM2B_SENSITIVE_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_SENSITIVE_CREATE_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMS_SENSITIVE_CREATE_MAX_SIZE)
+#define TSS2_MU_TPM2B_SENSITIVE_CREATE_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_CREATION_DATA_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMS_CREATION_DATA_MAX_SIZE)
+#define TSS2_MU_TPM2B_CREATION_DATA_FIXED_SIZE 0
+#define TSS2_MU_TPM2B_PUBLIC_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMT_PUBLIC_MAX_SIZE)
+#define TSS2_MU_TPM2B_PUBLIC_FIXED_SIZE 0
+
+/* Structures */
+#define TSS2_MU_TPMS_EMPTY_MAX_SIZE 0
+#define TSS2_MU_TPMS_EMPTY_FIXED_SIZE 1
+#define TSS2_MU_TPMS_ALG_PROPERTY_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMA_ALGORITHM_MAX_SIZE)
+#define TSS2_MU_TPMS_ALG_PROPERTY_FIXED_SIZE 1
+#define TSS2_MU_TPMS_ALGORITHM_DESCRIPTION_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMA_ALGORITHM_MAX_SIZE)
+#define TSS2_MU_TPMS_ALGORITHM_DESCRIPTION_FIXED_SIZE 1
+#define TSS2_MU_TPMS_TAGGED_PROPERTY_MAX_SIZE (sizeof(UINT32) + sizeof(UINT32))
+#define TSS2_MU_TPMS_TAGGED_PROPERTY_FIXED_SIZE 1
+#define TSS2_MU_TPMS_TAGGED_POLICY_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_TPMT_HA_MAX_SIZE)
+#define TSS2_MU_TPMS_TAGGED_POLICY_FIXED_SIZE 0
+#define TSS2_MU_TPMS_CLOCK_INFO_MAX_SIZE \
+    (sizeof(UINT64) + sizeof(UINT32) + sizeof(UINT32) + sizeof(UINT8))
+#define TSS2_MU_TPMS_CLOCK_INFO_FIXED_SIZE 1
+#define TSS2_MU_TPMS_TIME_INFO_MAX_SIZE \
+    (sizeof(UINT64) + TSS2_MU_TPMS_CLOCK_INFO_MAX_SIZE)
+#define TSS2_MU_TPMS_TIME_INFO_FIXED_SIZE 1
+#define TSS2_MU_TPMS_TIME_ATTEST_INFO_MAX_SIZE \
+    (TSS2_MU_TPMS_TIME_INFO_MAX_SIZE + sizeof(UINT64))
+#define TSS2_MU_TPMS_TIME_ATTEST_INFO_FIXED_SIZE 1
+#define TSS2_MU_TPMS_CERTIFY_INFO_MAX_SIZE \
+    (TSS2_MU_TPM2B_NAME_MAX_SIZE + TSS2_MU_TPM2B_NAME_MAX_SIZE)
+#define TSS2_MU_TPMS_CERTIFY_INFO_FIXED_SIZE 0
+#define TSS2_MU_TPMS_COMMAND_AUDIT_INFO_MAX_SIZE \
+    (sizeof(UINT64) + sizeof(UINT16) + TSS2_MU_TPM2B_DIGEST_MAX_SIZE + \
+        TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMS_COMMAND_AUDIT_INFO_FIXED_SIZE 0
+#define TSS2_MU_TPMS_SESSION_AUDIT_INFO_MAX_SIZE \
+    (sizeof(UINT8) + TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMS_SESSION_AUDIT_INFO_FIXED_SIZE 0
+#define TSS2_MU_TPMS_CREATION_INFO_MAX_SIZE \
+    (TSS2_MU_TPM2B_NAME_MAX_SIZE + TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMS_CREATION_INFO_FIXED_SIZE 0
+#define TSS2_MU_TPMS_NV_CERTIFY_INFO_MAX_SIZE \
+    (TSS2_MU_TPM2B_NAME_MAX_SIZE + sizeof(UINT16) + \
+        TSS2_MU_TPM2B_MAX_NV_BUFFER_MAX_SIZE)
+#define TSS2_MU_TPMS_NV_CERTIFY_INFO_FIXED_SIZE 0
+#define TSS2_MU_TPMS_AUTH_COMMAND_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_TPM2B_NONCE_MAX_SIZE + \
+        TSS2_MU_TPMA_SESSION_MAX_SIZE + TSS2_MU_TPM2B_AUTH_MAX_SIZE)
+#define TSS2_MU_TPMS_AUTH_COMMAND_FIXED_SIZE 0
+#define TSS2_MU_TPMS_AUTH_RESPONSE_MAX_SIZE \
+    (TSS2_MU_TPM2B_NONCE_MAX_SIZE + TSS2_MU_TPMA_SESSION_MAX_SIZE + \
+        TSS2_MU_TPM2B_AUTH_MAX_SIZE)
+#define TSS2_MU_TPMS_AUTH_RESPONSE_FIXED_SIZE 0
+#define TSS2_MU_TPMS_SENSITIVE_CREATE_MAX_SIZE \
+    (TSS2_MU_TPM2B_AUTH_MAX_SIZE + TSS2_MU_TPM2B_SENSITIVE_DATA_MAX_SIZE)
+#define TSS2_MU_TPMS_SENSITIVE_CREATE_FIXED_SIZE 0
+#define TSS2_MU_TPMS_SCHEME_HASH_MAX_SIZE sizeof(UINT16)
+#define TSS2_MU_TPMS_SCHEME_HASH_FIXED_SIZE 1
+#define TSS2_MU_TPMS_SCHEME_ECDAA_MAX_SIZE (sizeof(UINT16) + sizeof(UINT16))
+#define TSS2_MU_TPMS_SCHEME_ECDAA_FIXED_SIZE 1
+#define TSS2_MU_TPMS_SCHEME_XOR_MAX_SIZE (sizeof(UINT16) + sizeof(UINT16))
+#define TSS2_MU_TPMS_SCHEME_XOR_FIXED_SIZE 1
+#define TSS2_MU_TPMS_ECC_POINT_MAX_SIZE \
+    (TSS2_MU_TPM2B_ECC_PARAMETER_MAX_SIZE + \
+        TSS2_MU_TPM2B_ECC_PARAMETER_MAX_SIZE)
+#define TSS2_MU_TPMS_ECC_POINT_FIXED_SIZE 0
+#define TSS2_MU_TPMS_SIGNATURE_RSA_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPM2B_PUBLIC_KEY_RSA_MAX_SIZE)
+#define TSS2_MU_TPMS_SIGNATURE_RSA_FIXED_SIZE 0
+#define TSS2_MU_TPMS_SIGNATURE_ECC_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPM2B_ECC_PARAMETER_MAX_SIZE + \
+        TSS2_MU_TPM2B_ECC_PARAMETER_MAX_SIZE)
+#define TSS2_MU_TPMS_SIGNATURE_ECC_FIXED_SIZE 0
+#define TSS2_MU_TPMS_NV_PIN_COUNTER_PARAMETERS_MAX_SIZE \
+    (sizeof(UINT32) + sizeof(UINT32))
+#define TSS2_MU_TPMS_NV_PIN_COUNTER_PARAMETERS_FIXED_SIZE 1
+#define TSS2_MU_TPMS_NV_PUBLIC_MAX_SIZE \
+    (sizeof(UINT32) + sizeof(UINT16) + TSS2_MU_TPMA_NV_MAX_SIZE + \
+        TSS2_MU_TPM2B_DIGEST_MAX_SIZE + sizeof(UINT16))
+#define TSS2_MU_TPMS_NV_PUBLIC_FIXED_SIZE 0
+#define TSS2_MU_TPMS_CONTEXT_DATA_MAX_SIZE \
+    (TSS2_MU_TPM2B_DIGEST_MAX_SIZE + TSS2_MU_TPM2B_CONTEXT_SENSITIVE_MAX_SIZE)
+#define TSS2_MU_TPMS_CONTEXT_DATA_FIXED_SIZE 0
+#define TSS2_MU_TPMS_CONTEXT_MAX_SIZE \
+    (sizeof(UINT64) + sizeof(UINT32) + sizeof(UINT32) + \
+        TSS2_MU_TPM2B_CONTEXT_DATA_MAX_SIZE)
+#define TSS2_MU_TPMS_CONTEXT_FIXED_SIZE 0
+#define TSS2_MU_TPMS_PCR_SELECT_MAX_SIZE (sizeof(UINT8) + TPM2_PCR_SELECT_MAX)
+#define TSS2_MU_TPMS_PCR_SELECT_FIXED_SIZE 0
+#define TSS2_MU_TPMS_PCR_SELECTION_MAX_SIZE \
+    (sizeof(UINT16) + sizeof(UINT8) + TPM2_PCR_SELECT_MAX)
+#define TSS2_MU_TPMS_PCR_SELECTION_FIXED_SIZE 0
+#define TSS2_MU_TPMS_TAGGED_PCR_SELECT_MAX_SIZE \
+    (sizeof(UINT32) + sizeof(UINT8) + TPM2_PCR_SELECT_MAX)
+#define TSS2_MU_TPMS_TAGGED_PCR_SELECT_FIXED_SIZE 0
+#define TSS2_MU_TPMS_QUOTE_INFO_MAX_SIZE \
+    (TSS2_MU_TPML_PCR_SELECTION_MAX_SIZE + TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMS_QUOTE_INFO_FIXED_SIZE 0
+#define TSS2_MU_TPMS_CREATION_DATA_MAX_SIZE \
+    (TSS2_MU_TPML_PCR_SELECTION_MAX_SIZE + TSS2_MU_TPM2B_DIGEST_MAX_SIZE + \
+        TSS2_MU_TPMA_LOCALITY_MAX_SIZE + sizeof(UINT16) + \
+        TSS2_MU_TPM2B_NAME_MAX_SIZE + TSS2_MU_TPM2B_NAME_MAX_SIZE + \
+        TSS2_MU_TPM2B_DATA_MAX_SIZE)
+#define TSS2_MU_TPMS_CREATION_DATA_FIXED_SIZE 0
+#define TSS2_MU_TPMS_ECC_PARMS_MAX_SIZE \
+    (TSS2_MU_TPMT_SYM_DEF_OBJECT_MAX_SIZE + TSS2_MU_TPMT_ECC_SCHEME_MAX_SIZE + \
+        sizeof(UINT16) + TSS2_MU_TPMT_KDF_SCHEME_MAX_SIZE)
+#define TSS2_MU_TPMS_ECC_PARMS_FIXED_SIZE 0
+#define TSS2_MU_TPMS_ATTEST_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_TPM2_ST_MAX_SIZE + TSS2_MU_TPM2B_NAME_MAX_SIZE + \
+        TSS2_MU_TPM2B_DATA_MAX_SIZE + TSS2_MU_TPMS_CLOCK_INFO_MAX_SIZE + \
+        sizeof(UINT64) + TSS2_MU_TPMU_ATTEST_MAX_SIZE)
+#define TSS2_MU_TPMS_ATTEST_FIXED_SIZE 0
+#define TSS2_MU_TPMS_ALGORITHM_DETAIL_ECC_MAX_SIZE \
+    (sizeof(UINT16) + sizeof(UINT16) + TSS2_MU_TPMT_KDF_SCHEME_MAX_SIZE + \
+        TSS2_MU_TPMT_ECC_SCHEME_MAX_SIZE + \
+        7 * TSS2_MU_TPM2B_ECC_PARAMETER_MAX_SIZE)
+#define TSS2_MU_TPMS_ALGORITHM_DETAIL_ECC_FIXED_SIZE 0
+#define TSS2_MU_TPMS_CAPABILITY_DATA_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_TPMU_CAPABILITIES_MAX_SIZE)
+#define TSS2_MU_TPMS_CAPABILITY_DATA_FIXED_SIZE 0
+#define TSS2_MU_TPMS_KEYEDHASH_PARMS_MAX_SIZE \
+    TSS2_MU_TPMT_KEYEDHASH_SCHEME_MAX_SIZE
+#define TSS2_MU_TPMS_KEYEDHASH_PARMS_FIXED_SIZE 0
+#define TSS2_MU_TPMS_RSA_PARMS_MAX_SIZE \
+    (TSS2_MU_TPMT_SYM_DEF_OBJECT_MAX_SIZE + TSS2_MU_TPMT_RSA_SCHEME_MAX_SIZE + \
+        sizeof(UINT16) + sizeof(UINT32))
+#define TSS2_MU_TPMS_RSA_PARMS_FIXED_SIZE 0
+#define TSS2_MU_TPMS_SYMCIPHER_PARMS_MAX_SIZE \
+    TSS2_MU_TPMT_SYM_DEF_OBJECT_MAX_SIZE
+#define TSS2_MU_TPMS_SYMCIPHER_PARMS_FIXED_SIZE 0
+#define TSS2_MU_TPMS_AC_OUTPUT_MAX_SIZE (sizeof(UINT32) + sizeof(UINT32))
+#define TSS2_MU_TPMS_AC_OUTPUT_FIXED_SIZE 1
+#define TSS2_MU_TPMS_ID_OBJECT_MAX_SIZE \
+    (TSS2_MU_TPM2B_DIGEST_MAX_SIZE + TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMS_ID_OBJECT_FIXED_SIZE 0
+
+/* Lists: the count field plus a full array */
+#define TSS2_MU_TPML_CC_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_CC, \
+        commandCodes) * TSS2_MU_TPM2_CC_MAX_SIZE)
+#define TSS2_MU_TPML_CC_FIXED_SIZE 0
+#define TSS2_MU_TPML_CCA_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_CCA, \
+        commandAttributes) * TSS2_MU_TPMA_CC_MAX_SIZE)
+#define TSS2_MU_TPML_CCA_FIXED_SIZE 0
+#define TSS2_MU_TPML_ALG_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_ALG, \
+        algorithms) * TSS2_MU_UINT16_MAX_SIZE)
+#define TSS2_MU_TPML_ALG_FIXED_SIZE 0
+#define TSS2_MU_TPML_HANDLE_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_HANDLE, \
+        handle) * TSS2_MU_TPM2_HANDLE_MAX_SIZE)
+#define TSS2_MU_TPML_HANDLE_FIXED_SIZE 0
+#define TSS2_MU_TPML_DIGEST_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_DIGEST, \
+        digests) * TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPML_DIGEST_FIXED_SIZE 0
+#define TSS2_MU_TPML_DIGEST_VALUES_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_DIGEST_VALUES, \
+        digests) * TSS2_MU_TPMT_HA_MAX_SIZE)
+#define TSS2_MU_TPML_DIGEST_VALUES_FIXED_SIZE 0
+#define TSS2_MU_TPML_PCR_SELECTION_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_PCR_SELECTION, \
+        pcrSelections) * TSS2_MU_TPMS_PCR_SELECTION_MAX_SIZE)
+#define TSS2_MU_TPML_PCR_SELECTION_FIXED_SIZE 0
+#define TSS2_MU_TPML_ALG_PROPERTY_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_ALG_PROPERTY, \
+        algProperties) * TSS2_MU_TPMS_ALG_PROPERTY_MAX_SIZE)
+#define TSS2_MU_TPML_ALG_PROPERTY_FIXED_SIZE 0
+#define TSS2_MU_TPML_ECC_CURVE_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_ECC_CURVE, \
+        eccCurves) * TSS2_MU_UINT16_MAX_SIZE)
+#define TSS2_MU_TPML_ECC_CURVE_FIXED_SIZE 0
+#define TSS2_MU_TPML_TAGGED_PCR_PROPERTY_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_TAGGED_PCR_PROPERTY, \
+        pcrProperty) * TSS2_MU_TPMS_TAGGED_PCR_SELECT_MAX_SIZE)
+#define TSS2_MU_TPML_TAGGED_PCR_PROPERTY_FIXED_SIZE 0
+#define TSS2_MU_TPML_TAGGED_TPM_PROPERTY_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_TAGGED_TPM_PROPERTY, \
+        tpmProperty) * TSS2_MU_TPMS_TAGGED_PROPERTY_MAX_SIZE)
+#define TSS2_MU_TPML_TAGGED_TPM_PROPERTY_FIXED_SIZE 0
+#define TSS2_MU_TPML_INTEL_PTT_PROPERTY_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_INTEL_PTT_PROPERTY, \
+        property) * TSS2_MU_UINT32_MAX_SIZE)
+#define TSS2_MU_TPML_INTEL_PTT_PROPERTY_FIXED_SIZE 0
+#define TSS2_MU_TPML_AC_CAPABILITIES_MAX_SIZE \
+    (sizeof(UINT32) + TSS2_MU_ARRAY_LEN(TPML_AC_CAPABILITIES, \
+        acCapabilities) * TSS2_MU_TPMS_AC_OUTPUT_MAX_SIZE)
+#define TSS2_MU_TPML_AC_CAPABILITIES_FIXED_SIZE 0
+
+/* Unions: the largest member marshaled for any selector */
+#define TSS2_MU_TPMU_HA_MAX_SIZE \
+    TSS2_MU_MAX(TPM2_SHA1_DIGEST_SIZE, TSS2_MU_MAX(TPM2_SHA256_DIGEST_SIZE, \
+        TSS2_MU_MAX(TPM2_SHA384_DIGEST_SIZE, \
+        TSS2_MU_MAX(TPM2_SHA512_DIGEST_SIZE, TPM2_SM3_256_DIGEST_SIZE))))
+#define TSS2_MU_TPMU_HA_FIXED_SIZE 0
+#define TSS2_MU_TPMU_CAPABILITIES_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPML_ALG_PROPERTY_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPML_HANDLE_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPML_CCA_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPML_CC_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPML_PCR_SELECTION_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPML_TAGGED_TPM_PROPERTY_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPML_TAGGED_PCR_PROPERTY_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPML_ECC_CURVE_MAX_SIZE, \
+        TSS2_MU_TPML_INTEL_PTT_PROPERTY_MAX_SIZE))))))))
+#define TSS2_MU_TPMU_CAPABILITIES_FIXED_SIZE 0
+#define TSS2_MU_TPMU_ATTEST_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPMS_CERTIFY_INFO_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPMS_CREATION_INFO_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPMS_QUOTE_INFO_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPMS_COMMAND_AUDIT_INFO_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPMS_SESSION_AUDIT_INFO_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPMS_TIME_ATTEST_INFO_MAX_SIZE, \
+        TSS2_MU_TPMS_NV_CERTIFY_INFO_MAX_SIZE))))))
+#define TSS2_MU_TPMU_ATTEST_FIXED_SIZE 0
+#define TSS2_MU_TPMU_SYM_KEY_BITS_MAX_SIZE sizeof(UINT16)
+#define TSS2_MU_TPMU_SYM_KEY_BITS_FIXED_SIZE 0
+#define TSS2_MU_TPMU_SYM_MODE_MAX_SIZE sizeof(UINT16)
+#define TSS2_MU_TPMU_SYM_MODE_FIXED_SIZE 0
+#define TSS2_MU_TPMU_SIG_SCHEME_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPMS_SCHEME_HASH_MAX_SIZE, \
+        TSS2_MU_TPMS_SCHEME_ECDAA_MAX_SIZE)
+#define TSS2_MU_TPMU_SIG_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMU_KDF_SCHEME_MAX_SIZE TSS2_MU_TPMS_SCHEME_HASH_MAX_SIZE
+#define TSS2_MU_TPMU_KDF_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMU_ASYM_SCHEME_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPMS_SCHEME_HASH_MAX_SIZE, \
+        TSS2_MU_TPMS_SCHEME_ECDAA_MAX_SIZE)
+#define TSS2_MU_TPMU_ASYM_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMU_SCHEME_KEYEDHASH_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPMS_SCHEME_HASH_MAX_SIZE, \
+        TSS2_MU_TPMS_SCHEME_XOR_MAX_SIZE)
+#define TSS2_MU_TPMU_SCHEME_KEYEDHASH_FIXED_SIZE 0
+#define TSS2_MU_TPMU_SIGNATURE_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPMS_SIGNATURE_RSA_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPMS_SIGNATURE_ECC_MAX_SIZE, \
+        TSS2_MU_TPMT_HA_MAX_SIZE))
+#define TSS2_MU_TPMU_SIGNATURE_FIXED_SIZE 0
+#define TSS2_MU_TPMU_SENSITIVE_COMPOSITE_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPM2B_PRIVATE_KEY_RSA_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPM2B_ECC_PARAMETER_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPM2B_SENSITIVE_DATA_MAX_SIZE, \
+        TSS2_MU_TPM2B_SYM_KEY_MAX_SIZE)))
+#define TSS2_MU_TPMU_SENSITIVE_COMPOSITE_FIXED_SIZE 0
+#define TSS2_MU_TPMU_ENCRYPTED_SECRET_MAX_SIZE \
+    TSS2_MU_MAX(sizeof(TPMS_ECC_POINT), TSS2_MU_MAX(TPM2_MAX_RSA_KEY_BYTES, \
+        sizeof(TPM2B_DIGEST)))
+#define TSS2_MU_TPMU_ENCRYPTED_SECRET_FIXED_SIZE 0
+#define TSS2_MU_TPMU_PUBLIC_ID_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPM2B_DIGEST_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPM2B_PUBLIC_KEY_RSA_MAX_SIZE, \
+        TSS2_MU_TPMS_ECC_POINT_MAX_SIZE))
+#define TSS2_MU_TPMU_PUBLIC_ID_FIXED_SIZE 0
+#define TSS2_MU_TPMU_PUBLIC_PARMS_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPMS_KEYEDHASH_PARMS_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPMS_SYMCIPHER_PARMS_MAX_SIZE, \
+        TSS2_MU_MAX(TSS2_MU_TPMS_RSA_PARMS_MAX_SIZE, \
+        TSS2_MU_TPMS_ECC_PARMS_MAX_SIZE)))
+#define TSS2_MU_TPMU_PUBLIC_PARMS_FIXED_SIZE 0
+#define TSS2_MU_TPMU_NAME_MAX_SIZE \
+    TSS2_MU_MAX(TSS2_MU_TPM2_HANDLE_MAX_SIZE, TSS2_MU_TPMT_HA_MAX_SIZE)
+#define TSS2_MU_TPMU_NAME_FIXED_SIZE 0
+
+/* Tagged structures: the selector plus the largest union member */
+#define TSS2_MU_TPMT_HA_MAX_SIZE (sizeof(UINT16) + TSS2_MU_TPMU_HA_MAX_SIZE)
+#define TSS2_MU_TPMT_HA_FIXED_SIZE 0
+#define TSS2_MU_TPMT_SYM_DEF_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_SYM_KEY_BITS_MAX_SIZE + \
+        TSS2_MU_TPMU_SYM_MODE_MAX_SIZE)
+#define TSS2_MU_TPMT_SYM_DEF_FIXED_SIZE 0
+#define TSS2_MU_TPMT_SYM_DEF_OBJECT_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_SYM_KEY_BITS_MAX_SIZE + \
+        TSS2_MU_TPMU_SYM_MODE_MAX_SIZE)
+#define TSS2_MU_TPMT_SYM_DEF_OBJECT_FIXED_SIZE 0
+#define TSS2_MU_TPMT_KEYEDHASH_SCHEME_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_SCHEME_KEYEDHASH_MAX_SIZE)
+#define TSS2_MU_TPMT_KEYEDHASH_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMT_SIG_SCHEME_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_SIG_SCHEME_MAX_SIZE)
+#define TSS2_MU_TPMT_SIG_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMT_KDF_SCHEME_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_KDF_SCHEME_MAX_SIZE)
+#define TSS2_MU_TPMT_KDF_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMT_ASYM_SCHEME_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_ASYM_SCHEME_MAX_SIZE)
+#define TSS2_MU_TPMT_ASYM_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMT_RSA_SCHEME_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_ASYM_SCHEME_MAX_SIZE)
+#define TSS2_MU_TPMT_RSA_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMT_RSA_DECRYPT_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_ASYM_SCHEME_MAX_SIZE)
+#define TSS2_MU_TPMT_RSA_DECRYPT_FIXED_SIZE 0
+#define TSS2_MU_TPMT_ECC_SCHEME_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_ASYM_SCHEME_MAX_SIZE)
+#define TSS2_MU_TPMT_ECC_SCHEME_FIXED_SIZE 0
+#define TSS2_MU_TPMT_SIGNATURE_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_SIGNATURE_MAX_SIZE)
+#define TSS2_MU_TPMT_SIGNATURE_FIXED_SIZE 0
+#define TSS2_MU_TPMT_SENSITIVE_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPM2B_AUTH_MAX_SIZE + \
+        TSS2_MU_TPM2B_DIGEST_MAX_SIZE + \
+        TSS2_MU_TPMU_SENSITIVE_COMPOSITE_MAX_SIZE)
+#define TSS2_MU_TPMT_SENSITIVE_FIXED_SIZE 0
+#define TSS2_MU_TPMT_PUBLIC_MAX_SIZE \
+    (sizeof(UINT16) + sizeof(UINT16) + TSS2_MU_TPMA_OBJECT_MAX_SIZE + \
+        TSS2_MU_TPM2B_DIGEST_MAX_SIZE + TSS2_MU_TPMU_PUBLIC_PARMS_MAX_SIZE + \
+        TSS2_MU_TPMU_PUBLIC_ID_MAX_SIZE)
+#define TSS2_MU_TPMT_PUBLIC_FIXED_SIZE 0
+#define TSS2_MU_TPMT_PUBLIC_PARMS_MAX_SIZE \
+    (sizeof(UINT16) + TSS2_MU_TPMU_PUBLIC_PARMS_MAX_SIZE)
+#define TSS2_MU_TPMT_PUBLIC_PARMS_FIXED_SIZE 0
+#define TSS2_MU_TPMT_TK_CREATION_MAX_SIZE \
+    (TSS2_MU_TPM2_ST_MAX_SIZE + sizeof(UINT32) + \
+        TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMT_TK_CREATION_FIXED_SIZE 0
+#define TSS2_MU_TPMT_TK_VERIFIED_MAX_SIZE \
+    (TSS2_MU_TPM2_ST_MAX_SIZE + sizeof(UINT32) + \
+        TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMT_TK_VERIFIED_FIXED_SIZE 0
+#define TSS2_MU_TPMT_TK_AUTH_MAX_SIZE \
+    (TSS2_MU_TPM2_ST_MAX_SIZE + sizeof(UINT32) + \
+        TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMT_TK_AUTH_FIXED_SIZE 0
+#define TSS2_MU_TPMT_TK_HASHCHECK_MAX_SIZE \
+    (TSS2_MU_TPM2_ST_MAX_SIZE + sizeof(UINT32) + \
+        TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define TSS2_MU_TPMT_TK_HASHCHECK_FIXED_SIZE 0
+
 #ifdef __cplusplus
 }
 #endif
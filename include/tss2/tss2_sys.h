@@ -25,6 +25,12 @@ extern "C" {
 /* SAPI context blob */
 typedef struct _TSS2_SYS_OPAQUE_CONTEXT_BLOB TSS2_SYS_CONTEXT;
 
+/* Prepared command blob */
+typedef struct _TSS2_SYS_OPAQUE_PREPARED_COMMAND_BLOB TSS2_SYS_PREPARED_COMMAND;
+
+/* Command batch context blob */
+typedef struct _TSS2_SYS_OPAQUE_BATCH_CONTEXT_BLOB TSS2_SYS_BATCH_CONTEXT;
+
 #define TSS2_SYS_MAX_SESSIONS 3
 
 /* Input structure for authorization area(s). */
@@ -38,6 +44,34 @@ typedef struct {
     TPMS_AUTH_RESPONSE auths[TSS2_SYS_MAX_SESSIONS];
 } TSS2L_SYS_AUTH_RESPONSE;
 
+/* Authorization role required for a command handle */
+#define TSS2_SYS_AUTH_ROLE_NONE  0
+#define TSS2_SYS_AUTH_ROLE_USER  1
+#define TSS2_SYS_AUTH_ROLE_ADMIN 2
+#define TSS2_SYS_AUTH_ROLE_DUP   3
+
+/* Command attributes */
+#define TSS2_SYS_CMD_DECRYPT    (1 << 0) /* First command parameter can be encrypted */
+#define TSS2_SYS_CMD_ENCRYPT    (1 << 1) /* First response parameter can be encrypted */
+#define TSS2_SYS_CMD_SESSIONS   (1 << 2) /* Command accepts sessions */
+#define TSS2_SYS_CMD_READ_ONLY  (1 << 3) /* Command does not change TPM state */
+#define TSS2_SYS_CMD_IDEMPOTENT (1 << 4) /* Resending the command has no further
+                                            effect; implied by READ_ONLY */
+
+#define TSS2_SYS_MAX_CMD_HANDLES 3
+
+/* Static description of a TPM command */
+typedef struct {
+    TPM2_CC commandCode;
+    uint8_t numCommandHandles;
+    uint8_t numResponseHandles;
+    uint8_t authRoles[TSS2_SYS_MAX_CMD_HANDLES];
+    uint16_t attributes;
+    /* Maximum response size without authorization area; it may exceed
+       TPM2_MAX_COMMAND_SIZE, see Tss2_Sys_InitializeEx */
+    uint32_t maxResponseSize;
+} TSS2_SYS_COMMAND_INFO;
+
 size_t  Tss2_Sys_GetContextSize(
     size_t maxCommandResponseSize);
 
@@ -47,6 +81,18 @@ TSS2_RC Tss2_Sys_Initialize(
     TSS2_TCTI_CONTEXT *tctiContext,
     TSS2_ABI_VERSION *abiVersion);
 
+/* Contexts with separately sized command and response buffers */
+size_t Tss2_Sys_GetContextSizeEx(
+    size_t maxCommandSize,
+    size_t maxResponseSize);
+
+TSS2_RC Tss2_Sys_InitializeEx(
+    TSS2_SYS_CONTEXT *sysContext,
+    size_t contextSize,
+    size_t maxCommandSize,
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_ABI_VERSION *abiVersion);
+
 void Tss2_Sys_Finalize(
     TSS2_SYS_CONTEXT *sysContext);
 
@@ -85,6 +131,65 @@ TSS2_RC Tss2_Sys_ExecuteFinish(
 TSS2_RC Tss2_Sys_Execute(
     TSS2_SYS_CONTEXT *sysContext);
 
+/* Command metadata */
+const TSS2_SYS_COMMAND_INFO *Tss2_Sys_GetCommandInfo(
+    TPM2_CC commandCode);
+
+/* Prepared command functions */
+size_t Tss2_Sys_PreparedCommand_GetSize(
+    size_t maxCommandSize);
+
+TSS2_RC Tss2_Sys_PreparedCommand_Save(
+    TSS2_SYS_CONTEXT *sysContext,
+    TSS2_SYS_PREPARED_COMMAND *preparedCommand,
+    size_t preparedCommandSize);
+
+TSS2_RC Tss2_Sys_PreparedCommand_GetCpBuffer(
+    const TSS2_SYS_PREPARED_COMMAND *preparedCommand,
+    size_t *cpBufferUsedSize,
+    const uint8_t **cpBuffer);
+
+TSS2_RC Tss2_Sys_PreparedCommand_SetParam(
+    TSS2_SYS_PREPARED_COMMAND *preparedCommand,
+    size_t offset,
+    size_t paramSize,
+    const uint8_t *paramBuffer);
+
+TSS2_RC Tss2_Sys_PreparedCommand_Load(
+    TSS2_SYS_CONTEXT *sysContext,
+    const TSS2_SYS_PREPARED_COMMAND *preparedCommand);
+
+TSS2_RC Tss2_Sys_PreparedCommand_Execute(
+    TSS2_SYS_CONTEXT *sysContext,
+    const TSS2_SYS_PREPARED_COMMAND *preparedCommand);
+
+/* Command batch functions */
+size_t Tss2_Sys_Batch_GetContextSize(
+    size_t maxCommands,
+    size_t maxResponseSize);
+
+TSS2_RC Tss2_Sys_Batch_Initialize(
+    TSS2_SYS_BATCH_CONTEXT *batchContext,
+    size_t contextSize,
+    size_t maxCommands,
+    TSS2_TCTI_CONTEXT *tctiContext);
+
+TSS2_RC Tss2_Sys_Batch_Add(
+    TSS2_SYS_BATCH_CONTEXT *batchContext,
+    const TSS2_SYS_PREPARED_COMMAND *preparedCommand);
+
+TSS2_RC Tss2_Sys_Batch_Execute(
+    TSS2_SYS_BATCH_CONTEXT *batchContext,
+    size_t *numExecuted);
+
+TSS2_RC Tss2_Sys_Batch_GetResponse(
+    TSS2_SYS_BATCH_CONTEXT *batchContext,
+    size_t index,
+    TSS2_SYS_CONTEXT *sysContext);
+
+void Tss2_Sys_Batch_Reset(
+    TSS2_SYS_BATCH_CONTEXT *batchContext);
+
 /* Command Completion functions */
 TSS2_RC Tss2_Sys_GetCommandCode(
     TSS2_SYS_CONTEXT *sysContext,
@@ -212,7 +212,7 @@ Esys_ActivateCredential_Async(
     }
 
     /* Trigger execution and finish the async invocation */
-    r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+    r = iesys_execute_async(esysContext);
     return_state_if_error(r, _ESYS_STATE_INTERNALERROR,
                           "Finish (Execute Async)");
 
@@ -273,15 +273,16 @@ Esys_ActivateCredential_Finish(
     esysContext->state = _ESYS_STATE_INTERNALERROR;
 
     /* Allocate memory for response parameters */
+    iesys_output_reset(esysContext);
     if (certInfo != NULL) {
-        *certInfo = calloc(sizeof(TPM2B_DIGEST), 1);
+        *certInfo = iesys_output_calloc(esysContext, sizeof(TPM2B_DIGEST));
         if (*certInfo == NULL) {
             return_error(TSS2_ESYS_RC_MEMORY, "Out of memory");
         }
     }
 
     /*Receive the TPM response and handle resubmissions if necessary. */
-    r = Tss2_Sys_ExecuteFinish(esysContext->sys, esysContext->timeout);
+    r = iesys_execute_finish(esysContext);
     if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN) {
         LOG_DEBUG("A layer below returned TRY_AGAIN: %" PRIx32, r);
         esysContext->state = _ESYS_STATE_SENT;
@@ -292,13 +293,13 @@ Esys_ActivateCredential_Finish(
     if (r == TPM2_RC_RETRY || r == TPM2_RC_TESTING || r == TPM2_RC_YIELDED) {
         LOG_DEBUG("TPM returned RETRY, TESTING or YIELDED, which triggers a "
             "resubmission: %" PRIx32, r);
-        if (esysContext->submissionCount++ >= _ESYS_MAX_SUBMISSIONS) {
+        if (!iesys_retry(esysContext, r)) {
             LOG_WARNING("Maximum number of (re)submissions has been reached.");
             esysContext->state = _ESYS_STATE_INIT;
             goto error_cleanup;
         }
         esysContext->state = _ESYS_STATE_RESUBMISSION;
-        r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+        r = iesys_execute_async(esysContext);
         if (r != TSS2_RC_SUCCESS) {
             LOG_WARNING("Error attempting to resubmit");
             /* We do not set esysContext->state here but inherit the most recent
@@ -345,7 +346,7 @@ Esys_ActivateCredential_Finish(
 
 error_cleanup:
     if (certInfo != NULL)
-        SAFE_FREE(*certInfo);
+        IESYS_OUTPUT_FREE(esysContext, *certInfo);
 
     return r;
 }
@@ -226,7 +226,7 @@ Esys_CertifyCreation_Async(
     }
 
     /* Trigger execution and finish the async invocation */
-    r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+    r = iesys_execute_async(esysContext);
     return_state_if_error(r, _ESYS_STATE_INTERNALERROR,
                           "Finish (Execute Async)");
 
@@ -290,21 +290,22 @@ Esys_CertifyCreation_Finish(
     esysContext->state = _ESYS_STATE_INTERNALERROR;
 
     /* Allocate memory for response parameters */
+    iesys_output_reset(esysContext);
     if (certifyInfo != NULL) {
-        *certifyInfo = calloc(sizeof(TPM2B_ATTEST), 1);
+        *certifyInfo = iesys_output_calloc(esysContext, sizeof(TPM2B_ATTEST));
         if (*certifyInfo == NULL) {
             return_error(TSS2_ESYS_RC_MEMORY, "Out of memory");
         }
     }
     if (signature != NULL) {
-        *signature = calloc(sizeof(TPMT_SIGNATURE), 1);
+        *signature = iesys_output_calloc(esysContext, sizeof(TPMT_SIGNATURE));
         if (*signature == NULL) {
             goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory", error_cleanup);
         }
     }
 
     /*Receive the TPM response and handle resubmissions if necessary. */
-    r = Tss2_Sys_ExecuteFinish(esysContext->sys, esysContext->timeout);
+    r = iesys_execute_finish(esysContext);
     if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN) {
         LOG_DEBUG("A layer below returned TRY_AGAIN: %" PRIx32, r);
         esysContext->state = _ESYS_STATE_SENT;
@@ -315,13 +316,13 @@ Esys_CertifyCreation_Finish(
     if (r == TPM2_RC_RETRY || r == TPM2_RC_TESTING || r == TPM2_RC_YIELDED) {
         LOG_DEBUG("TPM returned RETRY, TESTING or YIELDED, which triggers a "
             "resubmission: %" PRIx32, r);
-        if (esysContext->submissionCount++ >= _ESYS_MAX_SUBMISSIONS) {
+        if (!iesys_retry(esysContext, r)) {
             LOG_WARNING("Maximum number of (re)submissions has been reached.");
             esysContext->state = _ESYS_STATE_INIT;
             goto error_cleanup;
         }
         esysContext->state = _ESYS_STATE_RESUBMISSION;
-        r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+        r = iesys_execute_async(esysContext);
         if (r != TSS2_RC_SUCCESS) {
             LOG_WARNING("Error attempting to resubmit");
             /* We do not set esysContext->state here but inherit the most recent
@@ -370,9 +371,9 @@ Esys_CertifyCreation_Finish(
 
 error_cleanup:
     if (certifyInfo != NULL)
-        SAFE_FREE(*certifyInfo);
+        IESYS_OUTPUT_FREE(esysContext, *certifyInfo);
     if (signature != NULL)
-        SAFE_FREE(*signature);
+        IESYS_OUTPUT_FREE(esysContext, *signature);
 
     return r;
 }
@@ -227,7 +227,7 @@ Esys_CreateLoaded_Async(
     }
 
     /* Trigger execution and finish the async invocation */
-    r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+    r = iesys_execute_async(esysContext);
     return_state_if_error(r, _ESYS_STATE_INTERNALERROR,
                           "Finish (Execute Async)");
 
@@ -297,6 +297,7 @@ Esys_CreateLoaded_Finish(
     RSRC_NODE_T *objectHandleNode = NULL;
 
     /* Allocate memory for response parameters */
+    iesys_output_reset(esysContext);
     if (objectHandle == NULL) {
         LOG_ERROR("Handle objectHandle may not be NULL");
         return TSS2_ESYS_RC_BAD_REFERENCE;
@@ -307,12 +308,12 @@ Esys_CreateLoaded_Finish(
         return r;
 
     if (outPrivate != NULL) {
-        *outPrivate = calloc(sizeof(TPM2B_PRIVATE), 1);
+        *outPrivate = iesys_output_calloc(esysContext, sizeof(TPM2B_PRIVATE));
         if (*outPrivate == NULL) {
             goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory", error_cleanup);
         }
     }
-    loutPublic = calloc(sizeof(TPM2B_PUBLIC), 1);
+    loutPublic = iesys_output_calloc(esysContext, sizeof(TPM2B_PUBLIC));
     if (loutPublic == NULL) {
         goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory", error_cleanup);
     }
@@ -326,7 +327,7 @@ Esys_CreateLoaded_Finish(
     goto_if_error(r, "Unmarshal TPMT_PUBULIC", error_cleanup);
 
     /*Receive the TPM response and handle resubmissions if necessary. */
-    r = Tss2_Sys_ExecuteFinish(esysContext->sys, esysContext->timeout);
+    r = iesys_execute_finish(esysContext);
     if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN) {
         LOG_DEBUG("A layer below returned TRY_AGAIN: %" PRIx32, r);
         esysContext->state = _ESYS_STATE_SENT;
@@ -337,13 +338,13 @@ Esys_CreateLoaded_Finish(
     if (r == TPM2_RC_RETRY || r == TPM2_RC_TESTING || r == TPM2_RC_YIELDED) {
         LOG_DEBUG("TPM returned RETRY, TESTING or YIELDED, which triggers a "
             "resubmission: %" PRIx32, r);
-        if (esysContext->submissionCount++ >= _ESYS_MAX_SUBMISSIONS) {
+        if (!iesys_retry(esysContext, r)) {
             LOG_WARNING("Maximum number of (re)submissions has been reached.");
             esysContext->state = _ESYS_STATE_INIT;
             goto error_cleanup;
         }
         esysContext->state = _ESYS_STATE_RESUBMISSION;
-        r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+        r = iesys_execute_async(esysContext);
         if (r != TSS2_RC_SUCCESS) {
             LOG_WARNING("Error attempting to resubmit");
             /* We do not set esysContext->state here but inherit the most recent
@@ -397,7 +398,7 @@ Esys_CreateLoaded_Finish(
     if (outPublic != NULL)
         *outPublic = loutPublic;
     else
-        SAFE_FREE(loutPublic);
+        IESYS_OUTPUT_FREE(esysContext, loutPublic);
 
     esysContext->state = _ESYS_STATE_INIT;
 
@@ -406,8 +407,8 @@ Esys_CreateLoaded_Finish(
 error_cleanup:
     Esys_TR_Close(esysContext, objectHandle);
     if (outPrivate != NULL)
-        SAFE_FREE(*outPrivate);
-    SAFE_FREE(loutPublic);
+        IESYS_OUTPUT_FREE(esysContext, *outPrivate);
+    IESYS_OUTPUT_FREE(esysContext, loutPublic);
 
     return r;
 }
@@ -240,7 +240,7 @@ Esys_CreatePrimary_Async(
     }
 
     /* Trigger execution and finish the async invocation */
-    r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+    r = iesys_execute_async(esysContext);
     return_state_if_error(r, _ESYS_STATE_INTERNALERROR,
                           "Finish (Execute Async)");
 
@@ -323,6 +323,7 @@ Esys_CreatePrimary_Finish(
         *creationTicket = NULL;
 
     /* Allocate memory for response parameters */
+    iesys_output_reset(esysContext);
     if (objectHandle == NULL) {
         LOG_ERROR("Handle objectHandle may not be NULL");
         return TSS2_ESYS_RC_BAD_REFERENCE;
@@ -332,31 +333,33 @@ Esys_CreatePrimary_Finish(
     if (r != TSS2_RC_SUCCESS)
         return r;
 
-    loutPublic = calloc(sizeof(TPM2B_PUBLIC), 1);
+    loutPublic = iesys_output_calloc(esysContext, sizeof(TPM2B_PUBLIC));
     if (loutPublic == NULL) {
         goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory", error_cleanup);
     }
     if (creationData != NULL) {
-        *creationData = calloc(sizeof(TPM2B_CREATION_DATA), 1);
+        *creationData = iesys_output_calloc(esysContext,
+                                            sizeof(TPM2B_CREATION_DATA));
         if (*creationData == NULL) {
             goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory", error_cleanup);
         }
     }
     if (creationHash != NULL) {
-        *creationHash = calloc(sizeof(TPM2B_DIGEST), 1);
+        *creationHash = iesys_output_calloc(esysContext, sizeof(TPM2B_DIGEST));
         if (*creationHash == NULL) {
             goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory", error_cleanup);
         }
     }
     if (creationTicket != NULL) {
-        *creationTicket = calloc(sizeof(TPMT_TK_CREATION), 1);
+        *creationTicket = iesys_output_calloc(esysContext,
+                                              sizeof(TPMT_TK_CREATION));
         if (*creationTicket == NULL) {
             goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory", error_cleanup);
         }
     }
 
     /*Receive the TPM response and handle resubmissions if necessary. */
-    r = Tss2_Sys_ExecuteFinish(esysContext->sys, esysContext->timeout);
+    r = iesys_execute_finish(esysContext);
     if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN) {
         LOG_DEBUG("A layer below returned TRY_AGAIN: %" PRIx32, r);
         esysContext->state = _ESYS_STATE_SENT;
@@ -367,13 +370,13 @@ Esys_CreatePrimary_Finish(
     if (r == TPM2_RC_RETRY || r == TPM2_RC_TESTING || r == TPM2_RC_YIELDED) {
         LOG_DEBUG("TPM returned RETRY, TESTING or YIELDED, which triggers a "
             "resubmission: %" PRIx32, r);
-        if (esysContext->submissionCount++ >= _ESYS_MAX_SUBMISSIONS) {
+        if (!iesys_retry(esysContext, r)) {
             LOG_WARNING("Maximum number of (re)submissions has been reached.");
             esysContext->state = _ESYS_STATE_INIT;
             goto error_cleanup;
         }
         esysContext->state = _ESYS_STATE_RESUBMISSION;
-        r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+        r = iesys_execute_async(esysContext);
         if (r != TSS2_RC_SUCCESS) {
             LOG_WARNING("Error attempting to resubmit");
             /* We do not set esysContext->state here but inherit the most recent
@@ -434,7 +437,7 @@ Esys_CreatePrimary_Finish(
     if (outPublic != NULL)
         *outPublic = loutPublic;
     else
-        SAFE_FREE(loutPublic);
+        IESYS_OUTPUT_FREE(esysContext, loutPublic);
 
     esysContext->state = _ESYS_STATE_INIT;
 
@@ -442,13 +445,13 @@ Esys_CreatePrimary_Finish(
 
 error_cleanup:
     Esys_TR_Close(esysContext, objectHandle);
-    SAFE_FREE(loutPublic);
+    IESYS_OUTPUT_FREE(esysContext, loutPublic);
     if (creationData != NULL)
-        SAFE_FREE(*creationData);
+        IESYS_OUTPUT_FREE(esysContext, *creationData);
     if (creationHash != NULL)
-        SAFE_FREE(*creationHash);
+        IESYS_OUTPUT_FREE(esysContext, *creationHash);
     if (creationTicket != NULL)
-        SAFE_FREE(*creationTicket);
+        IESYS_OUTPUT_FREE(esysContext, *creationTicket);
 
     return r;
 }
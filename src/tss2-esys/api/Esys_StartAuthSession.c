@@ -271,7 +271,7 @@ Esys_StartAuthSession_Async(
     }
 
     /* Trigger execution and finish the async invocation */
-    r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+    r = iesys_execute_async(esysContext);
     return_state_if_error(r, _ESYS_STATE_INTERNALERROR,
                           "Finish (Execute Async)");
 
@@ -350,7 +350,7 @@ Esys_StartAuthSession_Finish(
     rsrc->misc.rsrc_session.nonceCaller = esysContext->in.StartAuthSession.nonceCallerData;
 
     /* Receive the TPM response and handle resubmissions if necessary. */
-    r = Tss2_Sys_ExecuteFinish(esysContext->sys, esysContext->timeout);
+    r = iesys_execute_finish(esysContext);
     if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN) {
         LOG_DEBUG("A layer below returned TRY_AGAIN: %" PRIx32, r);
         esysContext->state = _ESYS_STATE_SENT;
@@ -361,13 +361,13 @@ Esys_StartAuthSession_Finish(
     if (r == TPM2_RC_RETRY || r == TPM2_RC_TESTING || r == TPM2_RC_YIELDED) {
         LOG_DEBUG("TPM returned RETRY, TESTING or YIELDED, which triggers a "
             "resubmission: %" PRIx32, r);
-        if (esysContext->submissionCount++ >= _ESYS_MAX_SUBMISSIONS) {
+        if (!iesys_retry(esysContext, r)) {
             LOG_WARNING("Maximum number of (re)submissions has been reached.");
             esysContext->state = _ESYS_STATE_INIT;
             goto error_cleanup;
         }
         esysContext->state = _ESYS_STATE_RESUBMISSION;
-        r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+        r = iesys_execute_async(esysContext);
         if (r != TSS2_RC_SUCCESS) {
             LOG_WARNING("Error attempting to resubmit");
             /* We do not set esysContext->state here but inherit the most recent
@@ -446,9 +446,9 @@ Esys_StartAuthSession_Finish(
             secret_size += bindNode->auth.size;
         /*
          * A non null pointer for secret is required by the subsequent functions,
-         * hence a malloc is called with size 1 if secret_size is zero.
+         * the arena returns one even if secret_size is zero.
          */
-        uint8_t *secret = malloc(secret_size ? secret_size : 1);
+        uint8_t *secret = iesys_arena_alloc(esysContext, secret_size);
         if (secret == NULL) {
             LOG_ERROR("Out of memory.");
             return TSS2_ESYS_RC_MEMORY;
@@ -470,7 +470,8 @@ Esys_StartAuthSession_Finish(
                                &lnonceTPM, esysContext->in.StartAuthSession.nonceCaller,
                                authHash_size*8, NULL,
                      &sessionHandleNode->rsrc.misc.rsrc_session.sessionKey.buffer[0], FALSE);
-        free(secret);
+        memset(secret, 0, secret_size);
+        iesys_arena_free(esysContext, secret);
         return_if_error(r, "Error in KDFa computation.");
 
         sessionHandleNode->rsrc.misc.rsrc_session.sessionKey.size = authHash_size;
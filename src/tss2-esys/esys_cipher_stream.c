@@ -0,0 +1,202 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Esys_EncryptDecryptStream runs the data delivered by a read callback
+ * through TPM2_EncryptDecrypt2 and hands the result to a write callback.
+ * The data is split into chunks of the TPM's TPM2_PT_INPUT_BUFFER, rounded
+ * down to whole cipher blocks, and the ivOut of each chunk is the ivIn of
+ * the next one. While the TPM processes a chunk, the next chunk is read;
+ * the output of a chunk is written while the TPM processes the next one.
+ */
+
+/** Wait for the response of an EncryptDecrypt2 command and drop it. */
+static void
+stream_drain(ESYS_CONTEXT *esys_context)
+{
+    TSS2_RC r;
+    TPM2B_MAX_BUFFER *out_data = NULL;
+    TPM2B_IV *iv_out = NULL;
+
+    do {
+        r = Esys_EncryptDecrypt2_Finish(esys_context, &out_data, &iv_out);
+    } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+    if (out_data != NULL)
+        memset(out_data, 0, sizeof(*out_data));
+    IESYS_OUTPUT_FREE(esys_context, out_data);
+    IESYS_OUTPUT_FREE(esys_context, iv_out);
+}
+
+/** Encrypt or decrypt an arbitrary amount of data with a symmetric key.
+ *
+ * Reads the data from the read callback, encrypts or decrypts it in chunks
+ * with TPM2_EncryptDecrypt2 and passes the result to the write callback.
+ * All chunks but the last hold a multiple of TPM2_MAX_SYM_BLOCK_SIZE bytes,
+ * so block modes are chained correctly; the total length must meet the
+ * requirements of the mode.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  keyHandle The symmetric cipher key.
+ * @param[in]  shandle1 Session handle for authorization of keyHandle.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  decrypt TPM2_YES to decrypt, TPM2_NO to encrypt.
+ * @param[in]  mode The symmetric mode.
+ * @param[in]  ivIn The initial value of the chain. May be NULL for an empty
+ *             IV.
+ * @param[in]  read Callback delivering the data; see ESYS_READ_CB.
+ * @param[in]  readUserdata Pointer passed to the read callback.
+ * @param[in]  write Callback receiving the result; see ESYS_WRITE_CB.
+ * @param[in]  writeUserdata Pointer passed to the write callback.
+ * @param[out] ivOut The chaining value after the last chunk. May be NULL.
+ *             (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext, read or write is
+ *         NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the read callback returned more bytes
+ *         than requested.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned a chunk of a
+ *         different size.
+ * @retval TSS2_RCs produced by the callbacks or by lower layers of the
+ *         software stack may be returned to the caller unaltered unless
+ *         handled internally.
+ */
+TSS2_RC
+Esys_EncryptDecryptStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR keyHandle,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    TPMI_YES_NO decrypt,
+    TPMI_ALG_SYM_MODE mode,
+    const TPM2B_IV *ivIn,
+    ESYS_READ_CB read,
+    void *readUserdata,
+    ESYS_WRITE_CB write,
+    void *writeUserdata,
+    TPM2B_IV **ivOut)
+{
+    TSS2_RC r;
+    TPM2B_MAX_BUFFER *chunk = NULL, *out_data = NULL;
+    TPM2B_IV iv = { .size = 0 }, *iv_next = NULL;
+    UINT16 chunk_size;
+    int32_t timeouttmp;
+    int cur = 0, eof = 0, more;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(read);
+    _ESYS_ASSERT_NON_NULL(write);
+    timeouttmp = esysContext->timeout;
+    if (ivIn != NULL)
+        iv = *ivIn;
+
+    if (esysContext->input_buffer_max == 0) {
+        r = Esys_AdjustBufferSizes(esysContext);
+        return_if_error(r, "Get input buffer size.");
+    }
+    chunk_size = esysContext->input_buffer_max -
+                 esysContext->input_buffer_max % TPM2_MAX_SYM_BLOCK_SIZE;
+
+    /* Two chunks; one being processed by the TPM, one being read */
+    chunk = calloc(2, sizeof(TPM2B_MAX_BUFFER));
+    return_if_null(chunk, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+
+    r = iesys_stream_fill(read, readUserdata, chunk_size, &chunk[cur], &eof);
+    goto_if_error(r, "Read chunk", error_cleanup);
+
+    /* The _Finish calls below shall block */
+    esysContext->timeout = -1;
+
+    if (chunk[cur].size > 0) {
+        r = Esys_EncryptDecrypt2_Async(esysContext, keyHandle,
+                                       shandle1, shandle2, shandle3,
+                                       &chunk[cur], decrypt, mode, &iv);
+        goto_if_error(r, "Error in async function", error_cleanup);
+    }
+
+    for (more = chunk[cur].size > 0; more; cur = !cur) {
+        /* Read the next chunk while the TPM is busy */
+        chunk[!cur].size = 0;
+        if (!eof) {
+            r = iesys_stream_fill(read, readUserdata, chunk_size,
+                                  &chunk[!cur], &eof);
+            if (r != TSS2_RC_SUCCESS) {
+                stream_drain(esysContext);
+                LOG_ERROR("Read chunk ErrorCode (0x%08x)", r);
+                goto error_cleanup;
+            }
+        }
+
+        do {
+            r = Esys_EncryptDecrypt2_Finish(esysContext, &out_data, &iv_next);
+        } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+        goto_if_error(r, "Esys Finish", error_cleanup);
+
+        if (out_data->size != chunk[cur].size) {
+            LOG_ERROR("TPM returned %" PRIu16 " bytes for %" PRIu16 ".",
+                      out_data->size, chunk[cur].size);
+            r = TSS2_ESYS_RC_MALFORMED_RESPONSE;
+            goto error_cleanup;
+        }
+        iv = *iv_next;
+        IESYS_OUTPUT_FREE(esysContext, iv_next);
+
+        /* Send the next chunk before writing out the current one */
+        more = chunk[!cur].size > 0;
+        if (more) {
+            r = Esys_EncryptDecrypt2_Async(esysContext, keyHandle,
+                                           shandle1, shandle2, shandle3,
+                                           &chunk[!cur], decrypt, mode, &iv);
+            goto_if_error(r, "Error in async function", error_cleanup);
+        }
+
+        r = write(writeUserdata, &out_data->buffer[0], out_data->size);
+        if (r != TSS2_RC_SUCCESS) {
+            if (more)
+                stream_drain(esysContext);
+            LOG_ERROR("Write chunk ErrorCode (0x%08x)", r);
+            goto error_cleanup;
+        }
+        memset(out_data, 0, sizeof(*out_data));
+        IESYS_OUTPUT_FREE(esysContext, out_data);
+    }
+
+    if (ivOut != NULL) {
+        *ivOut = malloc(sizeof(TPM2B_IV));
+        goto_if_null(*ivOut, "Out of memory.", TSS2_ESYS_RC_MEMORY,
+                     error_cleanup);
+        **ivOut = iv;
+    }
+
+    esysContext->timeout = timeouttmp;
+    memset(chunk, 0, 2 * sizeof(TPM2B_MAX_BUFFER));
+    free(chunk);
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    esysContext->timeout = timeouttmp;
+    if (out_data != NULL)
+        memset(out_data, 0, sizeof(*out_data));
+    IESYS_OUTPUT_FREE(esysContext, out_data);
+    IESYS_OUTPUT_FREE(esysContext, iv_next);
+    memset(chunk, 0, 2 * sizeof(TPM2B_MAX_BUFFER));
+    free(chunk);
+    return r;
+}
@@ -8,11 +8,16 @@
 #include <config.h>
 #endif
 #include <stdlib.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
 
 #include "tss2_esys.h"
 #include "tss2_tctildr.h"
 
 #include "esys_iutil.h"
+#include "esys_crypto.h"
 #include "tss2-tcti/tctildr-interface.h"
 #define LOGMODULE esys
 #include "util/log.h"
@@ -73,6 +78,22 @@ Esys_Initialize(ESYS_CONTEXT ** esys_context, TSS2_TCTI_CONTEXT * tcti,
     r = Tss2_Sys_Initialize((*esys_context)->sys, syssize, tcti, abiVersion);
     goto_if_error(r, "During syscontext initialization", cleanup_return);
 
+    /* Buffer sizes until Esys_AdjustBufferSizes asks the TPM; the chunk
+       sizes stay 0 until then. */
+    (*esys_context)->max_command_size = TPM2_MAX_COMMAND_SIZE;
+    (*esys_context)->max_response_size = TPM2_MAX_COMMAND_SIZE;
+
+    /* No deadline for the commands until Esys_SetDeadline */
+    (*esys_context)->deadline_timeout = -1;
+    (*esys_context)->deadline = -1;
+
+    /* Immediate resubmissions until Esys_SetRetryPolicy */
+    Esys_SetRetryPolicy(*esys_context, NULL);
+
+#if !defined(_WIN32)
+    (*esys_context)->pid = getpid();
+#endif
+
     /* Use random number for initial esys handle value to provide pseudo
        namespace for handles */
     (*esys_context)->esys_handle_cnt = ESYS_TR_MIN_OBJECT + (rand() % 6000000);
@@ -118,6 +139,18 @@ Esys_Finalize(ESYS_CONTEXT ** esys_context)
     /* Flush from TPM and free all resource objects first */
     iesys_DeleteAllResourceObjects(*esys_context);
 
+    /* Wipe the random reservoir and the nonce pool */
+    if ((*esys_context)->random_reservoir != NULL) {
+        memset((*esys_context)->random_reservoir, 0,
+               (*esys_context)->random_reservoir_size);
+        free((*esys_context)->random_reservoir);
+    }
+    memset(&(*esys_context)->nonce_pool[0], 0,
+           sizeof((*esys_context)->nonce_pool));
+
+    /* Return the transient memory to the allocator */
+    iesys_arena_release(*esys_context);
+
     /* If no tcti context was provided during initialization, then we need to
        finalize the tcti context. So we retrieve here before finalizing the
        SAPI context. */
@@ -144,6 +177,243 @@ Esys_Finalize(ESYS_CONTEXT ** esys_context)
     *esys_context = NULL;
 }
 
+/** Replace the SYS context of an ESYS_CONTEXT.
+ *
+ * The new SYS context talks to the TPM through tcti and has command and
+ * response buffers of the given sizes.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param tcti [in] The TCTI context.
+ * @param max_command_size [in] The size of the command buffer.
+ * @param max_response_size [in] The size of the response buffer.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_MEMORY if the new SYS context cannot be allocated.
+ * @retval TSS2_RCs produced by Tss2_Sys_InitializeEx.
+ */
+static TSS2_RC
+esys_replace_sys(ESYS_CONTEXT * esys_context, TSS2_TCTI_CONTEXT * tcti,
+                 UINT32 max_command_size, UINT32 max_response_size)
+{
+    TSS2_RC r;
+    TSS2_SYS_CONTEXT *sys;
+    size_t syssize;
+
+    syssize = Tss2_Sys_GetContextSizeEx(max_command_size, max_response_size);
+    sys = calloc(1, syssize);
+    return_if_null(sys, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+
+    r = Tss2_Sys_InitializeEx(sys, syssize, max_command_size, tcti, NULL);
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_ERROR("During syscontext initialization");
+        free(sys);
+        return r;
+    }
+
+    Tss2_Sys_Finalize(esys_context->sys);
+    free(esys_context->sys);
+    esys_context->sys = sys;
+    esys_context->max_command_size = max_command_size;
+    esys_context->max_response_size = max_response_size;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Check whether a resource object is usable from another connection.
+ *
+ * Sessions and transient objects belong to the connection that created them,
+ * while persistent objects, NV indices, PCRs and permanent handles can be
+ * addressed from every connection to the TPM.
+ * @param node [in] The resource object.
+ * @retval true if the object is usable from another connection.
+ */
+static bool
+esys_node_shareable(const RSRC_NODE_T * node)
+{
+    if (node->rsrc.rsrcType == IESYSC_SESSION_RSRC)
+        return false;
+    return (node->rsrc.handle >> TPM2_HR_SHIFT) != TPM2_HT_TRANSIENT;
+}
+
+/** Create a copy of an ESYS_CONTEXT with its own connection to the TPM.
+ *
+ * The clone knows the persistent objects, NV indices, PCRs and permanent
+ * handles of esys_context, including their authValues, under the same ESYS_TR
+ * handles, so it does not have to resolve them again. Sessions and transient
+ * objects belong to the connection of esys_context and are not copied. The
+ * timeouts, the retry policy, the buffer sizes and the allocator of
+ * esys_context are taken over; the random reservoir is configured alike but
+ * starts empty.
+ * Since the clone is meant for another process, both contexts take part in
+ * the fork detection of Esys_AfterFork from now on.
+ * @param esys_context [in] The ESYS_CONTEXT to copy.
+ * @param tcti [in] The TCTI context of the clone, or NULL to load the default
+ *        TCTI like Esys_Initialize.
+ * @param clone [out] The new ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext or clone is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a command is in flight.
+ * @retval TSS2_ESYS_RC_MEMORY if the clone cannot be allocated.
+ * @retval TSS2_RCs produced by Esys_Initialize.
+ */
+TSS2_RC
+Esys_Clone(ESYS_CONTEXT * esys_context, TSS2_TCTI_CONTEXT * tcti,
+           ESYS_CONTEXT ** clone)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti_context;
+    RSRC_NODE_T *node, *copy;
+
+    _ESYS_ASSERT_NON_NULL(clone);
+    *clone = NULL;
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    if (esys_context->state != _ESYS_STATE_INIT) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+
+    r = Esys_Initialize(clone, tcti, NULL);
+    return_if_error(r, "Initialize clone.");
+
+    if (esys_context->max_command_size != (*clone)->max_command_size ||
+        esys_context->max_response_size != (*clone)->max_response_size) {
+        r = Tss2_Sys_GetTctiContext((*clone)->sys, &tcti_context);
+        goto_if_error(r, "Invalid SAPI or TCTI context.", error_cleanup);
+        r = esys_replace_sys(*clone, tcti_context,
+                             esys_context->max_command_size,
+                             esys_context->max_response_size);
+        goto_if_error(r, "Resize buffers.", error_cleanup);
+    }
+    (*clone)->input_buffer_max = esys_context->input_buffer_max;
+    (*clone)->nv_buffer_max = esys_context->nv_buffer_max;
+    (*clone)->timeout = esys_context->timeout;
+    (*clone)->deadline_timeout = esys_context->deadline_timeout;
+    (*clone)->retry_policy = esys_context->retry_policy;
+    (*clone)->alloc_cb = esys_context->alloc_cb;
+    (*clone)->free_cb = esys_context->free_cb;
+    (*clone)->alloc_userdata = esys_context->alloc_userdata;
+    if (esys_context->random_reservoir != NULL) {
+        r = Esys_SetRandomReservoir(*clone,
+                                    esys_context->random_reservoir_size,
+                                    esys_context->random_low_water);
+        goto_if_error(r, "Set random reservoir.", error_cleanup);
+    }
+
+    /* Copy the resource table; the list order does not matter */
+    for (node = esys_context->rsrc_list; node != NULL; node = node->next) {
+        if (!esys_node_shareable(node))
+            continue;
+        r = esys_CreateResourceObject(*clone, node->esys_handle, &copy);
+        goto_if_error(r, "Copy resource object.", error_cleanup);
+        copy->auth = node->auth;
+        copy->rsrc = node->rsrc;
+        copy->name_dirty = node->name_dirty;
+    }
+    (*clone)->esys_handle_cnt = esys_context->esys_handle_cnt;
+#if !defined(_WIN32)
+    esys_context->fork_check = 1;
+    (*clone)->fork_check = 1;
+#endif
+
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    /* The TCTI provided by the caller stays with the caller */
+    Esys_Finalize(clone);
+    return r;
+}
+
+/** Take over an ESYS_CONTEXT in the child of fork().
+ *
+ * A forked process inherits the connection to the TPM, the state of the
+ * random number generator and the prefetched random bytes of its parent.
+ * Using any of them would interfere with the parent or repeat its nonces.
+ * Contexts that were passed to Esys_Clone or Esys_AfterFork before are
+ * therefore refused by the _Async functions in a forked child until this
+ * function was called in it; other contexts keep working on the inherited
+ * connection, as they always did. This function reseeds the crypto backend,
+ * discards the nonce pool and the random reservoir, abandons the command in
+ * flight, forgets the sessions and transient objects of the parent's
+ * connection and connects to the TPM through tcti. Persistent objects, NV
+ * indices, PCRs and permanent handles stay known under their ESYS_TR handles.
+ * The inherited TCTI is not finalized, since that may end the connection of
+ * the parent. A TCTI provided by the application stays with the
+ * application; a TCTI loaded by ESYS is handed to the caller through
+ * tcti_inherited.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param tcti [in] The new TCTI context, or NULL to load the default TCTI
+ *        like Esys_Initialize.
+ * @param tcti_inherited [out] The inherited TCTI context if ESYS loaded it,
+ *        to be released by the caller with Tss2_TctiLdr_Finalize, or NULL
+ *        if the application provided it (optional parameter).
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ * @retval TSS2_ESYS_RC_MEMORY if the new SYS context cannot be allocated.
+ * @retval TSS2_RCs produced by the crypto backend or the TCTI loader.
+ */
+TSS2_RC
+Esys_AfterFork(ESYS_CONTEXT * esys_context, TSS2_TCTI_CONTEXT * tcti,
+               TSS2_TCTI_CONTEXT ** tcti_inherited)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti_context = tcti, *tcti_parent = NULL;
+    RSRC_NODE_T **node, *next;
+
+    if (tcti_inherited != NULL)
+        *tcti_inherited = NULL;
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    /* Never hand out random bytes the parent may use as well */
+    r = iesys_reseed_crypto();
+    return_if_error(r, "Reseed crypto backend.");
+    memset(&esys_context->nonce_pool[0], 0, sizeof(esys_context->nonce_pool));
+    esys_context->nonce_pool_fill = 0;
+    if (esys_context->random_reservoir != NULL)
+        memset(esys_context->random_reservoir, 0,
+               esys_context->random_reservoir_size);
+    esys_context->random_reservoir_fill = 0;
+
+    if (esys_context->tcti_app_param == NULL) {
+        r = Tss2_Sys_GetTctiContext(esys_context->sys, &tcti_parent);
+        return_if_error(r, "Invalid SAPI or TCTI context.");
+    }
+    if (tcti_context == NULL) {
+        r = Tss2_TctiLdr_Initialize(NULL, &tcti_context);
+        return_if_error(r, "Initialize default tcti.");
+    }
+    r = esys_replace_sys(esys_context, tcti_context,
+                         esys_context->max_command_size,
+                         esys_context->max_response_size);
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_ERROR("Connect to the TPM.");
+        if (tcti == NULL)
+            Tss2_TctiLdr_Finalize(&tcti_context);
+        return r;
+    }
+    esys_context->tcti_app_param = tcti;
+    if (tcti_inherited != NULL)
+        *tcti_inherited = tcti_parent;
+#if !defined(_WIN32)
+    esys_context->pid = getpid();
+    esys_context->fork_check = 1;
+#endif
+
+    /* The command in flight was sent on the parent's connection */
+    if (esys_context->state != _ESYS_STATE_INTERNALERROR)
+        esys_context->state = _ESYS_STATE_INIT;
+    esys_context->response_received = 0;
+    esys_context->resubmit_pending = 0;
+
+    for (node = &esys_context->rsrc_list; *node != NULL;) {
+        if (esys_node_shareable(*node)) {
+            node = &(*node)->next;
+            continue;
+        }
+        next = (*node)->next;
+        free(*node);
+        *node = next;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
 /** Return the used TCTI context.
  *
  * If a tcti context was passed into Esys_Initialize then this tcti context is
@@ -203,6 +473,106 @@ Esys_GetPollHandles(ESYS_CONTEXT * esys_context,
     return r;
 }
 
+/** Advance the command in flight without blocking.
+ *
+ * Drives a command started with an _Async function from a coroutine or fiber
+ * scheduler. Esys_Step checks whether the response has arrived and tells the
+ * caller what to do next in step:
+ *   ESYS_STEP_NEED_READ: the response has not arrived yet. handles receives
+ *       the poll handles of the TCTI; wait until one is readable and call
+ *       Esys_Step again. count is set to 0 while the retry policy delays a
+ *       resubmission, in which case the caller polls again later.
+ *   ESYS_STEP_NEED_WRITE: the TPM asked for a resubmission. The _Finish
+ *       function schedules the command again and returns
+ *       TSS2_ESYS_RC_TRY_AGAIN; continue with Esys_Step, which sends it once
+ *       the backoff of the retry policy has passed. Once the submissions of
+ *       the policy are used up the _Finish function returns the TPM response
+ *       code instead.
+ *   ESYS_STEP_DONE: the response, or the error receiving it, is ready and is
+ *       delivered by the _Finish function without blocking.
+ * handles and count work like in Tss2_Tcti_GetPollHandles and may be NULL if
+ * the poll handles are not needed.
+ * Esys_Step needs a TCTI with poll handles and non-blocking receives. TCTIs
+ * without poll handles, such as mssim, are rejected with
+ * TSS2_ESYS_RC_NOT_IMPLEMENTED; the command stays in flight and its response
+ * is fetched with a blocking _Finish call.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param step [out] The next action; ESYS_STEP_ERROR if an error is returned.
+ * @param handles [out] The poll handles, or NULL. (caller-allocated)
+ * @param count [in,out] The number of entries of handles, or NULL.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext or step is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if no command is in flight.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if the TCTI has no poll handles.
+ * @retval TSS2_RCs produced by Tss2_Tcti_GetPollHandles.
+ */
+TSS2_RC
+Esys_Step(ESYS_CONTEXT * esys_context, ESYS_STEP * step,
+          TSS2_TCTI_POLL_HANDLE * handles, size_t * count)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti_context;
+    size_t handle_count;
+
+    _ESYS_ASSERT_NON_NULL(step);
+    *step = ESYS_STEP_ERROR;
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    if (esys_context->state != _ESYS_STATE_SENT &&
+        esys_context->state != _ESYS_STATE_RESUBMISSION) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+
+    /* Without poll handles the TCTI may not receive without blocking */
+    r = Tss2_Sys_GetTctiContext(esys_context->sys, &tcti_context);
+    return_if_error(r, "Invalid SAPI or TCTI context.");
+    r = Tss2_Tcti_GetPollHandles(tcti_context, NULL, &handle_count);
+    if (r == TSS2_TCTI_RC_NOT_IMPLEMENTED) {
+        return_error(TSS2_ESYS_RC_NOT_IMPLEMENTED,
+                     "TCTI has no poll handles.");
+    }
+    return_if_error(r, "Error getting poll handle count.");
+
+    if (esys_context->resubmit_pending) {
+        int32_t timeout = 0;
+        r = iesys_resubmit(esys_context, &timeout);
+        if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN) {
+            if (count != NULL)
+                *count = 0;
+            *step = ESYS_STEP_NEED_READ;
+            return TSS2_RC_SUCCESS;
+        } else if (r != TSS2_RC_SUCCESS) {
+            esys_context->response_rc = r;
+            esys_context->response_received = 1;
+        }
+    }
+
+    if (!esys_context->response_received) {
+        r = iesys_receive(esys_context, 0);
+        if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN) {
+            if (handles == NULL && count == NULL) {
+                *step = ESYS_STEP_NEED_READ;
+                return TSS2_RC_SUCCESS;
+            }
+            _ESYS_ASSERT_NON_NULL(count);
+            r = Tss2_Tcti_GetPollHandles(tcti_context, handles, count);
+            return_if_error(r, "Error getting poll handles.");
+            *step = ESYS_STEP_NEED_READ;
+            return TSS2_RC_SUCCESS;
+        }
+        esys_context->response_rc = r;
+        esys_context->response_received = 1;
+    }
+
+    r = esys_context->response_rc;
+    if (r == TPM2_RC_RETRY || r == TPM2_RC_TESTING || r == TPM2_RC_YIELDED)
+        *step = ESYS_STEP_NEED_WRITE;
+    else
+        *step = ESYS_STEP_DONE;
+    return TSS2_RC_SUCCESS;
+}
+
 /** Set the timeout of Esys asynchronous functions.
  *
  * Sets the timeout for the _finish() functions in the asynchronous versions of
@@ -219,3 +589,304 @@ Esys_SetTimeout(ESYS_CONTEXT * esys_context, int32_t timeout)
     esys_context->timeout = timeout;
     return TSS2_RC_SUCCESS;
 }
+
+/** Set the time budget of the commands of an ESYS_CONTEXT.
+ *
+ * Every following command has to complete within timeout ms after its
+ * _Async function was called, including resubmissions; the timeouts of the
+ * _Finish functions are shortened accordingly. Once the deadline has passed
+ * the command is canceled with Tss2_Tcti_Cancel, its response is received
+ * blocking and dropped, and the _Finish function, or Esys_Step, reports
+ * TPM2_RC_CANCELED. If the TCTI cannot cancel commands or only receives
+ * blocking, such as mssim, the command continues without deadline.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param timeout [in] The budget in ms or -1 for no deadline.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if timeout is below -1.
+ */
+TSS2_RC
+Esys_SetDeadline(ESYS_CONTEXT * esys_context, int32_t timeout)
+{
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    if (timeout < -1) {
+        LOG_ERROR("Bad timeout %" PRIi32, timeout);
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    esys_context->deadline_timeout = timeout;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Return the time spent in the phases of the last command.
+ *
+ * The times are reset by every _Async function and are complete once the
+ * _Finish function has returned.
+ * @param esys_context [in] The ESYS_CONTEXT.
+ * @param timings [out] The times. (caller-allocated)
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext or timings is NULL.
+ */
+TSS2_RC
+Esys_GetTimings(ESYS_CONTEXT * esys_context, ESYS_TIMINGS * timings)
+{
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    _ESYS_ASSERT_NON_NULL(timings);
+    *timings = esys_context->timings;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Set the retry policy of an ESYS_CONTEXT.
+ *
+ * The policy determines how often and after which delay a command is
+ * resubmitted when the TPM answers TPM2_RC_RETRY, TPM2_RC_YIELDED or
+ * TPM2_RC_TESTING. The delay is waited for by the _Finish functions within
+ * their timeout; asynchronous callers are not blocked by it.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param policy [in] The policy, or NULL for the default of
+ *        _ESYS_MAX_SUBMISSIONS immediate submissions.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if a rule allows no submission or has a
+ *         jitter above 100.
+ */
+TSS2_RC
+Esys_SetRetryPolicy(ESYS_CONTEXT * esys_context,
+                    const ESYS_RETRY_POLICY * policy)
+{
+    const ESYS_RETRY_RULE rule = { _ESYS_MAX_SUBMISSIONS, 0, 0, 0 };
+
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    if (policy == NULL) {
+        esys_context->retry_policy.retry = rule;
+        esys_context->retry_policy.yielded = rule;
+        esys_context->retry_policy.testing = rule;
+        return TSS2_RC_SUCCESS;
+    }
+    if (policy->retry.maxSubmissions == 0 ||
+        policy->yielded.maxSubmissions == 0 ||
+        policy->testing.maxSubmissions == 0) {
+        LOG_ERROR("A retry rule allows no submission.");
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    if (policy->retry.jitter > 100 || policy->yielded.jitter > 100 ||
+        policy->testing.jitter > 100) {
+        LOG_ERROR("Jitter of a retry rule above 100 percent.");
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    esys_context->retry_policy = *policy;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Return the retry statistics of a command.
+ *
+ * The statistics accumulate over the lifetime of the ESYS_CONTEXT. Command
+ * codes outside of the TPM 2.0 range share one entry.
+ * @param esys_context [in] The ESYS_CONTEXT.
+ * @param commandCode [in] The command code.
+ * @param stats [out] The statistics. (caller-allocated)
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext or stats is NULL.
+ */
+TSS2_RC
+Esys_GetRetryStats(ESYS_CONTEXT * esys_context, TPM2_CC commandCode,
+                   ESYS_RETRY_STATS * stats)
+{
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    _ESYS_ASSERT_NON_NULL(stats);
+    *stats = *iesys_retry_stats(esys_context, commandCode);
+    return TSS2_RC_SUCCESS;
+}
+
+/** Set caller provided storage for the outputs of _Finish functions.
+ *
+ * The outputs of the _Finish functions (and of the one-call functions) of
+ * this context are placed in buffer instead of being allocated on the heap.
+ * They stay valid until the next _Finish function of the context is called.
+ * Outputs that do not fit into buffer are allocated on the heap as usual.
+ * Outputs must therefore be freed with Esys_FreeOutput, which frees heap
+ * outputs and leaves outputs in buffer alone; Esys_Free must not be used
+ * while an output buffer is set. Outputs are aligned to 8 bytes.
+ *
+ * Some ESYS functions issue commands of their own and so also invalidate
+ * the outputs in buffer, e.g. Esys_TR_FromTPMPublic, Esys_TR_FromTPMPublicList,
+ * Esys_AdjustBufferSizes (also when called implicitly by the stream
+ * functions), Esys_PCR_ReadSnapshot and Esys_GetRandomBytes when it refills
+ * the random reservoir.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param buffer [in] The storage, or NULL to allocate outputs on the heap
+ *        again. (caller-allocated)
+ * @param size [in] The size of buffer.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a command is in flight.
+ */
+TSS2_RC
+Esys_SetOutputBuffer(ESYS_CONTEXT * esys_context, void *buffer, size_t size)
+{
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    if (esys_context->state == _ESYS_STATE_SENT ||
+        esys_context->state == _ESYS_STATE_RESUBMISSION) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+
+    esys_context->output_buffer = buffer;
+    esys_context->output_buffer_size = (buffer != NULL) ? size : 0;
+    esys_context->output_buffer_used = 0;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Free an output of an ESYS function of a context.
+ *
+ * Outputs placed in the output buffer of the context (see
+ * Esys_SetOutputBuffer) are left alone, all others are freed.
+ * @param esys_context [in] The ESYS_CONTEXT that produced the output, or NULL
+ *        if the output was not produced with an output buffer set.
+ * @param ptr [in] The output. May be NULL.
+ */
+void
+Esys_FreeOutput(ESYS_CONTEXT * esys_context, void *ptr)
+{
+    if (esys_context == NULL) {
+        free(ptr);
+        return;
+    }
+    iesys_output_free(esys_context, ptr);
+}
+
+/** Set the allocator for the transient memory of an ESYS_CONTEXT.
+ *
+ * Transient memory, such as the copies of encrypted command and response
+ * parameters, is taken from a per-context arena that is reused by every
+ * command. The arena is obtained with allocCb when it is first needed and
+ * sized for a command and a response buffer; allocCb is also used for
+ * transient memory that does not fit into it. The arena is returned with
+ * freeCb when the allocator is changed or the context is finalized.
+ * Outputs of the ESYS functions are not affected and are still allocated
+ * with malloc; see Esys_SetOutputBuffer.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param allocCb [in] The allocation callback, or NULL for malloc.
+ * @param freeCb [in] The free callback, or NULL for free.
+ * @param userdata [in] Pointer passed to the callbacks.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if only one of the callbacks is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a command is in flight.
+ */
+TSS2_RC
+Esys_SetAllocator(ESYS_CONTEXT * esys_context, ESYS_ALLOC_CB allocCb,
+                  ESYS_FREE_CB freeCb, void *userdata)
+{
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    if ((allocCb == NULL) != (freeCb == NULL)) {
+        LOG_ERROR("Allocation and free callback must be set together.");
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    if (esys_context->state == _ESYS_STATE_SENT ||
+        esys_context->state == _ESYS_STATE_RESUBMISSION) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+
+    /* The arena belongs to the previous allocator */
+    iesys_arena_release(esys_context);
+    esys_context->alloc_cb = allocCb;
+    esys_context->free_cb = freeCb;
+    esys_context->alloc_userdata = userdata;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Size the buffers of an ESYS_CONTEXT according to the TPM's limits.
+ *
+ * Esys_Initialize sizes the command and response buffers for
+ * TPM2_MAX_COMMAND_SIZE. This function queries TPM2_PT_MAX_COMMAND_SIZE,
+ * TPM2_PT_MAX_RESPONSE_SIZE, TPM2_PT_INPUT_BUFFER and TPM2_PT_NV_BUFFER_MAX
+ * with a single TPM2_GetCapability and replaces the SYS context with one
+ * whose command and response buffers match the limits advertised by the TPM.
+ * The buffers never shrink below TPM2_MAX_COMMAND_SIZE. The chunk sizes for
+ * NV and sequence data are capped by the TPM2B_MAX_NV_BUFFER and
+ * TPM2B_MAX_BUFFER types.
+ * It should be called once after Esys_Initialize, when the TPM is started.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a command is in flight.
+ * @retval TSS2_ESYS_RC_MEMORY if the new SYS context cannot be allocated.
+ * @retval TSS2_RCs produced by lower layers of the software stack.
+ */
+TSS2_RC
+Esys_AdjustBufferSizes(ESYS_CONTEXT * esys_context)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti_context;
+    TPMS_CAPABILITY_DATA *capability_data = NULL;
+    TPMI_YES_NO more_data;
+    UINT32 max_command_size = TPM2_MAX_COMMAND_SIZE;
+    UINT32 max_response_size = TPM2_MAX_COMMAND_SIZE;
+    UINT32 input_buffer_max = TPM2_MAX_DIGEST_BUFFER;
+    UINT32 nv_buffer_max = TPM2_MAX_NV_BUFFER_SIZE;
+    UINT32 i;
+
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    if (esys_context->state != _ESYS_STATE_INIT) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+
+    r = Esys_GetCapability(esys_context,
+                           ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                           TPM2_CAP_TPM_PROPERTIES, TPM2_PT_INPUT_BUFFER,
+                           TPM2_PT_NV_BUFFER_MAX - TPM2_PT_INPUT_BUFFER + 1,
+                           &more_data, &capability_data);
+    return_if_error(r, "Get TPM properties.");
+
+    for (i = 0; i < capability_data->data.tpmProperties.count; i++) {
+        TPMS_TAGGED_PROPERTY *prop =
+            &capability_data->data.tpmProperties.tpmProperty[i];
+
+        switch (prop->property) {
+        case TPM2_PT_MAX_COMMAND_SIZE:
+            if (prop->value > max_command_size)
+                max_command_size = prop->value;
+            break;
+        case TPM2_PT_MAX_RESPONSE_SIZE:
+            if (prop->value > max_response_size)
+                max_response_size = prop->value;
+            break;
+        case TPM2_PT_INPUT_BUFFER:
+            if (prop->value > 0)
+                input_buffer_max = prop->value;
+            break;
+        case TPM2_PT_NV_BUFFER_MAX:
+            if (prop->value > 0)
+                nv_buffer_max = prop->value;
+            break;
+        }
+    }
+    IESYS_OUTPUT_FREE(esys_context, capability_data);
+
+    if (input_buffer_max > TPM2_MAX_DIGEST_BUFFER)
+        input_buffer_max = TPM2_MAX_DIGEST_BUFFER;
+    if (nv_buffer_max > TPM2_MAX_NV_BUFFER_SIZE)
+        nv_buffer_max = TPM2_MAX_NV_BUFFER_SIZE;
+    esys_context->input_buffer_max = input_buffer_max;
+    esys_context->nv_buffer_max = nv_buffer_max;
+
+    if (max_command_size == esys_context->max_command_size &&
+        max_response_size == esys_context->max_response_size)
+        return TSS2_RC_SUCCESS;
+
+    LOG_DEBUG("Resizing buffers to %" PRIu32 " command / %" PRIu32
+              " response bytes", max_command_size, max_response_size);
+
+    r = Tss2_Sys_GetTctiContext(esys_context->sys, &tcti_context);
+    return_if_error(r, "Invalid SAPI or TCTI context.");
+
+    return esys_replace_sys(esys_context, tcti_context, max_command_size,
+                            max_response_size);
+}
@@ -536,3 +536,15 @@ TSS2_RC
 iesys_initialize_crypto() {
     return iesys_crypto_init();
 }
+
+/** Reseed the random number generator of the crypto backend.
+ *
+ * Called in a forked process before nonces are drawn.
+ *
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE if the backend can't be reseeded.
+ */
+TSS2_RC
+iesys_reseed_crypto() {
+    return iesys_crypto_reseed();
+}
@@ -102,6 +102,8 @@ TSS2_RC iesys_crypto_KDFe(
 
 TSS2_RC iesys_initialize_crypto();
 
+TSS2_RC iesys_reseed_crypto();
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
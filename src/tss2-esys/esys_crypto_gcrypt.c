@@ -487,6 +487,24 @@ iesys_cryptogcry_hmac_abort(IESYS_CRYPTO_CONTEXT_BLOB ** context)
     }
 }
 
+/** Compute random data.
+ *
+ * The random data will be generated and written to a passed buffer.
+ * @param[out] buffer The buffer for the random data (caller-allocated).
+ * @param[in] num_bytes The number of bytes to be generated.
+ * @retval TSS2_RC_SUCCESS on success.
+ */
+TSS2_RC
+iesys_cryptogcry_random(uint8_t *buffer, size_t num_bytes)
+{
+    /*
+     * possible values for random level:
+     *  GCRY_WEAK_RANDOM GCRY_STRONG_RANDOM  GCRY_VERY_STRONG_RANDOM
+     */
+    gcry_randomize(buffer, num_bytes, GCRY_STRONG_RANDOM);
+    return TSS2_RC_SUCCESS;
+}
+
 /** Compute random TPM2B data.
  *
  * The random data will be generated and written to a passed TPM2B structure.
@@ -502,12 +520,7 @@ iesys_cryptogcry_random2b(TPM2B_NONCE * nonce, size_t num_bytes)
     } else {
         nonce->size = num_bytes;
     }
-    /*
-     * possible values for random level:
-     *  GCRY_WEAK_RANDOM GCRY_STRONG_RANDOM  GCRY_VERY_STRONG_RANDOM
-     */
-    gcry_randomize(&nonce->buffer[0], nonce->size, GCRY_STRONG_RANDOM);
-    return TSS2_RC_SUCCESS;
+    return iesys_cryptogcry_random(&nonce->buffer[0], nonce->size);
 }
 
 /** Encryption of a buffer using a public (RSA) key.
@@ -881,6 +894,177 @@ iesys_cryptogcry_get_ecdh_point(TPM2B_PUBLIC *key,
     return r;
 }
 
+/** Verify a signature with a TPM public key.
+ *
+ * Supports RSASSA and RSAPSS signatures of RSA keys and ECDSA signatures of
+ * ECC keys on the NIST curves.
+ * @param[in] key The public key.
+ * @param[in] digest The signed digest.
+ * @param[in] signature The signature.
+ * @retval TSS2_RC_SUCCESS if the signature is valid.
+ * @retval TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2 if the signature is
+ *         invalid, as returned by TPM2_VerifySignature.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if the key or the scheme of the
+ *         signature is not supported.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE The internal crypto engine failed.
+ */
+TSS2_RC
+iesys_cryptogcry_verify_signature(const TPM2B_PUBLIC *key,
+                                  const TPM2B_DIGEST *digest,
+                                  const TPMT_SIGNATURE *signature)
+{
+/*
+ * The curve name has to be put into the format string with sprintf, see
+ * iesys_cryptogcry_get_ecdh_point.
+ */
+#define SEXP_ECC_PUBLIC_KEY "(public-key (ecc (curve %s) (q %%b)))"
+
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    gcry_error_t err;
+    gcry_sexp_t sexp_key = NULL, sexp_data = NULL, sexp_sig = NULL;
+    const char *hash_alg = NULL, *curveId;
+    BYTE exponent[4];
+    BYTE q[1 + 2 * TPM2_MAX_ECC_KEY_BYTES];
+    size_t offset = 0, q_size;
+    const TPMS_ECC_POINT *point = &key->publicArea.unique.ecc;
+    const TPMS_SIGNATURE_ECDSA *ecdsa = &signature->signature.ecdsa;
+    /* rsassa and rsapss have the same layout */
+    const TPMS_SIGNATURE_RSA *rsa = &signature->signature.rsassa;
+
+    switch (signature->sigAlg) {
+    case TPM2_ALG_RSASSA:
+    case TPM2_ALG_RSAPSS:
+        if (key->publicArea.type != TPM2_ALG_RSA)
+            goto not_implemented;
+        switch (rsa->hash) {
+        case TPM2_ALG_SHA1:
+            hash_alg = "sha1";
+            break;
+        case TPM2_ALG_SHA256:
+            hash_alg = "sha256";
+            break;
+        case TPM2_ALG_SHA384:
+            hash_alg = "sha384";
+            break;
+        case TPM2_ALG_SHA512:
+            hash_alg = "sha512";
+            break;
+        default:
+            goto not_implemented;
+        }
+
+        UINT32 exp;
+        if (key->publicArea.parameters.rsaDetail.exponent == 0)
+            exp = 65537;
+        else
+            exp = key->publicArea.parameters.rsaDetail.exponent;
+        r = Tss2_MU_UINT32_Marshal(exp, &exponent[0], sizeof(exponent),
+                                   &offset);
+        return_if_error(r, "Marshaling");
+
+        err = gcry_sexp_build(&sexp_key, NULL,
+                              "(public-key (rsa (n %b) (e %b)))",
+                              (int)key->publicArea.unique.rsa.size,
+                              &key->publicArea.unique.rsa.buffer[0],
+                              (int)sizeof(exponent), &exponent[0]);
+        if (err == GPG_ERR_NO_ERROR) {
+            if (signature->sigAlg == TPM2_ALG_RSASSA)
+                err = gcry_sexp_build(&sexp_data, NULL,
+                                      "(data (flags pkcs1) (hash %s %b))",
+                                      hash_alg, (int)digest->size,
+                                      &digest->buffer[0]);
+            else
+                /* The TPM uses a salt of the size of the digest */
+                err = gcry_sexp_build(&sexp_data, NULL,
+                                      "(data (flags pss) (salt-length %d) "
+                                      "(hash %s %b))",
+                                      (int)digest->size, hash_alg,
+                                      (int)digest->size, &digest->buffer[0]);
+        }
+        if (err == GPG_ERR_NO_ERROR)
+            err = gcry_sexp_build(&sexp_sig, NULL, "(sig-val (rsa (s %b)))",
+                                  (int)rsa->sig.size, &rsa->sig.buffer[0]);
+        break;
+    case TPM2_ALG_ECDSA:
+        if (key->publicArea.type != TPM2_ALG_ECC)
+            goto not_implemented;
+        switch (key->publicArea.parameters.eccDetail.curveID) {
+        case TPM2_ECC_NIST_P192:
+            curveId = "\"NIST P-192\"";
+            break;
+        case TPM2_ECC_NIST_P224:
+            curveId = "\"NIST P-224\"";
+            break;
+        case TPM2_ECC_NIST_P256:
+            curveId = "\"NIST P-256\"";
+            break;
+        case TPM2_ECC_NIST_P384:
+            curveId = "\"NIST P-384\"";
+            break;
+        case TPM2_ECC_NIST_P521:
+            curveId = "\"NIST P-521\"";
+            break;
+        default:
+            goto not_implemented;
+        }
+
+        /* Uncompressed point: 0x04 || x || y */
+        q[0] = 0x04;
+        memcpy(&q[1], &point->x.buffer[0], point->x.size);
+        memcpy(&q[1 + point->x.size], &point->y.buffer[0], point->y.size);
+        q_size = 1 + point->x.size + point->y.size;
+
+        { /* scope for sexp_ecc_key */
+            char sexp_ecc_key[sizeof(SEXP_ECC_PUBLIC_KEY) + strlen(curveId)];
+
+            if (sprintf(&sexp_ecc_key[0], SEXP_ECC_PUBLIC_KEY, curveId) < 1)
+                return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "sprintf");
+            err = gcry_sexp_build(&sexp_key, NULL, sexp_ecc_key,
+                                  (int)q_size, &q[0]);
+        }
+        if (err == GPG_ERR_NO_ERROR)
+            err = gcry_sexp_build(&sexp_data, NULL,
+                                  "(data (flags raw) (value %b))",
+                                  (int)digest->size, &digest->buffer[0]);
+        if (err == GPG_ERR_NO_ERROR)
+            err = gcry_sexp_build(&sexp_sig, NULL,
+                                  "(sig-val (ecdsa (r %b) (s %b)))",
+                                  (int)ecdsa->signatureR.size,
+                                  &ecdsa->signatureR.buffer[0],
+                                  (int)ecdsa->signatureS.size,
+                                  &ecdsa->signatureS.buffer[0]);
+        break;
+    default:
+        goto not_implemented;
+    }
+    if (err != GPG_ERR_NO_ERROR) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Function gcry_sexp_build", cleanup);
+    }
+
+    err = gcry_pk_verify(sexp_sig, sexp_data, sexp_key);
+    if (gcry_err_code(err) == GPG_ERR_BAD_SIGNATURE) {
+        LOG_DEBUG("Signature verification failed.");
+        r = TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2;
+    } else if (err != GPG_ERR_NO_ERROR) {
+        LOG_ERROR("Signature verification error: %s/%s",
+                  gcry_strsource(err), gcry_strerror(err));
+        r = TSS2_ESYS_RC_GENERAL_FAILURE;
+    }
+
+cleanup:
+    gcry_sexp_release(sexp_key);
+    gcry_sexp_release(sexp_data);
+    gcry_sexp_release(sexp_sig);
+    return r;
+
+not_implemented:
+    LOG_DEBUG("Signature scheme 0x%04" PRIx16 " not supported for key "
+              "type 0x%04" PRIx16 ".", signature->sigAlg,
+              key->publicArea.type);
+    return TSS2_ESYS_RC_NOT_IMPLEMENTED;
+}
+
 /** Initialize AES context for encryption / decryption.
  *
  * @param[out] handle for AES context
@@ -1079,3 +1263,17 @@ iesys_cryptogcry_init() {
     }
     return TSS2_RC_SUCCESS;
 }
+
+/** Reseed the gcrypt random number generator.
+ *
+ * Mixes fresh entropy of the operating system into the generator, so a
+ * forked process does not continue with the state of its parent.
+ *
+ * @retval TSS2_RC_SUCCESS always returned because GCRYCTL_FAST_POLL does
+ * not fail.
+ */
+TSS2_RC
+iesys_cryptogcry_reseed() {
+    gcry_control(GCRYCTL_FAST_POLL, 0);
+    return TSS2_RC_SUCCESS;
+}
@@ -85,7 +85,9 @@ void iesys_cryptogcry_hmac_abort(IESYS_CRYPTO_CONTEXT_BLOB **context);
 #define iesys_crypto_hmac_finish2b iesys_cryptogcry_hmac_finish2b
 #define iesys_crypto_hmac_abort iesys_cryptogcry_hmac_abort
 
+TSS2_RC iesys_cryptogcry_random(uint8_t *buffer, size_t num_bytes);
 TSS2_RC iesys_cryptogcry_random2b(TPM2B_NONCE *nonce, size_t num_bytes);
+#define iesys_crypto_random iesys_cryptogcry_random
 #define iesys_crypto_random2b iesys_cryptogcry_random2b
 
 TSS2_RC iesys_cryptogcry_pk_encrypt(
@@ -127,13 +129,21 @@ TSS2_RC iesys_cryptogcry_get_ecdh_point(
     BYTE * out_buffer,
     size_t * out_size);
 
+TSS2_RC iesys_cryptogcry_verify_signature(
+    const TPM2B_PUBLIC *key,
+    const TPM2B_DIGEST *digest,
+    const TPMT_SIGNATURE *signature);
+
 #define iesys_crypto_get_ecdh_point iesys_cryptogcry_get_ecdh_point
+#define iesys_crypto_verify_signature iesys_cryptogcry_verify_signature
 #define iesys_crypto_sym_aes_encrypt iesys_cryptogcry_sym_aes_encrypt
 #define iesys_crypto_sym_aes_decrypt iesys_cryptogcry_sym_aes_decrypt
 
 TSS2_RC iesys_cryptogcry_init();
+TSS2_RC iesys_cryptogcry_reseed();
 
 #define iesys_crypto_init iesys_cryptogcry_init
+#define iesys_crypto_reseed iesys_cryptogcry_reseed
 
 #endif /* ESYS_CRYPTO_GCRYPT_H */
 
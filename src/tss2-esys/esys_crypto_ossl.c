@@ -13,6 +13,7 @@
 #include <openssl/rsa.h>
 #include <openssl/engine.h>
 #include <stdio.h>
+#include <limits.h>
 
 #include "tss2_esys.h"
 
@@ -490,24 +491,22 @@ iesys_cryptossl_hmac_abort(IESYS_CRYPTO_CONTEXT_BLOB ** context)
     }
 }
 
-/** Compute random TPM2B data.
+/** Compute random data.
  *
- * The random data will be generated and written to a passed TPM2B structure.
- * @param[out] nonce The TPM2B structure for the random data (caller-allocated).
+ * The random data will be generated and written to a passed buffer.
+ * @param[out] buffer The buffer for the random data (caller-allocated).
  * @param[in] num_bytes The number of bytes to be generated.
  * @retval TSS2_RC_SUCCESS on success.
  *
  * NOTE: the TPM should not be used to obtain the random data
  */
 TSS2_RC
-iesys_cryptossl_random2b(TPM2B_NONCE * nonce, size_t num_bytes)
+iesys_cryptossl_random(uint8_t *buffer, size_t num_bytes)
 {
     const RAND_METHOD *rand_save = RAND_get_rand_method();
 
-    if (num_bytes == 0) {
-        nonce->size = sizeof(TPMU_HA);
-    } else {
-        nonce->size = num_bytes;
+    if (num_bytes > INT_MAX) {
+        return_error(TSS2_ESYS_RC_BAD_VALUE, "Too many random bytes.");
     }
 
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
@@ -515,7 +514,7 @@ iesys_cryptossl_random2b(TPM2B_NONCE * nonce, size_t num_bytes)
 #else
     RAND_set_rand_method(RAND_SSLeay());
 #endif
-    if (1 != RAND_bytes(&nonce->buffer[0], nonce->size)) {
+    if (1 != RAND_bytes(buffer, num_bytes)) {
         RAND_set_rand_method(rand_save);
         return_error(TSS2_ESYS_RC_GENERAL_FAILURE,
                      "Failure in random number generator.");
@@ -524,6 +523,27 @@ iesys_cryptossl_random2b(TPM2B_NONCE * nonce, size_t num_bytes)
     return TSS2_RC_SUCCESS;
 }
 
+/** Compute random TPM2B data.
+ *
+ * The random data will be generated and written to a passed TPM2B structure.
+ * @param[out] nonce The TPM2B structure for the random data (caller-allocated).
+ * @param[in] num_bytes The number of bytes to be generated.
+ * @retval TSS2_RC_SUCCESS on success.
+ *
+ * NOTE: the TPM should not be used to obtain the random data
+ */
+TSS2_RC
+iesys_cryptossl_random2b(TPM2B_NONCE * nonce, size_t num_bytes)
+{
+    if (num_bytes == 0) {
+        nonce->size = sizeof(TPMU_HA);
+    } else {
+        nonce->size = num_bytes;
+    }
+
+    return iesys_cryptossl_random(&nonce->buffer[0], nonce->size);
+}
+
 /** Encryption of a buffer using a public (RSA) key.
  *
  * Encrypting a buffer using a public key is used for example during
@@ -927,6 +947,247 @@ iesys_cryptossl_get_ecdh_point(TPM2B_PUBLIC *key,
     return r;
 }
 
+/** Map the result of an OSSL verify function to a response code. */
+static TSS2_RC
+verify_result(int rc)
+{
+    if (rc == 1)
+        return TSS2_RC_SUCCESS;
+    if (rc == 0) {
+        LOG_DEBUG("Signature verification failed.");
+        return TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2;
+    }
+    return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "Signature verification error.");
+}
+
+/** Verify an RSASSA or RSAPSS signature with a TPM RSA key.
+ *
+ * @param[in] key The public key.
+ * @param[in] digest The signed digest.
+ * @param[in] md The hash algorithm of the signature.
+ * @param[in] padding RSA_PKCS1_PADDING or RSA_PKCS1_PSS_PADDING.
+ * @param[in] sig The signature.
+ * @retval TSS2_RC_SUCCESS if the signature is valid.
+ * @retval TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2 if it is invalid.
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE The internal crypto engine failed.
+ */
+static TSS2_RC
+verify_rsa(const TPM2B_PUBLIC *key, const TPM2B_DIGEST *digest,
+           const EVP_MD *md, int padding, const TPM2B_PUBLIC_KEY_RSA *sig)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    RSA *rsa_key = NULL;
+    EVP_PKEY *evp_rsa_key = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
+    BIGNUM *n = NULL, *e = NULL;
+    UINT32 exp;
+
+    if (key->publicArea.parameters.rsaDetail.exponent == 0)
+        exp = 65537;
+    else
+        exp = key->publicArea.parameters.rsaDetail.exponent;
+
+    if (!(n = BN_bin2bn(key->publicArea.unique.rsa.buffer,
+                        key->publicArea.unique.rsa.size, NULL)) ||
+        !(e = BN_new()) || 1 != BN_set_word(e, exp)) {
+        goto_error(r, TSS2_ESYS_RC_MEMORY,
+                   "Could not create rsa n and e.", cleanup);
+    }
+
+    if (!(rsa_key = RSA_new())) {
+        goto_error(r, TSS2_ESYS_RC_MEMORY,
+                   "Could not allocate RSA key", cleanup);
+    }
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    rsa_key->n = n;
+    rsa_key->e = e;
+#else
+    if (1 != RSA_set0_key(rsa_key, n, e, NULL)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Could not set rsa n and e.", cleanup);
+    }
+#endif
+    /* Owned by rsa_key now */
+    n = NULL;
+    e = NULL;
+
+    if (!(evp_rsa_key = EVP_PKEY_new()) ||
+        1 != EVP_PKEY_set1_RSA(evp_rsa_key, rsa_key)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Could not create evp key.", cleanup);
+    }
+
+    if (!(ctx = EVP_PKEY_CTX_new(evp_rsa_key, NULL)) ||
+        1 != EVP_PKEY_verify_init(ctx) ||
+        1 != EVP_PKEY_CTX_set_rsa_padding(ctx, padding) ||
+        1 != EVP_PKEY_CTX_set_signature_md(ctx, md)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Could not init verify context.", cleanup);
+    }
+
+    /* Accept any salt length; the TPM chooses it when signing */
+    if (padding == RSA_PKCS1_PSS_PADDING &&
+        1 != EVP_PKEY_CTX_set_rsa_pss_saltlen(ctx, -2)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Could not set PSS salt length.", cleanup);
+    }
+
+    r = verify_result(EVP_PKEY_verify(ctx, &sig->buffer[0], sig->size,
+                                      &digest->buffer[0], digest->size));
+
+ cleanup:
+    OSSL_FREE(ctx, EVP_PKEY_CTX);
+    OSSL_FREE(evp_rsa_key, EVP_PKEY);
+    OSSL_FREE(rsa_key, RSA);
+    OSSL_FREE(n, BN);
+    OSSL_FREE(e, BN);
+    return r;
+}
+
+/** Verify an ECDSA signature with a TPM ECC key.
+ *
+ * @param[in] key The public key.
+ * @param[in] digest The signed digest.
+ * @param[in] sig The signature.
+ * @retval TSS2_RC_SUCCESS if the signature is valid.
+ * @retval TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2 if it is invalid.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if the curve is not supported.
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE The internal crypto engine failed.
+ */
+static TSS2_RC
+verify_ecdsa(const TPM2B_PUBLIC *key, const TPM2B_DIGEST *digest,
+             const TPMS_SIGNATURE_ECDSA *sig)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    EC_GROUP *group = NULL;
+    EC_POINT *point = NULL;
+    EC_KEY *ec_key = NULL;
+    ECDSA_SIG *ecdsa_sig = NULL;
+    BIGNUM *bn_r = NULL, *bn_s = NULL;
+    int curveId;
+
+    switch (key->publicArea.parameters.eccDetail.curveID) {
+    case TPM2_ECC_NIST_P192:
+        curveId = NID_X9_62_prime192v1;
+        break;
+    case TPM2_ECC_NIST_P224:
+        curveId = NID_secp224r1;
+        break;
+    case TPM2_ECC_NIST_P256:
+        curveId = NID_X9_62_prime256v1;
+        break;
+    case TPM2_ECC_NIST_P384:
+        curveId = NID_secp384r1;
+        break;
+    case TPM2_ECC_NIST_P521:
+        curveId = NID_secp521r1;
+        break;
+    default:
+        return_error(TSS2_ESYS_RC_NOT_IMPLEMENTED,
+                     "ECC curve not implemented.");
+    }
+
+    if (!(group = EC_GROUP_new_by_curve_name(curveId))) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Create group for curve", cleanup);
+    }
+
+    r = tpm_pub_to_ossl_pub(group, (TPM2B_PUBLIC *)key, &point);
+    goto_if_error(r, "Convert TPM pub point to ossl pub point", cleanup);
+
+    if (!(ec_key = EC_KEY_new()) ||
+        1 != EC_KEY_set_group(ec_key, group) ||
+        1 != EC_KEY_set_public_key(ec_key, point)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Create ec key", cleanup);
+    }
+
+    if (!(bn_r = BN_bin2bn(&sig->signatureR.buffer[0], sig->signatureR.size,
+                           NULL)) ||
+        !(bn_s = BN_bin2bn(&sig->signatureS.buffer[0], sig->signatureS.size,
+                           NULL))) {
+        goto_error(r, TSS2_ESYS_RC_MEMORY,
+                   "Create big num from byte buffer.", cleanup);
+    }
+
+    if (!(ecdsa_sig = ECDSA_SIG_new())) {
+        goto_error(r, TSS2_ESYS_RC_MEMORY, "Create ecdsa signature", cleanup);
+    }
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    BN_free(ecdsa_sig->r);
+    BN_free(ecdsa_sig->s);
+    ecdsa_sig->r = bn_r;
+    ecdsa_sig->s = bn_s;
+#else
+    if (1 != ECDSA_SIG_set0(ecdsa_sig, bn_r, bn_s)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Set ecdsa signature", cleanup);
+    }
+#endif
+    /* Owned by ecdsa_sig now */
+    bn_r = NULL;
+    bn_s = NULL;
+
+    r = verify_result(ECDSA_do_verify(&digest->buffer[0], digest->size,
+                                      ecdsa_sig, ec_key));
+
+ cleanup:
+    OSSL_FREE(ecdsa_sig, ECDSA_SIG);
+    OSSL_FREE(ec_key, EC_KEY);
+    OSSL_FREE(point, EC_POINT);
+    OSSL_FREE(group, EC_GROUP);
+    OSSL_FREE(bn_r, BN);
+    OSSL_FREE(bn_s, BN);
+    return r;
+}
+
+/** Verify a signature with a TPM public key.
+ *
+ * Supports RSASSA and RSAPSS signatures of RSA keys and ECDSA signatures of
+ * ECC keys on the NIST curves.
+ * @param[in] key The public key.
+ * @param[in] digest The signed digest.
+ * @param[in] signature The signature.
+ * @retval TSS2_RC_SUCCESS if the signature is valid.
+ * @retval TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2 if the signature is
+ *         invalid, as returned by TPM2_VerifySignature.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if the key or the scheme of the
+ *         signature is not supported.
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE The internal crypto engine failed.
+ */
+TSS2_RC
+iesys_cryptossl_verify_signature(const TPM2B_PUBLIC *key,
+                                 const TPM2B_DIGEST *digest,
+                                 const TPMT_SIGNATURE *signature)
+{
+    const EVP_MD *md;
+
+    switch (signature->sigAlg) {
+    case TPM2_ALG_RSASSA:
+    case TPM2_ALG_RSAPSS:
+        /* rsassa and rsapss have the same layout */
+        if (key->publicArea.type != TPM2_ALG_RSA)
+            break;
+        if (!(md = get_ossl_hash_md(signature->signature.rsassa.hash)))
+            break;
+        return verify_rsa(key, digest, md,
+                          (signature->sigAlg == TPM2_ALG_RSASSA) ?
+                          RSA_PKCS1_PADDING : RSA_PKCS1_PSS_PADDING,
+                          &signature->signature.rsassa.sig);
+    case TPM2_ALG_ECDSA:
+        if (key->publicArea.type != TPM2_ALG_ECC)
+            break;
+        return verify_ecdsa(key, digest, &signature->signature.ecdsa);
+    }
+
+    LOG_DEBUG("Signature scheme 0x%04" PRIx16 " not supported for key "
+              "type 0x%04" PRIx16 ".", signature->sigAlg,
+              key->publicArea.type);
+    return TSS2_ESYS_RC_NOT_IMPLEMENTED;
+}
+
 /** Encrypt data with AES.
  *
  * @param[in] key key used for AES.
@@ -1118,3 +1379,19 @@ iesys_cryptossl_init() {
     OpenSSL_add_all_algorithms();
     return TSS2_RC_SUCCESS;
 }
+
+/** Reseed the OpenSSL random number generator.
+ *
+ * Mixes fresh entropy of the operating system into the generator, so a
+ * forked process does not continue with the state of its parent.
+ *
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE if no entropy could be gathered.
+ */
+TSS2_RC
+iesys_cryptossl_reseed() {
+    if (1 != RAND_poll()) {
+        return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "Failure in RAND_poll");
+    }
+    return TSS2_RC_SUCCESS;
+}
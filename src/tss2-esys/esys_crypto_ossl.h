@@ -88,6 +88,7 @@ void iesys_cryptossl_hmac_abort(IESYS_CRYPTO_CONTEXT_BLOB **context);
 #define iesys_crypto_hmac_finish2b iesys_cryptossl_hmac_finish2b
 #define iesys_crypto_hmac_abort iesys_cryptossl_hmac_abort
 
+TSS2_RC iesys_cryptossl_random(uint8_t *buffer, size_t num_bytes);
 TSS2_RC iesys_cryptossl_random2b(TPM2B_NONCE *nonce, size_t num_bytes);
 
 TSS2_RC iesys_cryptossl_pk_encrypt(
@@ -128,14 +129,23 @@ TSS2_RC iesys_cryptossl_get_ecdh_point(
     BYTE * out_buffer,
     size_t * out_size);
 
+TSS2_RC iesys_cryptossl_verify_signature(
+    const TPM2B_PUBLIC *key,
+    const TPM2B_DIGEST *digest,
+    const TPMT_SIGNATURE *signature);
+
+#define iesys_crypto_random iesys_cryptossl_random
 #define iesys_crypto_random2b iesys_cryptossl_random2b
 #define iesys_crypto_get_ecdh_point iesys_cryptossl_get_ecdh_point
+#define iesys_crypto_verify_signature iesys_cryptossl_verify_signature
 #define iesys_crypto_sym_aes_encrypt iesys_cryptossl_sym_aes_encrypt
 #define iesys_crypto_sym_aes_decrypt iesys_cryptossl_sym_aes_decrypt
 
 TSS2_RC iesys_cryptossl_init();
+TSS2_RC iesys_cryptossl_reseed();
 
 #define iesys_crypto_init iesys_cryptossl_init
+#define iesys_crypto_reseed iesys_cryptossl_reseed
 
 #ifdef __cplusplus
 } /* extern "C" */
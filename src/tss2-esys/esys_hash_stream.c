@@ -0,0 +1,227 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * The hash stream functions feed the data delivered by a read callback
+ * through a TPM hash or HMAC sequence. The data is split into chunks of the
+ * TPM's TPM2_PT_INPUT_BUFFER. While the TPM processes a TPM2_SequenceUpdate
+ * for one chunk, the next chunk is read from the callback. The last chunk
+ * is passed to TPM2_SequenceComplete.
+ */
+
+/** Run the data of a read callback through a started sequence.
+ *
+ * The sequence object is removed in any case, either by
+ * Esys_SequenceComplete or by flushing it after an error.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param sequence [in] The sequence object.
+ * @param shandle1 [in] Session handle for authorization of the sequence.
+ * @param shandle2 [in] Second session handle.
+ * @param shandle3 [in] Third session handle.
+ * @param read [in] The read callback.
+ * @param userdata [in] The userdata for the callback.
+ * @param hierarchy [in] Hierarchy of the ticket.
+ * @param result [out] The digest. (callee-allocated)
+ * @param validation [out] The ticket. May be NULL. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_RCs produced by the callback or lower layers.
+ */
+static TSS2_RC
+stream_sequence(
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR sequence,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    ESYS_READ_CB read,
+    void *userdata,
+    TPMI_RH_HIERARCHY hierarchy,
+    TPM2B_DIGEST **result,
+    TPMT_TK_HASHCHECK **validation)
+{
+    TSS2_RC r;
+    TPM2B_MAX_BUFFER *chunk = NULL;
+    UINT16 chunk_size;
+    int32_t timeouttmp = esys_context->timeout;
+    int cur = 0, eof = 0, next_eof = 0;
+
+    if (esys_context->input_buffer_max == 0) {
+        r = Esys_AdjustBufferSizes(esys_context);
+        goto_if_error(r, "Get input buffer size.", error_cleanup);
+    }
+    chunk_size = esys_context->input_buffer_max;
+
+    /* Two chunks; one being processed by the TPM, one being read */
+    chunk = calloc(2, sizeof(TPM2B_MAX_BUFFER));
+    goto_if_null(chunk, "Out of memory.", TSS2_ESYS_RC_MEMORY, error_cleanup);
+
+    r = iesys_stream_fill(read, userdata, chunk_size, &chunk[cur], &eof);
+    goto_if_error(r, "Read chunk", error_cleanup);
+
+    /* The _Finish calls below shall block */
+    esys_context->timeout = -1;
+
+    while (!eof) {
+        r = Esys_SequenceUpdate_Async(esys_context, sequence,
+                                      shandle1, shandle2, shandle3,
+                                      &chunk[cur]);
+        goto_if_error(r, "Error in async function", error_cleanup);
+
+        /* Read the next chunk while the TPM is busy */
+        r = iesys_stream_fill(read, userdata, chunk_size, &chunk[!cur],
+                              &next_eof);
+        if (r != TSS2_RC_SUCCESS) {
+            /* Collect the response before bailing out */
+            TSS2_RC r2;
+            do {
+                r2 = Esys_SequenceUpdate_Finish(esys_context);
+            } while ((r2 & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+            LOG_ERROR("Read chunk ErrorCode (0x%08x)", r);
+            goto error_cleanup;
+        }
+
+        do {
+            r = Esys_SequenceUpdate_Finish(esys_context);
+        } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+        goto_if_error(r, "Esys Finish", error_cleanup);
+
+        cur = !cur;
+        eof = next_eof;
+    }
+
+    r = Esys_SequenceComplete(esys_context, sequence,
+                              shandle1, shandle2, shandle3,
+                              &chunk[cur], hierarchy, result, validation);
+    goto_if_error(r, "Complete sequence", error_cleanup);
+
+    esys_context->timeout = timeouttmp;
+    free(chunk);
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    esys_context->timeout = timeouttmp;
+    if (Esys_FlushContext(esys_context, sequence) != TSS2_RC_SUCCESS)
+        Esys_TR_Close(esys_context, &sequence);
+    free(chunk);
+    return r;
+}
+
+/** Hash an arbitrary amount of data on the TPM.
+ *
+ * Starts a hash sequence and feeds all data returned by the read callback
+ * through it. The sequence is completed with the given hierarchy, so a
+ * ticket for signing the digest with a restricted key is returned.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  shandle1 Session handle for authorization of the sequence.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  hashAlg The hash algorithm to use.
+ * @param[in]  hierarchy Hierarchy of the ticket for a hash.
+ * @param[in]  read Callback delivering the data; see ESYS_READ_CB.
+ * @param[in]  userdata Pointer passed to the callback.
+ * @param[out] result The returned hash. (callee-allocated)
+ * @param[out] validation Ticket indicating that the data did not start with
+ *             TPM2_GENERATED_VALUE. May be NULL. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext, read or result is
+ *         NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the callback returned more bytes than
+ *         requested.
+ * @retval TSS2_RCs produced by the callback or by lower layers of the software
+ *         stack may be returned to the caller unaltered unless handled
+ *         internally.
+ */
+TSS2_RC
+Esys_HashStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    TPMI_ALG_HASH hashAlg,
+    TPMI_RH_HIERARCHY hierarchy,
+    ESYS_READ_CB read,
+    void *userdata,
+    TPM2B_DIGEST **result,
+    TPMT_TK_HASHCHECK **validation)
+{
+    TSS2_RC r;
+    ESYS_TR sequence;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(read);
+    _ESYS_ASSERT_NON_NULL(result);
+
+    /* TPM2_HashSequenceStart has no handle that needs authorization */
+    r = Esys_HashSequenceStart(esysContext, ESYS_TR_NONE, ESYS_TR_NONE,
+                               ESYS_TR_NONE, NULL, hashAlg, &sequence);
+    return_if_error(r, "Start hash sequence");
+
+    return stream_sequence(esysContext, sequence, shandle1, shandle2, shandle3,
+                           read, userdata, hierarchy, result, validation);
+}
+
+/** Compute the HMAC of an arbitrary amount of data on the TPM.
+ *
+ * Starts an HMAC sequence with the given key and feeds all data returned by
+ * the read callback through it.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  handle Handle of an HMAC key.
+ * @param[in]  shandle1 Session handle for authorization of the key and of
+ *             the sequence.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  hashAlg The hash algorithm to use.
+ * @param[in]  read Callback delivering the data; see ESYS_READ_CB.
+ * @param[in]  userdata Pointer passed to the callback.
+ * @param[out] result The returned HMAC. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext, read or result is
+ *         NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the callback returned more bytes than
+ *         requested.
+ * @retval TSS2_RCs produced by the callback or by lower layers of the software
+ *         stack may be returned to the caller unaltered unless handled
+ *         internally.
+ */
+TSS2_RC
+Esys_HMACStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR handle,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    TPMI_ALG_HASH hashAlg,
+    ESYS_READ_CB read,
+    void *userdata,
+    TPM2B_DIGEST **result)
+{
+    TSS2_RC r;
+    ESYS_TR sequence;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(read);
+    _ESYS_ASSERT_NON_NULL(result);
+
+    r = Esys_HMAC_Start(esysContext, handle, shandle1, shandle2, shandle3,
+                        NULL, hashAlg, &sequence);
+    return_if_error(r, "Start HMAC sequence");
+
+    return stream_sequence(esysContext, sequence, shandle1, shandle2, shandle3,
+                           read, userdata, TPM2_RH_NULL, result, NULL);
+}
@@ -7,6 +7,9 @@
 #define ESYS_INT_H
 
 #include <stdint.h>
+#if !defined(_WIN32)
+#include <sys/types.h>
+#endif
 #include "esys_types.h"
 
 #ifdef __cplusplus
@@ -23,6 +26,8 @@ typedef struct RSRC_NODE_T {
                                      to reference this entry. */
     TPM2B_AUTH auth;            /**< The authValue for this resource object. */
     IESYS_RESOURCE rsrc;        /**< The meta data for this resource object. */
+    int name_dirty;             /**< 1 if rsrc.name has to be recomputed from
+                                     the public area in rsrc. */
     struct RSRC_NODE_T * next;  /**< The next object in the linked list. */
 } RSRC_NODE_T;
 
@@ -139,6 +144,20 @@ enum _ESYS_STATE {
                                    ESAPI code. */
 };
 
+/** The size of the caller nonce pool.
+ *
+ * The pool is refilled from the crypto backend in one call once it cannot
+ * serve the next nonce.
+ */
+#define _ESYS_NONCE_POOL_SIZE 1024
+
+/** The number of entries of the retry statistics.
+ *
+ * One entry per command code from TPM2_CC_FIRST to TPM2_CC_LAST and one for
+ * all other command codes.
+ */
+#define _ESYS_RETRY_STATS_SIZE (TPM2_CC_LAST - TPM2_CC_FIRST + 2)
+
 /** The data structure holding internal state information.
  *
  * Each ESYS_CONTEXT respresents a logically independent connection to the TPM.
@@ -176,12 +195,70 @@ struct ESYS_CONTEXT {
                                       automatically loaded. */
     IESYS_SESSION *enc_session;  /**< Ptr to the enc param session.
                                       Used to restore session attributes */
+    UINT32 max_command_size;     /**< Size of the SYS command buffer. */
+    UINT32 max_response_size;    /**< Size of the SYS response buffer. */
+    UINT16 input_buffer_max;     /**< Largest TPM2B_MAX_BUFFER chunk accepted
+                                      by the TPM (0 if not queried yet). */
+    UINT16 nv_buffer_max;        /**< Largest TPM2B_MAX_NV_BUFFER chunk
+                                      accepted by the TPM (0 if not queried
+                                      yet). */
+    uint8_t *random_reservoir;   /**< Random bytes prefetched from the TPM, or
+                                      NULL if no reservoir is configured. */
+    size_t random_reservoir_size;/**< Size of the random reservoir. */
+    size_t random_reservoir_fill;/**< Number of bytes in the reservoir. */
+    size_t random_low_water;     /**< Refill the reservoir when it holds fewer
+                                      bytes. */
+    uint8_t nonce_pool[_ESYS_NONCE_POOL_SIZE]; /**< Pregenerated random bytes
+                                      for caller nonces. */
+    size_t nonce_pool_fill;      /**< Number of unused bytes in nonce_pool. */
+    uint8_t *output_buffer;      /**< Caller provided storage for the outputs
+                                      of _Finish functions, or NULL. */
+    size_t output_buffer_size;   /**< Size of output_buffer. */
+    size_t output_buffer_used;   /**< Bytes of output_buffer holding the
+                                      outputs of the last response. */
+    ESYS_ALLOC_CB alloc_cb;      /**< Allocator of the transient memory, or
+                                      NULL for malloc. */
+    ESYS_FREE_CB free_cb;        /**< Deallocator matching alloc_cb, or NULL
+                                      for free. */
+    void *alloc_userdata;        /**< Pointer passed to alloc_cb and
+                                      free_cb. */
+    uint8_t *arena;              /**< Transient memory of the current command,
+                                      or NULL if not allocated yet. */
+    size_t arena_size;           /**< Size of arena. */
+    size_t arena_used;           /**< Bytes of arena used by the current
+                                      command. */
+    int response_received;       /**< 1 if Esys_Step already received the
+                                      response of the current command. */
+    TSS2_RC response_rc;         /**< The result of receiving the response
+                                      if response_received is set. */
+    int32_t deadline_timeout;    /**< Time budget of a command in ms, or -1
+                                      for none. */
+    int64_t deadline;            /**< End of the budget of the current
+                                      command in us of the monotonic clock, or
+                                      -1 for none. */
+    int64_t phase_start;         /**< Start of the current phase of the
+                                      command in us of the monotonic clock. */
+    ESYS_TIMINGS timings;        /**< Time spent in the phases of the
+                                      current or last command. */
+    ESYS_RETRY_POLICY retry_policy; /**< Rules for resubmissions. */
+    ESYS_RETRY_STATS retry_stats[_ESYS_RETRY_STATS_SIZE]; /**< Resubmissions
+                                      per command code. */
+    int64_t resubmit_at;         /**< Time of the next resubmission in us of
+                                      the monotonic clock. */
+    int resubmit_pending;        /**< 1 if the resubmission waits for
+                                      resubmit_at. */
+#if !defined(_WIN32)
+    pid_t pid;                   /**< The process owning the connection to
+                                      the TPM; see Esys_AfterFork. */
+    int fork_check;              /**< 1 if the _Async functions refuse the
+                                      context in other processes than pid. */
+#endif
 };
 
 /** The number of authomatic resubmissions.
  *
  * The number of resubmissions before a TPM's TPM2_RC_YIELDED is forwarded to
- * the application.
+ * the application, unless a retry policy is set with Esys_SetRetryPolicy.
  */
 #define _ESYS_MAX_SUBMISSIONS 5
 
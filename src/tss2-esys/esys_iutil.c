@@ -8,6 +8,13 @@
 #endif
 
 #include <inttypes.h>
+#include <stdlib.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
 
 #include "tss2_esys.h"
 #include "esys_mu.h"
@@ -533,9 +540,43 @@ iesys_compute_encrypted_salt(ESYS_CONTEXT * esys_context,
     return r;
 }
 
+/** Take a caller nonce from the nonce pool of the context.
+ *
+ * The pool is refilled from the crypto backend if it holds fewer than
+ * num_bytes bytes. Bytes taken from the pool are wiped there.
+ * @param[in,out] esys_context The ESYS_CONTEXT holding the pool.
+ * @param[out] nonce The TPM2B structure for the nonce.
+ * @param[in] num_bytes The size of the nonce; 0 for the largest digest size.
+ * @retval TPM2_RC_SUCCESS on success.
+ * @retval TSS2_RCs produced by the crypto backend.
+ */
+static TSS2_RC
+iesys_nonce_from_pool(ESYS_CONTEXT * esys_context, TPM2B_NONCE * nonce,
+                      size_t num_bytes)
+{
+    TSS2_RC r;
+
+    nonce->size = (num_bytes == 0) ? sizeof(TPMU_HA) : num_bytes;
+    if (nonce->size > esys_context->nonce_pool_fill) {
+        r = iesys_crypto_random(&esys_context->nonce_pool[0],
+                                sizeof(esys_context->nonce_pool));
+        return_if_error(r, "Refilling nonce pool");
+        esys_context->nonce_pool_fill = sizeof(esys_context->nonce_pool);
+    }
+
+    esys_context->nonce_pool_fill -= nonce->size;
+    memcpy(&nonce->buffer[0],
+           &esys_context->nonce_pool[esys_context->nonce_pool_fill],
+           nonce->size);
+    memset(&esys_context->nonce_pool[esys_context->nonce_pool_fill], 0,
+           nonce->size);
+    return TSS2_RC_SUCCESS;
+}
+
 /** Generate caller nonces for all sessions.
  *
- * For every uses session stored in context random nonce is computed.
+ * For every uses session stored in context random nonce is taken from the
+ * nonce pool of the context.
  * @param[in,out]  esys_context The ESYS_CONTEXT. The generated nonces will be
  *                 stored in this context.
  * @retval TPM2_RC_SUCCESS on success. An possible error is:
@@ -552,7 +593,8 @@ iesys_gen_caller_nonces(ESYS_CONTEXT * esys_context)
         if (session == NULL)
             continue;
 
-        r = iesys_crypto_random2b(&session->rsrc.misc.rsrc_session.nonceCaller,
+        r = iesys_nonce_from_pool(esys_context,
+                                  &session->rsrc.misc.rsrc_session.nonceCaller,
                                   session->rsrc.misc.rsrc_session.nonceCaller.size);
         return_if_error(r, "Error: computing caller nonce (%x).");
     }
@@ -623,6 +665,14 @@ iesys_restore_session_flags(ESYS_CONTEXT *esys_context)
     }
 }
 
+/** Size of the KDFa output for parameter encryption keys.
+ *
+ * KDFa produces whole digests, so the key and IV are rounded up to the
+ * largest digest size.
+ */
+#define SYM_KEY_BUFFER_SIZE \
+    (TPM2_MAX_SYM_KEY_BYTES + TPM2_MAX_SYM_BLOCK_SIZE + sizeof(TPMU_HA))
+
 /** Parameter encryption with AES or XOR obfuscation.
  *
  * One parameter of a TPM command will be encrypted with the selected method.
@@ -643,6 +693,8 @@ iesys_encrypt_param(ESYS_CONTEXT * esys_context,
                     TPM2B_NONCE ** decryptNonce, int *decryptNonceIdx)
 {
     TPM2B_NONCE *encryptNonce = NULL;
+    BYTE *encrypt_buffer = NULL;
+    size_t paramSize = 0;
     *decryptNonceIdx = 0;
     *decryptNonce = NULL;
     TSS2_RC r = TSS2_RC_SUCCESS;
@@ -681,14 +733,7 @@ iesys_encrypt_param(ESYS_CONTEXT * esys_context,
         if (rsrc_session->sessionAttributes & TPMA_SESSION_DECRYPT) {
             *decryptNonceIdx = i;
             *decryptNonce = &rsrc_session->nonceTPM;
-            size_t hlen;
-            r = iesys_crypto_hash_get_digest_size(rsrc_session->authHash, &hlen);
-            return_if_error(r, "get digest size");
-            size_t key_len = TPM2_MAX_SYM_KEY_BYTES + TPM2_MAX_SYM_BLOCK_SIZE;
-            if (key_len % hlen > 0)
-                key_len = key_len + hlen - (key_len % hlen);
-            uint8_t symKey[key_len];
-            size_t paramSize = 0;
+            uint8_t symKey[SYM_KEY_BUFFER_SIZE];
             const uint8_t *paramBuffer;
 
             r = Tss2_Sys_GetDecryptParam(esys_context->sys, &paramSize,
@@ -698,15 +743,18 @@ iesys_encrypt_param(ESYS_CONTEXT * esys_context,
             if (paramSize == 0)
                 continue;
 
-            BYTE encrypt_buffer[paramSize];
+            encrypt_buffer = iesys_arena_alloc(esys_context, paramSize);
+            goto_if_null(encrypt_buffer, "Out of memory.",
+                         TSS2_ESYS_RC_MEMORY, error_cleanup);
             memcpy(&encrypt_buffer[0], paramBuffer, paramSize);
             LOGBLOB_DEBUG(paramBuffer, paramSize, "param to encrypt");
 
             /* AES encryption with key derived with KDFa */
             if (symDef->algorithm == TPM2_ALG_AES) {
                 if (symDef->mode.aes != TPM2_ALG_CFB) {
-                    return_error(TSS2_ESYS_RC_BAD_VALUE,
-                                 "Invalid symmetric mode (must be CFB)");
+                    goto_error(r, TSS2_ESYS_RC_BAD_VALUE,
+                               "Invalid symmetric mode (must be CFB)",
+                               error_cleanup);
                 }
                 r = iesys_crypto_KDFa(rsrc_session->authHash,
                                       &rsrc_session->sessionValue[0],
@@ -715,7 +763,7 @@ iesys_encrypt_param(ESYS_CONTEXT * esys_context,
                                       &rsrc_session->nonceTPM,
                                       symDef->keyBits.aes + AES_BLOCK_SIZE_IN_BYTES * 8,
                                       NULL, &symKey[0], FALSE);
-                return_if_error(r, "while computing KDFa");
+                goto_if_error(r, "while computing KDFa", error_cleanup);
 
                 size_t aes_off = ( symDef->keyBits.aes + 7) / 8;
                 r = iesys_crypto_sym_aes_encrypt(&symKey[0],
@@ -725,7 +773,7 @@ iesys_encrypt_param(ESYS_CONTEXT * esys_context,
                                                  AES_BLOCK_SIZE_IN_BYTES,
                                                  &encrypt_buffer[0], paramSize,
                                                  &symKey[aes_off]);
-                return_if_error(r, "AES encryption not possible");
+                goto_if_error(r, "AES encryption not possible", error_cleanup);
             }
             /* XOR obfuscation of parameter */
             else if (symDef->algorithm == TPM2_ALG_XOR) {
@@ -736,19 +784,31 @@ iesys_encrypt_param(ESYS_CONTEXT * esys_context,
                                                     &rsrc_session->nonceTPM,
                                                     &encrypt_buffer[0],
                                                     paramSize);
-                return_if_error(r, "XOR obfuscation not possible.");
+                goto_if_error(r, "XOR obfuscation not possible.",
+                              error_cleanup);
 
             } else {
-                return_error(TSS2_ESYS_RC_BAD_VALUE,
-                             "Invalid symmetric algorithm (should be XOR or AES)");
+                goto_error(r, TSS2_ESYS_RC_BAD_VALUE,
+                           "Invalid symmetric algorithm (should be XOR or AES)",
+                           error_cleanup);
             }
             r = Tss2_Sys_SetDecryptParam(esys_context->sys, paramSize,
                                          &encrypt_buffer[0]);
-            return_if_error(r, "Set encrypt parameter not possible");
+            goto_if_error(r, "Set encrypt parameter not possible",
+                          error_cleanup);
 
+            memset(encrypt_buffer, 0, paramSize);
+            iesys_arena_free(esys_context, encrypt_buffer);
+            encrypt_buffer = NULL;
         }
     }
     return r;
+
+error_cleanup:
+    if (encrypt_buffer != NULL)
+        memset(encrypt_buffer, 0, paramSize);
+    iesys_arena_free(esys_context, encrypt_buffer);
+    return r;
 }
 
 /** Parameter decryption with AES or XOR obfuscation.
@@ -770,34 +830,28 @@ iesys_decrypt_param(ESYS_CONTEXT * esys_context)
     TSS2_RC r;
     const uint8_t *ciphertext;
     size_t p2BSize;
-    size_t hlen;
     RSRC_NODE_T *session;
     IESYS_SESSION *rsrc_session;
     TPMT_SYM_DEF *symDef;
-    size_t key_len = TPM2_MAX_SYM_KEY_BYTES + TPM2_MAX_SYM_BLOCK_SIZE;
+    uint8_t symKey[SYM_KEY_BUFFER_SIZE];
+    UINT8 *plaintext;
 
     session = esys_context->session_tab[esys_context->encryptNonceIdx];
     rsrc_session = &session->rsrc.misc.rsrc_session;
     symDef = &rsrc_session->symmetric;
 
-    r = iesys_crypto_hash_get_digest_size(rsrc_session->authHash, &hlen);
-    return_if_error(r, "Error");
-    if (key_len % hlen > 0)
-        key_len = key_len + hlen - (key_len % hlen);
-
-    uint8_t symKey[key_len];
-
     r = Tss2_Sys_GetEncryptParam(esys_context->sys, &p2BSize, &ciphertext);
     return_if_error(r, "Getting encrypt param");
 
-    UINT8 plaintext[p2BSize];
+    plaintext = iesys_arena_alloc(esys_context, p2BSize);
+    return_if_null(plaintext, "Out of memory.", TSS2_ESYS_RC_MEMORY);
     memcpy(&plaintext[0], ciphertext, p2BSize);
 
     if (symDef->algorithm == TPM2_ALG_AES) {
         /* Parameter decryption with a symmetric AES key derived by KDFa */
         if (symDef->mode.aes != TPM2_ALG_CFB) {
-            return_error(TSS2_ESYS_RC_BAD_VALUE,
-                         "Invalid symmetric mode (must be CFB)");
+            goto_error(r, TSS2_ESYS_RC_BAD_VALUE,
+                       "Invalid symmetric mode (must be CFB)", error_cleanup);
         }
         LOGBLOB_DEBUG(&rsrc_session->sessionKey.buffer[0],
                       rsrc_session->sessionKey.size,
@@ -811,7 +865,7 @@ iesys_decrypt_param(ESYS_CONTEXT * esys_context)
                               symDef->keyBits.aes
                               + AES_BLOCK_SIZE_IN_BYTES * 8, NULL,
                               &symKey[0], FALSE);
-        return_if_error(r, "KDFa error");
+        goto_if_error(r, "KDFa error", error_cleanup);
         LOGBLOB_DEBUG(&symKey[0],
                       ((symDef->keyBits.aes +
                         AES_BLOCK_SIZE_IN_BYTES * 8) + 7) / 8,
@@ -825,10 +879,10 @@ iesys_decrypt_param(ESYS_CONTEXT * esys_context)
                                      AES_BLOCK_SIZE_IN_BYTES,
                                      &plaintext[0], p2BSize,
                                      &symKey[aes_off]);
-        return_if_error(r, "Decryption error");
+        goto_if_error(r, "Decryption error", error_cleanup);
 
         r = Tss2_Sys_SetEncryptParam(esys_context->sys, p2BSize, &plaintext[0]);
-        return_if_error(r, "Setting plaintext");
+        goto_if_error(r, "Setting plaintext", error_cleanup);
     } else if (symDef->algorithm == TPM2_ALG_XOR) {
         /* Parameter decryption with XOR obfuscation */
         r = iesys_xor_parameter_obfuscation(rsrc_session->authHash,
@@ -838,15 +892,20 @@ iesys_decrypt_param(ESYS_CONTEXT * esys_context)
                                             &rsrc_session->nonceCaller,
                                             &plaintext[0],
                                             p2BSize);
-        return_if_error(r, "XOR obfuscation not possible.");
+        goto_if_error(r, "XOR obfuscation not possible.", error_cleanup);
 
         r = Tss2_Sys_SetEncryptParam(esys_context->sys, p2BSize, &plaintext[0]);
-        return_if_error(r, "Setting plaintext");
+        goto_if_error(r, "Setting plaintext", error_cleanup);
     } else {
-        return_error(TSS2_ESYS_RC_BAD_VALUE,
-                     "Invalid symmetric algorithm (should be XOR or AES)");
+        goto_error(r, TSS2_ESYS_RC_BAD_VALUE,
+                   "Invalid symmetric algorithm (should be XOR or AES)",
+                   error_cleanup);
     }
-    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    memset(plaintext, 0, p2BSize);
+    iesys_arena_free(esys_context, plaintext);
+    return r;
 }
 
 /** Check the HMAC values of the response for all sessions.
@@ -1040,6 +1099,7 @@ iesys_compute_session_value(RSRC_NODE_T * session,
  * @param[in,out] esys_context The esys context to issue the command on.
  * @param[in] esys_handle The handle to find the corresponding object for.
  * @param[out] esys_object The object containing the name, tpm handle and auth value
+ *             The name is recomputed first if the public area was changed.
  * @retval TSS2_RC_SUCCESS on success.
  * @retval TSS2_ESYS_RC_BAD_TR if the handle is invalid.
  * @retval TSS2_ESYS_RC_BAD_VALUE if an unknown handle < ESYS_TR_MIN_OBJECT is
@@ -1071,6 +1131,9 @@ esys_GetResourceObject(ESYS_CONTEXT * esys_context,
     for (esys_object_aux = esys_context->rsrc_list; esys_object_aux != NULL;
          esys_object_aux = esys_object_aux->next) {
         if (esys_object_aux->esys_handle == esys_handle) {
+            /* Names are computed lazily, when the object is used */
+            r = iesys_update_name(esys_object_aux);
+            return_if_error(r, "Update name.");
             *esys_object = esys_object_aux;
             return TPM2_RC_SUCCESS;
         }
@@ -1131,10 +1194,324 @@ iesys_check_sequence_async(ESYS_CONTEXT * esys_context)
         LOG_ERROR("Esys called in bad sequence.");
         return TSS2_ESYS_RC_BAD_SEQUENCE;
     }
+#if !defined(_WIN32)
+    /* The connection belongs to the parent of a forked process */
+    if (esys_context->fork_check && esys_context->pid != getpid()) {
+        LOG_ERROR("Esys context inherited by fork(), call Esys_AfterFork.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+#endif
     esys_context->submissionCount = 1;
+    esys_context->response_received = 0;
+    esys_context->resubmit_pending = 0;
+    esys_context->resubmit_at = 0;
+    iesys_arena_reset(esys_context);
+
+    /* Start the clock of the command */
+    esys_context->phase_start = iesys_time_us();
+    memset(&esys_context->timings, 0, sizeof(esys_context->timings));
+    if (esys_context->deadline_timeout < 0)
+        esys_context->deadline = -1;
+    else
+        esys_context->deadline = esys_context->phase_start +
+            (int64_t) esys_context->deadline_timeout * 1000;
     return TSS2_RC_SUCCESS;
 }
 
+/** Read the monotonic clock in microseconds. */
+int64_t
+iesys_time_us(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER count, frequency;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (int64_t) (count.QuadPart / frequency.QuadPart) * 1000000 +
+           (int64_t) (count.QuadPart % frequency.QuadPart) * 1000000 /
+           frequency.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/** Send the command of the context to the TPM.
+ *
+ * Called by the _Async functions, and by the _Finish functions for
+ * resubmissions, instead of Tss2_Sys_ExecuteAsync. Ends the prepare phase
+ * of the command.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TSS2_RCs produced by Tss2_Sys_ExecuteAsync.
+ */
+TSS2_RC
+iesys_execute_async(ESYS_CONTEXT * esys_context)
+{
+    int64_t now = iesys_time_us();
+
+    if (esys_context->state != _ESYS_STATE_RESUBMISSION) {
+        esys_context->timings.prepare = now - esys_context->phase_start;
+    } else if (esys_context->resubmit_at > now) {
+        /* The retry policy delays the resubmission; it is sent by
+           iesys_execute_finish once it is due. */
+        esys_context->resubmit_pending = 1;
+        return TSS2_RC_SUCCESS;
+    }
+    esys_context->phase_start = now;
+    return Tss2_Sys_ExecuteAsync(esys_context->sys);
+}
+
+/** Suspend the calling thread.
+ *
+ * @param[in] ms The time in ms.
+ */
+static void
+iesys_sleep_ms(int64_t ms)
+{
+    if (ms <= 0)
+        return;
+#if defined(_WIN32)
+    Sleep((DWORD) ms);
+#else
+    struct timespec ts = { .tv_sec = ms / 1000,
+                           .tv_nsec = (ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) != 0);
+#endif
+}
+
+/** Return the retry statistics of a command code.
+ *
+ * @param[in] esys_context The ESYS_CONTEXT.
+ * @param[in] command_code The command code.
+ * @retval The statistics entry of the command code.
+ */
+ESYS_RETRY_STATS *
+iesys_retry_stats(ESYS_CONTEXT * esys_context, TPM2_CC command_code)
+{
+    if (command_code < TPM2_CC_FIRST || command_code > TPM2_CC_LAST)
+        return &esys_context->retry_stats[_ESYS_RETRY_STATS_SIZE - 1];
+    return &esys_context->retry_stats[command_code - TPM2_CC_FIRST];
+}
+
+/** Decide on the resubmission of a command according to the retry policy.
+ *
+ * Called by the _Finish functions when the TPM answered TPM2_RC_RETRY,
+ * TPM2_RC_YIELDED or TPM2_RC_TESTING. Counts the submission, schedules the
+ * resubmission after the backoff of the rule of the response code and
+ * records it in the retry statistics.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] r The response code of the TPM.
+ * @retval true if the command is to be resubmitted.
+ * @retval false if the maximum number of submissions was reached.
+ */
+bool
+iesys_retry(ESYS_CONTEXT * esys_context, TSS2_RC r)
+{
+    const ESYS_RETRY_RULE *rule;
+    ESYS_RETRY_STATS *stats;
+    UINT64 delay;
+    UINT32 submissions;
+
+    if (r == TPM2_RC_TESTING)
+        rule = &esys_context->retry_policy.testing;
+    else if (r == TPM2_RC_YIELDED)
+        rule = &esys_context->retry_policy.yielded;
+    else
+        rule = &esys_context->retry_policy.retry;
+    stats = iesys_retry_stats(esys_context,
+                              syscontext_cast(esys_context->sys)->commandCode);
+
+    submissions = (UINT32) esys_context->submissionCount;
+    if (submissions >= rule->maxSubmissions) {
+        stats->exhausted++;
+        return false;
+    }
+
+    /* Exponential backoff, capped at maxDelay */
+    delay = rule->initialDelay;
+    for (; submissions > 1 && delay < rule->maxDelay; submissions--)
+        delay *= 2;
+    if (delay > rule->maxDelay)
+        delay = rule->maxDelay;
+    if (delay > 0 && rule->jitter > 0)
+        delay -= (UINT64) rand() % (delay * rule->jitter / 100 + 1);
+
+    esys_context->submissionCount++;
+    esys_context->resubmit_at = iesys_time_us() + (int64_t) delay * 1000;
+    stats->retries++;
+    stats->delay += delay;
+    LOG_DEBUG("Resubmission %i in %" PRIu64 " ms",
+              esys_context->submissionCount, delay);
+    return true;
+}
+
+/** Return the time until a delayed resubmission is due.
+ *
+ * @param[in] esys_context The ESYS_CONTEXT.
+ * @retval The time in ms, 0 if it is due, or -1 if no resubmission is
+ *         pending.
+ */
+int32_t
+iesys_resubmit_wait(ESYS_CONTEXT * esys_context)
+{
+    int64_t now;
+
+    if (!esys_context->resubmit_pending)
+        return -1;
+    now = iesys_time_us();
+    if (esys_context->resubmit_at <= now)
+        return 0;
+    return (int32_t) ((esys_context->resubmit_at - now + 999) / 1000);
+}
+
+/** Send a resubmission delayed by the retry policy once it is due.
+ *
+ * Waits for the resubmission within timeout.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in,out] timeout The timeout in ms or -1 to block; reduced by the
+ *                time waited.
+ * @retval TSS2_RC_SUCCESS if the command was sent.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if the resubmission is not due within
+ *         timeout.
+ * @retval TPM2_RC_CANCELED if the deadline of the command passes before.
+ * @retval TSS2_RCs produced by Tss2_Sys_ExecuteAsync.
+ */
+TSS2_RC
+iesys_resubmit(ESYS_CONTEXT * esys_context, int32_t *timeout)
+{
+    int32_t wait = iesys_resubmit_wait(esys_context);
+
+    if (wait < 0)
+        return TSS2_RC_SUCCESS;
+    if (esys_context->deadline >= 0 &&
+        esys_context->resubmit_at >= esys_context->deadline) {
+        LOG_WARNING("Deadline passes before the resubmission.");
+        esys_context->resubmit_pending = 0;
+        esys_context->deadline = -1;
+        return TPM2_RC_CANCELED;
+    }
+    if (wait > 0) {
+        if (*timeout >= 0 && *timeout < wait) {
+            iesys_sleep_ms(*timeout);
+            return TSS2_ESYS_RC_TRY_AGAIN;
+        }
+        iesys_sleep_ms(wait);
+        if (*timeout >= 0)
+            *timeout -= wait;
+    }
+    esys_context->resubmit_pending = 0;
+    esys_context->phase_start = iesys_time_us();
+    return Tss2_Sys_ExecuteAsync(esys_context->sys);
+}
+
+/** Abandon the command of the context after its deadline passed.
+ *
+ * The command is canceled with Tss2_Tcti_Cancel and its response, usually
+ * TPM2_RC_CANCELED, is received blocking and dropped, so that it is not taken
+ * for the response of the next command. If the TCTI cannot cancel, the
+ * deadline is dropped and the command continues.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TPM2_RC_CANCELED if the command was canceled.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if the TCTI cannot cancel the command.
+ */
+static TSS2_RC
+iesys_cancel(ESYS_CONTEXT * esys_context)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti_context;
+
+    esys_context->deadline = -1;
+    r = Tss2_Sys_GetTctiContext(esys_context->sys, &tcti_context);
+    return_if_error(r, "Invalid SAPI or TCTI context.");
+
+    r = Tss2_Tcti_Cancel(tcti_context);
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_WARNING("Deadline passed, but the command cannot be canceled: %"
+                    PRIx32, r);
+        return TSS2_ESYS_RC_TRY_AGAIN;
+    }
+    r = Tss2_Sys_ExecuteFinish(esys_context->sys, TSS2_TCTI_TIMEOUT_BLOCK);
+    if (r != TSS2_RC_SUCCESS)
+        LOG_DEBUG("Response of the canceled command: %" PRIx32, r);
+    /* The SAPI context does not wait for the response any more */
+    syscontext_cast(esys_context->sys)->previousStage = CMD_STAGE_INITIALIZE;
+    LOG_WARNING("Deadline passed, command canceled.");
+    return TPM2_RC_CANCELED;
+}
+
+/** Receive the TPM response of the current command within its deadline.
+ *
+ * The timeout is shortened to the time left until the deadline of the
+ * command. Once the deadline has passed, the command is canceled. If the
+ * TCTI rejects the shortened timeout, e.g. because it only receives blocking
+ * like mssim, the deadline is dropped and timeout is used.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] timeout The timeout in ms or -1 to block.
+ * @retval TPM2_RC_CANCELED if the command was canceled.
+ * @retval TSS2_RCs produced by Tss2_Sys_ExecuteFinish.
+ */
+TSS2_RC
+iesys_receive(ESYS_CONTEXT * esys_context, int32_t timeout)
+{
+    TSS2_RC r;
+    int64_t left, now;
+    int32_t timeout_deadline = timeout;
+
+    if (esys_context->deadline >= 0) {
+        now = iesys_time_us();
+        left = (esys_context->deadline > now) ?
+            (esys_context->deadline - now + 999) / 1000 : 0;
+        if (timeout < 0 || left < timeout)
+            timeout_deadline = (int32_t) left;
+    }
+
+    r = Tss2_Sys_ExecuteFinish(esys_context->sys, timeout_deadline);
+    if (r == TSS2_TCTI_RC_BAD_VALUE && timeout_deadline != timeout) {
+        LOG_WARNING("Deadline passed, but the TCTI does not support the "
+                    "timeout.");
+        esys_context->deadline = -1;
+        r = Tss2_Sys_ExecuteFinish(esys_context->sys, timeout);
+    }
+    now = iesys_time_us();
+    if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN) {
+        if (esys_context->deadline >= 0 && now >= esys_context->deadline) {
+            esys_context->timings.tpm += now - esys_context->phase_start;
+            return iesys_cancel(esys_context);
+        }
+        return r;
+    }
+    esys_context->timings.tpm += now - esys_context->phase_start;
+    esys_context->phase_start = now;
+    return r;
+}
+
+/** Receive the TPM response of the current command.
+ *
+ * Called by the _Finish functions instead of Tss2_Sys_ExecuteFinish. If
+ * Esys_Step already received the response, its result is returned without
+ * calling the TCTI again. A resubmission delayed by the retry policy is sent
+ * first.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TSS2_RCs produced by iesys_receive.
+ */
+TSS2_RC
+iesys_execute_finish(ESYS_CONTEXT * esys_context)
+{
+    TSS2_RC r;
+    int32_t timeout = esys_context->timeout;
+
+    if (esys_context->response_received) {
+        esys_context->response_received = 0;
+        return esys_context->response_rc;
+    }
+    r = iesys_resubmit(esys_context, &timeout);
+    if (r != TSS2_RC_SUCCESS)
+        return r;
+    return iesys_receive(esys_context, timeout);
+}
+
 /** Check whether session without authorization occurs before one with.
  *
  * @param[in] session1-3 The three sessions.
@@ -1338,23 +1715,9 @@ iesys_gen_auths(ESYS_CONTEXT * esys_context,
     return TSS2_RC_SUCCESS;
 }
 
-/** Check the response HMACs for all sessions.
- *
- * The response HMAC values are computed. Based on these values the HMACs for
- * all sessions are computed and compared with the HMACs stored in the response
- * auth list which is determined with the SAPI function Tss2_Sys_GetRspAuths.
- * @param[in] esys_context The esys context which is used to get the response
- * auth values and the sessions.
- * @retval TSS2_RC_SUCCESS on success.
- * @retval TSS2_ESYS_RC_MEMORY Memory can not be allocated.
- * @retval TSS2_ESYS_RC_BAD_VALUE for invalid parameters.
- * @retval TSS2_ESYS_RC_BAD_REFERENCE for unexpected NULL pointer parameters.
- * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
- * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if hash algorithm is not implemented.
- * @retval TSS2_SYS_RC_* for SAPI errors.
- */
-TSS2_RC
-iesys_check_response(ESYS_CONTEXT * esys_context)
+/** Check the response HMACs and decrypt the response parameters. */
+static TSS2_RC
+check_response(ESYS_CONTEXT * esys_context)
 {
     TSS2_RC r;
     const uint8_t *rpBuffer;
@@ -1409,6 +1772,32 @@ iesys_check_response(ESYS_CONTEXT * esys_context)
     return TSS2_RC_SUCCESS;
 }
 
+/** Check the response HMACs for all sessions.
+ *
+ * The response HMAC values are computed. Based on these values the HMACs for
+ * all sessions are computed and compared with the HMACs stored in the response
+ * auth list which is determined with the SAPI function Tss2_Sys_GetRspAuths.
+ * @param[in] esys_context The esys context which is used to get the response
+ * auth values and the sessions.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY Memory can not be allocated.
+ * @retval TSS2_ESYS_RC_BAD_VALUE for invalid parameters.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for unexpected NULL pointer parameters.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if hash algorithm is not implemented.
+ * @retval TSS2_SYS_RC_* for SAPI errors.
+ */
+TSS2_RC
+iesys_check_response(ESYS_CONTEXT * esys_context)
+{
+    TSS2_RC r;
+    int64_t start = iesys_time_us();
+
+    r = check_response(esys_context);
+    esys_context->timings.verify = iesys_time_us() - start;
+    return r;
+}
+
 /** Compute the name from the public data of a NV index.
  *
  * The name of a NV index is computed as follows:
@@ -1426,7 +1815,7 @@ iesys_check_response(ESYS_CONTEXT * esys_context)
 TSS2_RC
 iesys_nv_get_name(TPM2B_NV_PUBLIC * publicInfo, TPM2B_NAME * name)
 {
-    BYTE buffer[sizeof(TPMS_NV_PUBLIC)];
+    BYTE buffer[TSS2_MU_TPMS_NV_PUBLIC_MAX_SIZE];
     size_t offset = 0;
     size_t size = sizeof(TPMU_NAME) - sizeof(TPMI_ALG_HASH);
     size_t len_alg_id = sizeof(TPMI_ALG_HASH);
@@ -1441,7 +1830,7 @@ iesys_nv_get_name(TPM2B_NV_PUBLIC * publicInfo, TPM2B_NAME * name)
     return_if_error(r, "Crypto hash start");
 
     r = Tss2_MU_TPMS_NV_PUBLIC_Marshal(&publicInfo->nvPublic,
-                                       &buffer[0], sizeof(TPMS_NV_PUBLIC),
+                                       &buffer[0], sizeof(buffer),
                                        &offset);
     return_if_error(r, "Marshaling TPMS_NV_PUBLIC");
 
@@ -1475,7 +1864,7 @@ iesys_nv_get_name(TPM2B_NV_PUBLIC * publicInfo, TPM2B_NAME * name)
 TSS2_RC
 iesys_get_name(TPM2B_PUBLIC * publicInfo, TPM2B_NAME * name)
 {
-    BYTE buffer[sizeof(TPMT_PUBLIC)];
+    BYTE buffer[TSS2_MU_TPMT_PUBLIC_MAX_SIZE];
     size_t offset = 0;
     size_t len_alg_id = sizeof(TPMI_ALG_HASH);
     size_t size = sizeof(TPMU_NAME) - sizeof(TPMI_ALG_HASH);
@@ -1490,7 +1879,7 @@ iesys_get_name(TPM2B_PUBLIC * publicInfo, TPM2B_NAME * name)
     return_if_error(r, "crypto hash start");
 
     r = Tss2_MU_TPMT_PUBLIC_Marshal(&publicInfo->publicArea,
-                                    &buffer[0], sizeof(TPMT_PUBLIC), &offset);
+                                    &buffer[0], sizeof(buffer), &offset);
     return_if_error(r, "Marshaling TPMT_PUBLIC");
 
     r = iesys_crypto_hash_update(cryptoContext, &buffer[0], offset);
@@ -1510,6 +1899,50 @@ iesys_get_name(TPM2B_PUBLIC * publicInfo, TPM2B_NAME * name)
     return TSS2_RC_SUCCESS;
 }
 
+/** Recompute the cached name of a resource object if it is outdated.
+ *
+ * The name of a key or NV index is stored in the resource object and only
+ * recomputed from the public area after the public area was changed, i.e.
+ * name_dirty was set.
+ * @param[in,out] node The resource object.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_RCs produced by iesys_get_name or iesys_nv_get_name.
+ */
+TSS2_RC
+iesys_update_name(RSRC_NODE_T * node)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+
+    if (!node->name_dirty)
+        return TSS2_RC_SUCCESS;
+    if (node->rsrc.rsrcType == IESYSC_KEY_RSRC)
+        r = iesys_get_name(&node->rsrc.misc.rsrc_key_pub, &node->rsrc.name);
+    else if (node->rsrc.rsrcType == IESYSC_NV_RSRC)
+        r = iesys_nv_get_name(&node->rsrc.misc.rsrc_nv_pub, &node->rsrc.name);
+    return_if_error(r, "Compute name");
+
+    node->name_dirty = 0;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Set attributes in the public area of an NV index resource object.
+ *
+ * The name of the NV index is marked outdated only if the attributes change,
+ * e.g. the first time TPMA_NV_WRITTEN is set.
+ * @param[in,out] node The resource object of the NV index.
+ * @param[in] attributes The attributes to set.
+ */
+void
+iesys_nv_set_attributes(RSRC_NODE_T * node, TPMA_NV attributes)
+{
+    TPMA_NV *nv_attributes = &node->rsrc.misc.rsrc_nv_pub.nvPublic.attributes;
+
+    if ((*nv_attributes & attributes) == attributes)
+        return;
+    *nv_attributes |= attributes;
+    node->name_dirty = 1;
+}
+
 /** Check whether the return code corresponds to an TPM error.
  *
  * if no layer is part of the return code or a layer from the resource manager
@@ -1526,3 +1959,238 @@ iesys_tpm_error(TSS2_RC r)
              (r & TSS2_RC_LAYER_MASK) == TSS2_RESMGR_TPM_RC_LAYER ||
              (r & TSS2_RC_LAYER_MASK) == TSS2_RESMGR_RC_LAYER));
 }
+
+/** Fill a chunk from the read callback.
+ *
+ * Calls the read callback until the chunk holds chunk_size bytes or the
+ * callback signals the end of the data.
+ * @param[in]  read The read callback.
+ * @param[in]  userdata The userdata for the callback.
+ * @param[in]  chunk_size The number of bytes to read.
+ * @param[out] chunk The chunk to fill.
+ * @param[out] eof Set to 1 if the end of the data was reached.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the callback returns too many bytes.
+ * @retval TSS2_RCs produced by the callback.
+ */
+TSS2_RC
+iesys_stream_fill(
+    ESYS_READ_CB read,
+    void *userdata,
+    UINT16 chunk_size,
+    TPM2B_MAX_BUFFER *chunk,
+    int *eof)
+{
+    TSS2_RC r;
+    size_t size;
+
+    chunk->size = 0;
+    *eof = 0;
+    while (chunk->size < chunk_size) {
+        size = chunk_size - chunk->size;
+        r = read(userdata, &chunk->buffer[chunk->size], &size);
+        return_if_error(r, "Read callback");
+        if (size > (size_t)(chunk_size - chunk->size)) {
+            LOG_ERROR("Read callback returned %zu bytes.", size);
+            return TSS2_ESYS_RC_BAD_VALUE;
+        }
+        if (size == 0) {
+            *eof = 1;
+            break;
+        }
+        chunk->size += size;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Alignment of the memory in the output buffer and in the arena. */
+#define OUTPUT_ALIGNMENT sizeof(UINT64)
+
+/** Align an offset into a buffer to OUTPUT_ALIGNMENT.
+ *
+ * The address is aligned, not the offset; the buffer may be unaligned.
+ */
+static size_t
+align_offset(const uint8_t *buffer, size_t offset)
+{
+    uintptr_t start = (uintptr_t) buffer;
+
+    return offset + (OUTPUT_ALIGNMENT - (start + offset) % OUTPUT_ALIGNMENT) %
+                    OUTPUT_ALIGNMENT;
+}
+
+/** Release the outputs of the previous response.
+ *
+ * Called by the _Finish functions before they allocate their outputs. The
+ * outputs of the previous command that were placed in the output buffer of
+ * the context become invalid.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+void
+iesys_output_reset(ESYS_CONTEXT *esys_context)
+{
+    esys_context->output_buffer_used = 0;
+}
+
+/** Allocate a zeroed output of a _Finish function.
+ *
+ * The output is placed in the output buffer set with Esys_SetOutputBuffer.
+ * If no output buffer is set or it is exhausted, the output is allocated
+ * on the heap; callers free outputs with Esys_FreeOutput either way.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] size The size of the output.
+ * @retval The output or NULL if memory cannot be allocated.
+ */
+void *
+iesys_output_calloc(ESYS_CONTEXT *esys_context, size_t size)
+{
+    size_t offset;
+    uint8_t *ptr;
+
+    if (esys_context->output_buffer == NULL)
+        return calloc(1, size);
+
+    offset = align_offset(esys_context->output_buffer,
+                          esys_context->output_buffer_used);
+    if (offset > esys_context->output_buffer_size ||
+        size > esys_context->output_buffer_size - offset) {
+        LOG_WARNING("Output buffer exhausted, allocating %zu bytes.", size);
+        return calloc(1, size);
+    }
+
+    ptr = &esys_context->output_buffer[offset];
+    esys_context->output_buffer_used = offset + size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+/** Free an output of a _Finish function.
+ *
+ * Outputs in the output buffer of the context are left alone, all others
+ * are freed.
+ * @param[in] esys_context The ESYS_CONTEXT.
+ * @param[in] ptr The output. May be NULL.
+ */
+void
+iesys_output_free(ESYS_CONTEXT *esys_context, void *ptr)
+{
+    uintptr_t start = (uintptr_t) esys_context->output_buffer;
+    uintptr_t addr = (uintptr_t) ptr;
+
+    if (esys_context->output_buffer != NULL && addr >= start &&
+        addr - start < esys_context->output_buffer_size)
+        return;
+    free(ptr);
+}
+
+/** Allocate memory with the allocator of the context. */
+static void *
+arena_block_alloc(ESYS_CONTEXT *esys_context, size_t size)
+{
+    if (esys_context->alloc_cb != NULL)
+        return esys_context->alloc_cb(esys_context->alloc_userdata, size);
+    return malloc(size);
+}
+
+/** Free memory with the deallocator of the context. */
+static void
+arena_block_free(ESYS_CONTEXT *esys_context, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    if (esys_context->free_cb != NULL)
+        esys_context->free_cb(esys_context->alloc_userdata, ptr);
+    else
+        free(ptr);
+}
+
+/** Release the transient memory of the previous command.
+ *
+ * Called when a command is started. The memory handed out by
+ * iesys_arena_alloc becomes invalid; the arena itself is kept.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+void
+iesys_arena_reset(ESYS_CONTEXT *esys_context)
+{
+    esys_context->arena_used = 0;
+}
+
+/** Allocate transient memory for the current command.
+ *
+ * The memory is taken from the arena of the context, which is allocated on
+ * first use with the allocator set by Esys_SetAllocator and is large enough
+ * for a command and a response buffer. Requests that do not fit are
+ * allocated with the allocator directly. The memory is not initialized and
+ * must be released with iesys_arena_free.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] size The size of the memory.
+ * @retval The memory or NULL if it cannot be allocated.
+ */
+void *
+iesys_arena_alloc(ESYS_CONTEXT *esys_context, size_t size)
+{
+    size_t arena_size, offset;
+
+    /* Every allocation gets its own address */
+    if (size == 0)
+        size = 1;
+
+    /* (Re)size the arena while nothing of it is in use */
+    arena_size = (size_t) esys_context->max_command_size +
+                 esys_context->max_response_size + 2 * OUTPUT_ALIGNMENT;
+    if (esys_context->arena_used == 0 &&
+        esys_context->arena_size < arena_size) {
+        arena_block_free(esys_context, esys_context->arena);
+        esys_context->arena_size = 0;
+        esys_context->arena = arena_block_alloc(esys_context, arena_size);
+        if (esys_context->arena != NULL)
+            esys_context->arena_size = arena_size;
+    }
+
+    if (esys_context->arena != NULL) {
+        offset = align_offset(esys_context->arena, esys_context->arena_used);
+        if (offset <= esys_context->arena_size &&
+            size <= esys_context->arena_size - offset) {
+            esys_context->arena_used = offset + size;
+            return &esys_context->arena[offset];
+        }
+    }
+
+    LOG_DEBUG("Arena exhausted, allocating %zu bytes.", size);
+    return arena_block_alloc(esys_context, size);
+}
+
+/** Free transient memory of the current command.
+ *
+ * Memory in the arena of the context is left alone until the arena is reset,
+ * all other memory is returned to the allocator.
+ * @param[in] esys_context The ESYS_CONTEXT.
+ * @param[in] ptr The memory. May be NULL.
+ */
+void
+iesys_arena_free(ESYS_CONTEXT *esys_context, void *ptr)
+{
+    uintptr_t start = (uintptr_t) esys_context->arena;
+    uintptr_t addr = (uintptr_t) ptr;
+
+    if (esys_context->arena != NULL && addr >= start &&
+        addr - start < esys_context->arena_size)
+        return;
+    arena_block_free(esys_context, ptr);
+}
+
+/** Return the arena of the context to the allocator.
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+void
+iesys_arena_release(ESYS_CONTEXT *esys_context)
+{
+    if (esys_context->arena != NULL)
+        memset(esys_context->arena, 0, esys_context->arena_size);
+    arena_block_free(esys_context, esys_context->arena);
+    esys_context->arena = NULL;
+    esys_context->arena_size = 0;
+    esys_context->arena_used = 0;
+}
@@ -110,6 +110,34 @@ bool iesys_is_object_bound(
 TSS2_RC iesys_check_sequence_async(
     ESYS_CONTEXT *esysContext);
 
+int64_t iesys_time_us(
+    void);
+
+TSS2_RC iesys_execute_async(
+    ESYS_CONTEXT *esysContext);
+
+TSS2_RC iesys_receive(
+    ESYS_CONTEXT *esysContext,
+    int32_t timeout);
+
+ESYS_RETRY_STATS *iesys_retry_stats(
+    ESYS_CONTEXT *esysContext,
+    TPM2_CC commandCode);
+
+bool iesys_retry(
+    ESYS_CONTEXT *esysContext,
+    TSS2_RC r);
+
+int32_t iesys_resubmit_wait(
+    ESYS_CONTEXT *esysContext);
+
+TSS2_RC iesys_resubmit(
+    ESYS_CONTEXT *esysContext,
+    int32_t *timeout);
+
+TSS2_RC iesys_execute_finish(
+    ESYS_CONTEXT *esysContext);
+
 TSS2_RC check_session_feasibility(
     ESYS_TR shandle1,
     ESYS_TR shandle2,
@@ -147,9 +175,52 @@ TSS2_RC iesys_get_name(
     TPM2B_PUBLIC *publicInfo,
     TPM2B_NAME *name);
 
+TSS2_RC iesys_update_name(
+    RSRC_NODE_T *node);
+
+void iesys_nv_set_attributes(
+    RSRC_NODE_T *node,
+    TPMA_NV attributes);
+
 bool iesys_tpm_error(
     TSS2_RC r);
 
+TSS2_RC iesys_stream_fill(
+    ESYS_READ_CB read,
+    void *userdata,
+    UINT16 chunk_size,
+    TPM2B_MAX_BUFFER *chunk,
+    int *eof);
+
+void iesys_output_reset(
+    ESYS_CONTEXT *esys_context);
+
+void *iesys_output_calloc(
+    ESYS_CONTEXT *esys_context,
+    size_t size);
+
+void iesys_output_free(
+    ESYS_CONTEXT *esys_context,
+    void *ptr);
+
+void iesys_arena_reset(
+    ESYS_CONTEXT *esys_context);
+
+void *iesys_arena_alloc(
+    ESYS_CONTEXT *esys_context,
+    size_t size);
+
+void iesys_arena_free(
+    ESYS_CONTEXT *esys_context,
+    void *ptr);
+
+void iesys_arena_release(
+    ESYS_CONTEXT *esys_context);
+
+/** Free an output of a _Finish function and set the pointer to NULL. */
+#define IESYS_OUTPUT_FREE(esys_context, ptr) \
+    do { iesys_output_free(esys_context, ptr); (ptr) = NULL; } while (0)
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,478 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * An ESYS_LOOP waits for the responses of many ESYS_CONTEXTs at once and
+ * calls a completion callback for every context whose response can be read.
+ * The poll handles of the contexts are watched with epoll on Linux and with
+ * poll elsewhere; while their callback runs, the timeout of the context is 0,
+ * so its _Finish call never blocks the loop. Contexts whose resubmission is
+ * delayed by the retry policy are offered to their callback once it is due.
+ * Contexts whose TCTI has no poll handles, such as mssim, cannot be watched
+ * and their TCTI may not support non-blocking receives. They are offered to
+ * their callback on every round with a blocking timeout instead, so their
+ * _Finish call blocks the loop until their response arrives.
+ */
+
+/** Number of events read with one epoll_wait. */
+#define LOOP_MAX_EVENTS 64
+
+/** A context waiting for its response. */
+typedef struct ESYS_LOOP_ENTRY ESYS_LOOP_ENTRY;
+struct ESYS_LOOP_ENTRY {
+    ESYS_CONTEXT *esys_context;  /**< The context. */
+    ESYS_COMPLETION_CB callback; /**< The completion callback. */
+    void *userdata;              /**< Pointer passed to callback. */
+    int64_t deadline;            /**< Expiry in ms of the monotonic clock, or
+                                      -1 for none. */
+    TSS2_TCTI_POLL_HANDLE *handles; /**< The poll handles of the TCTI. */
+    size_t handle_count;         /**< Number of handles. */
+    bool done;                   /**< The entry is to be removed. */
+    ESYS_LOOP_ENTRY *next;       /**< Next entry of the loop. */
+};
+
+struct ESYS_LOOP {
+    ESYS_LOOP_ENTRY *entries;    /**< The contexts waiting for a response. */
+    int epoll_fd;                /**< The epoll instance (Linux only). */
+};
+
+#if !defined(_WIN32)
+
+/** Read the monotonic clock in ms. */
+static int64_t
+loop_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** Compute the time left until a point of the monotonic clock, at least 0. */
+static int64_t
+loop_remaining(int64_t until, int64_t now)
+{
+    return (until > now) ? until - now : 0;
+}
+
+/** Check whether a context has a command in flight. */
+static bool
+loop_in_flight(ESYS_CONTEXT *esys_context)
+{
+    return esys_context->state == _ESYS_STATE_SENT ||
+           esys_context->state == _ESYS_STATE_RESUBMISSION;
+}
+
+/** Find the entry of a context. */
+static ESYS_LOOP_ENTRY *
+loop_find(ESYS_LOOP *loop, ESYS_CONTEXT *esys_context)
+{
+    for (ESYS_LOOP_ENTRY *entry = loop->entries; entry != NULL;
+         entry = entry->next) {
+        if (entry->esys_context == esys_context && !entry->done)
+            return entry;
+    }
+    return NULL;
+}
+
+/** Start watching the poll handles of an entry. */
+static TSS2_RC
+loop_watch(ESYS_LOOP *loop, ESYS_LOOP_ENTRY *entry)
+{
+#if defined(__linux__)
+    for (size_t i = 0; i < entry->handle_count; i++) {
+        struct epoll_event event = { .events = EPOLLIN,
+                                     .data.ptr = entry };
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, entry->handles[i].fd,
+                      &event) != 0) {
+            LOG_ERROR("epoll_ctl failed: %s", strerror(errno));
+            while (i-- > 0)
+                epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, entry->handles[i].fd,
+                          NULL);
+            return TSS2_ESYS_RC_GENERAL_FAILURE;
+        }
+    }
+#else
+    (void)(loop);
+    (void)(entry);
+#endif
+    return TSS2_RC_SUCCESS;
+}
+
+/** Stop watching the poll handles of an entry. */
+static void
+loop_unwatch(ESYS_LOOP *loop, ESYS_LOOP_ENTRY *entry)
+{
+#if defined(__linux__)
+    for (size_t i = 0; i < entry->handle_count; i++)
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, entry->handles[i].fd, NULL);
+#else
+    (void)(loop);
+    (void)(entry);
+#endif
+}
+
+/** Offer the response of a context to its callback.
+ *
+ * The timeout of the context is 0 while the callback runs, or blocking if
+ * the TCTI has no poll handles. The entry is removed afterwards unless the
+ * context still has a command in flight, e.g. after a resubmission or when
+ * the callback started the next command.
+ */
+static void
+loop_dispatch(ESYS_LOOP *loop, ESYS_LOOP_ENTRY *entry)
+{
+    ESYS_CONTEXT *esys_context = entry->esys_context;
+    int32_t timeouttmp;
+
+    if (entry->done)
+        return;
+
+    timeouttmp = esys_context->timeout;
+    esys_context->timeout = (entry->handle_count == 0) ?
+                            TSS2_TCTI_TIMEOUT_BLOCK : 0;
+    entry->callback(esys_context, TSS2_RC_SUCCESS, entry->userdata);
+    esys_context->timeout = timeouttmp;
+
+    if (!loop_in_flight(esys_context)) {
+        loop_unwatch(loop, entry);
+        entry->done = true;
+    }
+}
+
+/** Wait for poll handles to become readable and dispatch their entries.
+ *
+ * @param[in,out] loop The ESYS_LOOP.
+ * @param[in] timeout The time to wait in ms or -1 to block indefinitely.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE if waiting failed.
+ */
+static TSS2_RC
+loop_wait(ESYS_LOOP *loop, int timeout)
+{
+#if defined(__linux__)
+    struct epoll_event events[LOOP_MAX_EVENTS];
+    int n;
+
+    n = epoll_wait(loop->epoll_fd, events, LOOP_MAX_EVENTS, timeout);
+    if (n < 0 && errno != EINTR) {
+        LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+        return TSS2_ESYS_RC_GENERAL_FAILURE;
+    }
+    for (int i = 0; i < n; i++)
+        loop_dispatch(loop, events[i].data.ptr);
+#else
+    struct pollfd *fds;
+    ESYS_LOOP_ENTRY **owners;
+    size_t nfds = 0, i = 0;
+    int n;
+
+    for (ESYS_LOOP_ENTRY *entry = loop->entries; entry != NULL;
+         entry = entry->next)
+        nfds += entry->handle_count;
+    fds = calloc(nfds + 1, sizeof(*fds));
+    owners = calloc(nfds + 1, sizeof(*owners));
+    if (fds == NULL || owners == NULL) {
+        free(fds);
+        free(owners);
+        return_error(TSS2_ESYS_RC_MEMORY, "Out of memory.");
+    }
+    for (ESYS_LOOP_ENTRY *entry = loop->entries; entry != NULL;
+         entry = entry->next) {
+        for (size_t j = 0; j < entry->handle_count; j++, i++) {
+            fds[i].fd = entry->handles[j].fd;
+            fds[i].events = POLLIN;
+            owners[i] = entry;
+        }
+    }
+
+    n = poll(fds, nfds, timeout);
+    if (n < 0 && errno != EINTR) {
+        LOG_ERROR("poll failed: %s", strerror(errno));
+        free(fds);
+        free(owners);
+        return TSS2_ESYS_RC_GENERAL_FAILURE;
+    }
+    for (i = 0; n > 0 && i < nfds; i++) {
+        if (fds[i].revents != 0)
+            loop_dispatch(loop, owners[i]);
+    }
+    free(fds);
+    free(owners);
+#endif
+    return TSS2_RC_SUCCESS;
+}
+
+/** Free the entries that were completed. */
+static void
+loop_sweep(ESYS_LOOP *loop)
+{
+    ESYS_LOOP_ENTRY **link = &loop->entries;
+
+    while (*link != NULL) {
+        ESYS_LOOP_ENTRY *entry = *link;
+        if (entry->done) {
+            *link = entry->next;
+            free(entry->handles);
+            free(entry);
+        } else {
+            link = &entry->next;
+        }
+    }
+}
+
+#endif /* !_WIN32 */
+
+/** Create an event loop for ESYS contexts.
+ *
+ * @param[out] loop The new ESYS_LOOP. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if loop is NULL.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE if the epoll instance cannot be
+ *         created.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if the platform has no poll handles.
+ */
+TSS2_RC
+Esys_Loop_Initialize(ESYS_LOOP **loop)
+{
+    _ESYS_ASSERT_NON_NULL(loop);
+    *loop = NULL;
+
+#if defined(_WIN32)
+    return_error(TSS2_ESYS_RC_NOT_IMPLEMENTED,
+                 "Event loop not supported on this platform.");
+#else
+    *loop = calloc(1, sizeof(ESYS_LOOP));
+    return_if_null(*loop, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+
+#if defined(__linux__)
+    (*loop)->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if ((*loop)->epoll_fd < 0) {
+        LOG_ERROR("epoll_create1 failed: %s", strerror(errno));
+        SAFE_FREE(*loop);
+        return TSS2_ESYS_RC_GENERAL_FAILURE;
+    }
+#else
+    (*loop)->epoll_fd = -1;
+#endif
+    return TSS2_RC_SUCCESS;
+#endif
+}
+
+/** Free an event loop.
+ *
+ * Contexts still in the loop keep their command in flight; their responses
+ * can be fetched with the _Finish functions.
+ * @param[in,out] loop The ESYS_LOOP. (will be freed and set to NULL)
+ */
+void
+Esys_Loop_Finalize(ESYS_LOOP **loop)
+{
+    if (loop == NULL || *loop == NULL)
+        return;
+
+#if !defined(_WIN32)
+    for (ESYS_LOOP_ENTRY *entry = (*loop)->entries; entry != NULL;
+         entry = entry->next)
+        entry->done = true;
+    loop_sweep(*loop);
+#if defined(__linux__)
+    close((*loop)->epoll_fd);
+#endif
+#endif
+    SAFE_FREE(*loop);
+}
+
+/** Wait for the response of a context in an event loop.
+ *
+ * Must be called after an _Async function of the context. When the response
+ * can be read, Esys_Loop_Run calls callback with TSS2_RC_SUCCESS and the
+ * callback calls the matching _Finish function; it does not block. If the
+ * _Finish function returns TSS2_BASE_RC_TRY_AGAIN, e.g. because the command
+ * was resubmitted, the callback is called again for the next response. The
+ * callback may start the next command on the context and add it again with
+ * a different callback or timeout.
+ * If the response does not arrive within timeout ms, the context is removed
+ * from the loop and the callback is called with TSS2_ESYS_RC_TRY_AGAIN; the
+ * command is still in flight.
+ * If the TCTI of the context has no poll handles, the _Finish function of
+ * the callback receives blocking; it blocks the loop until the response
+ * arrives and timeout is only checked afterwards.
+ * @param[in,out] loop The ESYS_LOOP.
+ * @param[in,out] esys_context The ESYS_CONTEXT with a command in flight.
+ * @param[in] timeout The time to wait for the response in ms or -1 to wait
+ *            indefinitely.
+ * @param[in] callback The completion callback.
+ * @param[in] userdata Pointer passed to callback.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if loop, esys_context or callback is
+ *         NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if no command is in flight.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE if the poll handles cannot be watched.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if the platform has no poll handles.
+ */
+TSS2_RC
+Esys_Loop_Add(
+    ESYS_LOOP *loop,
+    ESYS_CONTEXT *esys_context,
+    int32_t timeout,
+    ESYS_COMPLETION_CB callback,
+    void *userdata)
+{
+    _ESYS_ASSERT_NON_NULL(loop);
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    _ESYS_ASSERT_NON_NULL(callback);
+
+#if defined(_WIN32)
+    (void)(timeout);
+    (void)(userdata);
+    return_error(TSS2_ESYS_RC_NOT_IMPLEMENTED,
+                 "Event loop not supported on this platform.");
+#else
+    TSS2_RC r;
+    ESYS_LOOP_ENTRY *entry;
+
+    if (!loop_in_flight(esys_context)) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+
+    /* A context added again from its callback keeps its entry */
+    entry = loop_find(loop, esys_context);
+    if (entry == NULL) {
+        entry = calloc(1, sizeof(ESYS_LOOP_ENTRY));
+        return_if_null(entry, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+        entry->esys_context = esys_context;
+
+        r = Esys_GetPollHandles(esys_context, &entry->handles,
+                                &entry->handle_count);
+        if (r != TSS2_RC_SUCCESS) {
+            LOG_DEBUG("No poll handles, receiving blocking.");
+            SAFE_FREE(entry->handles);
+            entry->handle_count = 0;
+        }
+
+        r = loop_watch(loop, entry);
+        if (r != TSS2_RC_SUCCESS) {
+            free(entry->handles);
+            free(entry);
+            return r;
+        }
+        entry->next = loop->entries;
+        loop->entries = entry;
+    }
+
+    entry->callback = callback;
+    entry->userdata = userdata;
+    entry->deadline = (timeout < 0) ? -1 : loop_now() + timeout;
+    return TSS2_RC_SUCCESS;
+#endif
+}
+
+/** Dispatch the responses of the contexts in an event loop.
+ *
+ * Waits for the responses of the contexts added with Esys_Loop_Add and
+ * calls their callbacks until no context is left or timeout expires.
+ * @param[in,out] loop The ESYS_LOOP.
+ * @param[in] timeout The time to run in ms or -1 to run until no context is
+ *            left.
+ * @retval TSS2_RC_SUCCESS if no context is left.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if timeout expired before.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if loop is NULL.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE if waiting failed.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if the platform has no poll handles.
+ */
+TSS2_RC
+Esys_Loop_Run(ESYS_LOOP *loop, int32_t timeout)
+{
+    _ESYS_ASSERT_NON_NULL(loop);
+
+#if defined(_WIN32)
+    (void)(timeout);
+    return_error(TSS2_ESYS_RC_NOT_IMPLEMENTED,
+                 "Event loop not supported on this platform.");
+#else
+    TSS2_RC r;
+    int64_t now, end, wait, remaining;
+    ESYS_LOOP_ENTRY *entry;
+
+    end = (timeout < 0) ? -1 : loop_now() + timeout;
+
+    while (loop->entries != NULL) {
+        /* Wait until the next deadline at most; -1 waits indefinitely */
+        now = loop_now();
+        wait = (end < 0) ? -1 : loop_remaining(end, now);
+        for (entry = loop->entries; entry != NULL; entry = entry->next) {
+            if (entry->esys_context->resubmit_pending)
+                remaining = iesys_resubmit_wait(entry->esys_context);
+            else if (entry->handle_count == 0)
+                remaining = 0;
+            else if (entry->deadline >= 0)
+                remaining = loop_remaining(entry->deadline, now);
+            else
+                continue;
+            if (wait < 0 || remaining < wait)
+                wait = remaining;
+        }
+        if (wait > INT32_MAX)
+            wait = INT32_MAX;
+
+        r = loop_wait(loop, (int) wait);
+        return_if_error(r, "Wait for responses.");
+
+        /* Contexts without poll handles receive blocking on every round,
+           delayed resubmissions are dispatched once they are due */
+        for (entry = loop->entries; entry != NULL; entry = entry->next) {
+            remaining = iesys_resubmit_wait(entry->esys_context);
+            if (remaining == 0 || (remaining < 0 && entry->handle_count == 0))
+                loop_dispatch(loop, entry);
+        }
+
+        /* Report the contexts whose response did not arrive in time */
+        now = loop_now();
+        for (entry = loop->entries; entry != NULL; entry = entry->next) {
+            if (entry->done || entry->deadline < 0 || entry->deadline > now)
+                continue;
+            LOG_WARNING("No response within the timeout.");
+            loop_unwatch(loop, entry);
+            entry->done = true;
+            entry->callback(entry->esys_context, TSS2_ESYS_RC_TRY_AGAIN,
+                            entry->userdata);
+        }
+        loop_sweep(loop);
+
+        if (end >= 0 && loop_now() >= end && loop->entries != NULL)
+            return TSS2_ESYS_RC_TRY_AGAIN;
+    }
+    return TSS2_RC_SUCCESS;
+#endif
+}
@@ -0,0 +1,261 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * The NV stream functions split a transfer into chunks of the TPM's
+ * TPM2_PT_NV_BUFFER_MAX and issue one TPM2_NV_Read or TPM2_NV_Write per
+ * chunk with the same authorization and sessions. The host side work of a
+ * chunk (copying the data of the caller) is done while the TPM executes
+ * the previous chunk, i.e. between the _Async and _Finish calls. The
+ * authorization of a chunk cannot be computed ahead of time, since it
+ * depends on the nonceTPM returned for the previous chunk.
+ */
+
+/** Determine the chunk size for NV transfers.
+ *
+ * Queries the TPM's limits with Esys_AdjustBufferSizes if this has not
+ * happened for the context yet.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param chunk_size [out] The maximum number of bytes per NV command.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_RCs produced by Esys_AdjustBufferSizes.
+ */
+static TSS2_RC
+nv_chunk_size(ESYS_CONTEXT *esys_context, UINT16 *chunk_size)
+{
+    TSS2_RC r;
+
+    if (esys_context->nv_buffer_max == 0) {
+        r = Esys_AdjustBufferSizes(esys_context);
+        return_if_error(r, "Get NV buffer size.");
+    }
+    *chunk_size = esys_context->nv_buffer_max;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Check the offset and size of an NV stream.
+ *
+ * NV offsets are 16 bit values, so a stream may not extend beyond 64kB.
+ */
+static TSS2_RC
+nv_check_range(UINT16 offset, size_t size)
+{
+    if (size > (size_t)UINT16_MAX + 1 - offset) {
+        LOG_ERROR("NV stream of %zu bytes at offset %" PRIu16 " too large.",
+                  size, offset);
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Read an arbitrary amount of data from an NV index.
+ *
+ * Reads size bytes starting at offset from the NV index in chunks of the
+ * TPM's maximum NV buffer size. All chunks are read with the same authHandle
+ * and sessions. Before the data of a chunk is copied to the caller's buffer,
+ * the command for the next chunk has already been sent to the TPM.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  authHandle The handle indicating the source of the authorization
+ *             value.
+ * @param[in]  nvIndex The NV Index to be read.
+ * @param[in]  shandle1 Session handle for authorization of authHandle
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  offset Octet offset into the NV area.
+ * @param[in]  size Number of octets to read.
+ * @param[out] data Buffer of at least size bytes receiving the data.
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or data is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if offset and size exceed the 16 bit NV
+ *         address space.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned less data than
+ *         requested.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_NV_ReadStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    UINT16 offset,
+    size_t size,
+    uint8_t *data)
+{
+    TSS2_RC r;
+    TPM2B_MAX_NV_BUFFER *chunk = NULL;
+    UINT16 chunk_size, chunk_len;
+    size_t done = 0, next;
+    int32_t timeouttmp;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    if (size > 0)
+        _ESYS_ASSERT_NON_NULL(data);
+
+    r = nv_check_range(offset, size);
+    return_if_error(r, "Bad NV range.");
+    if (size == 0)
+        return TSS2_RC_SUCCESS;
+
+    r = nv_chunk_size(esysContext, &chunk_size);
+    return_if_error(r, "NV chunk size.");
+
+    /* The _Finish calls below shall block */
+    timeouttmp = esysContext->timeout;
+    esysContext->timeout = -1;
+
+    chunk_len = (size < chunk_size) ? size : chunk_size;
+    r = Esys_NV_Read_Async(esysContext, authHandle, nvIndex,
+                           shandle1, shandle2, shandle3,
+                           chunk_len, offset);
+    goto_if_error(r, "Error in async function", error_cleanup);
+
+    while (done < size) {
+        do {
+            r = Esys_NV_Read_Finish(esysContext, &chunk);
+        } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+        goto_if_error(r, "Esys Finish", error_cleanup);
+
+        if (chunk->size != chunk_len) {
+            LOG_ERROR("TPM returned %" PRIu16 " instead of %" PRIu16 " bytes.",
+                      chunk->size, chunk_len);
+            r = TSS2_ESYS_RC_MALFORMED_RESPONSE;
+            goto error_cleanup;
+        }
+
+        /* Start the next chunk before copying out the current one */
+        next = done + chunk_len;
+        if (next < size) {
+            UINT16 next_len = (size - next < chunk_size) ?
+                              size - next : chunk_size;
+            r = Esys_NV_Read_Async(esysContext, authHandle, nvIndex,
+                                   shandle1, shandle2, shandle3,
+                                   next_len, offset + next);
+            goto_if_error(r, "Error in async function", error_cleanup);
+            memcpy(&data[done], &chunk->buffer[0], chunk_len);
+            chunk_len = next_len;
+        } else {
+            memcpy(&data[done], &chunk->buffer[0], chunk_len);
+        }
+        IESYS_OUTPUT_FREE(esysContext, chunk);
+        done = next;
+    }
+
+    esysContext->timeout = timeouttmp;
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    IESYS_OUTPUT_FREE(esysContext, chunk);
+    esysContext->timeout = timeouttmp;
+    return r;
+}
+
+/** Write an arbitrary amount of data to an NV index.
+ *
+ * Writes size bytes to the NV index starting at offset in chunks of the TPM's
+ * maximum NV buffer size. All chunks are written with the same authHandle
+ * and sessions. The next chunk is copied from the caller's buffer while the
+ * TPM executes the current one.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  authHandle Handle indicating the source of the authorization
+ *             value.
+ * @param[in]  nvIndex The NV Index of the area to write.
+ * @param[in]  shandle1 Session handle for authorization of authHandle
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  offset The offset into the NV Area.
+ * @param[in]  size Number of octets to write.
+ * @param[in]  data The data to write.
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or data is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if offset and size exceed the 16 bit NV
+ *         address space.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_NV_WriteStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    UINT16 offset,
+    size_t size,
+    const uint8_t *data)
+{
+    TSS2_RC r;
+    TPM2B_MAX_NV_BUFFER chunk[2];
+    UINT16 chunk_size;
+    size_t done = 0;
+    int32_t timeouttmp;
+    int cur = 0;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    if (size > 0)
+        _ESYS_ASSERT_NON_NULL(data);
+
+    r = nv_check_range(offset, size);
+    return_if_error(r, "Bad NV range.");
+    if (size == 0)
+        return TSS2_RC_SUCCESS;
+
+    r = nv_chunk_size(esysContext, &chunk_size);
+    return_if_error(r, "NV chunk size.");
+
+    /* The _Finish calls below shall block */
+    timeouttmp = esysContext->timeout;
+    esysContext->timeout = -1;
+
+    chunk[cur].size = (size < chunk_size) ? size : chunk_size;
+    memcpy(&chunk[cur].buffer[0], data, chunk[cur].size);
+
+    while (done < size) {
+        r = Esys_NV_Write_Async(esysContext, authHandle, nvIndex,
+                                shandle1, shandle2, shandle3,
+                                &chunk[cur], offset + done);
+        goto_if_error(r, "Error in async function", error_cleanup);
+        done += chunk[cur].size;
+
+        /* Fill the next chunk while the TPM is busy */
+        if (done < size) {
+            chunk[!cur].size = (size - done < chunk_size) ?
+                               size - done : chunk_size;
+            memcpy(&chunk[!cur].buffer[0], &data[done], chunk[!cur].size);
+        }
+
+        do {
+            r = Esys_NV_Write_Finish(esysContext);
+        } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+        goto_if_error(r, "Esys Finish", error_cleanup);
+
+        cur = !cur;
+    }
+
+    esysContext->timeout = timeouttmp;
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    esysContext->timeout = timeouttmp;
+    return r;
+}
@@ -0,0 +1,255 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#include "esys_crypto.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Esys_PCR_ExtendBatch runs a list of TPM2_PCR_Extend and TPM2_PCR_Event
+ * commands and optionally writes the matching TCG_PCR_EVENT2 records of the
+ * crypto agile event log format. The record of a TPM2_PCR_Extend is written
+ * while the TPM executes the command and is dropped again if the command
+ * fails. Event log records are little endian.
+ */
+
+/** Worst case size of the digest list of a TPM2_PCR_Event record. */
+#define EVENT_DIGESTS_MAX (sizeof(UINT32) + TPM2_NUM_PCR_BANKS * \
+                           (sizeof(TPMI_ALG_HASH) + sizeof(TPMU_HA)))
+
+/** Append a little endian integer to the event log. */
+static void
+log_put(uint8_t *log, size_t *offset, UINT32 value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+        log[(*offset)++] = (value >> (8 * i)) & 0xff;
+}
+
+/** Compute the size of the digest list of an event log record.
+ *
+ * @param[in]  digests The digests of the record.
+ * @param[out] size The size of the marshaled digest list.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED for an unknown hash algorithm.
+ */
+static TSS2_RC
+log_digests_size(const TPML_DIGEST_VALUES *digests, size_t *size)
+{
+    TSS2_RC r;
+    size_t digest_size;
+
+    *size = sizeof(UINT32);
+    for (UINT32 i = 0; i < digests->count; i++) {
+        r = iesys_crypto_hash_get_digest_size(digests->digests[i].hashAlg,
+                                              &digest_size);
+        return_if_error(r, "Unknown hash algorithm");
+        *size += sizeof(TPMI_ALG_HASH) + digest_size;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Write a TCG_PCR_EVENT2 record to the event log.
+ *
+ * @param[in]     entry The batch entry of the record.
+ * @param[in]     digests The digests extended into the PCR.
+ * @param[out]    log The event log buffer.
+ * @param[in]     log_size The size of the event log buffer.
+ * @param[in,out] offset The offset into the event log.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_INSUFFICIENT_BUFFER if the record does not fit.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED for an unknown hash algorithm.
+ */
+static TSS2_RC
+log_write(const ESYS_PCR_EXTEND_ENTRY *entry,
+          const TPML_DIGEST_VALUES *digests,
+          uint8_t *log, size_t log_size, size_t *offset)
+{
+    TSS2_RC r;
+    size_t size, digest_size;
+
+    r = log_digests_size(digests, &size);
+    return_if_error(r, "Digest size");
+    size += 3 * sizeof(UINT32) + entry->eventData.size;
+    if (size > log_size - *offset) {
+        LOG_ERROR("Event log buffer too small.");
+        return TSS2_ESYS_RC_INSUFFICIENT_BUFFER;
+    }
+
+    log_put(log, offset, entry->pcrHandle - ESYS_TR_PCR0, sizeof(UINT32));
+    log_put(log, offset, entry->eventType, sizeof(UINT32));
+    log_put(log, offset, digests->count, sizeof(UINT32));
+    for (UINT32 i = 0; i < digests->count; i++) {
+        const TPMT_HA *ha = &digests->digests[i];
+        iesys_crypto_hash_get_digest_size(ha->hashAlg, &digest_size);
+        log_put(log, offset, ha->hashAlg, sizeof(TPMI_ALG_HASH));
+        memcpy(&log[*offset], (const uint8_t *)&ha->digest, digest_size);
+        *offset += digest_size;
+    }
+    log_put(log, offset, entry->eventData.size, sizeof(UINT32));
+    memcpy(&log[*offset], &entry->eventData.buffer[0], entry->eventData.size);
+    *offset += entry->eventData.size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Extend a list of measurements into PCRs.
+ *
+ * Executes one TPM2_PCR_Extend or, if hashEvent of the entry is set, one
+ * TPM2_PCR_Event per entry with the same sessions. An entry that fails with
+ * a TPM error does not stop the batch; any other error aborts it and is
+ * reported for all remaining entries.
+ * If eventLog is not NULL, a TCG_PCR_EVENT2 record is appended at
+ * *eventLogOffset for every successful entry. For TPM2_PCR_Event entries the
+ * record holds the digests computed by the TPM, so room for the digests of
+ * TPM2_NUM_PCR_BANKS banks is required. An entry whose record may not fit
+ * into the event log is not executed.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  shandle1 Session handle for authorization of the PCRs.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  entries The measurements.
+ * @param[in]  count The number of entries.
+ * @param[out] results The result of every entry. May be NULL.
+ * @param[out] eventLog Buffer for the event log records. May be NULL.
+ * @param[in]  eventLogSize The size of eventLog.
+ * @param[in,out] eventLogOffset The offset into eventLog.
+ * @retval TSS2_RC_SUCCESS if all entries were successful.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext, entries or the
+ *         eventLogOffset for an eventLog is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the PCR of an entry cannot be logged.
+ * @retval TSS2_ESYS_RC_INSUFFICIENT_BUFFER if eventLog is too small.
+ * @retval TSS2_RCs of the first failing entry otherwise.
+ */
+TSS2_RC
+Esys_PCR_ExtendBatch(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const ESYS_PCR_EXTEND_ENTRY *entries,
+    size_t count,
+    TSS2_RC *results,
+    uint8_t *eventLog,
+    size_t eventLogSize,
+    size_t *eventLogOffset)
+{
+    TSS2_RC r, rc = TSS2_RC_SUCCESS;
+    TPML_DIGEST_VALUES *digests = NULL;
+    size_t i, size, log_start = 0;
+    int32_t timeouttmp;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    if (count > 0)
+        _ESYS_ASSERT_NON_NULL(entries);
+    if (eventLog != NULL) {
+        _ESYS_ASSERT_NON_NULL(eventLogOffset);
+        if (*eventLogOffset > eventLogSize)
+            return TSS2_ESYS_RC_BAD_VALUE;
+    }
+
+    /* The _Finish calls below shall block */
+    timeouttmp = esysContext->timeout;
+    esysContext->timeout = -1;
+
+    for (i = 0; i < count; i++) {
+        const ESYS_PCR_EXTEND_ENTRY *entry = &entries[i];
+
+        if (eventLog != NULL) {
+            if (entry->pcrHandle > ESYS_TR_PCR31) {
+                LOG_ERROR("Entry %zu does not extend a PCR.", i);
+                r = TSS2_ESYS_RC_BAD_VALUE;
+                goto entry_done;
+            }
+            if (entry->hashEvent) {
+                size = EVENT_DIGESTS_MAX;
+            } else {
+                r = log_digests_size(&entry->digests, &size);
+                if (r != TSS2_RC_SUCCESS)
+                    goto entry_done;
+            }
+            size += 3 * sizeof(UINT32) + entry->eventData.size;
+            if (size > eventLogSize - *eventLogOffset) {
+                LOG_ERROR("Event log buffer too small for entry %zu.", i);
+                r = TSS2_ESYS_RC_INSUFFICIENT_BUFFER;
+                break;
+            }
+            log_start = *eventLogOffset;
+        }
+
+        if (entry->hashEvent) {
+            r = Esys_PCR_Event_Async(esysContext, entry->pcrHandle,
+                                     shandle1, shandle2, shandle3,
+                                     &entry->eventData);
+        } else {
+            r = Esys_PCR_Extend_Async(esysContext, entry->pcrHandle,
+                                      shandle1, shandle2, shandle3,
+                                      &entry->digests);
+        }
+        if (r != TSS2_RC_SUCCESS) {
+            if (esysContext->state != _ESYS_STATE_INIT)
+                break;
+            goto entry_done;
+        }
+
+        /* Log the known digests while the TPM is busy */
+        if (eventLog != NULL && !entry->hashEvent) {
+            log_write(entry, &entry->digests, eventLog, eventLogSize,
+                      eventLogOffset);
+        }
+
+        do {
+            if (entry->hashEvent)
+                r = Esys_PCR_Event_Finish(esysContext, &digests);
+            else
+                r = Esys_PCR_Extend_Finish(esysContext);
+        } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+
+        if (r != TSS2_RC_SUCCESS) {
+            if (eventLog != NULL)
+                *eventLogOffset = log_start;
+            if (!iesys_tpm_error(r))
+                break;
+            goto entry_done;
+        }
+
+        if (eventLog != NULL && entry->hashEvent) {
+            r = log_write(entry, digests, eventLog, eventLogSize,
+                          eventLogOffset);
+        }
+        IESYS_OUTPUT_FREE(esysContext, digests);
+
+entry_done:
+        if (results != NULL)
+            results[i] = r;
+        if (r != TSS2_RC_SUCCESS) {
+            LOG_WARNING("PCR extend entry %zu failed: 0x%08" PRIx32, i, r);
+            if (rc == TSS2_RC_SUCCESS)
+                rc = r;
+        }
+    }
+
+    /* An aborted batch reports the error for all remaining entries */
+    if (i < count) {
+        LOG_ERROR("PCR extend batch aborted at entry %zu: 0x%08" PRIx32, i, r);
+        if (rc == TSS2_RC_SUCCESS)
+            rc = r;
+        for (; results != NULL && i < count; i++)
+            results[i] = r;
+    }
+
+    esysContext->timeout = timeouttmp;
+    return rc;
+}
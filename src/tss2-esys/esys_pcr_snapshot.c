@@ -0,0 +1,323 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * TPM2_PCR_Read returns at most 8 digests per call. Esys_PCR_ReadSnapshot
+ * splits the requested selection into chunks of 8 PCRs, sends the read for
+ * the next chunk before merging the result of the current one and restarts
+ * the snapshot if the pcrUpdateCounter changes in between.
+ */
+
+/** Maximum number of digests returned by one TPM2_PCR_Read */
+#define PCR_READ_MAX (sizeof(((TPML_DIGEST *)0)->digests) / \
+                      sizeof(((TPML_DIGEST *)0)->digests[0]))
+
+/** Maximum number of restarts of a snapshot. */
+#define PCR_SNAPSHOT_MAX_RETRIES 5
+
+/** Position of the PCR selection iterator. */
+typedef struct {
+    UINT32 bank;
+    UINT32 bit;
+} PCR_ITER;
+
+/** Count the PCRs selected in a PCR selection. */
+static size_t
+pcr_count(const TPML_PCR_SELECTION *selection)
+{
+    size_t count = 0;
+
+    for (UINT32 b = 0; b < selection->count; b++) {
+        const TPMS_PCR_SELECTION *sel = &selection->pcrSelections[b];
+        for (UINT32 i = 0; i < sel->sizeofSelect; i++) {
+            for (BYTE v = sel->pcrSelect[i]; v; v &= v - 1)
+                count++;
+        }
+    }
+    return count;
+}
+
+/** Get the next chunk of at most PCR_READ_MAX PCRs of a selection.
+ *
+ * @param[in]     selection The complete selection.
+ * @param[in,out] iter The position in selection.
+ * @param[out]    chunk The next chunk.
+ * @retval The number of PCRs selected in chunk; 0 if the end was reached.
+ */
+static size_t
+pcr_next_chunk(const TPML_PCR_SELECTION *selection, PCR_ITER *iter,
+               TPML_PCR_SELECTION *chunk)
+{
+    size_t count = 0;
+
+    memset(chunk, 0, sizeof(*chunk));
+    for (; iter->bank < selection->count; iter->bank++, iter->bit = 0) {
+        const TPMS_PCR_SELECTION *sel = &selection->pcrSelections[iter->bank];
+        TPMS_PCR_SELECTION *out = NULL;
+
+        for (; iter->bit < (UINT32)sel->sizeofSelect * 8; iter->bit++) {
+            if (!(sel->pcrSelect[iter->bit / 8] & (1 << (iter->bit % 8))))
+                continue;
+            if (count == PCR_READ_MAX)
+                return count;
+            if (out == NULL) {
+                out = &chunk->pcrSelections[chunk->count++];
+                out->hash = sel->hash;
+                out->sizeofSelect = sel->sizeofSelect;
+            }
+            out->pcrSelect[iter->bit / 8] |= 1 << (iter->bit % 8);
+            count++;
+        }
+    }
+    return count;
+}
+
+/** Merge the selection returned for a chunk into the snapshot selection. */
+static TSS2_RC
+pcr_merge_selection(TPML_PCR_SELECTION *snapshot,
+                    const TPML_PCR_SELECTION *chunk)
+{
+    for (UINT32 c = 0; c < chunk->count; c++) {
+        const TPMS_PCR_SELECTION *in = &chunk->pcrSelections[c];
+        TPMS_PCR_SELECTION *out = NULL;
+        UINT32 b;
+
+        if (in->sizeofSelect > TPM2_PCR_SELECT_MAX)
+            return TSS2_ESYS_RC_MALFORMED_RESPONSE;
+        for (b = 0; b < snapshot->count; b++) {
+            if (snapshot->pcrSelections[b].hash == in->hash) {
+                out = &snapshot->pcrSelections[b];
+                break;
+            }
+        }
+        if (out == NULL) {
+            if (snapshot->count == TPM2_NUM_PCR_BANKS)
+                return TSS2_ESYS_RC_MALFORMED_RESPONSE;
+            out = &snapshot->pcrSelections[snapshot->count++];
+            out->hash = in->hash;
+        }
+        if (out->sizeofSelect < in->sizeofSelect)
+            out->sizeofSelect = in->sizeofSelect;
+        for (UINT32 i = 0; i < in->sizeofSelect; i++)
+            out->pcrSelect[i] |= in->pcrSelect[i];
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Read one snapshot of all PCRs of a selection.
+ *
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if the pcrUpdateCounter changed.
+ * @retval TSS2_RCs produced by lower layers of the software stack.
+ */
+static TSS2_RC
+pcr_snapshot(
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const TPML_PCR_SELECTION *selection,
+    UINT32 *update_counter,
+    TPML_PCR_SELECTION *snapshot,
+    TPM2B_DIGEST *digests,
+    size_t *num_digests)
+{
+    TSS2_RC r;
+    TPML_PCR_SELECTION chunk;
+    TPML_PCR_SELECTION *chunk_out = NULL;
+    TPML_DIGEST *values = NULL;
+    PCR_ITER iter = { 0, 0 };
+    UINT32 counter;
+    size_t max_digests = *num_digests;
+    size_t next;
+    int first = 1;
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    *num_digests = 0;
+
+    if (pcr_next_chunk(selection, &iter, &chunk) == 0)
+        return TSS2_RC_SUCCESS;
+    r = Esys_PCR_Read_Async(esys_context, shandle1, shandle2, shandle3,
+                            &chunk);
+    return_if_error(r, "Error in async function");
+
+    do {
+        do {
+            r = Esys_PCR_Read_Finish(esys_context, &counter, &chunk_out,
+                                     &values);
+        } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+        return_if_error(r, "Esys Finish");
+
+        if (first) {
+            *update_counter = counter;
+            first = 0;
+        } else if (counter != *update_counter) {
+            LOG_DEBUG("pcrUpdateCounter changed from %" PRIu32 " to %" PRIu32,
+                      *update_counter, counter);
+            r = TSS2_ESYS_RC_TRY_AGAIN;
+            goto error_cleanup;
+        }
+
+        /* Send the next read before merging the current result */
+        next = pcr_next_chunk(selection, &iter, &chunk);
+        if (next > 0) {
+            r = Esys_PCR_Read_Async(esys_context, shandle1, shandle2,
+                                    shandle3, &chunk);
+            goto_if_error(r, "Error in async function", error_cleanup);
+        }
+
+        if (values->count != pcr_count(chunk_out) ||
+            values->count > max_digests - *num_digests) {
+            LOG_ERROR("TPM returned %" PRIu32 " PCR values not matching its "
+                      "selection.", values->count);
+            r = TSS2_ESYS_RC_MALFORMED_RESPONSE;
+            goto error_cleanup;
+        }
+        r = pcr_merge_selection(snapshot, chunk_out);
+        goto_if_error(r, "Bad PCR selection", error_cleanup);
+        memcpy(&digests[*num_digests], &values->digests[0],
+               values->count * sizeof(values->digests[0]));
+        *num_digests += values->count;
+
+        IESYS_OUTPUT_FREE(esys_context, chunk_out);
+        IESYS_OUTPUT_FREE(esys_context, values);
+    } while (next > 0);
+
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    IESYS_OUTPUT_FREE(esys_context, chunk_out);
+    IESYS_OUTPUT_FREE(esys_context, values);
+    /* Collect the response of a read still in flight */
+    if (esys_context->state == _ESYS_STATE_SENT ||
+        esys_context->state == _ESYS_STATE_RESUBMISSION) {
+        TSS2_RC r2;
+        do {
+            r2 = Esys_PCR_Read_Finish(esys_context, NULL, NULL, NULL);
+        } while ((r2 & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+    }
+    return r;
+}
+
+/** Read a consistent snapshot of any number of PCRs.
+ *
+ * Reads all PCRs of pcrSelectionIn, which may span all banks of the TPM,
+ * using as many TPM2_PCR_Read commands as needed. If the TPM's
+ * pcrUpdateCounter changes while the snapshot is taken, the snapshot is
+ * started again.
+ * The digests are returned as one array, ordered like the TPM orders the
+ * values of TPM2_PCR_Read: by bank in the order of pcrSelectionIn and by
+ * ascending PCR index within a bank. PCRs not implemented by the TPM are
+ * missing from pcrSelectionOut and pcrValues.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  shandle1 First session handle.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  pcrSelectionIn The selection of PCRs to read.
+ * @param[out] pcrUpdateCounter The pcrUpdateCounter of the snapshot. May be
+ *             NULL.
+ * @param[out] pcrSelectionOut The PCRs that were read. May be NULL.
+ *             (callee-allocated)
+ * @param[out] pcrValues The array of the PCR values. (callee-allocated)
+ * @param[out] pcrValuesCount The number of elements of pcrValues.
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or a required
+ *         parameter is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if pcrSelectionIn is malformed.
+ * @retval TSS2_ESYS_RC_MEMORY if the ESAPI cannot allocate enough memory.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if the PCRs kept changing during the
+ *         snapshot.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned more or other
+ *         values than selected.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_PCR_ReadSnapshot(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const TPML_PCR_SELECTION *pcrSelectionIn,
+    UINT32 *pcrUpdateCounter,
+    TPML_PCR_SELECTION **pcrSelectionOut,
+    TPM2B_DIGEST **pcrValues,
+    size_t *pcrValuesCount)
+{
+    TSS2_RC r;
+    TPML_PCR_SELECTION *snapshot = NULL;
+    TPM2B_DIGEST *digests = NULL;
+    size_t max_digests, num_digests;
+    UINT32 counter = 0;
+    int32_t timeouttmp;
+    int retries = 0;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(pcrSelectionIn);
+    _ESYS_ASSERT_NON_NULL(pcrValues);
+    _ESYS_ASSERT_NON_NULL(pcrValuesCount);
+
+    if (pcrSelectionIn->count > TPM2_NUM_PCR_BANKS) {
+        LOG_ERROR("Too many PCR banks selected.");
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    for (UINT32 b = 0; b < pcrSelectionIn->count; b++) {
+        if (pcrSelectionIn->pcrSelections[b].sizeofSelect >
+            TPM2_PCR_SELECT_MAX) {
+            LOG_ERROR("PCR selection of bank %" PRIu32 " too large.", b);
+            return TSS2_ESYS_RC_BAD_VALUE;
+        }
+    }
+
+    snapshot = calloc(1, sizeof(*snapshot));
+    max_digests = pcr_count(pcrSelectionIn);
+    digests = calloc(max_digests ? max_digests : 1, sizeof(*digests));
+    if (snapshot == NULL || digests == NULL) {
+        goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory", error_cleanup);
+    }
+
+    /* The _Finish calls shall block */
+    timeouttmp = esysContext->timeout;
+    esysContext->timeout = -1;
+    do {
+        num_digests = max_digests;
+        r = pcr_snapshot(esysContext, shandle1, shandle2, shandle3,
+                         pcrSelectionIn, &counter, snapshot, &digests[0],
+                         &num_digests);
+    } while (r == TSS2_ESYS_RC_TRY_AGAIN &&
+             retries++ < PCR_SNAPSHOT_MAX_RETRIES);
+    esysContext->timeout = timeouttmp;
+    goto_if_error(r, "PCR snapshot", error_cleanup);
+
+    if (pcrUpdateCounter != NULL)
+        *pcrUpdateCounter = counter;
+    if (pcrSelectionOut != NULL)
+        *pcrSelectionOut = snapshot;
+    else
+        free(snapshot);
+    *pcrValues = digests;
+    *pcrValuesCount = num_digests;
+
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    SAFE_FREE(snapshot);
+    SAFE_FREE(digests);
+    return r;
+}
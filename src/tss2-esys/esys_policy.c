@@ -0,0 +1,750 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "esys_iutil.h"
+#include "esys_crypto.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Esys_PolicyCalculate computes the policy digest of a list of policy
+ * commands the way the TPM updates policyDigest (TPM 2.0 Part 3, section 23),
+ * so no trial session is needed to build the authPolicy of an object.
+ * Esys_PolicyExecute runs the same list against a policy session and uses the
+ * calculation for the parameters that depend on the policy digest, i.e. the
+ * digest list of TPM2_PolicyOR and the approvedPolicy of TPM2_PolicyAuthorize.
+ */
+
+/** Compute digest := H(digest || buffer).
+ *
+ * @param[in]     hashAlg The hash algorithm of the policy.
+ * @param[in,out] digest The policy digest.
+ * @param[in]     buffer The data to extend.
+ * @param[in]     size The size of buffer.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_* for errors of the crypto backend.
+ */
+static TSS2_RC
+policy_hash(TPMI_ALG_HASH hashAlg, TPM2B_DIGEST *digest,
+            const uint8_t *buffer, size_t size)
+{
+    TSS2_RC r;
+    IESYS_CRYPTO_CONTEXT_BLOB *cryptoContext;
+    size_t digest_size = sizeof(digest->buffer);
+
+    r = iesys_crypto_hash_start(&cryptoContext, hashAlg);
+    return_if_error(r, "crypto hash start");
+
+    r = iesys_crypto_hash_update2b(cryptoContext, (TPM2B *) digest);
+    goto_if_error(r, "crypto hash update", error_cleanup);
+
+    r = iesys_crypto_hash_update(cryptoContext, buffer, size);
+    goto_if_error(r, "crypto hash update", error_cleanup);
+
+    r = iesys_crypto_hash_finish(&cryptoContext, &digest->buffer[0],
+                                 &digest_size);
+    goto_if_error(r, "crypto hash finish", error_cleanup);
+    digest->size = digest_size;
+
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    if (cryptoContext)
+        iesys_crypto_hash_abort(&cryptoContext);
+    return r;
+}
+
+/** Append the buffer of a TPM2B to the data of a policy command.
+ *
+ * The sizes of the TPM2Bs of a policy come from the caller and are checked
+ * here, since they are not marshaled.
+ * @param[in,out] buffer The data of the policy command.
+ * @param[in]     max The size of buffer.
+ * @param[in,out] offset The number of bytes used in buffer.
+ * @param[in]     data The buffer of the TPM2B.
+ * @param[in]     size The size of the TPM2B.
+ * @param[in]     capacity The size of the buffer of the TPM2B.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if size exceeds capacity or buffer.
+ */
+static TSS2_RC
+policy_append(uint8_t *buffer, size_t max, size_t *offset,
+              const uint8_t *data, UINT16 size, size_t capacity)
+{
+    if (size > capacity || size > max - *offset) {
+        LOG_ERROR("Policy argument of %" PRIu16 " bytes too large.", size);
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    memcpy(&buffer[*offset], data, size);
+    *offset += size;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Reset the policy digest to the initial value of a policy session.
+ *
+ * @param[in]  hashAlg The hash algorithm of the policy.
+ * @param[out] digest The policy digest.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED for an unknown hash algorithm.
+ */
+static TSS2_RC
+policy_reset(TPMI_ALG_HASH hashAlg, TPM2B_DIGEST *digest)
+{
+    TSS2_RC r;
+    size_t digest_size;
+
+    r = iesys_crypto_hash_get_digest_size(hashAlg, &digest_size);
+    return_if_error(r, "Unknown hash algorithm");
+
+    memset(&digest->buffer[0], 0, digest_size);
+    digest->size = digest_size;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Determine the name of an entity referenced by a policy.
+ *
+ * @param[in]  esysContext The ESYS_CONTEXT. May be NULL if the name is given.
+ * @param[in]  entity The entity.
+ * @param[out] name The name of the entity.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the name is neither given nor known.
+ */
+static TSS2_RC
+policy_name(ESYS_CONTEXT *esysContext, const ESYS_POLICY_ENTITY *entity,
+            TPM2B_NAME *name)
+{
+    TSS2_RC r;
+    TPM2B_NAME *handle_name = NULL;
+
+    if (entity->name.size > 0) {
+        *name = entity->name;
+        return TSS2_RC_SUCCESS;
+    }
+    if (esysContext == NULL) {
+        LOG_ERROR("Name of policy entity missing.");
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+
+    r = Esys_TR_GetName(esysContext, entity->handle, &handle_name);
+    return_if_error(r, "Get name of policy entity");
+    *name = *handle_name;
+    free(handle_name);
+    return TSS2_RC_SUCCESS;
+}
+
+/** Compute the digest of the operands of TPM2_PolicyNV and
+ *  TPM2_PolicyCounterTimer, H(operandB.buffer || offset || operation).
+ *
+ * @param[in]  hashAlg The hash algorithm of the policy.
+ * @param[in]  operandB The operand.
+ * @param[in]  offset The offset of the operand.
+ * @param[in]  operation The comparison.
+ * @param[out] args The digest of the operands.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the size of operandB is invalid.
+ * @retval TSS2_ESYS_RC_* for errors of the crypto backend.
+ */
+static TSS2_RC
+policy_args(TPMI_ALG_HASH hashAlg, const TPM2B_OPERAND *operandB,
+            UINT16 offset, TPM2_EO operation, TPM2B_DIGEST *args)
+{
+    TSS2_RC r;
+    IESYS_CRYPTO_CONTEXT_BLOB *cryptoContext;
+    uint8_t buffer[sizeof(UINT16) + sizeof(TPM2_EO)];
+    size_t size = 0, digest_size = sizeof(args->buffer);
+
+    if (operandB->size > sizeof(operandB->buffer)) {
+        LOG_ERROR("operandB of %" PRIu16 " bytes too large.", operandB->size);
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+
+    r = Tss2_MU_UINT16_Marshal(offset, &buffer[0], sizeof(buffer), &size);
+    return_if_error(r, "Marshal offset");
+    r = Tss2_MU_UINT16_Marshal(operation, &buffer[0], sizeof(buffer), &size);
+    return_if_error(r, "Marshal operation");
+
+    r = iesys_crypto_hash_start(&cryptoContext, hashAlg);
+    return_if_error(r, "crypto hash start");
+
+    r = iesys_crypto_hash_update2b(cryptoContext, (TPM2B *) operandB);
+    goto_if_error(r, "crypto hash update", error_cleanup);
+
+    r = iesys_crypto_hash_update(cryptoContext, &buffer[0], size);
+    goto_if_error(r, "crypto hash update", error_cleanup);
+
+    r = iesys_crypto_hash_finish(&cryptoContext, &args->buffer[0],
+                                 &digest_size);
+    goto_if_error(r, "crypto hash finish", error_cleanup);
+    args->size = digest_size;
+
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    if (cryptoContext)
+        iesys_crypto_hash_abort(&cryptoContext);
+    return r;
+}
+
+static TSS2_RC
+policy_calculate(ESYS_CONTEXT *esysContext, const ESYS_POLICY *policy,
+                 TPMI_ALG_HASH hashAlg, TPM2B_DIGEST *digest);
+
+/** Compute the digests of the branches of a TPM2_PolicyOR.
+ *
+ * @param[in]  esysContext The ESYS_CONTEXT. May be NULL.
+ * @param[in]  element The TPM2_PolicyOR element.
+ * @param[in]  hashAlg The hash algorithm of the policy.
+ * @param[in]  digest The policy digest before the TPM2_PolicyOR.
+ * @param[out] hashes The digests of the branches.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the number of branches is invalid.
+ * @retval TSS2_RCs of the calculation of the branches.
+ */
+static TSS2_RC
+policy_or_hashes(ESYS_CONTEXT *esysContext, const ESYS_POLICY_ELEMENT *element,
+                 TPMI_ALG_HASH hashAlg, const TPM2B_DIGEST *digest,
+                 TPML_DIGEST *hashes)
+{
+    TSS2_RC r;
+
+    if (element->args.policyOR.count < 2 ||
+        element->args.policyOR.count > sizeof(hashes->digests) /
+                                       sizeof(hashes->digests[0])) {
+        LOG_ERROR("PolicyOR needs 2 to 8 branches, got %" PRIu32 ".",
+                  element->args.policyOR.count);
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    _ESYS_ASSERT_NON_NULL(element->args.policyOR.branches);
+
+    hashes->count = element->args.policyOR.count;
+    for (UINT32 i = 0; i < hashes->count; i++) {
+        hashes->digests[i] = *digest;
+        r = policy_calculate(esysContext, &element->args.policyOR.branches[i],
+                             hashAlg, &hashes->digests[i]);
+        return_if_error(r, "Calculate PolicyOR branch");
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Update the policy digest for TPM2_PolicyOR.
+ *
+ * @param[in]     hashAlg The hash algorithm of the policy.
+ * @param[in]     hashes The digests of the branches.
+ * @param[in,out] digest The policy digest.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_* for errors of the crypto backend.
+ */
+static TSS2_RC
+policy_or_update(TPMI_ALG_HASH hashAlg, const TPML_DIGEST *hashes,
+                 TPM2B_DIGEST *digest)
+{
+    TSS2_RC r;
+    uint8_t buffer[sizeof(TPM2_CC) + sizeof(TPML_DIGEST)];
+    size_t size = 0;
+
+    r = Tss2_MU_TPM2_CC_Marshal(TPM2_CC_PolicyOR, &buffer[0], sizeof(buffer),
+                                &size);
+    return_if_error(r, "Marshal command code");
+    for (UINT32 i = 0; i < hashes->count; i++) {
+        memcpy(&buffer[size], &hashes->digests[i].buffer[0],
+               hashes->digests[i].size);
+        size += hashes->digests[i].size;
+    }
+
+    r = policy_reset(hashAlg, digest);
+    return_if_error(r, "Reset policy digest");
+    return policy_hash(hashAlg, digest, &buffer[0], size);
+}
+
+/** Update the policy digest for one policy command.
+ *
+ * @param[in]     esysContext The ESYS_CONTEXT. May be NULL if all names are
+ *                given.
+ * @param[in]     element The policy command.
+ * @param[in]     hashAlg The hash algorithm of the policy.
+ * @param[in,out] digest The policy digest.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_VALUE for an invalid element.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED for an unsupported policy command.
+ * @retval TSS2_RCs produced by lower layers of the software stack.
+ */
+static TSS2_RC
+policy_update(ESYS_CONTEXT *esysContext, const ESYS_POLICY_ELEMENT *element,
+              TPMI_ALG_HASH hashAlg, TPM2B_DIGEST *digest)
+{
+    TSS2_RC r;
+    uint8_t buffer[sizeof(TPM2_CC) + sizeof(TPML_PCR_SELECTION) +
+                   2 * sizeof(TPMU_NAME) + sizeof(TPMU_HA)];
+    size_t size = 0, max = sizeof(buffer);
+    TPML_DIGEST hashes;
+    TPM2B_DIGEST args;
+    TPM2B_NAME name;
+    const TPM2B_NONCE *policyRef = NULL;
+    TPM2_CC cc = element->commandCode;
+
+    /* TPM2_PolicyPassword is recorded like TPM2_PolicyAuthValue */
+    if (cc == TPM2_CC_PolicyPassword)
+        cc = TPM2_CC_PolicyAuthValue;
+
+    switch (cc) {
+    case TPM2_CC_PolicyOR:
+        r = policy_or_hashes(esysContext, element, hashAlg, digest, &hashes);
+        return_if_error(r, "PolicyOR branches");
+        return policy_or_update(hashAlg, &hashes, digest);
+    case TPM2_CC_PolicyAuthorize:
+    case TPM2_CC_PolicyAuthorizeNV:
+        /* These replace the policy digest */
+        r = policy_reset(hashAlg, digest);
+        return_if_error(r, "Reset policy digest");
+        break;
+    default:
+        break;
+    }
+
+    r = Tss2_MU_TPM2_CC_Marshal(cc, &buffer[0], max, &size);
+    return_if_error(r, "Marshal command code");
+
+    switch (cc) {
+    case TPM2_CC_PolicyAuthValue:
+    case TPM2_CC_PolicyPhysicalPresence:
+        break;
+    case TPM2_CC_PolicyPCR:
+        r = Tss2_MU_TPML_PCR_SELECTION_Marshal(&element->args.policyPCR.pcrs,
+                                               &buffer[0], max, &size);
+        return_if_error(r, "Marshal pcrs");
+        r = policy_append(&buffer[0], max, &size,
+                          &element->args.policyPCR.pcrDigest.buffer[0],
+                          element->args.policyPCR.pcrDigest.size,
+                          sizeof(element->args.policyPCR.pcrDigest.buffer));
+        return_if_error(r, "Append pcrDigest");
+        break;
+    case TPM2_CC_PolicyCommandCode:
+        r = Tss2_MU_TPM2_CC_Marshal(element->args.policyCommandCode.code,
+                                    &buffer[0], max, &size);
+        return_if_error(r, "Marshal code");
+        break;
+    case TPM2_CC_PolicyLocality:
+        r = Tss2_MU_TPMA_LOCALITY_Marshal(element->args.policyLocality.locality,
+                                          &buffer[0], max, &size);
+        return_if_error(r, "Marshal locality");
+        break;
+    case TPM2_CC_PolicyCpHash:
+    case TPM2_CC_PolicyNameHash:
+    case TPM2_CC_PolicyTemplate:
+        /* These share the layout of their arguments */
+        r = policy_append(&buffer[0], max, &size,
+                          &element->args.policyCpHash.digest.buffer[0],
+                          element->args.policyCpHash.digest.size,
+                          sizeof(element->args.policyCpHash.digest.buffer));
+        return_if_error(r, "Append digest");
+        break;
+    case TPM2_CC_PolicyNvWritten:
+        r = Tss2_MU_UINT8_Marshal(element->args.policyNvWritten.writtenSet,
+                                  &buffer[0], max, &size);
+        return_if_error(r, "Marshal writtenSet");
+        break;
+    case TPM2_CC_PolicySecret:
+        r = policy_name(esysContext, &element->args.policySecret.authObject,
+                        &name);
+        return_if_error(r, "Name of authObject");
+        policyRef = &element->args.policySecret.policyRef;
+        goto append_name;
+    case TPM2_CC_PolicySigned:
+        r = policy_name(esysContext, &element->args.policySigned.authObject,
+                        &name);
+        return_if_error(r, "Name of authObject");
+        policyRef = &element->args.policySigned.policyRef;
+        goto append_name;
+    case TPM2_CC_PolicyAuthorize:
+        r = policy_name(esysContext, &element->args.policyAuthorize.keySign,
+                        &name);
+        return_if_error(r, "Name of keySign");
+        policyRef = &element->args.policyAuthorize.policyRef;
+        goto append_name;
+    case TPM2_CC_PolicyAuthorizeNV:
+        r = policy_name(esysContext, &element->args.policyAuthorizeNV.nvIndex,
+                        &name);
+        return_if_error(r, "Name of nvIndex");
+        goto append_name;
+    case TPM2_CC_PolicyNV:
+        r = policy_args(hashAlg, &element->args.policyNV.operandB,
+                        element->args.policyNV.offset,
+                        element->args.policyNV.operation, &args);
+        return_if_error(r, "Digest of operands");
+        r = policy_append(&buffer[0], max, &size, &args.buffer[0], args.size,
+                          sizeof(args.buffer));
+        return_if_error(r, "Append args");
+        r = policy_name(esysContext, &element->args.policyNV.nvIndex, &name);
+        return_if_error(r, "Name of nvIndex");
+        goto append_name;
+    case TPM2_CC_PolicyCounterTimer:
+        r = policy_args(hashAlg, &element->args.policyCounterTimer.operandB,
+                        element->args.policyCounterTimer.offset,
+                        element->args.policyCounterTimer.operation, &args);
+        return_if_error(r, "Digest of operands");
+        r = policy_append(&buffer[0], max, &size, &args.buffer[0], args.size,
+                          sizeof(args.buffer));
+        return_if_error(r, "Append args");
+        break;
+    case TPM2_CC_PolicyDuplicationSelect:
+        if (element->args.policyDuplicationSelect.includeObject) {
+            name = element->args.policyDuplicationSelect.objectName;
+            r = policy_append(&buffer[0], max, &size, &name.name[0],
+                              name.size, sizeof(name.name));
+            return_if_error(r, "Append objectName");
+        }
+        name = element->args.policyDuplicationSelect.newParentName;
+        r = policy_append(&buffer[0], max, &size, &name.name[0], name.size,
+                          sizeof(name.name));
+        return_if_error(r, "Append newParentName");
+        r = Tss2_MU_UINT8_Marshal(
+                element->args.policyDuplicationSelect.includeObject,
+                &buffer[0], max, &size);
+        return_if_error(r, "Marshal includeObject");
+        break;
+    default:
+        LOG_ERROR("Policy command 0x%" PRIx32 " not supported.",
+                  element->commandCode);
+        return TSS2_ESYS_RC_NOT_IMPLEMENTED;
+    }
+
+    r = policy_hash(hashAlg, digest, &buffer[0], size);
+    return_if_error(r, "Policy hash");
+    return TSS2_RC_SUCCESS;
+
+append_name:
+    if (policyRef != NULL && policyRef->size > sizeof(policyRef->buffer)) {
+        LOG_ERROR("policyRef of %" PRIu16 " bytes too large.",
+                  policyRef->size);
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+    r = policy_append(&buffer[0], max, &size, &name.name[0], name.size,
+                      sizeof(name.name));
+    return_if_error(r, "Append name");
+    r = policy_hash(hashAlg, digest, &buffer[0], size);
+    return_if_error(r, "Policy hash");
+
+    /* PolicyUpdate() extends the policyRef in a second step */
+    if (policyRef != NULL) {
+        r = policy_hash(hashAlg, digest, &policyRef->buffer[0],
+                        policyRef->size);
+        return_if_error(r, "Policy hash");
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Compute the policy digest of a list of policy commands.
+ *
+ * @param[in]     esysContext The ESYS_CONTEXT. May be NULL.
+ * @param[in]     policy The policy commands.
+ * @param[in]     hashAlg The hash algorithm of the policy.
+ * @param[in,out] digest The policy digest.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_RCs of policy_update.
+ */
+static TSS2_RC
+policy_calculate(ESYS_CONTEXT *esysContext, const ESYS_POLICY *policy,
+                 TPMI_ALG_HASH hashAlg, TPM2B_DIGEST *digest)
+{
+    TSS2_RC r;
+
+    if (policy->count > 0)
+        _ESYS_ASSERT_NON_NULL(policy->elements);
+
+    for (size_t i = 0; i < policy->count; i++) {
+        r = policy_update(esysContext, &policy->elements[i], hashAlg, digest);
+        return_if_error(r, "Policy update");
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Compute a policy digest without the TPM.
+ *
+ * Computes the policyDigest a policy session with the authHash hashAlg would
+ * have after executing the commands of policy, e.g. to set the authPolicy of
+ * a key template without a trial session. The branches of a TPM2_PolicyOR
+ * continue the digest of the preceding commands.
+ * Names of entities are taken from the policy; a name that is not given is
+ * looked up from the ESYS_TR handle of the entity without TPM access.
+ * @param[in]     esysContext The ESYS_CONTEXT. May be NULL if the policy
+ *                holds all names.
+ * @param[in]     policy The policy commands.
+ * @param[in]     hashAlg The hash algorithm of the policy.
+ * @param[in,out] policyDigest The digest the policy starts from; a size of 0
+ *                starts a new policy. Receives the policy digest.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if policy or policyDigest is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if policyDigest does not match hashAlg, if
+ *         a name is missing, for a TPM2B whose size exceeds its buffer or
+ *         for an invalid PolicyOR.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED for an unknown hash algorithm or an
+ *         unsupported policy command.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_PolicyCalculate(
+    ESYS_CONTEXT *esysContext,
+    const ESYS_POLICY *policy,
+    TPMI_ALG_HASH hashAlg,
+    TPM2B_DIGEST *policyDigest)
+{
+    TSS2_RC r;
+    size_t digest_size;
+
+    _ESYS_ASSERT_NON_NULL(policy);
+    _ESYS_ASSERT_NON_NULL(policyDigest);
+
+    r = iesys_crypto_hash_get_digest_size(hashAlg, &digest_size);
+    return_if_error(r, "Unknown hash algorithm");
+    if (policyDigest->size == 0) {
+        r = policy_reset(hashAlg, policyDigest);
+        return_if_error(r, "Reset policy digest");
+    } else if (policyDigest->size != digest_size) {
+        LOG_ERROR("Policy digest does not match the hash algorithm.");
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+
+    return policy_calculate(esysContext, policy, hashAlg, policyDigest);
+}
+
+/** Send one policy command to the TPM.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]     policySession The policy session.
+ * @param[in]     element The policy command.
+ * @param[in]     hashes The digests of the branches of a TPM2_PolicyOR.
+ * @param[in]     digest The policy digest before the command.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_RCs of the policy command.
+ */
+static TSS2_RC
+policy_send(ESYS_CONTEXT *esysContext, ESYS_TR policySession,
+            const ESYS_POLICY_ELEMENT *element, const TPML_DIGEST *hashes,
+            const TPM2B_DIGEST *digest)
+{
+    TSS2_RC r;
+    TPM2B_NAME name;
+
+    switch (element->commandCode) {
+    case TPM2_CC_PolicyAuthValue:
+        return Esys_PolicyAuthValue(esysContext, policySession, ESYS_TR_NONE,
+                                    ESYS_TR_NONE, ESYS_TR_NONE);
+    case TPM2_CC_PolicyPassword:
+        return Esys_PolicyPassword(esysContext, policySession, ESYS_TR_NONE,
+                                   ESYS_TR_NONE, ESYS_TR_NONE);
+    case TPM2_CC_PolicyPhysicalPresence:
+        return Esys_PolicyPhysicalPresence(esysContext, policySession,
+                                           ESYS_TR_NONE, ESYS_TR_NONE,
+                                           ESYS_TR_NONE);
+    case TPM2_CC_PolicyPCR:
+        return Esys_PolicyPCR(esysContext, policySession, ESYS_TR_NONE,
+                              ESYS_TR_NONE, ESYS_TR_NONE,
+                              &element->args.policyPCR.pcrDigest,
+                              &element->args.policyPCR.pcrs);
+    case TPM2_CC_PolicyCommandCode:
+        return Esys_PolicyCommandCode(esysContext, policySession, ESYS_TR_NONE,
+                                      ESYS_TR_NONE, ESYS_TR_NONE,
+                                      element->args.policyCommandCode.code);
+    case TPM2_CC_PolicyLocality:
+        return Esys_PolicyLocality(esysContext, policySession, ESYS_TR_NONE,
+                                   ESYS_TR_NONE, ESYS_TR_NONE,
+                                   element->args.policyLocality.locality);
+    case TPM2_CC_PolicyCpHash:
+        return Esys_PolicyCpHash(esysContext, policySession, ESYS_TR_NONE,
+                                 ESYS_TR_NONE, ESYS_TR_NONE,
+                                 &element->args.policyCpHash.digest);
+    case TPM2_CC_PolicyNameHash:
+        return Esys_PolicyNameHash(esysContext, policySession, ESYS_TR_NONE,
+                                   ESYS_TR_NONE, ESYS_TR_NONE,
+                                   &element->args.policyNameHash.digest);
+    case TPM2_CC_PolicyTemplate:
+        return Esys_PolicyTemplate(esysContext, policySession, ESYS_TR_NONE,
+                                   ESYS_TR_NONE, ESYS_TR_NONE,
+                                   &element->args.policyTemplate.digest);
+    case TPM2_CC_PolicyNvWritten:
+        return Esys_PolicyNvWritten(esysContext, policySession, ESYS_TR_NONE,
+                                    ESYS_TR_NONE, ESYS_TR_NONE,
+                                    element->args.policyNvWritten.writtenSet);
+    case TPM2_CC_PolicySecret:
+        return Esys_PolicySecret(esysContext,
+                                 element->args.policySecret.authObject.handle,
+                                 policySession,
+                                 element->args.policySecret.authSession,
+                                 ESYS_TR_NONE, ESYS_TR_NONE, NULL, NULL,
+                                 &element->args.policySecret.policyRef, 0,
+                                 NULL, NULL);
+    case TPM2_CC_PolicySigned:
+        return Esys_PolicySigned(esysContext,
+                                 element->args.policySigned.authObject.handle,
+                                 policySession, ESYS_TR_NONE, ESYS_TR_NONE,
+                                 ESYS_TR_NONE, NULL, NULL,
+                                 &element->args.policySigned.policyRef, 0,
+                                 &element->args.policySigned.auth,
+                                 NULL, NULL);
+    case TPM2_CC_PolicyNV:
+        return Esys_PolicyNV(esysContext, element->args.policyNV.authHandle,
+                             element->args.policyNV.nvIndex.handle,
+                             policySession,
+                             element->args.policyNV.authSession,
+                             ESYS_TR_NONE, ESYS_TR_NONE,
+                             &element->args.policyNV.operandB,
+                             element->args.policyNV.offset,
+                             element->args.policyNV.operation);
+    case TPM2_CC_PolicyCounterTimer:
+        return Esys_PolicyCounterTimer(
+                   esysContext, policySession, ESYS_TR_NONE, ESYS_TR_NONE,
+                   ESYS_TR_NONE, &element->args.policyCounterTimer.operandB,
+                   element->args.policyCounterTimer.offset,
+                   element->args.policyCounterTimer.operation);
+    case TPM2_CC_PolicyDuplicationSelect:
+        return Esys_PolicyDuplicationSelect(
+                   esysContext, policySession, ESYS_TR_NONE, ESYS_TR_NONE,
+                   ESYS_TR_NONE,
+                   &element->args.policyDuplicationSelect.objectName,
+                   &element->args.policyDuplicationSelect.newParentName,
+                   element->args.policyDuplicationSelect.includeObject);
+    case TPM2_CC_PolicyAuthorize:
+        r = policy_name(esysContext, &element->args.policyAuthorize.keySign,
+                        &name);
+        return_if_error(r, "Name of keySign");
+        /* The policy approved by keySign is the digest up to this point */
+        return Esys_PolicyAuthorize(esysContext, policySession, ESYS_TR_NONE,
+                                    ESYS_TR_NONE, ESYS_TR_NONE, digest,
+                                    &element->args.policyAuthorize.policyRef,
+                                    &name,
+                                    &element->args.policyAuthorize.checkTicket);
+    case TPM2_CC_PolicyAuthorizeNV:
+        return Esys_PolicyAuthorizeNV(
+                   esysContext, element->args.policyAuthorizeNV.authHandle,
+                   element->args.policyAuthorizeNV.nvIndex.handle,
+                   policySession, element->args.policyAuthorizeNV.authSession,
+                   ESYS_TR_NONE, ESYS_TR_NONE);
+    case TPM2_CC_PolicyOR:
+        return Esys_PolicyOR(esysContext, policySession, ESYS_TR_NONE,
+                             ESYS_TR_NONE, ESYS_TR_NONE, hashes);
+    default:
+        LOG_ERROR("Policy command 0x%" PRIx32 " not supported.",
+                  element->commandCode);
+        return TSS2_ESYS_RC_NOT_IMPLEMENTED;
+    }
+}
+
+/** Execute a list of policy commands and track the policy digest.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]     policySession The policy session.
+ * @param[in]     policy The policy commands.
+ * @param[in]     hashAlg The hash algorithm of the policy session.
+ * @param[in,out] digest The policy digest of the session.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_RCs of the first failing command.
+ */
+static TSS2_RC
+policy_execute(ESYS_CONTEXT *esysContext, ESYS_TR policySession,
+               const ESYS_POLICY *policy, TPMI_ALG_HASH hashAlg,
+               TPM2B_DIGEST *digest)
+{
+    TSS2_RC r;
+    TPML_DIGEST hashes = { .count = 0 };
+
+    if (policy->count > 0)
+        _ESYS_ASSERT_NON_NULL(policy->elements);
+
+    for (size_t i = 0; i < policy->count; i++) {
+        const ESYS_POLICY_ELEMENT *element = &policy->elements[i];
+
+        if (element->commandCode != TPM2_CC_PolicyOR) {
+            r = policy_send(esysContext, policySession, element, NULL, digest);
+            return_if_error(r, "Policy command");
+            r = policy_update(esysContext, element, hashAlg, digest);
+            return_if_error(r, "Policy update");
+            continue;
+        }
+
+        /* The digest list of the TPM2_PolicyOR is computed locally */
+        r = policy_or_hashes(esysContext, element, hashAlg, digest, &hashes);
+        return_if_error(r, "PolicyOR branches");
+        if (element->args.policyOR.selected >= hashes.count) {
+            LOG_ERROR("Selected PolicyOR branch does not exist.");
+            return TSS2_ESYS_RC_BAD_VALUE;
+        }
+
+        r = policy_execute(esysContext, policySession,
+                           &element->args.policyOR.branches[
+                               element->args.policyOR.selected],
+                           hashAlg, digest);
+        return_if_error(r, "PolicyOR branch");
+
+        r = policy_send(esysContext, policySession, element, &hashes, digest);
+        return_if_error(r, "Policy command");
+        r = policy_or_update(hashAlg, &hashes, digest);
+        return_if_error(r, "Policy update");
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Execute a policy in a policy session.
+ *
+ * Sends the commands of policy to the TPM in order. Of a TPM2_PolicyOR only
+ * the selected branch is executed; the digests of all branches are computed
+ * as by Esys_PolicyCalculate, as is the approvedPolicy of a
+ * TPM2_PolicyAuthorize. The session is expected to be freshly started or
+ * reset with TPM2_PolicyRestart.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  policySession The policy or trial session.
+ * @param[in]  policy The policy commands.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or policy is NULL.
+ * @retval TSS2_ESYS_RC_BAD_TR if policySession is not a policy session.
+ * @retval TSS2_ESYS_RC_BAD_VALUE for an invalid PolicyOR.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED for an unsupported policy command.
+ * @retval TSS2_RCs of the first failing policy command.
+ */
+TSS2_RC
+Esys_PolicyExecute(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR policySession,
+    const ESYS_POLICY *policy)
+{
+    TSS2_RC r;
+    RSRC_NODE_T *sessionNode;
+    IESYS_SESSION *session;
+    TPM2B_DIGEST digest;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(policy);
+
+    r = esys_GetResourceObject(esysContext, policySession, &sessionNode);
+    return_if_error(r, "Get policy session");
+    if (sessionNode == NULL ||
+        sessionNode->rsrc.rsrcType != IESYSC_SESSION_RSRC) {
+        LOG_ERROR("Handle is not a session.");
+        return TSS2_ESYS_RC_BAD_TR;
+    }
+    session = &sessionNode->rsrc.misc.rsrc_session;
+    if (session->sessionType != TPM2_SE_POLICY &&
+        session->sessionType != TPM2_SE_TRIAL) {
+        LOG_ERROR("Session is not a policy session.");
+        return TSS2_ESYS_RC_BAD_TR;
+    }
+
+    r = policy_reset(session->authHash, &digest);
+    return_if_error(r, "Reset policy digest");
+
+    return policy_execute(esysContext, policySession, policy,
+                          session->authHash, &digest);
+}
@@ -0,0 +1,378 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#if defined(_MSC_VER)
+#include <windows.h>
+#endif
+
+#include "tss2_esys.h"
+#include "tss2_tctildr.h"
+
+#include "esys_iutil.h"
+#include "esys_mu.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * An ESYS_POOL holds a fixed set of ESYS_CONTEXTs for multi-threaded
+ * servers. Every context has its own TCTI from the TCTI loader. A thread
+ * checks a context out with Esys_Pool_Acquire, which claims a free slot
+ * with a compare-and-swap, and returns it with Esys_Pool_Release; no locks
+ * are taken. Objects shared with Esys_Pool_Share are kept serialized in an
+ * append-only store and copied into a context, under the same ESYS_TR in
+ * every context, when the context is checked out. The store never changes
+ * once an entry is published, so the metadata is resolved once and read
+ * without locks.
+ */
+
+/** The ESYS_TR of the first shared object. */
+#define POOL_HANDLE_FIRST 0x40000000U
+
+#if defined(_MSC_VER)
+#define pool_cas(p, expected, desired) \
+    (InterlockedCompareExchange((p), (desired), (expected)) == (expected))
+#define pool_load(p) InterlockedCompareExchange((p), 0, 0)
+#define pool_store(p, v) InterlockedExchange((p), (v))
+#define pool_fetch_add(p, v) InterlockedExchangeAdd((p), (v))
+#else
+static bool
+pool_cas(volatile long *p, long expected, long desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#define pool_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define pool_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define pool_fetch_add(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#endif
+
+/** A context of the pool. */
+typedef struct {
+    ESYS_CONTEXT *esys_context;  /**< The context. */
+    volatile long in_use;        /**< 1 while the context is checked out. */
+    long loaded;                 /**< Number of shared objects copied into
+                                      the context. */
+} POOL_SLOT;
+
+/** A shared object. */
+typedef struct {
+    uint8_t *buffer;             /**< The object serialized by
+                                      Esys_TR_Serialize. */
+    size_t size;                 /**< Size of buffer. */
+    volatile long ready;         /**< 1 once buffer is published. */
+} POOL_OBJECT;
+
+struct ESYS_POOL {
+    POOL_SLOT *slots;            /**< The contexts. */
+    long count;                  /**< Number of contexts. */
+    volatile long next;          /**< Slot to try first on the next
+                                      checkout. */
+    POOL_OBJECT *objects;        /**< The shared objects. */
+    long object_max;             /**< Capacity of objects. */
+    volatile long object_count;  /**< Number of reserved entries of
+                                      objects. */
+};
+
+/** Copy the published shared objects into the context of a slot.
+ *
+ * The slot must be checked out by the caller. An object that cannot be
+ * unmarshaled is skipped for good, so its pool handle stays unknown in the
+ * context while the objects after it are copied.
+ * @param[in] pool The ESYS_POOL.
+ * @param[in,out] slot The slot.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY if the object cannot be allocated.
+ */
+static TSS2_RC
+pool_sync(ESYS_POOL *pool, POOL_SLOT *slot)
+{
+    TSS2_RC r;
+    long count = pool_load(&pool->object_count);
+    RSRC_NODE_T *node;
+    ESYS_TR esys_handle;
+
+    for (; slot->loaded < count && slot->loaded < pool->object_max;
+         slot->loaded++) {
+        POOL_OBJECT *object = &pool->objects[slot->loaded];
+        size_t offset = 0;
+
+        /* Stop at an entry that is still being written */
+        if (!pool_load(&object->ready))
+            break;
+
+        esys_handle = POOL_HANDLE_FIRST + slot->loaded;
+        r = esys_CreateResourceObject(slot->esys_context, esys_handle, &node);
+        return_if_error(r, "Create resource object");
+        r = iesys_MU_IESYS_RESOURCE_Unmarshal(object->buffer, object->size,
+                                              &offset, &node->rsrc);
+        if (r != TSS2_RC_SUCCESS) {
+            LOG_WARNING("Skip shared object 0x%08" PRIx32 ": 0x%08" PRIx32,
+                        esys_handle, r);
+            Esys_TR_Close(slot->esys_context, &esys_handle);
+        }
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Find the slot of a context. */
+static POOL_SLOT *
+pool_find(ESYS_POOL *pool, ESYS_CONTEXT *esys_context)
+{
+    for (long i = 0; i < pool->count; i++) {
+        if (pool->slots[i].esys_context == esys_context)
+            return &pool->slots[i];
+    }
+    return NULL;
+}
+
+/** Finalize a context of the pool and its TCTI. */
+static void
+pool_context_finalize(ESYS_CONTEXT **esys_context)
+{
+    TSS2_TCTI_CONTEXT *tcti = NULL;
+
+    if (*esys_context == NULL)
+        return;
+    Esys_GetTcti(*esys_context, &tcti);
+    Esys_Finalize(esys_context);
+    Tss2_TctiLdr_Finalize(&tcti);
+}
+
+/** Create a pool of ESYS contexts.
+ *
+ * Creates count contexts, each with a TCTI from Tss2_TctiLdr_Initialize with
+ * tctiConf.
+ * @param[out] pool The new ESYS_POOL. (callee-allocated)
+ * @param[in] count The number of contexts.
+ * @param[in] maxObjects The number of objects that can be shared with
+ *            Esys_Pool_Share.
+ * @param[in] tctiConf The TCTI configuration, or NULL for the default TCTI.
+ * @param[in] abiVersion The ABI version requested for the contexts.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if pool is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if count is 0.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_RCs produced by the TCTI loader or Esys_Initialize.
+ */
+TSS2_RC
+Esys_Pool_Initialize(
+    ESYS_POOL **pool,
+    size_t count,
+    size_t maxObjects,
+    const char *tctiConf,
+    TSS2_ABI_VERSION *abiVersion)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti;
+
+    _ESYS_ASSERT_NON_NULL(pool);
+    *pool = NULL;
+    if (count == 0 || count > LONG_MAX || maxObjects > LONG_MAX ||
+        maxObjects > UINT32_MAX - POOL_HANDLE_FIRST) {
+        LOG_ERROR("Bad pool size.");
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+
+    *pool = calloc(1, sizeof(ESYS_POOL));
+    return_if_null(*pool, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+    (*pool)->slots = calloc(count, sizeof(POOL_SLOT));
+    (*pool)->objects = calloc(maxObjects ? maxObjects : 1,
+                              sizeof(POOL_OBJECT));
+    goto_if_null((*pool)->slots, "Out of memory.", TSS2_ESYS_RC_MEMORY,
+                 error_cleanup);
+    goto_if_null((*pool)->objects, "Out of memory.", TSS2_ESYS_RC_MEMORY,
+                 error_cleanup);
+    (*pool)->object_max = maxObjects;
+
+    for (size_t i = 0; i < count; i++) {
+        r = Tss2_TctiLdr_Initialize(tctiConf, &tcti);
+        goto_if_error(r, "Initialize tcti", error_cleanup);
+        r = Esys_Initialize(&(*pool)->slots[i].esys_context, tcti, abiVersion);
+        if (r != TSS2_RC_SUCCESS) {
+            LOG_ERROR("Initialize context %zu", i);
+            Tss2_TctiLdr_Finalize(&tcti);
+            goto error_cleanup;
+        }
+        (*pool)->count++;
+    }
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    Esys_Pool_Finalize(pool);
+    return r;
+}
+
+/** Free a pool of ESYS contexts.
+ *
+ * Finalizes all contexts and their TCTIs. No context may be checked out.
+ * @param[in,out] pool The ESYS_POOL. (will be freed and set to NULL)
+ */
+void
+Esys_Pool_Finalize(ESYS_POOL **pool)
+{
+    if (pool == NULL || *pool == NULL)
+        return;
+
+    for (long i = 0; i < (*pool)->count; i++) {
+        if ((*pool)->slots[i].in_use)
+            LOG_WARNING("Finalizing a checked out context.");
+        pool_context_finalize(&(*pool)->slots[i].esys_context);
+    }
+    for (long i = 0; (*pool)->objects != NULL && i < (*pool)->object_max; i++)
+        free((*pool)->objects[i].buffer);
+    free((*pool)->slots);
+    free((*pool)->objects);
+    SAFE_FREE(*pool);
+}
+
+/** Check a context out of a pool.
+ *
+ * The context is owned by the calling thread until it is returned with
+ * Esys_Pool_Release. The objects shared with Esys_Pool_Share are available
+ * in the context. Does not block.
+ * @param[in,out] pool The ESYS_POOL.
+ * @param[out] esys_context The context.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if pool or esys_context is NULL.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if all contexts are checked out.
+ * @retval TSS2_ESYS_RC_MEMORY if a shared object cannot be allocated.
+ */
+TSS2_RC
+Esys_Pool_Acquire(ESYS_POOL *pool, ESYS_CONTEXT **esys_context)
+{
+    TSS2_RC r;
+    unsigned long start;
+
+    _ESYS_ASSERT_NON_NULL(pool);
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    *esys_context = NULL;
+
+    /* Spread the threads over the slots */
+    start = (unsigned long) pool_fetch_add(&pool->next, 1);
+    for (long i = 0; i < pool->count; i++) {
+        POOL_SLOT *slot = &pool->slots[(start + i) % pool->count];
+
+        if (!pool_cas(&slot->in_use, 0, 1))
+            continue;
+
+        r = pool_sync(pool, slot);
+        if (r != TSS2_RC_SUCCESS) {
+            pool_store(&slot->in_use, 0);
+            return r;
+        }
+        *esys_context = slot->esys_context;
+        return TSS2_RC_SUCCESS;
+    }
+    LOG_DEBUG("All contexts are checked out.");
+    return TSS2_ESYS_RC_TRY_AGAIN;
+}
+
+/** Return a context to a pool.
+ *
+ * @param[in,out] pool The ESYS_POOL.
+ * @param[in] esys_context The context checked out with Esys_Pool_Acquire.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if pool or esys_context is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the context is not part of the pool.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the context is not checked out or a
+ *         command is in flight.
+ */
+TSS2_RC
+Esys_Pool_Release(ESYS_POOL *pool, ESYS_CONTEXT *esys_context)
+{
+    POOL_SLOT *slot;
+
+    _ESYS_ASSERT_NON_NULL(pool);
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    slot = pool_find(pool, esys_context);
+    return_if_null(slot, "Context is not part of the pool.",
+                   TSS2_ESYS_RC_BAD_VALUE);
+    if (!pool_load(&slot->in_use) ||
+        esys_context->state == _ESYS_STATE_SENT ||
+        esys_context->state == _ESYS_STATE_RESUBMISSION) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+
+    pool_store(&slot->in_use, 0);
+    return TSS2_RC_SUCCESS;
+}
+
+/** Share the metadata of an object with all contexts of a pool.
+ *
+ * The name and public area of object are stored in the pool and are
+ * available under poolHandle in every context of the pool, so other threads
+ * need not resolve the object again. The auth value is not shared and has
+ * to be set with Esys_TR_SetAuth in every context. poolHandle must not be
+ * closed.
+ * @param[in,out] pool The ESYS_POOL.
+ * @param[in,out] esys_context A context of the pool checked out by the
+ *                caller.
+ * @param[in] object The object in esys_context.
+ * @param[out] poolHandle The ESYS_TR of the object in all contexts.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if pool, esys_context or poolHandle is
+ *         NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the context is not part of the pool.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the context is not checked out.
+ * @retval TSS2_ESYS_RC_INSUFFICIENT_BUFFER if maxObjects objects are shared.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_RCs produced by Esys_TR_Serialize.
+ */
+TSS2_RC
+Esys_Pool_Share(
+    ESYS_POOL *pool,
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR object,
+    ESYS_TR *poolHandle)
+{
+    TSS2_RC r;
+    POOL_SLOT *slot;
+    uint8_t *buffer = NULL;
+    size_t size;
+    long index;
+
+    _ESYS_ASSERT_NON_NULL(pool);
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    _ESYS_ASSERT_NON_NULL(poolHandle);
+
+    slot = pool_find(pool, esys_context);
+    return_if_null(slot, "Context is not part of the pool.",
+                   TSS2_ESYS_RC_BAD_VALUE);
+    if (!pool_load(&slot->in_use)) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+
+    r = Esys_TR_Serialize(esys_context, object, &buffer, &size);
+    return_if_error(r, "Serialize object");
+
+    /* Reserve an entry of the store */
+    do {
+        index = pool_load(&pool->object_count);
+        if (index >= pool->object_max) {
+            free(buffer);
+            LOG_ERROR("Too many shared objects.");
+            return TSS2_ESYS_RC_INSUFFICIENT_BUFFER;
+        }
+    } while (!pool_cas(&pool->object_count, index, index + 1));
+
+    pool->objects[index].buffer = buffer;
+    pool->objects[index].size = size;
+    pool_store(&pool->objects[index].ready, 1);
+    *poolHandle = POOL_HANDLE_FIRST + index;
+
+    return pool_sync(pool, slot);
+}
@@ -0,0 +1,233 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * TPM2_GetRandom returns at most the size of the largest digest of the TPM
+ * per call. Esys_GetRandomBytes issues as many commands as needed, sending
+ * the next command before the result of the previous one is copied.
+ * Optionally, random bytes are kept in a reservoir of the context, so small
+ * requests are served from memory. The reservoir is topped up whenever a
+ * request leaves less than its low-water mark in it. Only requests without
+ * sessions use the reservoir: bytes fetched in the clear must not satisfy a
+ * request with an encrypt session, and audit sessions must not see commands
+ * the caller did not ask for.
+ */
+
+/** Fill a buffer with random bytes from the TPM.
+ *
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param shandle1 [in] First session handle.
+ * @param shandle2 [in] Second session handle.
+ * @param shandle3 [in] Third session handle.
+ * @param size [in] The number of bytes to get.
+ * @param data [out] The buffer receiving the bytes.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned no or too many
+ *         bytes.
+ * @retval TSS2_RCs produced by lower layers of the software stack.
+ */
+static TSS2_RC
+random_fill(
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    size_t size,
+    uint8_t *data)
+{
+    TSS2_RC r;
+    TPM2B_DIGEST *random = NULL;
+    UINT16 requested;
+    size_t done = 0, next;
+    int32_t timeouttmp;
+
+    if (size == 0)
+        return TSS2_RC_SUCCESS;
+
+    /* The _Finish calls below shall block */
+    timeouttmp = esys_context->timeout;
+    esys_context->timeout = -1;
+
+    requested = (size < sizeof(TPMU_HA)) ? size : sizeof(TPMU_HA);
+    r = Esys_GetRandom_Async(esys_context, shandle1, shandle2, shandle3,
+                             requested);
+    goto_if_error(r, "Error in async function", error_cleanup);
+
+    while (done < size) {
+        do {
+            r = Esys_GetRandom_Finish(esys_context, &random);
+        } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+        goto_if_error(r, "Esys Finish", error_cleanup);
+
+        /* The TPM may return fewer bytes than requested */
+        if (random->size == 0 || random->size > requested) {
+            LOG_ERROR("TPM returned %" PRIu16 " random bytes for %" PRIu16 ".",
+                      random->size, requested);
+            r = TSS2_ESYS_RC_MALFORMED_RESPONSE;
+            goto error_cleanup;
+        }
+
+        /* Request the next bytes before copying out the current ones */
+        next = done + random->size;
+        if (next < size) {
+            requested = (size - next < sizeof(TPMU_HA)) ?
+                        size - next : sizeof(TPMU_HA);
+            r = Esys_GetRandom_Async(esys_context, shandle1, shandle2,
+                                     shandle3, requested);
+            goto_if_error(r, "Error in async function", error_cleanup);
+        }
+        memcpy(&data[done], &random->buffer[0], random->size);
+        memset(random, 0, sizeof(*random));
+        IESYS_OUTPUT_FREE(esys_context, random);
+        done = next;
+    }
+
+    esys_context->timeout = timeouttmp;
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    if (random != NULL)
+        memset(random, 0, sizeof(*random));
+    IESYS_OUTPUT_FREE(esys_context, random);
+    esys_context->timeout = timeouttmp;
+    return r;
+}
+
+/** Get an arbitrary number of random bytes from the TPM.
+ *
+ * If a reservoir is configured for the context (see Esys_SetRandomReservoir)
+ * and holds enough bytes, the request is served from it without talking to
+ * the TPM. Otherwise the bytes are requested from the TPM directly. In both
+ * cases the reservoir is refilled afterwards if it holds less than its
+ * low-water mark. Requests with sessions bypass the reservoir: they neither
+ * take bytes from it nor refill it, so all their bytes are fetched with
+ * their sessions.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  shandle1 First session handle.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  size Number of random bytes to get.
+ * @param[out] data Buffer of at least size bytes receiving the random bytes.
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or data is NULL.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned no or too many
+ *         bytes.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_GetRandomBytes(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    size_t size,
+    uint8_t *data)
+{
+    TSS2_RC r;
+    uint8_t *reservoir;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    if (size > 0)
+        _ESYS_ASSERT_NON_NULL(data);
+
+    /* The reservoir is only filled and used without sessions */
+    if (shandle1 != ESYS_TR_NONE || shandle2 != ESYS_TR_NONE ||
+        shandle3 != ESYS_TR_NONE)
+        return random_fill(esysContext, shandle1, shandle2, shandle3, size,
+                           data);
+
+    reservoir = esysContext->random_reservoir;
+    if (reservoir != NULL && size <= esysContext->random_reservoir_fill) {
+        /* Take the bytes from the end and wipe them */
+        esysContext->random_reservoir_fill -= size;
+        memcpy(data, &reservoir[esysContext->random_reservoir_fill], size);
+        memset(&reservoir[esysContext->random_reservoir_fill], 0, size);
+    } else {
+        r = random_fill(esysContext, shandle1, shandle2, shandle3, size, data);
+        return_if_error(r, "Get random bytes");
+    }
+
+    if (reservoir == NULL ||
+        esysContext->random_reservoir_fill >= esysContext->random_low_water)
+        return TSS2_RC_SUCCESS;
+
+    r = random_fill(esysContext, shandle1, shandle2, shandle3,
+                    esysContext->random_reservoir_size -
+                    esysContext->random_reservoir_fill,
+                    &reservoir[esysContext->random_reservoir_fill]);
+    if (r != TSS2_RC_SUCCESS) {
+        /* The request itself was served; retry the refill next time */
+        LOG_WARNING("Refilling random reservoir failed: 0x%08" PRIx32, r);
+        memset(&reservoir[esysContext->random_reservoir_fill], 0,
+               esysContext->random_reservoir_size -
+               esysContext->random_reservoir_fill);
+        return TSS2_RC_SUCCESS;
+    }
+    esysContext->random_reservoir_fill = esysContext->random_reservoir_size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Configure the random reservoir of a context.
+ *
+ * The reservoir is filled on the next call of Esys_GetRandomBytes without
+ * sessions, with sessionless TPM2_GetRandom commands. Any bytes left in a
+ * previous reservoir are discarded.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  size Size of the reservoir in bytes; 0 disables the reservoir.
+ * @param[in]  lowWater Refill the reservoir when it holds fewer bytes.
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if lowWater is larger than size.
+ * @retval TSS2_ESYS_RC_MEMORY if the reservoir cannot be allocated.
+ */
+TSS2_RC
+Esys_SetRandomReservoir(
+    ESYS_CONTEXT *esysContext,
+    size_t size,
+    size_t lowWater)
+{
+    uint8_t *reservoir = NULL;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    if (lowWater > size) {
+        LOG_ERROR("Low-water mark %zu exceeds reservoir size %zu.",
+                  lowWater, size);
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+
+    if (size > 0) {
+        reservoir = calloc(1, size);
+        return_if_null(reservoir, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+    }
+
+    if (esysContext->random_reservoir != NULL) {
+        memset(esysContext->random_reservoir, 0,
+               esysContext->random_reservoir_size);
+        free(esysContext->random_reservoir);
+    }
+    esysContext->random_reservoir = reservoir;
+    esysContext->random_reservoir_size = size;
+    esysContext->random_reservoir_fill = 0;
+    /* A low-water mark of 0 refills the reservoir once it is empty */
+    esysContext->random_low_water = (size > 0 && lowWater == 0) ? 1 : lowWater;
+
+    return TSS2_RC_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Esys_SignBatch signs a list of digests with one key. The command for the
+ * next digest, including its authorization, is prepared and sent as soon as
+ * the response of the previous one has been verified; the previous signature
+ * is copied out while the TPM executes the next command. HMAC sessions chain
+ * their nonces from response to command as with individual Esys_Sign calls.
+ */
+
+/** Sign a list of digests with the same key.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  keyHandle Handle of key that will perform signing.
+ * @param[in]  shandle1 Session handle for authorization of keyHandle.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  digests The digests to sign.
+ * @param[in]  count The number of digests.
+ * @param[in]  inScheme Signing scheme to use if the scheme for keyHandle is
+ *             TPM2_ALG_NULL.
+ * @param[in]  validation Proof that the digests were created by the TPM. May
+ *             be NULL for a NULL ticket.
+ * @param[out] signatures Array of count signatures. If an error is returned,
+ *             the first signedCount signatures are valid.
+ * @param[out] signedCount The number of digests that were signed, also if an
+ *             error is returned. May be NULL.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext, digests, inScheme or
+ *         signatures is NULL.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_SignBatch(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR keyHandle,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const TPM2B_DIGEST *digests,
+    size_t count,
+    const TPMT_SIG_SCHEME *inScheme,
+    const TPMT_TK_HASHCHECK *validation,
+    TPMT_SIGNATURE *signatures,
+    size_t *signedCount)
+{
+    TSS2_RC r;
+    TPMT_SIGNATURE *signature = NULL;
+    TPMT_TK_HASHCHECK null_ticket = {
+        .tag = TPM2_ST_HASHCHECK,
+        .hierarchy = TPM2_RH_NULL,
+        .digest = { .size = 0 }
+    };
+    size_t i = 0;
+    int32_t timeouttmp;
+
+    if (signedCount != NULL)
+        *signedCount = 0;
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(inScheme);
+    if (count == 0)
+        return TSS2_RC_SUCCESS;
+    _ESYS_ASSERT_NON_NULL(digests);
+    _ESYS_ASSERT_NON_NULL(signatures);
+    if (validation == NULL)
+        validation = &null_ticket;
+
+    /* The _Finish calls below shall block */
+    timeouttmp = esysContext->timeout;
+    esysContext->timeout = -1;
+
+    r = Esys_Sign_Async(esysContext, keyHandle, shandle1, shandle2, shandle3,
+                        &digests[0], inScheme, validation);
+    goto_if_error(r, "Error in async function", error_cleanup);
+
+    for (i = 0; i < count; i++) {
+        do {
+            r = Esys_Sign_Finish(esysContext, &signature);
+        } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+        goto_if_error(r, "Esys Finish", error_cleanup);
+
+        /* Send the next digest before copying out the current signature */
+        if (i + 1 < count) {
+            r = Esys_Sign_Async(esysContext, keyHandle, shandle1, shandle2,
+                                shandle3, &digests[i + 1], inScheme,
+                                validation);
+            goto_if_error(r, "Error in async function", error_cleanup);
+        }
+        signatures[i] = *signature;
+        IESYS_OUTPUT_FREE(esysContext, signature);
+    }
+
+    if (signedCount != NULL)
+        *signedCount = count;
+    esysContext->timeout = timeouttmp;
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    /* Keep the signature received before a failing send */
+    if (signature != NULL)
+        signatures[i++] = *signature;
+    IESYS_OUTPUT_FREE(esysContext, signature);
+    if (signedCount != NULL)
+        *signedCount = i;
+    LOG_ERROR("Signing failed after %zu of %zu digests.", i, count);
+    esysContext->timeout = timeouttmp;
+    return r;
+}
@@ -212,8 +212,8 @@ Esys_TR_FromTPMPublic_Finish(ESYS_CONTEXT * esys_context, ESYS_TR * object)
         objectHandleNode->rsrc.rsrcType = IESYSC_NV_RSRC;
         objectHandleNode->rsrc.name = *nvName;
         objectHandleNode->rsrc.misc.rsrc_nv_pub = *nvPublic;
-        SAFE_FREE(nvPublic);
-        SAFE_FREE(nvName);
+        IESYS_OUTPUT_FREE(esys_context, nvPublic);
+        IESYS_OUTPUT_FREE(esys_context, nvName);
     } else if(objectHandleNode->rsrc.handle >> TPM2_HR_SHIFT == TPM2_HT_LOADED_SESSION
             || objectHandleNode->rsrc.handle >> TPM2_HR_SHIFT == TPM2_HT_SAVED_SESSION) {
         objectHandleNode->rsrc.rsrcType = IESYSC_DEGRADED_SESSION_RSRC;
@@ -233,9 +233,9 @@ Esys_TR_FromTPMPublic_Finish(ESYS_CONTEXT * esys_context, ESYS_TR * object)
         objectHandleNode->rsrc.rsrcType = IESYSC_KEY_RSRC;
         objectHandleNode->rsrc.name = *name;
         objectHandleNode->rsrc.misc.rsrc_key_pub = *public;
-        SAFE_FREE(public);
-        SAFE_FREE(name);
-        SAFE_FREE(qualifiedName);
+        IESYS_OUTPUT_FREE(esys_context, public);
+        IESYS_OUTPUT_FREE(esys_context, name);
+        IESYS_OUTPUT_FREE(esys_context, qualifiedName);
     }
     *object = objectHandle;
     return TSS2_RC_SUCCESS;
@@ -426,23 +426,18 @@ Esys_TR_GetName(ESYS_CONTEXT * esys_context, ESYS_TR esys_handle,
         LOG_ERROR("Error: out of memory");
         return TSS2_ESYS_RC_MEMORY;
     }
-    if (esys_object->rsrc.rsrcType == IESYSC_KEY_RSRC) {
-        r = iesys_get_name(&esys_object->rsrc.misc.rsrc_key_pub, *name);
-        goto_if_error(r, "Error get name", error_cleanup);
+    /* The cached name is up to date, see esys_GetResourceObject */
+    if (esys_object->rsrc.rsrcType == IESYSC_KEY_RSRC ||
+        esys_object->rsrc.rsrcType == IESYSC_NV_RSRC) {
+        **name = esys_object->rsrc.name;
 
     } else {
-        if (esys_object->rsrc.rsrcType == IESYSC_NV_RSRC) {
-            r = iesys_nv_get_name(&esys_object->rsrc.misc.rsrc_nv_pub, *name);
-            goto_if_error(r, "Error get name", error_cleanup);
-
-        } else {
-            size_t offset = 0;
-            r = Tss2_MU_TPM2_HANDLE_Marshal(esys_object->rsrc.handle,
-                                            &(*name)->name[0], sizeof(TPM2_HANDLE),
-                                            &offset);
-            goto_if_error(r, "Error get name", error_cleanup);
-            (*name)->size = offset;
-        }
+        size_t offset = 0;
+        r = Tss2_MU_TPM2_HANDLE_Marshal(esys_object->rsrc.handle,
+                                        &(*name)->name[0], sizeof(TPM2_HANDLE),
+                                        &offset);
+        goto_if_error(r, "Error get name", error_cleanup);
+        (*name)->size = offset;
     }
     return r;
  error_cleanup:
@@ -0,0 +1,457 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Bulk resolution creates the ESYS_TRs of many persistent objects and NV
+ * indices at once. The handles are dealt out to the ESYS_CONTEXT of the
+ * caller and to optional shard contexts with their own connections to the
+ * TPM; every context reads the public area of its next handle as soon as
+ * its previous response has been processed. While the TPM works on the
+ * command of one shard, the responses of the others are unmarshaled and
+ * their names are recomputed from the public areas and checked against the
+ * names reported by the TPM. The results are stored in the context of the
+ * caller.
+ * Shards whose TCTI has poll handles are driven by an ESYS_LOOP. The context
+ * of the caller and shards without poll handles, whose TCTI may only receive
+ * blocking like mssim, take turns with blocking _Finish calls; the loop
+ * dispatches the responses that arrived in between. On platforms without an
+ * ESYS_LOOP all contexts take turns this way.
+ */
+
+/** Marks a shard without a command in flight. */
+#define TR_BULK_IDLE ((size_t) -1)
+
+/** The state of one bulk resolution. */
+typedef struct {
+    ESYS_CONTEXT *esys_context;  /**< The context receiving the ESYS_TRs. */
+    const TPM2_HANDLE *tpm_handles; /**< The handles to resolve. */
+    ESYS_TR *objects;            /**< The ESYS_TRs of the handles. */
+    size_t count;                /**< Number of handles. */
+    size_t next;                 /**< The next handle to resolve. */
+    TSS2_RC rc;                  /**< The first error. */
+    ESYS_LOOP *loop;             /**< The event loop of the polled shards, or
+                                      NULL. */
+} TR_BULK;
+
+/** A context resolving handles of a bulk resolution. */
+typedef struct {
+    TR_BULK *bulk;               /**< The bulk resolution. */
+    ESYS_CONTEXT *esys_context;  /**< The context sending the commands. */
+    size_t index;                /**< The handle in flight, or TR_BULK_IDLE. */
+    ESYS_TR object;              /**< The ESYS_TR of the handle in flight in
+                                      esys_context. */
+    bool polled;                 /**< The shard is driven by the loop. */
+    int32_t timeout;             /**< The timeout of esys_context to restore
+                                      after blocking _Finish calls. */
+} TR_BULK_SHARD;
+
+/** Check whether a TPM handle can be resolved in bulk. */
+static bool
+tr_bulk_handle_valid(TPM2_HANDLE tpm_handle)
+{
+    return (tpm_handle >> TPM2_HR_SHIFT) == TPM2_HT_NV_INDEX ||
+           (tpm_handle >> TPM2_HR_SHIFT) == TPM2_HT_PERSISTENT;
+}
+
+/** Check whether the TCTI of a context has poll handles. */
+static bool
+tr_bulk_pollable(ESYS_CONTEXT *esys_context)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti_context;
+    size_t count;
+
+    r = Tss2_Sys_GetTctiContext(esys_context->sys, &tcti_context);
+    if (r != TSS2_RC_SUCCESS)
+        return false;
+    r = Tss2_Tcti_GetPollHandles(tcti_context, NULL, &count);
+    return r == TSS2_RC_SUCCESS;
+}
+
+static void tr_bulk_done(ESYS_CONTEXT *esys_context, TSS2_RC rc,
+                         void *userdata);
+
+/** Record the first error of a bulk resolution. */
+static void
+tr_bulk_fail(TR_BULK *bulk, TSS2_RC r)
+{
+    if (bulk->rc == TSS2_RC_SUCCESS)
+        bulk->rc = r;
+}
+
+/** Send the read of the next public area on a shard.
+ *
+ * The shard stays idle once all handles are sent or an error occurred.
+ */
+static void
+tr_bulk_start(TR_BULK_SHARD *shard)
+{
+    TSS2_RC r;
+    TR_BULK *bulk = shard->bulk;
+    RSRC_NODE_T *node;
+    TPM2_HANDLE tpm_handle;
+
+    shard->index = TR_BULK_IDLE;
+    if (bulk->rc != TSS2_RC_SUCCESS || bulk->next >= bulk->count)
+        return;
+    shard->index = bulk->next++;
+    tpm_handle = bulk->tpm_handles[shard->index];
+
+    /* Shards refer to the handle through an ESYS_TR of their own */
+    if (shard->esys_context == bulk->esys_context) {
+        shard->object = bulk->objects[shard->index];
+    } else {
+        shard->object = shard->esys_context->esys_handle_cnt++;
+        r = esys_CreateResourceObject(shard->esys_context, shard->object,
+                                      &node);
+        if (r != TSS2_RC_SUCCESS) {
+            tr_bulk_fail(bulk, r);
+            shard->index = TR_BULK_IDLE;
+            return;
+        }
+        node->rsrc.handle = tpm_handle;
+    }
+
+    if ((tpm_handle >> TPM2_HR_SHIFT) == TPM2_HT_NV_INDEX)
+        r = Esys_NV_ReadPublic_Async(shard->esys_context, shard->object,
+                                     ESYS_TR_NONE, ESYS_TR_NONE,
+                                     ESYS_TR_NONE);
+    else
+        r = Esys_ReadPublic_Async(shard->esys_context, shard->object,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE);
+    if (r == TSS2_RC_SUCCESS && shard->polled)
+        r = Esys_Loop_Add(bulk->loop, shard->esys_context, -1, tr_bulk_done,
+                          shard);
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_ERROR("Read public area of 0x%08" PRIx32, tpm_handle);
+        tr_bulk_fail(bulk, r);
+        if (shard->esys_context != bulk->esys_context)
+            Esys_TR_Close(shard->esys_context, &shard->object);
+        shard->index = TR_BULK_IDLE;
+    }
+}
+
+/** Receive a public area, verify its name and store it.
+ *
+ * Completion callback of the polled shards, called directly with a blocking
+ * timeout for the others; starts the next handle of the shard.
+ */
+static void
+tr_bulk_done(ESYS_CONTEXT *esys_context, TSS2_RC rc, void *userdata)
+{
+    TSS2_RC r = rc;
+    TR_BULK_SHARD *shard = userdata;
+    TR_BULK *bulk = shard->bulk;
+    RSRC_NODE_T *node;
+    TPM2_HANDLE tpm_handle = bulk->tpm_handles[shard->index];
+    TPM2B_NAME *name = NULL;
+    TPM2B_NAME computed;
+    TPM2B_PUBLIC *public = NULL;
+    TPM2B_NV_PUBLIC *nv_public = NULL;
+
+    if (r == TSS2_RC_SUCCESS) {
+        if ((tpm_handle >> TPM2_HR_SHIFT) == TPM2_HT_NV_INDEX)
+            r = Esys_NV_ReadPublic_Finish(esys_context, &nv_public, &name);
+        else
+            r = Esys_ReadPublic_Finish(esys_context, &public, &name, NULL);
+        if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN)
+            return;
+    }
+    if (shard->esys_context != bulk->esys_context)
+        Esys_TR_Close(shard->esys_context, &shard->object);
+    goto_if_error(r, "Read public area", error_cleanup);
+
+    /* The name has to match the public area */
+    if (nv_public != NULL)
+        r = iesys_nv_get_name(nv_public, &computed);
+    else
+        r = iesys_get_name(public, &computed);
+    goto_if_error(r, "Compute name", error_cleanup);
+    if (computed.size != name->size ||
+        memcmp(&computed.name[0], &name->name[0], name->size) != 0) {
+        goto_error(r, TSS2_ESYS_RC_MALFORMED_RESPONSE,
+                   "Name does not match the public area", error_cleanup);
+    }
+
+    r = esys_GetResourceObject(bulk->esys_context,
+                               bulk->objects[shard->index], &node);
+    goto_if_error(r, "Get resource object", error_cleanup);
+    node->rsrc.name = *name;
+    if (nv_public != NULL) {
+        node->rsrc.rsrcType = IESYSC_NV_RSRC;
+        node->rsrc.misc.rsrc_nv_pub = *nv_public;
+    } else {
+        node->rsrc.rsrcType = IESYSC_KEY_RSRC;
+        node->rsrc.misc.rsrc_key_pub = *public;
+    }
+
+error_cleanup:
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_ERROR("Resolve 0x%08" PRIx32, tpm_handle);
+        tr_bulk_fail(bulk, r);
+    }
+    IESYS_OUTPUT_FREE(esys_context, nv_public);
+    IESYS_OUTPUT_FREE(esys_context, public);
+    IESYS_OUTPUT_FREE(esys_context, name);
+    tr_bulk_start(shard);
+}
+
+/** Create the ESYS_TRs of many persistent objects and NV indices.
+ *
+ * Does the work of Esys_TR_FromTPMPublic without sessions for every handle
+ * of tpmHandles. The public areas are read through esysContext and the shard
+ * contexts concurrently, see above, and the name reported by the TPM for
+ * every handle is checked against the name computed from its public area.
+ * Shards can be further connections to the same TPM, e.g. from an ESYS_POOL;
+ * they must not have a command in flight and keep no ESYS_TRs of the
+ * resolution. Only shards whose TCTI has poll handles run concurrently with
+ * the others; esysContext and shards without poll handles receive blocking.
+ * Without shards the commands are sent one after the other.
+ * Either all ESYS_TRs are created or none.
+ * @param[in,out] esysContext The ESYS_CONTEXT receiving the ESYS_TRs.
+ * @param[in,out] shards Further contexts reading public areas, or NULL.
+ * @param[in] shardCount The number of shards.
+ * @param[in] tpmHandles The handles of persistent objects and NV indices.
+ * @param[in] count The number of handles.
+ * @param[out] objects The ESYS_TRs of the handles. (caller-allocated, count
+ *             entries)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext, tpmHandles, objects or
+ *         a shard is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if a handle is neither a persistent object
+ *         nor an NV index or esysContext is one of the shards.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a context has a command in flight.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if a name reported by the TPM does
+ *         not match the public area.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_RCs produced by the TPM or lower layers of the software stack.
+ */
+TSS2_RC
+Esys_TR_FromTPMPublicList(
+    ESYS_CONTEXT *esysContext,
+    ESYS_CONTEXT *const *shards,
+    size_t shardCount,
+    const TPM2_HANDLE *tpmHandles,
+    size_t count,
+    ESYS_TR *objects)
+{
+    TSS2_RC r;
+    TR_BULK bulk = { .esys_context = esysContext, .tpm_handles = tpmHandles,
+                     .objects = objects, .count = count };
+    TR_BULK_SHARD *shard = NULL;
+    RSRC_NODE_T *node;
+    size_t i, created = 0;
+    bool blocking = true;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(tpmHandles);
+    _ESYS_ASSERT_NON_NULL(objects);
+    if (shardCount > 0) {
+        _ESYS_ASSERT_NON_NULL(shards);
+    }
+
+    if (esysContext->state != _ESYS_STATE_INIT) {
+        LOG_ERROR("Esys called in bad sequence.");
+        return TSS2_ESYS_RC_BAD_SEQUENCE;
+    }
+    for (i = 0; i < shardCount; i++) {
+        _ESYS_ASSERT_NON_NULL(shards[i]);
+        if (shards[i] == esysContext) {
+            LOG_ERROR("The context is a shard of itself.");
+            return TSS2_ESYS_RC_BAD_VALUE;
+        }
+        if (shards[i]->state != _ESYS_STATE_INIT) {
+            LOG_ERROR("Esys called in bad sequence.");
+            return TSS2_ESYS_RC_BAD_SEQUENCE;
+        }
+    }
+    for (i = 0; i < count; i++) {
+        if (!tr_bulk_handle_valid(tpmHandles[i])) {
+            LOG_ERROR("Bad handle 0x%08" PRIx32, tpmHandles[i]);
+            return TSS2_ESYS_RC_BAD_VALUE;
+        }
+        objects[i] = ESYS_TR_NONE;
+    }
+    if (count == 0)
+        return TSS2_RC_SUCCESS;
+
+    /* The ESYS_TRs are handed out in the order of the handles */
+    for (created = 0; created < count; created++) {
+        objects[created] = esysContext->esys_handle_cnt++;
+        r = esys_CreateResourceObject(esysContext, objects[created], &node);
+        goto_if_error(r, "Create resource object", error_cleanup);
+        node->rsrc.handle = tpmHandles[created];
+    }
+
+    shard = calloc(shardCount + 1, sizeof(TR_BULK_SHARD));
+    goto_if_null(shard, "Out of memory.", TSS2_ESYS_RC_MEMORY, error_cleanup);
+    for (i = 0; i <= shardCount; i++) {
+        shard[i].bulk = &bulk;
+        shard[i].esys_context = (i == 0) ? esysContext : shards[i - 1];
+        shard[i].index = TR_BULK_IDLE;
+        shard[i].timeout = shard[i].esys_context->timeout;
+    }
+
+    r = Esys_Loop_Initialize(&bulk.loop);
+    if (r == TSS2_ESYS_RC_NOT_IMPLEMENTED) {
+        LOG_DEBUG("No event loop, receiving blocking on all contexts.");
+    } else if (r != TSS2_RC_SUCCESS) {
+        tr_bulk_fail(&bulk, r);
+        blocking = false;
+    }
+
+    for (i = 0; i <= shardCount && bulk.rc == TSS2_RC_SUCCESS; i++) {
+        shard[i].polled = bulk.loop != NULL && i > 0 &&
+                          tr_bulk_pollable(shard[i].esys_context);
+        if (!shard[i].polled)
+            shard[i].esys_context->timeout = TSS2_TCTI_TIMEOUT_BLOCK;
+        tr_bulk_start(&shard[i]);
+    }
+
+    /* The blocking contexts take turns until all of them are idle, the loop
+       dispatches the polled shards in between and then until they are done */
+    while (blocking) {
+        blocking = false;
+        for (i = 0; i <= shardCount; i++) {
+            if (shard[i].polled || shard[i].index == TR_BULK_IDLE)
+                continue;
+            tr_bulk_done(shard[i].esys_context, TSS2_RC_SUCCESS, &shard[i]);
+            blocking = true;
+        }
+        if (bulk.loop != NULL) {
+            r = Esys_Loop_Run(bulk.loop, blocking ? 0 : -1);
+            if (r != TSS2_RC_SUCCESS && r != TSS2_ESYS_RC_TRY_AGAIN)
+                tr_bulk_fail(&bulk, r);
+        }
+    }
+
+    for (i = 0; i <= shardCount; i++)
+        shard[i].esys_context->timeout = shard[i].timeout;
+    Esys_Loop_Finalize(&bulk.loop);
+    free(shard);
+    r = bulk.rc;
+    goto_if_error(r, "Bulk resolution", error_cleanup);
+
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    for (i = 0; i < created; i++)
+        Esys_TR_Close(esysContext, &objects[i]);
+    return r;
+}
+
+/** Create the ESYS_TRs of a range of persistent objects or NV indices.
+ *
+ * Enumerates the handles of the TPM from firstHandle on with
+ * TPM2_GetCapability(TPM2_CAP_HANDLES), up to maxCount handles of the same
+ * type, and resolves them with Esys_TR_FromTPMPublicList.
+ * @param[in,out] esysContext The ESYS_CONTEXT receiving the ESYS_TRs.
+ * @param[in,out] shards Further contexts reading public areas, or NULL.
+ * @param[in] shardCount The number of shards.
+ * @param[in] firstHandle The first handle of the range, e.g.
+ *            TPM2_PERSISTENT_FIRST or TPM2_NV_INDEX_FIRST.
+ * @param[in] maxCount The maximum number of handles.
+ * @param[out] objects The ESYS_TRs of the handles. (callee-allocated, use
+ *             free())
+ * @param[out] count The number of ESYS_TRs.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext, objects, count or a
+ *         shard is NULL.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if firstHandle is neither a persistent
+ *         object nor an NV index handle.
+ * @retval TSS2_ESYS_RC_MEMORY if memory cannot be allocated.
+ * @retval TSS2_RCs produced by Esys_GetCapability or
+ *         Esys_TR_FromTPMPublicList.
+ */
+TSS2_RC
+Esys_TR_FromTPMHandleRange(
+    ESYS_CONTEXT *esysContext,
+    ESYS_CONTEXT *const *shards,
+    size_t shardCount,
+    TPM2_HANDLE firstHandle,
+    UINT32 maxCount,
+    ESYS_TR **objects,
+    size_t *count)
+{
+    TSS2_RC r;
+    TPMS_CAPABILITY_DATA *capability_data = NULL;
+    TPMI_YES_NO more_data = TPM2_YES;
+    TPM2_HANDLE *tpm_handles = NULL, *tmp, property = firstHandle;
+    TPML_HANDLE *handles;
+    size_t n = 0;
+
+    _ESYS_ASSERT_NON_NULL(objects);
+    *objects = NULL;
+    _ESYS_ASSERT_NON_NULL(count);
+    *count = 0;
+    _ESYS_ASSERT_NON_NULL(esysContext);
+
+    if (!tr_bulk_handle_valid(firstHandle)) {
+        LOG_ERROR("Bad handle 0x%08" PRIx32, firstHandle);
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+
+    while (more_data == TPM2_YES && n < maxCount) {
+        r = Esys_GetCapability(esysContext,
+                               ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                               TPM2_CAP_HANDLES, property,
+                               maxCount - (UINT32) n, &more_data,
+                               &capability_data);
+        goto_if_error(r, "Get handles.", error_cleanup);
+
+        handles = &capability_data->data.handles;
+        if (handles->count > maxCount - n)
+            handles->count = (UINT32) (maxCount - n);
+        if (handles->count == 0) {
+            IESYS_OUTPUT_FREE(esysContext, capability_data);
+            break;
+        }
+        tmp = realloc(tpm_handles, (n + handles->count) * sizeof(TPM2_HANDLE));
+        if (tmp == NULL) {
+            IESYS_OUTPUT_FREE(esysContext, capability_data);
+            goto_error(r, TSS2_ESYS_RC_MEMORY, "Out of memory.",
+                       error_cleanup);
+        }
+        tpm_handles = tmp;
+        memcpy(&tpm_handles[n], &handles->handle[0],
+               handles->count * sizeof(TPM2_HANDLE));
+        n += handles->count;
+        property = handles->handle[handles->count - 1] + 1;
+        IESYS_OUTPUT_FREE(esysContext, capability_data);
+    }
+    if (n == 0)
+        return TSS2_RC_SUCCESS;
+
+    *objects = calloc(n, sizeof(ESYS_TR));
+    goto_if_null(*objects, "Out of memory.", TSS2_ESYS_RC_MEMORY,
+                 error_cleanup);
+    r = Esys_TR_FromTPMPublicList(esysContext, shards, shardCount,
+                                  tpm_handles, n, *objects);
+    goto_if_error(r, "Resolve handles.", error_cleanup);
+
+    free(tpm_handles);
+    *count = n;
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    free(tpm_handles);
+    SAFE_FREE(*objects);
+    return r;
+}
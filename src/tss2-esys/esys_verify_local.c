@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#include "esys_crypto.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** Check a signature against the key and the digest like the TPM does.
+ *
+ * TPM2_VerifySignature rejects signatures whose scheme or hash differs from
+ * the scheme of the key, unless the key has none, and digests whose size
+ * differs from the size of the hash of the signature.
+ * @param[in] key The public area of the key.
+ * @param[in] digest Digest of the signed message.
+ * @param[in] signature Signature to be tested.
+ * @retval TSS2_RC_SUCCESS if the signature may be verified.
+ * @retval TPM2_RC_SCHEME + TPM2_RC_P + TPM2_RC_2 if the scheme or hash of
+ *         the signature does not match the scheme of the key.
+ * @retval TPM2_RC_SIZE + TPM2_RC_P + TPM2_RC_1 if the size of the digest
+ *         does not match the hash of the signature.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if the hash is not supported.
+ */
+static TSS2_RC
+check_signature_scheme(const TPMT_PUBLIC *key, const TPM2B_DIGEST *digest,
+                       const TPMT_SIGNATURE *signature)
+{
+    TSS2_RC r;
+    TPM2_ALG_ID scheme = TPM2_ALG_NULL, hash_alg = TPM2_ALG_NULL;
+    size_t size;
+
+    if (key->type == TPM2_ALG_RSA) {
+        scheme = key->parameters.rsaDetail.scheme.scheme;
+        hash_alg = key->parameters.rsaDetail.scheme.details.anySig.hashAlg;
+    } else if (key->type == TPM2_ALG_ECC) {
+        scheme = key->parameters.eccDetail.scheme.scheme;
+        hash_alg = key->parameters.eccDetail.scheme.details.anySig.hashAlg;
+    }
+
+    if (scheme != TPM2_ALG_NULL &&
+        (scheme != signature->sigAlg ||
+         hash_alg != signature->signature.any.hashAlg)) {
+        LOG_WARNING("Signature scheme 0x%04" PRIx16 " does not match key "
+                    "scheme 0x%04" PRIx16 ".", signature->sigAlg, scheme);
+        return TPM2_RC_SCHEME + TPM2_RC_P + TPM2_RC_2;
+    }
+
+    r = iesys_crypto_hash_get_digest_size(signature->signature.any.hashAlg,
+                                          &size);
+    if (r != TSS2_RC_SUCCESS)
+        return TSS2_ESYS_RC_NOT_IMPLEMENTED;
+    if (digest->size != size) {
+        LOG_WARNING("Digest size %" PRIu16 " does not match the hash of the "
+                    "signature.", digest->size);
+        return TPM2_RC_SIZE + TPM2_RC_P + TPM2_RC_1;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Verify a signature, preferably without the TPM.
+ *
+ * If ESYS knows the public area of keyHandle and the crypto backend supports
+ * the signature scheme, the signature is verified in software. The TPM is
+ * only used if a validation ticket is requested, after the signature has
+ * been verified locally, or if local verification is not possible.
+ * A signature that is invalid results in the same response code that
+ * TPM2_VerifySignature returns.
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  keyHandle Handle of public key that will be used in the
+ *             validation.
+ * @param[in]  shandle1 First session handle for the TPM command.
+ * @param[in]  shandle2 Second session handle for the TPM command.
+ * @param[in]  shandle3 Third session handle for the TPM command.
+ * @param[in]  digest Digest of the signed message.
+ * @param[in]  signature Signature to be tested.
+ * @param[out] validation The validation ticket. If NULL, no ticket is
+ *             created. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS if the signature is valid.
+ * @retval TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2 if the signature is
+ *         invalid.
+ * @retval TPM2_RC_SCHEME + TPM2_RC_P + TPM2_RC_2 if the scheme or hash of
+ *         the signature does not match the scheme of the key.
+ * @retval TPM2_RC_SIZE + TPM2_RC_P + TPM2_RC_1 if the size of digest does
+ *         not match the hash of the signature.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext, digest or signature
+ *         is NULL.
+ * @retval TSS2_ESYS_RC_BAD_TR if keyHandle is unknown.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_VerifySignatureLocal(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR keyHandle,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    const TPM2B_DIGEST *digest,
+    const TPMT_SIGNATURE *signature,
+    TPMT_TK_VERIFIED **validation)
+{
+    TSS2_RC r;
+    RSRC_NODE_T *keyNode;
+    TPMT_TK_VERIFIED *ticket = NULL;
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(digest);
+    _ESYS_ASSERT_NON_NULL(signature);
+
+    r = esys_GetResourceObject(esysContext, keyHandle, &keyNode);
+    return_if_error(r, "keyHandle unknown.");
+
+    if (keyNode == NULL || keyNode->rsrc.rsrcType != IESYSC_KEY_RSRC ||
+        !(keyNode->rsrc.misc.rsrc_key_pub.publicArea.objectAttributes &
+          TPMA_OBJECT_SIGN_ENCRYPT)) {
+        LOG_DEBUG("No public signing key known for keyHandle.");
+        goto tpm_verify;
+    }
+
+    r = check_signature_scheme(&keyNode->rsrc.misc.rsrc_key_pub.publicArea,
+                               digest, signature);
+    if (r == TSS2_RC_SUCCESS)
+        r = iesys_crypto_verify_signature(&keyNode->rsrc.misc.rsrc_key_pub,
+                                          digest, signature);
+    if (r == TSS2_ESYS_RC_NOT_IMPLEMENTED)
+        goto tpm_verify;
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_WARNING("Signature verification failed: 0x%08" PRIx32, r);
+        return r;
+    }
+    if (validation == NULL)
+        return TSS2_RC_SUCCESS;
+
+tpm_verify:
+    r = Esys_VerifySignature(esysContext, keyHandle, shandle1, shandle2,
+                             shandle3, digest, signature,
+                             (validation != NULL) ? validation : &ticket);
+    IESYS_OUTPUT_FREE(esysContext, ticket);
+    return r;
+}
@@ -68,15 +68,15 @@ TSS2_RC Tss2_Sys_AC_GetCapability_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_UINT8_Unmarshal(ctx->cmdBuffer,
-                                   ctx->maxCmdSize,
+    rval = Tss2_MU_UINT8_Unmarshal(ctx->rspBuffer,
+                                   ctx->maxRspSize,
                                    &ctx->nextData,
                                    moreData);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPML_AC_CAPABILITIES_Unmarshal(ctx->cmdBuffer,
-                                                  ctx->maxCmdSize,
+    return Tss2_MU_TPML_AC_CAPABILITIES_Unmarshal(ctx->rspBuffer,
+                                                  ctx->maxRspSize,
                                                   &ctx->nextData,
                                                   capabilityData);
 }
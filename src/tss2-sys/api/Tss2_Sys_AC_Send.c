@@ -83,8 +83,8 @@ TSS2_RC Tss2_Sys_AC_Send_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMS_AC_OUTPUT_Unmarshal(ctx->cmdBuffer,
-                                            ctx->maxCmdSize,
+    return Tss2_MU_TPMS_AC_OUTPUT_Unmarshal(ctx->rspBuffer,
+                                            ctx->maxRspSize,
                                             &ctx->nextData,
                                             acDataOut);
 }
@@ -95,8 +95,8 @@ TSS2_RC Tss2_Sys_ActivateCredential_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData,
                                           certInfo);
 }
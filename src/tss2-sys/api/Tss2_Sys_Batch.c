@@ -0,0 +1,266 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************;
+ * Copyright (c) 2019, Intel Corporation
+ * All rights reserved.
+ ***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "tss2_tpm2_types.h"
+#include "tss2_mu.h"
+#include "sysapi_util.h"
+#include "util/tss2_endian.h"
+#define LOGMODULE sys
+#include "util/log.h"
+
+/*
+ * A batch runs a list of prepared commands back to back through the TCTI
+ * of the batch context. Each command gets its own response buffer in the
+ * batch context, so the responses can be completed afterwards, in any
+ * order, by loading them into a regular SAPI context with
+ * Tss2_Sys_Batch_GetResponse and calling the matching *_Complete function.
+ * Execution stops at the first command that fails.
+ */
+
+size_t Tss2_Sys_Batch_GetContextSize(
+    size_t maxCommands,
+    size_t maxResponseSize)
+{
+    if (maxResponseSize == 0)
+        maxResponseSize = TPM2_MAX_COMMAND_SIZE;
+    else if (maxResponseSize < sizeof(TPM20_Header_Out))
+        maxResponseSize = sizeof(TPM20_Header_Out);
+
+    return sizeof(_TSS2_SYS_BATCH_CONTEXT_BLOB) +
+           maxCommands * (sizeof(_TSS2_SYS_BATCH_ENTRY) + maxResponseSize);
+}
+
+TSS2_RC Tss2_Sys_Batch_Initialize(
+    TSS2_SYS_BATCH_CONTEXT *batchContext,
+    size_t contextSize,
+    size_t maxCommands,
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    _TSS2_SYS_BATCH_CONTEXT_BLOB *ctx = batchcontext_cast(batchContext);
+    size_t rspSize;
+
+    if (!ctx || !tctiContext)
+        return TSS2_SYS_RC_BAD_REFERENCE;
+
+    if (maxCommands == 0)
+        return TSS2_SYS_RC_BAD_VALUE;
+
+    if (contextSize < Tss2_Sys_Batch_GetContextSize(maxCommands, 1))
+        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
+
+    if (!TSS2_TCTI_TRANSMIT (tctiContext) ||
+        !TSS2_TCTI_RECEIVE (tctiContext))
+        return TSS2_SYS_RC_BAD_TCTI_STRUCTURE;
+
+    rspSize = (contextSize - sizeof(_TSS2_SYS_BATCH_CONTEXT_BLOB)) /
+              maxCommands - sizeof(_TSS2_SYS_BATCH_ENTRY);
+    if (rspSize > UINT32_MAX)
+        rspSize = UINT32_MAX;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->tctiContext = tctiContext;
+    ctx->maxCommands = maxCommands;
+    ctx->maxRspSize = rspSize;
+    ctx->entries = (_TSS2_SYS_BATCH_ENTRY *)((UINT8 *)ctx +
+                   sizeof(_TSS2_SYS_BATCH_CONTEXT_BLOB));
+    ctx->rspBuffers = (UINT8 *)(ctx->entries + maxCommands);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Sys_Batch_Add(
+    TSS2_SYS_BATCH_CONTEXT *batchContext,
+    const TSS2_SYS_PREPARED_COMMAND *preparedCommand)
+{
+    _TSS2_SYS_BATCH_CONTEXT_BLOB *ctx = batchcontext_cast(batchContext);
+    _TSS2_SYS_BATCH_ENTRY *entry;
+
+    if (!ctx || !preparedCommand)
+        return TSS2_SYS_RC_BAD_REFERENCE;
+
+    if (ctx->numCommands >= ctx->maxCommands)
+        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
+
+    entry = &ctx->entries[ctx->numCommands++];
+    entry->command = preparedCommand;
+    entry->responseSize = 0;
+    entry->rc = TSS2_RC_SUCCESS;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+batch_execute_one(
+    _TSS2_SYS_BATCH_CONTEXT_BLOB *ctx,
+    _TSS2_SYS_BATCH_ENTRY *entry,
+    UINT8 *rspBuffer)
+{
+    _TSS2_SYS_PREPARED_COMMAND_BLOB *cmd =
+        prepared_command_cast((TSS2_SYS_PREPARED_COMMAND *)entry->command);
+    TPM20_Header_Out hdr;
+    size_t responseSize = 0;
+    size_t offset = 0;
+    TSS2_RC rval;
+
+    entry->responseSize = 0;
+
+    rval = Tss2_Tcti_Transmit(ctx->tctiContext, cmd->commandSize,
+                              prepared_command_buffer(cmd));
+    if (rval)
+        return rval;
+
+#ifdef TCTI_PARTIAL_READ
+    rval = Tss2_Tcti_Receive(ctx->tctiContext, &responseSize,
+                             NULL, TSS2_TCTI_TIMEOUT_BLOCK);
+    if (rval)
+        return rval;
+
+    if (responseSize < sizeof(TPM20_Header_Out))
+        return TSS2_SYS_RC_INSUFFICIENT_RESPONSE;
+    if (responseSize > ctx->maxRspSize)
+        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
+#else
+    responseSize = ctx->maxRspSize;
+#endif
+
+    rval = Tss2_Tcti_Receive(ctx->tctiContext, &responseSize,
+                             rspBuffer, TSS2_TCTI_TIMEOUT_BLOCK);
+    if (rval == TSS2_TCTI_RC_INSUFFICIENT_BUFFER)
+        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
+    if (rval)
+        return rval;
+
+    rval = Tss2_MU_TPM2_ST_Unmarshal(rspBuffer, responseSize,
+                                     &offset, &hdr.tag);
+    if (rval)
+        return TSS2_SYS_RC_INSUFFICIENT_RESPONSE;
+
+    if (hdr.tag != TPM2_ST_SESSIONS && hdr.tag != TPM2_ST_NO_SESSIONS) {
+        LOG_ERROR("Malformed reponse: Invalid tag in response header: %" PRIx16,
+                  hdr.tag);
+        return TSS2_SYS_RC_MALFORMED_RESPONSE;
+    }
+
+    rval = Tss2_MU_UINT32_Unmarshal(rspBuffer, responseSize,
+                                    &offset, &hdr.responseSize);
+    if (rval)
+        return TSS2_SYS_RC_INSUFFICIENT_RESPONSE;
+
+    rval = Tss2_MU_UINT32_Unmarshal(rspBuffer, responseSize,
+                                    &offset, &hdr.responseCode);
+    if (rval)
+        return TSS2_SYS_RC_INSUFFICIENT_RESPONSE;
+
+    if (hdr.responseSize > responseSize)
+        return TSS2_SYS_RC_MALFORMED_RESPONSE;
+
+    if (hdr.responseSize < sizeof(TPM20_Header_Out))
+        return TSS2_SYS_RC_INSUFFICIENT_RESPONSE;
+
+    entry->responseSize = hdr.responseSize;
+    return hdr.responseCode;
+}
+
+/*
+ * Execute the commands of the batch that have not been executed
+ * successfully yet. On failure, numExecuted is the index of the failed
+ * command; calling this function again resumes with that command.
+ */
+TSS2_RC Tss2_Sys_Batch_Execute(
+    TSS2_SYS_BATCH_CONTEXT *batchContext,
+    size_t *numExecuted)
+{
+    _TSS2_SYS_BATCH_CONTEXT_BLOB *ctx = batchcontext_cast(batchContext);
+    _TSS2_SYS_BATCH_ENTRY *entry;
+    TSS2_RC rval = TSS2_RC_SUCCESS;
+
+    if (!ctx)
+        return TSS2_SYS_RC_BAD_REFERENCE;
+
+    while (ctx->numExecuted < ctx->numCommands) {
+        entry = &ctx->entries[ctx->numExecuted];
+        rval = batch_execute_one(ctx, entry, ctx->rspBuffers +
+                                 (size_t)ctx->numExecuted * ctx->maxRspSize);
+        entry->rc = rval;
+        if (rval) {
+            LOG_DEBUG("Batch command %" PRIu32 " failed: 0x%" PRIx32,
+                      ctx->numExecuted, rval);
+            break;
+        }
+        ctx->numExecuted++;
+    }
+
+    if (numExecuted)
+        *numExecuted = ctx->numExecuted;
+
+    return rval;
+}
+
+/*
+ * Load the response of a batch command into a SAPI context, so that it
+ * can be processed by the *_Complete function of the command. If the TPM
+ * returned an error for the command, the context is left in the prepare
+ * stage with the command loaded and the error is returned.
+ */
+TSS2_RC Tss2_Sys_Batch_GetResponse(
+    TSS2_SYS_BATCH_CONTEXT *batchContext,
+    size_t index,
+    TSS2_SYS_CONTEXT *sysContext)
+{
+    _TSS2_SYS_BATCH_CONTEXT_BLOB *ctx = batchcontext_cast(batchContext);
+    _TSS2_SYS_CONTEXT_BLOB *sys = syscontext_cast(sysContext);
+    _TSS2_SYS_BATCH_ENTRY *entry;
+    TSS2_RC rval;
+
+    if (!ctx || !sys)
+        return TSS2_SYS_RC_BAD_REFERENCE;
+
+    if (index >= ctx->numCommands)
+        return TSS2_SYS_RC_BAD_VALUE;
+
+    entry = &ctx->entries[index];
+    if (entry->responseSize == 0)
+        return TSS2_SYS_RC_BAD_SEQUENCE;
+
+    if (entry->responseSize > sys->maxRspSize)
+        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
+
+    rval = Tss2_Sys_PreparedCommand_Load(sysContext, entry->command);
+    if (rval)
+        return rval;
+
+    if (entry->rc)
+        return entry->rc;
+
+    memcpy(sys->rspBuffer, ctx->rspBuffers + index * ctx->maxRspSize,
+           entry->responseSize);
+    sys->rsp_header.tag = BE_TO_HOST_16(resp_header_from_cxt(sys)->tag);
+    sys->rsp_header.responseSize = entry->responseSize;
+    sys->rsp_header.responseCode = TSS2_RC_SUCCESS;
+    sys->nextData = sizeof(TPM20_Header_Out);
+    sys->previousStage = CMD_STAGE_RECEIVE_RESPONSE;
+
+    return TSS2_RC_SUCCESS;
+}
+
+void Tss2_Sys_Batch_Reset(
+    TSS2_SYS_BATCH_CONTEXT *batchContext)
+{
+    _TSS2_SYS_BATCH_CONTEXT_BLOB *ctx = batchcontext_cast(batchContext);
+
+    if (!ctx)
+        return;
+
+    ctx->numCommands = 0;
+    ctx->numExecuted = 0;
+}
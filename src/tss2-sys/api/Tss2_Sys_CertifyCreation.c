@@ -99,15 +99,15 @@ TSS2_RC Tss2_Sys_CertifyCreation_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_ATTEST_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_ATTEST_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData,
                                           certifyInfo);
     if (rval)
         return rval;
 
-    return rval = Tss2_MU_TPMT_SIGNATURE_Unmarshal(ctx->cmdBuffer,
-                                                   ctx->maxCmdSize,
+    return rval = Tss2_MU_TPMT_SIGNATURE_Unmarshal(ctx->rspBuffer,
+                                                   ctx->maxRspSize,
                                                    &ctx->nextData,
                                                    signature);
 }
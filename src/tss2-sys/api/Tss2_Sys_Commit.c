@@ -104,26 +104,26 @@ TSS2_RC Tss2_Sys_Commit_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData, K);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData, L);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData, E);
     if (rval)
         return rval;
 
-    return Tss2_MU_UINT16_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    return Tss2_MU_UINT16_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData, counter);
 }
 
@@ -49,8 +49,8 @@ TSS2_RC Tss2_Sys_ContextLoad_Complete(
     if (!ctx)
         return TSS2_SYS_RC_BAD_REFERENCE;
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData,
                                     loadedHandle);
     if (rval)
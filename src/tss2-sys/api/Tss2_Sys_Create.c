@@ -124,36 +124,36 @@ TSS2_RC Tss2_Sys_Create_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->cmdBuffer,
-                                           ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->rspBuffer,
+                                           ctx->maxRspSize,
                                            &ctx->nextData,
                                            outPrivate);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_PUBLIC_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_PUBLIC_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData,
                                           outPublic);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_CREATION_DATA_Unmarshal(ctx->cmdBuffer,
-                                                 ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_CREATION_DATA_Unmarshal(ctx->rspBuffer,
+                                                 ctx->maxRspSize,
                                                  &ctx->nextData,
                                                  creationData);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData,
                                           creationHash);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMT_TK_CREATION_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    return Tss2_MU_TPMT_TK_CREATION_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData,
                                           creationTicket);
 }
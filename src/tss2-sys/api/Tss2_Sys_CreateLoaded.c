@@ -80,8 +80,8 @@ TSS2_RC Tss2_Sys_CreateLoaded_Complete(
     if (!ctx)
         return TSS2_SYS_RC_BAD_REFERENCE;
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData, objectHandle);
     if (rval)
         return rval;
@@ -90,20 +90,20 @@ TSS2_RC Tss2_Sys_CreateLoaded_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->cmdBuffer,
-                                           ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->rspBuffer,
+                                           ctx->maxRspSize,
                                            &ctx->nextData, outPrivate);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_PUBLIC_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_PUBLIC_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData, outPublic);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_NAME_Unmarshal(ctx->cmdBuffer,
-                                        ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_NAME_Unmarshal(ctx->rspBuffer,
+                                        ctx->maxRspSize,
                                         &ctx->nextData, name);
     return rval;
 }
@@ -119,8 +119,8 @@ TSS2_RC Tss2_Sys_CreatePrimary_Complete(
     if (!ctx)
         return TSS2_SYS_RC_BAD_REFERENCE;
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData, objectHandle);
     if (rval)
         return rval;
@@ -129,35 +129,35 @@ TSS2_RC Tss2_Sys_CreatePrimary_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_PUBLIC_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_PUBLIC_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData, outPublic);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_CREATION_DATA_Unmarshal(ctx->cmdBuffer,
-                                                 ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_CREATION_DATA_Unmarshal(ctx->rspBuffer,
+                                                 ctx->maxRspSize,
                                                  &ctx->nextData,
                                                  creationData);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData,
                                           creationHash);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPMT_TK_CREATION_Unmarshal(ctx->cmdBuffer,
-                                              ctx->maxCmdSize,
+    rval = Tss2_MU_TPMT_TK_CREATION_Unmarshal(ctx->rspBuffer,
+                                              ctx->maxRspSize,
                                               &ctx->nextData,
                                               creationTicket);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_NAME_Unmarshal(ctx->cmdBuffer,
-                                        ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_NAME_Unmarshal(ctx->rspBuffer,
+                                        ctx->maxRspSize,
                                         &ctx->nextData, name);
     return rval;
 }
@@ -87,22 +87,22 @@ TSS2_RC Tss2_Sys_Duplicate_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_DATA_Unmarshal(ctx->cmdBuffer,
-                                        ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_DATA_Unmarshal(ctx->rspBuffer,
+                                        ctx->maxRspSize,
                                         &ctx->nextData,
                                         encryptionKeyOut);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->cmdBuffer,
-                                           ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->rspBuffer,
+                                           ctx->maxRspSize,
                                            &ctx->nextData,
                                            duplicate);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_ENCRYPTED_SECRET_Unmarshal(ctx->cmdBuffer,
-                                                    ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_ENCRYPTED_SECRET_Unmarshal(ctx->rspBuffer,
+                                                    ctx->maxRspSize,
                                                     &ctx->nextData,
                                                     outSymSeed);
 }
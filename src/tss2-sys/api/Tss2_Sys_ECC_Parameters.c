@@ -53,8 +53,8 @@ TSS2_RC Tss2_Sys_ECC_Parameters_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMS_ALGORITHM_DETAIL_ECC_Unmarshal(ctx->cmdBuffer,
-                                                       ctx->maxCmdSize,
+    return Tss2_MU_TPMS_ALGORITHM_DETAIL_ECC_Unmarshal(ctx->rspBuffer,
+                                                       ctx->maxRspSize,
                                                        &ctx->nextData,
                                                        parameters);
 }
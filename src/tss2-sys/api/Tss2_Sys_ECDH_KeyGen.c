@@ -54,15 +54,15 @@ TSS2_RC Tss2_Sys_ECDH_KeyGen_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData,
                                              zPoint);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData,
                                              pubPoint);
 }
@@ -69,8 +69,8 @@ TSS2_RC Tss2_Sys_ECDH_ZGen_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData,
                                              outPoint);
 }
@@ -53,14 +53,14 @@ TSS2_RC Tss2_Sys_EC_Ephemeral_Complete(
     rval = CommonComplete(ctx);
     if (rval)
         return rval;
-    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_ECC_POINT_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData, Q);
     if (rval)
         return rval;
 
-    return Tss2_MU_UINT16_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    return Tss2_MU_UINT16_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData, counter);
 }
 
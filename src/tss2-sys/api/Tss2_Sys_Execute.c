@@ -71,20 +71,20 @@ TSS2_RC Tss2_Sys_ExecuteFinish(TSS2_SYS_CONTEXT *sysContext, int32_t timeout)
         ctx->previousStage = CMD_STAGE_PREPARE;
         return TSS2_SYS_RC_INSUFFICIENT_RESPONSE;
     }
-    if (responseSize > ctx->maxCmdSize) {
+    if (responseSize > ctx->maxRspSize) {
         ctx->previousStage = CMD_STAGE_PREPARE;
         return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
     }
 #else
-    /* For none partial reads set the size to maxCmdSize */
-    responseSize = ctx->maxCmdSize;
+    /* For none partial reads set the size to maxRspSize */
+    responseSize = ctx->maxRspSize;
 #endif
 
     /*
      * Then call receive again with the response buffer to read the response
      */
     rval = Tss2_Tcti_Receive(ctx->tctiContext, &responseSize,
-                             ctx->cmdBuffer, timeout);
+                             ctx->rspBuffer, timeout);
     if (rval == TSS2_TCTI_RC_INSUFFICIENT_BUFFER)
         return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
 
@@ -99,8 +99,8 @@ TSS2_RC Tss2_Sys_ExecuteFinish(TSS2_SYS_CONTEXT *sysContext, int32_t timeout)
      */
     ctx->nextData = 0;
 
-    rval = Tss2_MU_TPM2_ST_Unmarshal(ctx->cmdBuffer,
-                                     ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2_ST_Unmarshal(ctx->rspBuffer,
+                                     ctx->maxRspSize,
                                      &ctx->nextData,
                                      &ctx->rsp_header.tag);
     if (rval) {
@@ -120,19 +120,19 @@ TSS2_RC Tss2_Sys_ExecuteFinish(TSS2_SYS_CONTEXT *sysContext, int32_t timeout)
         }
     }
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                     ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                     ctx->maxRspSize,
                                      &ctx->nextData,
                                      &ctx->rsp_header.responseSize);
     if (rval)
         return rval;
 
-    if (ctx->rsp_header.responseSize > ctx->maxCmdSize) {
+    if (ctx->rsp_header.responseSize > ctx->maxRspSize) {
         return TSS2_SYS_RC_MALFORMED_RESPONSE;
     }
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData,
                                     &ctx->rsp_header.responseCode);
     if (rval)
@@ -154,7 +154,8 @@ TSS2_RC Tss2_Sys_ExecuteFinish(TSS2_SYS_CONTEXT *sysContext, int32_t timeout)
      */
     if (rval && rval != TPM2_RC_INITIALIZE) {
         ctx->previousStage = CMD_STAGE_PREPARE;
-        memcpy(ctx->cmdBuffer, ctx->cmd_header, sizeof(ctx->cmd_header));
+        if (ctx->rspBuffer == ctx->cmdBuffer)
+            memcpy(ctx->cmdBuffer, ctx->cmd_header, sizeof(ctx->cmd_header));
         return rval;
     }
 
@@ -64,15 +64,15 @@ TSS2_RC Tss2_Sys_FieldUpgradeData_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPMT_HA_Unmarshal(ctx->cmdBuffer,
-                                     ctx->maxCmdSize,
+    rval = Tss2_MU_TPMT_HA_Unmarshal(ctx->rspBuffer,
+                                     ctx->maxRspSize,
                                      &ctx->nextData,
                                      nextDigest);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMT_HA_Unmarshal(ctx->cmdBuffer,
-                                     ctx->maxCmdSize,
+    return Tss2_MU_TPMT_HA_Unmarshal(ctx->rspBuffer,
+                                     ctx->maxRspSize,
                                      &ctx->nextData,
                                      firstDigest);
 }
@@ -53,8 +53,8 @@ TSS2_RC Tss2_Sys_FirmwareRead_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_MAX_BUFFER_Unmarshal(ctx->cmdBuffer,
-                                              ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_MAX_BUFFER_Unmarshal(ctx->rspBuffer,
+                                              ctx->maxRspSize,
                                               &ctx->nextData, fuData);
 }
 
@@ -0,0 +1,484 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************;
+ * Copyright (c) 2019, Intel Corporation
+ * All rights reserved.
+ ***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "tss2_tpm2_types.h"
+#include "tss2_mu.h"
+#include "sysapi_util.h"
+
+/*
+ * Command metadata indexed directly by command code: one dense table for
+ * the TCG command codes TPM2_CC_FIRST..TPM2_CC_LAST and one for the vendor
+ * specific commands starting at TPM2_CC_Vendor_TCG_Test. Unassigned codes
+ * within the ranges have a commandCode of 0.
+ *
+ * The attributes mirror what the *_Prepare functions allow (param
+ * encryption and sessions). Commands are idempotent if resending them after
+ * a lost response leaves the TPM in the same state, apart from the nonces
+ * of the sessions; read-only commands are idempotent implicitly. The maximum
+ * response size is computed from the maximum marshaled sizes of the
+ * response parameters. It may exceed TPM2_MAX_COMMAND_SIZE, the size of the
+ * default SAPI buffer, so such responses need a context with a larger
+ * response buffer (maxRspSize of a context from Tss2_Sys_InitializeEx).
+ */
+
+#define RSP_PCR_Allocate \
+    (TSS2_MU_BYTE_MAX_SIZE + TSS2_MU_UINT32_MAX_SIZE + \
+     TSS2_MU_UINT32_MAX_SIZE + TSS2_MU_UINT32_MAX_SIZE)
+#define RSP_CreatePrimary \
+    (TSS2_MU_TPM2B_PUBLIC_MAX_SIZE + TSS2_MU_TPM2B_CREATION_DATA_MAX_SIZE + \
+     TSS2_MU_TPM2B_DIGEST_MAX_SIZE + TSS2_MU_TPMT_TK_CREATION_MAX_SIZE + \
+     TSS2_MU_TPM2B_NAME_MAX_SIZE)
+#define RSP_GetCommandAuditDigest \
+    (TSS2_MU_TPM2B_ATTEST_MAX_SIZE + TSS2_MU_TPMT_SIGNATURE_MAX_SIZE)
+#define RSP_PCR_Event \
+    (TSS2_MU_TPML_DIGEST_VALUES_MAX_SIZE)
+#define RSP_SequenceComplete \
+    (TSS2_MU_TPM2B_DIGEST_MAX_SIZE + TSS2_MU_TPMT_TK_HASHCHECK_MAX_SIZE)
+#define RSP_FieldUpgradeData \
+    (TSS2_MU_TPMT_HA_MAX_SIZE + TSS2_MU_TPMT_HA_MAX_SIZE)
+#define RSP_IncrementalSelfTest \
+    (TSS2_MU_TPML_ALG_MAX_SIZE)
+#define RSP_ActivateCredential \
+    (TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define RSP_Certify \
+    (TSS2_MU_TPM2B_ATTEST_MAX_SIZE + TSS2_MU_TPMT_SIGNATURE_MAX_SIZE)
+#define RSP_CertifyCreation \
+    (TSS2_MU_TPM2B_ATTEST_MAX_SIZE + TSS2_MU_TPMT_SIGNATURE_MAX_SIZE)
+#define RSP_Duplicate \
+    (TSS2_MU_TPM2B_DATA_MAX_SIZE + TSS2_MU_TPM2B_PRIVATE_MAX_SIZE + \
+     TSS2_MU_TPM2B_ENCRYPTED_SECRET_MAX_SIZE)
+#define RSP_GetTime \
+    (TSS2_MU_TPM2B_ATTEST_MAX_SIZE + TSS2_MU_TPMT_SIGNATURE_MAX_SIZE)
+#define RSP_GetSessionAuditDigest \
+    (TSS2_MU_TPM2B_ATTEST_MAX_SIZE + TSS2_MU_TPMT_SIGNATURE_MAX_SIZE)
+#define RSP_NV_Read \
+    (TSS2_MU_TPM2B_MAX_NV_BUFFER_MAX_SIZE)
+#define RSP_ObjectChangeAuth \
+    (TSS2_MU_TPM2B_PRIVATE_MAX_SIZE)
+#define RSP_PolicySecret \
+    (TSS2_MU_TPM2B_TIMEOUT_MAX_SIZE + TSS2_MU_TPMT_TK_AUTH_MAX_SIZE)
+#define RSP_Rewrap \
+    (TSS2_MU_TPM2B_PRIVATE_MAX_SIZE + \
+     TSS2_MU_TPM2B_ENCRYPTED_SECRET_MAX_SIZE)
+#define RSP_Create \
+    (TSS2_MU_TPM2B_PRIVATE_MAX_SIZE + TSS2_MU_TPM2B_PUBLIC_MAX_SIZE + \
+     TSS2_MU_TPM2B_CREATION_DATA_MAX_SIZE + TSS2_MU_TPM2B_DIGEST_MAX_SIZE + \
+     TSS2_MU_TPMT_TK_CREATION_MAX_SIZE)
+#define RSP_ECDH_ZGen \
+    (TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE)
+#define RSP_HMAC \
+    (TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define RSP_Import \
+    (TSS2_MU_TPM2B_PRIVATE_MAX_SIZE)
+#define RSP_Load \
+    (TSS2_MU_TPM2B_NAME_MAX_SIZE)
+#define RSP_Quote \
+    (TSS2_MU_TPM2B_ATTEST_MAX_SIZE + TSS2_MU_TPMT_SIGNATURE_MAX_SIZE)
+#define RSP_RSA_Decrypt \
+    (TSS2_MU_TPM2B_PUBLIC_KEY_RSA_MAX_SIZE)
+#define RSP_Sign \
+    (TSS2_MU_TPMT_SIGNATURE_MAX_SIZE)
+#define RSP_Unseal \
+    (TSS2_MU_TPM2B_SENSITIVE_DATA_MAX_SIZE)
+#define RSP_PolicySigned \
+    (TSS2_MU_TPM2B_TIMEOUT_MAX_SIZE + TSS2_MU_TPMT_TK_AUTH_MAX_SIZE)
+#define RSP_ContextSave \
+    (TSS2_MU_TPMS_CONTEXT_MAX_SIZE)
+#define RSP_ECDH_KeyGen \
+    (TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE + TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE)
+#define RSP_EncryptDecrypt \
+    (TSS2_MU_TPM2B_MAX_BUFFER_MAX_SIZE + TSS2_MU_TPM2B_IV_MAX_SIZE)
+#define RSP_LoadExternal \
+    (TSS2_MU_TPM2B_NAME_MAX_SIZE)
+#define RSP_MakeCredential \
+    (TSS2_MU_TPM2B_ID_OBJECT_MAX_SIZE + \
+     TSS2_MU_TPM2B_ENCRYPTED_SECRET_MAX_SIZE)
+#define RSP_NV_ReadPublic \
+    (TSS2_MU_TPM2B_NV_PUBLIC_MAX_SIZE + TSS2_MU_TPM2B_NAME_MAX_SIZE)
+#define RSP_ReadPublic \
+    (TSS2_MU_TPM2B_PUBLIC_MAX_SIZE + TSS2_MU_TPM2B_NAME_MAX_SIZE + \
+     TSS2_MU_TPM2B_NAME_MAX_SIZE)
+#define RSP_RSA_Encrypt \
+    (TSS2_MU_TPM2B_PUBLIC_KEY_RSA_MAX_SIZE)
+#define RSP_StartAuthSession \
+    (TSS2_MU_TPM2B_NONCE_MAX_SIZE)
+#define RSP_VerifySignature \
+    (TSS2_MU_TPMT_TK_VERIFIED_MAX_SIZE)
+#define RSP_ECC_Parameters \
+    (TSS2_MU_TPMS_ALGORITHM_DETAIL_ECC_MAX_SIZE)
+#define RSP_FirmwareRead \
+    (TSS2_MU_TPM2B_MAX_BUFFER_MAX_SIZE)
+#define RSP_GetCapability \
+    (TSS2_MU_BYTE_MAX_SIZE + TSS2_MU_TPMS_CAPABILITY_DATA_MAX_SIZE)
+#define RSP_GetRandom \
+    (TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define RSP_GetTestResult \
+    (TSS2_MU_TPM2B_MAX_BUFFER_MAX_SIZE + TSS2_MU_UINT32_MAX_SIZE)
+#define RSP_Hash \
+    (TSS2_MU_TPM2B_DIGEST_MAX_SIZE + TSS2_MU_TPMT_TK_HASHCHECK_MAX_SIZE)
+#define RSP_PCR_Read \
+    (TSS2_MU_UINT32_MAX_SIZE + TSS2_MU_TPML_PCR_SELECTION_MAX_SIZE + \
+     TSS2_MU_TPML_DIGEST_MAX_SIZE)
+#define RSP_ReadClock \
+    (TSS2_MU_TPMS_TIME_INFO_MAX_SIZE)
+#define RSP_NV_Certify \
+    (TSS2_MU_TPM2B_ATTEST_MAX_SIZE + TSS2_MU_TPMT_SIGNATURE_MAX_SIZE)
+#define RSP_EventSequenceComplete \
+    (TSS2_MU_TPML_DIGEST_VALUES_MAX_SIZE)
+#define RSP_PolicyGetDigest \
+    (TSS2_MU_TPM2B_DIGEST_MAX_SIZE)
+#define RSP_Commit \
+    (TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE + TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE + \
+     TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE + TSS2_MU_UINT16_MAX_SIZE)
+#define RSP_ZGen_2Phase \
+    (TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE + TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE)
+#define RSP_EC_Ephemeral \
+    (TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE + TSS2_MU_UINT16_MAX_SIZE)
+#define RSP_CreateLoaded \
+    (TSS2_MU_TPM2B_PRIVATE_MAX_SIZE + TSS2_MU_TPM2B_PUBLIC_MAX_SIZE + \
+     TSS2_MU_TPM2B_NAME_MAX_SIZE)
+#define RSP_EncryptDecrypt2 \
+    (TSS2_MU_TPM2B_MAX_BUFFER_MAX_SIZE + TSS2_MU_TPM2B_IV_MAX_SIZE)
+#define RSP_AC_GetCapability \
+    (TSS2_MU_BYTE_MAX_SIZE + TSS2_MU_TPML_AC_CAPABILITIES_MAX_SIZE)
+#define RSP_AC_Send \
+    (TSS2_MU_TPMS_AC_OUTPUT_MAX_SIZE)
+#define RSP_Vendor_TCG_Test \
+    (TSS2_MU_TPM2B_DATA_MAX_SIZE)
+
+#define RSP_SIZE(numRspHandles, params) \
+    (sizeof(TPM20_Header_Out) + (numRspHandles) * sizeof(TPM2_HANDLE) + \
+     (params))
+
+#define CMD_ATTR(attr) \
+    ((attr) | (((attr) & TSS2_SYS_CMD_READ_ONLY) ? TSS2_SYS_CMD_IDEMPOTENT : 0))
+
+#define CMD_INFO(cc, cmdHandles, rspHandles, role0, role1, role2, attr, rsp) \
+    { TPM2_CC_##cc, cmdHandles, rspHandles, \
+      { TSS2_SYS_AUTH_ROLE_##role0, TSS2_SYS_AUTH_ROLE_##role1, \
+        TSS2_SYS_AUTH_ROLE_##role2 }, \
+      CMD_ATTR(attr), RSP_SIZE(rspHandles, rsp) }
+
+#define CMD(cc, cmdHandles, rspHandles, role0, role1, role2, attr, rsp) \
+    [TPM2_CC_##cc - TPM2_CC_FIRST] = \
+    CMD_INFO(cc, cmdHandles, rspHandles, role0, role1, role2, attr, rsp)
+
+static const TSS2_SYS_COMMAND_INFO
+commandInfo[TPM2_CC_LAST - TPM2_CC_FIRST + 1] = {
+    CMD(NV_UndefineSpaceSpecial, 2, 0, ADMIN, USER, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(EvictControl, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(HierarchyControl, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(NV_UndefineSpace, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(ChangeEPS, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(ChangePPS, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(Clear, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(ClearControl, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(ClockSet, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(HierarchyChangeAuth, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(NV_DefineSpace, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PCR_Allocate, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, RSP_PCR_Allocate),
+    CMD(PCR_SetAuthPolicy, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT,
+        0),
+    CMD(PP_Commands, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(SetPrimaryPolicy, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT,
+        0),
+    CMD(FieldUpgradeStart, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(ClockRateAdjust, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(CreatePrimary, 1, 1, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_CreatePrimary),
+    CMD(NV_GlobalWriteLock, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(GetCommandAuditDigest, 2, 0, USER, USER, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_GetCommandAuditDigest),
+    CMD(NV_Increment, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(NV_SetBits, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(NV_Extend, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(NV_Write, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT,
+        0),
+    CMD(NV_WriteLock, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(DictionaryAttackLockReset, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(DictionaryAttackParameters, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(NV_ChangeAuth, 1, 0, ADMIN, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PCR_Event, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, RSP_PCR_Event),
+    CMD(PCR_Reset, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(SequenceComplete, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_SequenceComplete),
+    CMD(SetAlgorithmSet, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(SetCommandCodeAuditStatus, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(FieldUpgradeData, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, RSP_FieldUpgradeData),
+    CMD(IncrementalSelfTest, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, RSP_IncrementalSelfTest),
+    CMD(SelfTest, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(Startup, 0, 0, NONE, NONE, NONE,
+        0, 0),
+    CMD(Shutdown, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(StirRandom, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(ActivateCredential, 2, 0, ADMIN, USER, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_ActivateCredential),
+    CMD(Certify, 2, 0, ADMIN, USER, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Certify),
+    CMD(PolicyNV, 3, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(CertifyCreation, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_CertifyCreation),
+    CMD(Duplicate, 2, 0, DUP, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Duplicate),
+    CMD(GetTime, 2, 0, USER, USER, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_GetTime),
+    CMD(GetSessionAuditDigest, 3, 0, USER, USER, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_GetSessionAuditDigest),
+    CMD(NV_Read, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS |
+        TSS2_SYS_CMD_READ_ONLY,
+        RSP_NV_Read),
+    CMD(NV_ReadLock, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_IDEMPOTENT, 0),
+    CMD(ObjectChangeAuth, 2, 0, ADMIN, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_ObjectChangeAuth),
+    CMD(PolicySecret, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_PolicySecret),
+    CMD(Rewrap, 2, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Rewrap),
+    CMD(Create, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Create),
+    CMD(ECDH_ZGen, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_ECDH_ZGen),
+    CMD(HMAC, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_HMAC),
+    CMD(Import, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Import),
+    CMD(Load, 1, 1, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Load),
+    CMD(Quote, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Quote),
+    CMD(RSA_Decrypt, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_RSA_Decrypt),
+    CMD(HMAC_Start, 1, 1, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(SequenceUpdate, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(Sign, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, RSP_Sign),
+    CMD(Unseal, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS, RSP_Unseal),
+    CMD(PolicySigned, 2, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_PolicySigned),
+    CMD(ContextLoad, 0, 1, NONE, NONE, NONE,
+        0, 0),
+    CMD(ContextSave, 1, 0, NONE, NONE, NONE,
+        0, RSP_ContextSave),
+    CMD(ECDH_KeyGen, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS, RSP_ECDH_KeyGen),
+    CMD(EncryptDecrypt, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS, RSP_EncryptDecrypt),
+    CMD(FlushContext, 1, 0, NONE, NONE, NONE,
+        0, 0),
+    CMD(LoadExternal, 0, 1, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_LoadExternal),
+    CMD(MakeCredential, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT |
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_READ_ONLY,
+        RSP_MakeCredential),
+    CMD(NV_ReadPublic, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS |
+        TSS2_SYS_CMD_READ_ONLY,
+        RSP_NV_ReadPublic),
+    CMD(PolicyAuthorize, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyAuthValue, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyCommandCode, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyCounterTimer, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyCpHash, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyLocality, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyNameHash, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyOR, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyTicket, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(ReadPublic, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS |
+        TSS2_SYS_CMD_READ_ONLY,
+        RSP_ReadPublic),
+    CMD(RSA_Encrypt, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT |
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_READ_ONLY,
+        RSP_RSA_Encrypt),
+    CMD(StartAuthSession, 2, 1, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_StartAuthSession),
+    CMD(VerifySignature, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS |
+        TSS2_SYS_CMD_READ_ONLY,
+        RSP_VerifySignature),
+    CMD(ECC_Parameters, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_READ_ONLY, RSP_ECC_Parameters),
+    CMD(FirmwareRead, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS |
+        TSS2_SYS_CMD_READ_ONLY,
+        RSP_FirmwareRead),
+    CMD(GetCapability, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_READ_ONLY, RSP_GetCapability),
+    CMD(GetRandom, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS |
+        TSS2_SYS_CMD_READ_ONLY,
+        RSP_GetRandom),
+    CMD(GetTestResult, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS |
+        TSS2_SYS_CMD_READ_ONLY,
+        RSP_GetTestResult),
+    CMD(Hash, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT |
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_READ_ONLY,
+        RSP_Hash),
+    CMD(PCR_Read, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_READ_ONLY, RSP_PCR_Read),
+    CMD(PolicyPCR, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyRestart, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(ReadClock, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_READ_ONLY, RSP_ReadClock),
+    CMD(PCR_Extend, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PCR_SetAuthValue, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(NV_Certify, 3, 0, USER, USER, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_NV_Certify),
+    CMD(EventSequenceComplete, 2, 0, USER, USER, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_EventSequenceComplete),
+    CMD(HashSequenceStart, 0, 1, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyPhysicalPresence, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyDuplicationSelect, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyGetDigest, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS |
+        TSS2_SYS_CMD_READ_ONLY,
+        RSP_PolicyGetDigest),
+    CMD(TestParms, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_READ_ONLY, 0),
+    CMD(Commit, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Commit),
+    CMD(PolicyPassword, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(ZGen_2Phase, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_ZGen_2Phase),
+    CMD(EC_Ephemeral, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS, RSP_EC_Ephemeral),
+    CMD(PolicyNvWritten, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(PolicyTemplate, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(CreateLoaded, 1, 1, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_CreateLoaded),
+    CMD(PolicyAuthorizeNV, 3, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS, 0),
+    CMD(EncryptDecrypt2, 1, 0, USER, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_EncryptDecrypt2),
+    CMD(AC_GetCapability, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_SESSIONS | TSS2_SYS_CMD_READ_ONLY, RSP_AC_GetCapability),
+    CMD(AC_Send, 3, 0, USER, USER, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, RSP_AC_Send),
+    CMD(Policy_AC_SendSelect, 1, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_SESSIONS, 0)
+};
+
+static const TSS2_SYS_COMMAND_INFO vendorCommandInfo[] = {
+    CMD_INFO(Vendor_TCG_Test, 0, 0, NONE, NONE, NONE,
+        TSS2_SYS_CMD_DECRYPT | TSS2_SYS_CMD_ENCRYPT | TSS2_SYS_CMD_SESSIONS,
+        RSP_Vendor_TCG_Test)
+};
+
+const TSS2_SYS_COMMAND_INFO *Tss2_Sys_GetCommandInfo(TPM2_CC commandCode)
+{
+    const TSS2_SYS_COMMAND_INFO *info;
+
+    if (commandCode >= TPM2_CC_FIRST && commandCode <= TPM2_CC_LAST) {
+        info = &commandInfo[commandCode - TPM2_CC_FIRST];
+    } else if (commandCode >= TPM2_CC_Vendor_TCG_Test &&
+               commandCode - TPM2_CC_Vendor_TCG_Test <
+               sizeof(vendorCommandInfo) / sizeof(vendorCommandInfo[0])) {
+        info = &vendorCommandInfo[commandCode - TPM2_CC_Vendor_TCG_Test];
+    } else {
+        return NULL;
+    }
+
+    if (info->commandCode != commandCode)
+        return NULL;
+
+    return info;
+}
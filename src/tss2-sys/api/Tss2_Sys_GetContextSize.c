@@ -22,3 +22,15 @@ size_t Tss2_Sys_GetContextSize(size_t maxCommandSize)
                        maxCommandSize : sizeof(TPM20_Header_In));
     }
 }
+
+size_t Tss2_Sys_GetContextSizeEx(
+    size_t maxCommandSize,
+    size_t maxResponseSize)
+{
+    if (maxCommandSize < sizeof(TPM20_Header_In))
+        maxCommandSize = sizeof(TPM20_Header_In);
+    if (maxResponseSize < sizeof(TPM20_Header_Out))
+        maxResponseSize = sizeof(TPM20_Header_Out);
+
+    return sizeof(_TSS2_SYS_CONTEXT_BLOB) + maxCommandSize + maxResponseSize;
+}
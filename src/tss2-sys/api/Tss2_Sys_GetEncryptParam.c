@@ -35,7 +35,7 @@ TSS2_RC Tss2_Sys_GetEncryptParam(
 
     /* Get first parameter, interpret it as a TPM2B and return its size field
      * and a pointer to its buffer area. */
-    offset = ctx->cmdBuffer
+    offset = ctx->rspBuffer
             + sizeof(TPM20_Header_Out)
             + ctx->numResponseHandles * sizeof(TPM2_HANDLE)
             + sizeof(TPM2_PARAMETER_SIZE);
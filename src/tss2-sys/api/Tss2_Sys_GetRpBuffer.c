@@ -39,16 +39,16 @@ TSS2_RC Tss2_Sys_GetRpBuffer(
     if (ctx->rsp_header.tag == TPM2_ST_SESSIONS) {
         /* If sessions are used a parameterSize values exists for convenience */
         TPM2_PARAMETER_SIZE parameterSize;
-        rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
+        rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
                 ctx->rsp_header.responseSize, &offset, &parameterSize);
         if (rval != TSS2_RC_SUCCESS) {
             return rval;
         }
-        *rpBuffer = ctx->cmdBuffer + offset;
+        *rpBuffer = ctx->rspBuffer + offset;
         *rpBufferUsedSize = parameterSize;
     } else {
         /* If no session is used the remainder is the rpArea */
-        *rpBuffer = ctx->cmdBuffer + offset;
+        *rpBuffer = ctx->rspBuffer + offset;
         *rpBufferUsedSize = ctx->rsp_header.responseSize - offset;
     }
 
@@ -48,7 +48,7 @@ TSS2_RC Tss2_Sys_GetRspAuths(
             return TSS2_SYS_RC_MALFORMED_RESPONSE;
 
         UINT16 tmp;
-        memcpy(&tmp, ctx->cmdBuffer + offset_tmp, sizeof(UINT16));
+        memcpy(&tmp, ctx->rspBuffer + offset_tmp, sizeof(UINT16));
         offset_tmp += sizeof(UINT16);
         offset_tmp += BE_TO_HOST_16(tmp);
 
@@ -60,7 +60,7 @@ TSS2_RC Tss2_Sys_GetRspAuths(
         if (offset_tmp > ctx->rsp_header.responseSize)
             return TSS2_SYS_RC_MALFORMED_RESPONSE;
 
-        memcpy(&tmp, ctx->cmdBuffer + offset_tmp, sizeof(UINT16));
+        memcpy(&tmp, ctx->rspBuffer + offset_tmp, sizeof(UINT16));
         offset_tmp += sizeof(UINT16);
         offset_tmp += BE_TO_HOST_16(tmp);
 
@@ -73,8 +73,8 @@ TSS2_RC Tss2_Sys_GetRspAuths(
 
     /* Unmarshal the auth area */
     for (i = 0; i < ctx->authsCount; i++) {
-        rval = Tss2_MU_TPMS_AUTH_RESPONSE_Unmarshal(ctx->cmdBuffer,
-                                            ctx->maxCmdSize,
+        rval = Tss2_MU_TPMS_AUTH_RESPONSE_Unmarshal(ctx->rspBuffer,
+                                            ctx->maxRspSize,
                                             &offset, &rspAuthsArray->auths[i]);
         if (rval)
             break;
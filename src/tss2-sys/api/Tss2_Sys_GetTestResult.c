@@ -47,15 +47,15 @@ TSS2_RC Tss2_Sys_GetTestResult_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_MAX_BUFFER_Unmarshal(ctx->cmdBuffer,
-                                              ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_MAX_BUFFER_Unmarshal(ctx->rspBuffer,
+                                              ctx->maxRspSize,
                                               &ctx->nextData,
                                               outData);
     if (rval)
         return rval;
 
-    return Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    return Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData,
                                     testResult);
 }
@@ -84,15 +84,15 @@ TSS2_RC Tss2_Sys_GetTime_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_ATTEST_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_ATTEST_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData,
                                           timeInfo);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMT_SIGNATURE_Unmarshal(ctx->cmdBuffer,
-                                            ctx->maxCmdSize,
+    return Tss2_MU_TPMT_SIGNATURE_Unmarshal(ctx->rspBuffer,
+                                            ctx->maxRspSize,
                                             &ctx->nextData,
                                             signature);
 }
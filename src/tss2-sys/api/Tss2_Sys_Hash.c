@@ -81,15 +81,15 @@ TSS2_RC Tss2_Sys_Hash_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData,
                                           outHash);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMT_TK_HASHCHECK_Unmarshal(ctx->cmdBuffer,
-                                               ctx->maxCmdSize,
+    return Tss2_MU_TPMT_TK_HASHCHECK_Unmarshal(ctx->rspBuffer,
+                                               ctx->maxRspSize,
                                                &ctx->nextData,
                                                validation);
 }
@@ -130,8 +130,8 @@ TSS2_RC Tss2_Sys_Import_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->cmdBuffer,
-                                           ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->rspBuffer,
+                                           ctx->maxRspSize,
                                            &ctx->nextData,
                                            outPrivate);
 }
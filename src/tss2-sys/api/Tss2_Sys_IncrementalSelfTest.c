@@ -53,8 +53,8 @@ TSS2_RC Tss2_Sys_IncrementalSelfTest_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPML_ALG_Unmarshal(ctx->cmdBuffer,
-                                      ctx->maxCmdSize,
+    return Tss2_MU_TPML_ALG_Unmarshal(ctx->rspBuffer,
+                                      ctx->maxRspSize,
                                       &ctx->nextData, toDoList);
 }
 
@@ -30,6 +30,23 @@ TSS2_RC Tss2_Sys_Initialize(
     size_t contextSize,
     TSS2_TCTI_CONTEXT *tctiContext,
     TSS2_ABI_VERSION *abiVersion)
+{
+    return Tss2_Sys_InitializeEx(sysContext, contextSize, 0, tctiContext,
+                                 abiVersion);
+}
+
+/*
+ * Initialize a context whose buffer is split into a command buffer of
+ * maxCommandSize bytes and a response buffer taking the remaining space,
+ * see Tss2_Sys_GetContextSizeEx. A maxCommandSize of 0 gives the single
+ * shared buffer of Tss2_Sys_Initialize.
+ */
+TSS2_RC Tss2_Sys_InitializeEx(
+    TSS2_SYS_CONTEXT *sysContext,
+    size_t contextSize,
+    size_t maxCommandSize,
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_ABI_VERSION *abiVersion)
 {
     _TSS2_SYS_CONTEXT_BLOB *ctx = syscontext_cast(sysContext);
 
@@ -39,6 +56,12 @@ TSS2_RC Tss2_Sys_Initialize(
     if (contextSize < sizeof(_TSS2_SYS_CONTEXT_BLOB))
         return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
 
+    if (maxCommandSize != 0 &&
+        (maxCommandSize < sizeof(TPM20_Header_In) ||
+         maxCommandSize > UINT32_MAX ||
+         contextSize < Tss2_Sys_GetContextSizeEx(maxCommandSize, 0)))
+        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
+
     if (!TSS2_TCTI_TRANSMIT (tctiContext) ||
         !TSS2_TCTI_RECEIVE (tctiContext))
         return TSS2_SYS_RC_BAD_TCTI_STRUCTURE;
@@ -60,7 +83,7 @@ TSS2_RC Tss2_Sys_Initialize(
     }
 
     ctx->tctiContext = tctiContext;
-    InitSysContextPtrs(ctx, contextSize);
+    InitSysContextBuffers(ctx, contextSize, maxCommandSize);
     InitSysContextFields(ctx);
     ctx->previousStage = CMD_STAGE_INITIALIZE;
 
@@ -87,8 +87,8 @@ TSS2_RC Tss2_Sys_Load_Complete(
     if (!ctx)
         return TSS2_SYS_RC_BAD_REFERENCE;
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData, objectHandle);
     if (rval)
         return rval;
@@ -97,8 +97,8 @@ TSS2_RC Tss2_Sys_Load_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_NAME_Unmarshal(ctx->cmdBuffer,
-                                        ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_NAME_Unmarshal(ctx->rspBuffer,
+                                        ctx->maxRspSize,
                                         &ctx->nextData, name);
 }
 
@@ -89,8 +89,8 @@ TSS2_RC Tss2_Sys_LoadExternal_Complete(
     if (!ctx)
         return TSS2_SYS_RC_BAD_REFERENCE;
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData,
                                     objectHandle);
     if (rval)
@@ -100,8 +100,8 @@ TSS2_RC Tss2_Sys_LoadExternal_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_NAME_Unmarshal(ctx->cmdBuffer,
-                                        ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_NAME_Unmarshal(ctx->rspBuffer,
+                                        ctx->maxRspSize,
                                         &ctx->nextData, name);
 }
 
@@ -87,15 +87,15 @@ TSS2_RC Tss2_Sys_MakeCredential_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_ID_OBJECT_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_ID_OBJECT_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData,
                                              credentialBlob);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_ENCRYPTED_SECRET_Unmarshal(ctx->cmdBuffer,
-                                                    ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_ENCRYPTED_SECRET_Unmarshal(ctx->rspBuffer,
+                                                    ctx->maxRspSize,
                                                     &ctx->nextData,
                                                     secret);
 }
@@ -54,15 +54,15 @@ TSS2_RC Tss2_Sys_NV_ReadPublic_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_NV_PUBLIC_Unmarshal(ctx->cmdBuffer,
-                                             ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_NV_PUBLIC_Unmarshal(ctx->rspBuffer,
+                                             ctx->maxRspSize,
                                              &ctx->nextData,
                                              nvPublic);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_NAME_Unmarshal(ctx->cmdBuffer,
-                                        ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_NAME_Unmarshal(ctx->rspBuffer,
+                                        ctx->maxRspSize,
                                         &ctx->nextData,
                                         nvName);
 }
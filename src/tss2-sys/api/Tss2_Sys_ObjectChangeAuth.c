@@ -76,8 +76,8 @@ TSS2_RC Tss2_Sys_ObjectChangeAuth_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->cmdBuffer,
-                                           ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->rspBuffer,
+                                           ctx->maxRspSize,
                                            &ctx->nextData,
                                            outPrivate);
 }
@@ -69,8 +69,8 @@ TSS2_RC Tss2_Sys_PCR_Event_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPML_DIGEST_VALUES_Unmarshal(ctx->cmdBuffer,
-                                                ctx->maxCmdSize,
+    return Tss2_MU_TPML_DIGEST_VALUES_Unmarshal(ctx->rspBuffer,
+                                                ctx->maxRspSize,
                                                 &ctx->nextData,
                                                 digests);
 }
@@ -56,22 +56,22 @@ TSS2_RC Tss2_Sys_PCR_Read_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData,
                                     pcrUpdateCounter);
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPML_PCR_SELECTION_Unmarshal(ctx->cmdBuffer,
-                                                ctx->maxCmdSize,
+    rval = Tss2_MU_TPML_PCR_SELECTION_Unmarshal(ctx->rspBuffer,
+                                                ctx->maxRspSize,
                                                 &ctx->nextData,
                                                 pcrSelectionOut);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPML_DIGEST_Unmarshal(ctx->cmdBuffer,
-                                         ctx->maxCmdSize,
+    return Tss2_MU_TPML_DIGEST_Unmarshal(ctx->rspBuffer,
+                                         ctx->maxRspSize,
                                          &ctx->nextData, pcrValues);
 }
 
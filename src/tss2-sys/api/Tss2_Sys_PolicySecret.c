@@ -109,14 +109,14 @@ TSS2_RC Tss2_Sys_PolicySecret_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_TIMEOUT_Unmarshal(ctx->cmdBuffer,
-                                           ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_TIMEOUT_Unmarshal(ctx->rspBuffer,
+                                           ctx->maxRspSize,
                                            &ctx->nextData, timeout);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMT_TK_AUTH_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    return Tss2_MU_TPMT_TK_AUTH_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData, policyTicket);
 }
 
@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************;
+ * Copyright (c) 2019, Intel Corporation
+ * All rights reserved.
+ ***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "tss2_tpm2_types.h"
+#include "tss2_mu.h"
+#include "sysapi_util.h"
+#include "util/tss2_endian.h"
+#define LOGMODULE sys
+#include "util/log.h"
+
+/*
+ * A prepared command is a copy of a command marshaled by one of the
+ * *_Prepare functions (and optionally Tss2_Sys_SetCmdAuths) together with
+ * the SAPI state needed to execute and complete it. Loading it back into a
+ * context restores the CMD_STAGE_PREPARE state without running the
+ * marshaling code again, so commands that are issued repeatedly only pay
+ * for a copy of the command bytes. Single parameters can be changed in the
+ * stored command between executions.
+ */
+
+size_t Tss2_Sys_PreparedCommand_GetSize(size_t maxCommandSize)
+{
+    if (maxCommandSize == 0) {
+        return sizeof(_TSS2_SYS_PREPARED_COMMAND_BLOB) + TPM2_MAX_COMMAND_SIZE;
+    } else {
+        return sizeof(_TSS2_SYS_PREPARED_COMMAND_BLOB) +
+                     ((maxCommandSize > sizeof(TPM20_Header_In)) ?
+                       maxCommandSize : sizeof(TPM20_Header_In));
+    }
+}
+
+TSS2_RC Tss2_Sys_PreparedCommand_Save(
+    TSS2_SYS_CONTEXT *sysContext,
+    TSS2_SYS_PREPARED_COMMAND *preparedCommand,
+    size_t preparedCommandSize)
+{
+    _TSS2_SYS_CONTEXT_BLOB *ctx = syscontext_cast(sysContext);
+    _TSS2_SYS_PREPARED_COMMAND_BLOB *cmd = prepared_command_cast(preparedCommand);
+    UINT32 commandSize;
+
+    if (!ctx || !cmd)
+        return TSS2_SYS_RC_BAD_REFERENCE;
+
+    if (ctx->previousStage != CMD_STAGE_PREPARE)
+        return TSS2_SYS_RC_BAD_SEQUENCE;
+
+    commandSize = BE_TO_HOST_32(req_header_from_cxt(ctx)->commandSize);
+    if (preparedCommandSize < sizeof(_TSS2_SYS_PREPARED_COMMAND_BLOB) +
+                              commandSize)
+        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
+
+    cmd->commandCode = ctx->commandCode;
+    cmd->commandSize = commandSize;
+    cmd->maxCmdSize = preparedCommandSize -
+                      sizeof(_TSS2_SYS_PREPARED_COMMAND_BLOB);
+    cmd->cpBufferOffset = ctx->cpBuffer - ctx->cmdBuffer;
+    cmd->cpBufferUsedSize = ctx->cpBufferUsedSize;
+    cmd->rspParamsOffset = (UINT8 *)ctx->rspParamsSize - ctx->rspBuffer;
+    cmd->authsCount = ctx->authsCount;
+    cmd->numResponseHandles = ctx->numResponseHandles;
+    cmd->decryptAllowed = ctx->decryptAllowed;
+    cmd->encryptAllowed = ctx->encryptAllowed;
+    cmd->decryptNull = ctx->decryptNull;
+    cmd->authAllowed = ctx->authAllowed;
+
+    memcpy(prepared_command_buffer(cmd), ctx->cmdBuffer, commandSize);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Sys_PreparedCommand_GetCpBuffer(
+    const TSS2_SYS_PREPARED_COMMAND *preparedCommand,
+    size_t *cpBufferUsedSize,
+    const uint8_t **cpBuffer)
+{
+    _TSS2_SYS_PREPARED_COMMAND_BLOB *cmd =
+        prepared_command_cast((TSS2_SYS_PREPARED_COMMAND *)preparedCommand);
+
+    if (!cmd || !cpBufferUsedSize || !cpBuffer)
+        return TSS2_SYS_RC_BAD_REFERENCE;
+
+    *cpBuffer = prepared_command_buffer(cmd) + cmd->cpBufferOffset;
+    *cpBufferUsedSize = cmd->cpBufferUsedSize;
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Overwrite paramSize bytes of the command parameters, starting at offset
+ * bytes from the beginning of the cpBuffer. The size of the command does
+ * not change, so only parameters with the same marshaled size can be
+ * replaced, e.g. a digest of the same length or a fixed size integer.
+ */
+TSS2_RC Tss2_Sys_PreparedCommand_SetParam(
+    TSS2_SYS_PREPARED_COMMAND *preparedCommand,
+    size_t offset,
+    size_t paramSize,
+    const uint8_t *paramBuffer)
+{
+    _TSS2_SYS_PREPARED_COMMAND_BLOB *cmd = prepared_command_cast(preparedCommand);
+
+    if (!cmd || !paramBuffer)
+        return TSS2_SYS_RC_BAD_REFERENCE;
+
+    if (offset > cmd->cpBufferUsedSize ||
+        paramSize > cmd->cpBufferUsedSize - offset)
+        return TSS2_SYS_RC_BAD_SIZE;
+
+    memcpy(prepared_command_buffer(cmd) + cmd->cpBufferOffset + offset,
+           paramBuffer, paramSize);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Sys_PreparedCommand_Load(
+    TSS2_SYS_CONTEXT *sysContext,
+    const TSS2_SYS_PREPARED_COMMAND *preparedCommand)
+{
+    _TSS2_SYS_CONTEXT_BLOB *ctx = syscontext_cast(sysContext);
+    _TSS2_SYS_PREPARED_COMMAND_BLOB *cmd =
+        prepared_command_cast((TSS2_SYS_PREPARED_COMMAND *)preparedCommand);
+
+    if (!ctx || !cmd)
+        return TSS2_SYS_RC_BAD_REFERENCE;
+
+    if (ctx->previousStage != CMD_STAGE_INITIALIZE &&
+        ctx->previousStage != CMD_STAGE_RECEIVE_RESPONSE &&
+        ctx->previousStage != CMD_STAGE_PREPARE)
+        return TSS2_SYS_RC_BAD_SEQUENCE;
+
+    if (cmd->commandSize > ctx->maxCmdSize ||
+        cmd->rspParamsOffset + sizeof(UINT32) > ctx->maxRspSize) {
+        LOG_ERROR("Prepared command does not fit into the context");
+        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
+    }
+
+    memcpy(ctx->cmdBuffer, prepared_command_buffer(cmd), cmd->commandSize);
+
+    ctx->commandCode = cmd->commandCode;
+    ctx->cpBuffer = ctx->cmdBuffer + cmd->cpBufferOffset;
+    ctx->cpBufferUsedSize = cmd->cpBufferUsedSize;
+    ctx->rspParamsSize = (UINT32 *)(ctx->rspBuffer + cmd->rspParamsOffset);
+    ctx->authsCount = cmd->authsCount;
+    ctx->numResponseHandles = cmd->numResponseHandles;
+    ctx->decryptAllowed = cmd->decryptAllowed;
+    ctx->encryptAllowed = cmd->encryptAllowed;
+    ctx->decryptNull = cmd->decryptNull;
+    ctx->authAllowed = cmd->authAllowed;
+    ctx->nextData = cmd->commandSize;
+    ctx->previousStage = CMD_STAGE_PREPARE;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Sys_PreparedCommand_Execute(
+    TSS2_SYS_CONTEXT *sysContext,
+    const TSS2_SYS_PREPARED_COMMAND *preparedCommand)
+{
+    TSS2_RC rval;
+
+    rval = Tss2_Sys_PreparedCommand_Load(sysContext, preparedCommand);
+    if (rval)
+        return rval;
+
+    return Tss2_Sys_Execute(sysContext);
+}
@@ -94,8 +94,8 @@ TSS2_RC Tss2_Sys_RSA_Decrypt_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_PUBLIC_KEY_RSA_Unmarshal(ctx->cmdBuffer,
-                                                  ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_PUBLIC_KEY_RSA_Unmarshal(ctx->rspBuffer,
+                                                  ctx->maxRspSize,
                                                   &ctx->nextData, message);
 }
 
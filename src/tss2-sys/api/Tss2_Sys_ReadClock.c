@@ -46,8 +46,8 @@ TSS2_RC Tss2_Sys_ReadClock_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMS_TIME_INFO_Unmarshal(ctx->cmdBuffer,
-                                            ctx->maxCmdSize,
+    return Tss2_MU_TPMS_TIME_INFO_Unmarshal(ctx->rspBuffer,
+                                            ctx->maxRspSize,
                                             &ctx->nextData,
                                             currentTime);
 }
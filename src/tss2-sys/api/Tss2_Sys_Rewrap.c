@@ -111,14 +111,14 @@ TSS2_RC Tss2_Sys_Rewrap_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->cmdBuffer,
-                                           ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_PRIVATE_Unmarshal(ctx->rspBuffer,
+                                           ctx->maxRspSize,
                                            &ctx->nextData, outDuplicate);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_ENCRYPTED_SECRET_Unmarshal(ctx->cmdBuffer,
-                                                    ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_ENCRYPTED_SECRET_Unmarshal(ctx->rspBuffer,
+                                                    ctx->maxRspSize,
                                                     &ctx->nextData,
                                                     outSymSeed);
 }
@@ -78,14 +78,14 @@ TSS2_RC Tss2_Sys_SequenceComplete_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->cmdBuffer,
-                                          ctx->maxCmdSize,
+    rval = Tss2_MU_TPM2B_DIGEST_Unmarshal(ctx->rspBuffer,
+                                          ctx->maxRspSize,
                                           &ctx->nextData, result);
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMT_TK_HASHCHECK_Unmarshal(ctx->cmdBuffer,
-                                               ctx->maxCmdSize,
+    return Tss2_MU_TPMT_TK_HASHCHECK_Unmarshal(ctx->rspBuffer,
+                                               ctx->maxRspSize,
                                                &ctx->nextData, validation);
 }
 
@@ -37,7 +37,7 @@ TSS2_RC Tss2_Sys_SetEncryptParam(
         return TSS2_SYS_RC_BAD_SIZE;
 
     if (currEncryptParamBuffer + encryptParamSize >
-            ctx->cmdBuffer + ctx->maxCmdSize)
+            ctx->rspBuffer + ctx->maxRspSize)
         return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
 
     memmove((void *)currEncryptParamBuffer,
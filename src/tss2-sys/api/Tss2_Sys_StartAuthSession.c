@@ -115,8 +115,8 @@ TSS2_RC Tss2_Sys_StartAuthSession_Complete(
     if (!ctx)
         return TSS2_SYS_RC_BAD_REFERENCE;
 
-    rval = Tss2_MU_UINT32_Unmarshal(ctx->cmdBuffer,
-                                    ctx->maxCmdSize,
+    rval = Tss2_MU_UINT32_Unmarshal(ctx->rspBuffer,
+                                    ctx->maxRspSize,
                                     &ctx->nextData,
                                     sessionHandle);
     if (rval)
@@ -126,8 +126,8 @@ TSS2_RC Tss2_Sys_StartAuthSession_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_NONCE_Unmarshal(ctx->cmdBuffer,
-                                         ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_NONCE_Unmarshal(ctx->rspBuffer,
+                                         ctx->maxRspSize,
                                          &ctx->nextData, nonceTPM);
 }
 
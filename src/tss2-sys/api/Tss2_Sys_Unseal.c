@@ -53,8 +53,8 @@ TSS2_RC Tss2_Sys_Unseal_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_SENSITIVE_DATA_Unmarshal(ctx->cmdBuffer,
-                                                  ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_SENSITIVE_DATA_Unmarshal(ctx->rspBuffer,
+                                                  ctx->maxRspSize,
                                                   &ctx->nextData,
                                                   outData);
 }
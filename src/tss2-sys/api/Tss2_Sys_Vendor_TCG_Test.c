@@ -62,8 +62,8 @@ TSS2_RC Tss2_Sys_Vendor_TCG_Test_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPM2B_DATA_Unmarshal(ctx->cmdBuffer,
-                                        ctx->maxCmdSize,
+    return Tss2_MU_TPM2B_DATA_Unmarshal(ctx->rspBuffer,
+                                        ctx->maxRspSize,
                                         &ctx->nextData, outputData);
 }
 
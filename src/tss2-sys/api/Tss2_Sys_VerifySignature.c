@@ -77,8 +77,8 @@ TSS2_RC Tss2_Sys_VerifySignature_Complete(
     if (rval)
         return rval;
 
-    return Tss2_MU_TPMT_TK_VERIFIED_Unmarshal(ctx->cmdBuffer,
-                                              ctx->maxCmdSize,
+    return Tss2_MU_TPMT_TK_VERIFIED_Unmarshal(ctx->rspBuffer,
+                                              ctx->maxRspSize,
                                               &ctx->nextData, validation);
 }
 
@@ -37,6 +37,8 @@ typedef struct {
     TSS2_TCTI_CONTEXT *tctiContext;
     UINT8 *cmdBuffer;
     UINT32 maxCmdSize;
+    UINT8 *rspBuffer;       /* Same as cmdBuffer unless sized separately */
+    UINT32 maxRspSize;
     UINT8 cmd_header[sizeof(TPM20_Header_In)]; /* Copy of the cmd header to allow reissue */
     TPM20_Header_Out rsp_header;
 
@@ -60,16 +62,77 @@ typedef struct {
     size_t nextData;
 } _TSS2_SYS_CONTEXT_BLOB;
 
+/*
+ * Snapshot of a prepared command. The marshaled command follows the
+ * structure in memory, so the blob can be copied as a whole.
+ */
+typedef struct {
+    TPM2_CC commandCode;    /* In host endian */
+    UINT32 commandSize;
+    UINT32 maxCmdSize;
+    UINT32 cpBufferOffset;
+    UINT32 cpBufferUsedSize;
+    UINT32 rspParamsOffset;
+    UINT8 authsCount;
+    UINT8 numResponseHandles;
+
+    struct
+    {
+        UINT16 decryptAllowed:1;
+        UINT16 encryptAllowed:1;
+        UINT16 decryptNull:1;
+        UINT16 authAllowed:1;
+    };
+} _TSS2_SYS_PREPARED_COMMAND_BLOB;
+
+typedef struct {
+    const TSS2_SYS_PREPARED_COMMAND *command;
+    UINT32 responseSize;
+    TSS2_RC rc;
+} _TSS2_SYS_BATCH_ENTRY;
+
+/*
+ * Batch of prepared commands. The entries and one response buffer of
+ * maxRspSize bytes per entry follow the structure in memory.
+ */
+typedef struct {
+    TSS2_TCTI_CONTEXT *tctiContext;
+    UINT32 maxCommands;
+    UINT32 maxRspSize;
+    UINT32 numCommands;
+    UINT32 numExecuted;
+    _TSS2_SYS_BATCH_ENTRY *entries;
+    UINT8 *rspBuffers;
+} _TSS2_SYS_BATCH_CONTEXT_BLOB;
+
 static inline _TSS2_SYS_CONTEXT_BLOB *
 syscontext_cast(TSS2_SYS_CONTEXT *ctx)
 {
     return (_TSS2_SYS_CONTEXT_BLOB*) ctx;
 }
 
+static inline _TSS2_SYS_PREPARED_COMMAND_BLOB *
+prepared_command_cast(TSS2_SYS_PREPARED_COMMAND *cmd)
+{
+    return (_TSS2_SYS_PREPARED_COMMAND_BLOB*) cmd;
+}
+
+static inline UINT8 *
+prepared_command_buffer(_TSS2_SYS_PREPARED_COMMAND_BLOB *cmd)
+{
+    return (UINT8 *)cmd + sizeof(_TSS2_SYS_PREPARED_COMMAND_BLOB);
+}
+
+static inline _TSS2_SYS_BATCH_CONTEXT_BLOB *
+batchcontext_cast(TSS2_SYS_BATCH_CONTEXT *ctx)
+{
+    return (_TSS2_SYS_BATCH_CONTEXT_BLOB*) ctx;
+}
+
 static inline TPM20_Header_Out *
 resp_header_from_cxt(_TSS2_SYS_CONTEXT_BLOB *ctx)
 {
-    return (TPM20_Header_Out *)ctx->cmdBuffer;
+    return (TPM20_Header_Out *)ctx->rspBuffer;
 }
 
 static inline TPM20_Header_In *
@@ -78,12 +141,6 @@ req_header_from_cxt(_TSS2_SYS_CONTEXT_BLOB *ctx)
     return (TPM20_Header_In *)ctx->cmdBuffer;
 }
 
-typedef struct {
-    TPM2_CC commandCode;
-    int numCommandHandles;
-    int numResponseHandles;
-} COMMAND_HANDLES;
-
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -92,6 +149,10 @@ TSS2_RC CopyCommandHeader(_TSS2_SYS_CONTEXT_BLOB *ctx, TPM2_CC commandCode);
 UINT32 GetCommandSize(_TSS2_SYS_CONTEXT_BLOB *ctx);
 void InitSysContextFields(_TSS2_SYS_CONTEXT_BLOB *ctx);
 void InitSysContextPtrs(_TSS2_SYS_CONTEXT_BLOB *ctx, size_t contextSize);
+void InitSysContextBuffers(
+    _TSS2_SYS_CONTEXT_BLOB *ctx,
+    size_t contextSize,
+    size_t maxCommandSize);
 TSS2_RC CompleteChecks(_TSS2_SYS_CONTEXT_BLOB *ctx);
 TSS2_RC CommonComplete(_TSS2_SYS_CONTEXT_BLOB *ctx);
 
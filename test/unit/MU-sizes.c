@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************
+ * Copyright (c) 2019, Intel Corporation
+ *
+ * All rights reserved.
+ ***********************************************************************/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <string.h>
+#include "tss2_mu.h"
+
+/*
+ * The size macros must be usable where an integer constant expression
+ * is required.
+ */
+static BYTE public_buffer[TSS2_MU_TPMT_PUBLIC_MAX_SIZE];
+
+/*
+ * Fixed size types always marshal to their maximum size
+ */
+static void
+mu_sizes_fixed(void **state)
+{
+    TPMS_CLOCK_INFO clock = {0};
+    TPMS_TIME_ATTEST_INFO time = {0};
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    assert_int_equal (TSS2_MU_TPMS_CLOCK_INFO_FIXED_SIZE, 1);
+    assert_int_equal (TSS2_MU_TPMS_TIME_ATTEST_INFO_FIXED_SIZE, 1);
+    assert_int_equal (TSS2_MU_TPMA_SESSION_MAX_SIZE, 1);
+    assert_int_equal (TSS2_MU_TPMS_EMPTY_MAX_SIZE, 0);
+    assert_int_equal (TSS2_MU_TPM2B_DIGEST_FIXED_SIZE, 0);
+
+    rc = Tss2_MU_TPMS_CLOCK_INFO_Marshal(&clock, NULL, 0, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, TSS2_MU_TPMS_CLOCK_INFO_MAX_SIZE);
+
+    offset = 0;
+    rc = Tss2_MU_TPMS_TIME_ATTEST_INFO_Marshal(&time, NULL, 0, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, TSS2_MU_TPMS_TIME_ATTEST_INFO_MAX_SIZE);
+}
+
+/*
+ * Sized buffers and lists filled up to their capacity
+ */
+static void
+mu_sizes_tpm2b_tpml(void **state)
+{
+    TPM2B_DIGEST digest = {0};
+    TPM2B_ECC_POINT point = {0};
+    TPML_PCR_SELECTION sel = {0};
+    uint8_t buffer[TSS2_MU_MAX(TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE,
+                               TSS2_MU_TPML_PCR_SELECTION_MAX_SIZE)] = { 0 };
+    size_t offset = 0;
+    TSS2_RC rc;
+    UINT32 i;
+
+    digest.size = sizeof(digest.buffer);
+    rc = Tss2_MU_TPM2B_DIGEST_Marshal(&digest, NULL, 0, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, TSS2_MU_TPM2B_DIGEST_MAX_SIZE);
+
+    point.point.x.size = sizeof(point.point.x.buffer);
+    point.point.y.size = sizeof(point.point.y.buffer);
+    offset = 0;
+    rc = Tss2_MU_TPM2B_ECC_POINT_Marshal(&point, buffer, sizeof(buffer),
+                                         &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, TSS2_MU_TPM2B_ECC_POINT_MAX_SIZE);
+
+    sel.count = TPM2_NUM_PCR_BANKS;
+    for (i = 0; i < sel.count; i++)
+        sel.pcrSelections[i].sizeofSelect = TPM2_PCR_SELECT_MAX;
+    offset = 0;
+    rc = Tss2_MU_TPML_PCR_SELECTION_Marshal(&sel, buffer, sizeof(buffer),
+                                            &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, TSS2_MU_TPML_PCR_SELECTION_MAX_SIZE);
+}
+
+/*
+ * The largest selector of tagged structures reaches the maximum size
+ */
+static void
+mu_sizes_tpmt(void **state)
+{
+    TPMT_PUBLIC pub = {0};
+    TPMT_SIGNATURE sig = {0};
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    pub.type = TPM2_ALG_RSA;
+    pub.nameAlg = TPM2_ALG_SHA256;
+    pub.authPolicy.size = sizeof(pub.authPolicy.buffer);
+    pub.parameters.rsaDetail.symmetric.algorithm = TPM2_ALG_AES;
+    pub.parameters.rsaDetail.scheme.scheme = TPM2_ALG_ECDAA;
+    pub.unique.rsa.size = sizeof(pub.unique.rsa.buffer);
+    rc = Tss2_MU_TPMT_PUBLIC_Marshal(&pub, public_buffer,
+                                     sizeof(public_buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, TSS2_MU_TPMT_PUBLIC_MAX_SIZE);
+
+    sig.sigAlg = TPM2_ALG_RSASSA;
+    sig.signature.rsassa.sig.size = sizeof(sig.signature.rsassa.sig.buffer);
+    offset = 0;
+    rc = Tss2_MU_TPMT_SIGNATURE_Marshal(&sig, NULL, 0, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, TSS2_MU_TPMT_SIGNATURE_MAX_SIZE);
+}
+
+/*
+ * The maximum size of a structure does not depend on the C layout
+ */
+static void
+mu_sizes_no_padding(void **state)
+{
+    assert_int_equal (TSS2_MU_TPMS_TAGGED_PROPERTY_MAX_SIZE, 8);
+    assert_int_equal (TSS2_MU_TPMS_CLOCK_INFO_MAX_SIZE, 17);
+    assert_int_equal (TSS2_MU_TPMT_SYM_DEF_OBJECT_MAX_SIZE, 6);
+    assert_true (TSS2_MU_TPMS_CLOCK_INFO_MAX_SIZE < sizeof(TPMS_CLOCK_INFO));
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (mu_sizes_fixed),
+        cmocka_unit_test (mu_sizes_tpm2b_tpml),
+        cmocka_unit_test (mu_sizes_tpmt),
+        cmocka_unit_test (mu_sizes_no_padding),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
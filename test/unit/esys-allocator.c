@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that the transient memory of parameter encryption is
+ * taken from the arena of the context, that the arena is obtained once from
+ * the allocator set with Esys_SetAllocator and reused by the next command,
+ * and that all memory is returned to the allocator. The TCTI records the
+ * command and answers with a TPM error.
+ */
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint8_t command[1024];
+    size_t command_size;
+} TCTI_ALLOC;
+
+static TPM2_RC
+tcti_alloc_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                   const uint8_t *command, size_t size,
+                   uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_ALLOC *tcti_alloc = (TCTI_ALLOC *) mock;
+
+    assert_true(size <= sizeof(tcti_alloc->command));
+    memcpy(tcti_alloc->command, command, size);
+    tcti_alloc->command_size = size;
+    return TPM2_RC_FAILURE;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_ALLOC), tcti_alloc_respond);
+}
+
+/** Statistics of the test allocator. */
+typedef struct {
+    size_t allocs;
+    size_t frees;
+    size_t last_size;
+} ALLOC_STATS;
+
+static void *
+test_alloc(void *userdata, size_t size)
+{
+    ALLOC_STATS *stats = userdata;
+
+    stats->allocs++;
+    stats->last_size = size;
+    return malloc(size);
+}
+
+static void
+test_free(void *userdata, void *ptr)
+{
+    ALLOC_STATS *stats = userdata;
+
+    stats->frees++;
+    free(ptr);
+}
+
+/** Add an XOR obfuscation session for command parameters to the context. */
+static ESYS_TR
+add_decrypt_session(ESYS_CONTEXT *esys_context)
+{
+    TSS2_RC r;
+    RSRC_NODE_T *session;
+    IESYS_SESSION *rsrc_session;
+
+    r = esys_CreateResourceObject(esys_context, ESYS_TR_MIN_OBJECT, &session);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    session->rsrc.rsrcType = IESYSC_SESSION_RSRC;
+    session->rsrc.handle = TPM2_HMAC_SESSION_FIRST;
+    rsrc_session = &session->rsrc.misc.rsrc_session;
+    rsrc_session->sessionType = TPM2_SE_HMAC;
+    rsrc_session->authHash = TPM2_ALG_SHA256;
+    rsrc_session->symmetric.algorithm = TPM2_ALG_XOR;
+    rsrc_session->symmetric.keyBits.exclusiveOr = TPM2_ALG_SHA256;
+    rsrc_session->sessionAttributes = TPMA_SESSION_DECRYPT |
+                                      TPMA_SESSION_CONTINUESESSION;
+    rsrc_session->nonceCaller.size = 32;
+    rsrc_session->nonceTPM.size = 32;
+    rsrc_session->sessionKey.size = 32;
+    memset(&rsrc_session->sessionKey.buffer[0], 0x5a, 32);
+    return ESYS_TR_MIN_OBJECT;
+}
+
+static int
+find(const uint8_t *buffer, size_t size, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i + len <= size; i++) {
+        if (memcmp(&buffer[i], data, len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static void
+test_arena_encrypt(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_ALLOC *tcti_alloc;
+    ALLOC_STATS stats = { 0 };
+    ESYS_TR session;
+    ESYS_TR sequenceHandle;
+    TPM2B_AUTH auth = {
+        .size = 16, .buffer = "sequence secret"
+    };
+    uint8_t *arena;
+
+    tcti_alloc = (TCTI_ALLOC *) tcti_mock_esys_get(esys_context);
+    session = add_decrypt_session(esys_context);
+
+    r = Esys_SetAllocator(esys_context, test_alloc, test_free, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* The first command allocates the arena */
+    r = Esys_HashSequenceStart_Async(esys_context, session, ESYS_TR_NONE,
+                                     ESYS_TR_NONE, &auth, TPM2_ALG_SHA256);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.allocs, 1);
+    assert_true(stats.last_size >= esys_context->max_command_size +
+                                   esys_context->max_response_size);
+    assert_non_null(esys_context->arena);
+    arena = esys_context->arena;
+
+    /* The auth value is sent encrypted and wiped from the arena */
+    assert_false(find(tcti_alloc->command, tcti_alloc->command_size,
+                      &auth.buffer[0], auth.size));
+    assert_false(find(esys_context->arena, esys_context->arena_size,
+                      &auth.buffer[0], auth.size));
+
+    r = Esys_HashSequenceStart_Finish(esys_context, &sequenceHandle);
+    assert_int_equal(r, TPM2_RC_FAILURE);
+
+    /* The next command reuses the arena */
+    r = Esys_HashSequenceStart_Async(esys_context, session, ESYS_TR_NONE,
+                                     ESYS_TR_NONE, &auth, TPM2_ALG_SHA256);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.allocs, 1);
+    assert_ptr_equal(esys_context->arena, arena);
+    r = Esys_HashSequenceStart_Finish(esys_context, &sequenceHandle);
+    assert_int_equal(r, TPM2_RC_FAILURE);
+
+    /* Restoring the default allocator returns the arena */
+    r = Esys_SetAllocator(esys_context, NULL, NULL, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.frees, 1);
+    assert_null(esys_context->arena);
+}
+
+static void
+test_arena_alloc(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    ALLOC_STATS stats = { 0 };
+    uint8_t *a, *b, *big;
+
+    r = Esys_SetAllocator(esys_context, test_alloc, test_free, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    a = iesys_arena_alloc(esys_context, 3);
+    b = iesys_arena_alloc(esys_context, 0);
+    assert_non_null(a);
+    assert_non_null(b);
+    assert_true(b > a);
+    assert_int_equal((uintptr_t)b % 8, 0);
+    assert_int_equal(stats.allocs, 1);
+
+    /* Memory that does not fit is allocated directly */
+    big = iesys_arena_alloc(esys_context, esys_context->arena_size);
+    assert_non_null(big);
+    assert_int_equal(stats.allocs, 2);
+    iesys_arena_free(esys_context, big);
+    assert_int_equal(stats.frees, 1);
+    iesys_arena_free(esys_context, a);
+    iesys_arena_free(esys_context, b);
+    assert_int_equal(stats.frees, 1);
+
+    /* A reset hands out the same memory again */
+    iesys_arena_reset(esys_context);
+    assert_ptr_equal(iesys_arena_alloc(esys_context, 3), a);
+    assert_int_equal(stats.allocs, 2);
+
+    r = Esys_SetAllocator(esys_context, NULL, NULL, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.frees, 2);
+}
+
+static void
+test_allocator_finalize(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context;
+    void *ctx_state;
+    ALLOC_STATS stats = { 0 };
+
+    assert_int_equal(setup(&ctx_state), 0);
+    esys_context = ctx_state;
+
+    r = Esys_SetAllocator(esys_context, test_alloc, NULL, &stats);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+    r = Esys_SetAllocator(NULL, test_alloc, test_free, &stats);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+
+    r = Esys_SetAllocator(esys_context, test_alloc, test_free, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_non_null(iesys_arena_alloc(esys_context, 16));
+
+    /* Finalize returns the arena to the allocator */
+    tcti_mock_teardown(&ctx_state);
+    assert_int_equal(stats.allocs, 1);
+    assert_int_equal(stats.frees, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_arena_encrypt,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_arena_alloc,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test(test_allocator_finalize),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
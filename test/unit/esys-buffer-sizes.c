@@ -0,0 +1,151 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_AdjustBufferSizes queries the TPM's
+ * buffer limits and resizes the SYS context accordingly, so responses
+ * larger than TPM2_MAX_COMMAND_SIZE can be received afterwards.
+ */
+
+#define BIG_RESPONSE_SIZE 6000
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t capability_count;
+    uint32_t max_command_size;
+    uint32_t max_response_size;
+    uint32_t nv_buffer_max;
+} TCTI_SIZES;
+
+/*
+ * Answer TPM2_GetCapability with the configured limits and TPM2_GetRandom
+ * with a response padded to BIG_RESPONSE_SIZE bytes.
+ */
+static TPM2_RC
+tcti_sizes_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                   const uint8_t *command, size_t size,
+                   uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_SIZES *tcti_sizes = (TCTI_SIZES *) mock;
+
+    if (command_code == TPM2_CC_GetCapability) {
+        tcti_sizes->capability_count++;
+        Tss2_MU_BYTE_Marshal(TPM2_NO, response, max, offset);
+        Tss2_MU_UINT32_Marshal(TPM2_CAP_TPM_PROPERTIES, response, max, offset);
+        Tss2_MU_UINT32_Marshal(3, response, max, offset);
+        Tss2_MU_UINT32_Marshal(TPM2_PT_MAX_COMMAND_SIZE, response, max, offset);
+        Tss2_MU_UINT32_Marshal(tcti_sizes->max_command_size, response, max,
+                               offset);
+        Tss2_MU_UINT32_Marshal(TPM2_PT_MAX_RESPONSE_SIZE, response, max,
+                               offset);
+        Tss2_MU_UINT32_Marshal(tcti_sizes->max_response_size, response, max,
+                               offset);
+        Tss2_MU_UINT32_Marshal(TPM2_PT_NV_BUFFER_MAX, response, max, offset);
+        Tss2_MU_UINT32_Marshal(tcti_sizes->nv_buffer_max, response, max,
+                               offset);
+    } else {
+        Tss2_MU_UINT16_Marshal(4, response, max, offset);
+        *offset = BIG_RESPONSE_SIZE;
+    }
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_SIZES), tcti_sizes_respond);
+}
+
+static void
+test_adjust_buffer_sizes(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_SIZES *tcti_sizes;
+    TPM2B_DIGEST *randomBytes = NULL;
+
+    tcti_sizes = (TCTI_SIZES *) tcti_mock_esys_get(esys_context);
+    tcti_sizes->max_command_size = 8192;
+    tcti_sizes->max_response_size = 8192;
+    tcti_sizes->nv_buffer_max = 1024;
+
+    r = Esys_AdjustBufferSizes(esys_context);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_sizes->capability_count, 1);
+    assert_int_equal(esys_context->max_command_size, 8192);
+    assert_int_equal(esys_context->max_response_size, 8192);
+    assert_int_equal(esys_context->nv_buffer_max, 1024);
+
+    r = Esys_GetRandom(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                       4, &randomBytes);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_non_null(randomBytes);
+    assert_int_equal(randomBytes->size, 4);
+    free(randomBytes);
+}
+
+static void
+test_adjust_buffer_sizes_small(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TSS2_SYS_CONTEXT *sys = esys_context->sys;
+    TCTI_SIZES *tcti_sizes;
+    TPM2B_DIGEST *randomBytes = NULL;
+
+    tcti_sizes = (TCTI_SIZES *) tcti_mock_esys_get(esys_context);
+    tcti_sizes->max_command_size = 2048;
+    tcti_sizes->max_response_size = 2048;
+    tcti_sizes->nv_buffer_max = 0xffff;
+
+    /* Buffers never shrink below the default and chunks fit the types */
+    r = Esys_AdjustBufferSizes(esys_context);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_ptr_equal(esys_context->sys, sys);
+    assert_int_equal(esys_context->max_command_size, TPM2_MAX_COMMAND_SIZE);
+    assert_int_equal(esys_context->max_response_size, TPM2_MAX_COMMAND_SIZE);
+    assert_int_equal(esys_context->nv_buffer_max, TPM2_MAX_NV_BUFFER_SIZE);
+
+    /* The default buffers cannot take the response */
+    r = Esys_GetRandom(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                       4, &randomBytes);
+    assert_int_equal(r, TSS2_SYS_RC_INSUFFICIENT_CONTEXT);
+    assert_null(randomBytes);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_adjust_buffer_sizes,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_adjust_buffer_sizes_small,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,312 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_EncryptDecryptStream passes the data of
+ * the read callback through TPM2_EncryptDecrypt2 in chunks of whole cipher
+ * blocks, chains the IV from chunk to chunk and hands the output to the
+ * write callback. The TCTI "encrypts" by XORing the data with the first
+ * byte of ivIn and returns that byte incremented as ivOut.
+ */
+
+/* Rounded down to 64 bytes, four AES blocks */
+#define INPUT_BUFFER 70
+#define CHUNK_SIZE 64
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t cipher_count;
+    uint32_t short_count;
+    uint32_t max_command_size;  /* Reported if not 0 */
+    uint32_t max_response_size;
+} TCTI_CIPHER;
+
+static TPM2_RC
+tcti_cipher_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                    const uint8_t *buffer, size_t size,
+                    uint8_t *rsp, size_t max, size_t *out)
+{
+    TCTI_CIPHER *tcti_cipher = (TCTI_CIPHER *) mock;
+    size_t offset = 10;
+    UINT32 auth_size;
+    TPM2B_MAX_BUFFER data;
+    TPMI_YES_NO decrypt;
+    TPMI_ALG_SYM_MODE mode;
+    TPM2B_IV iv;
+
+    switch (command_code) {
+    case TPM2_CC_GetCapability:
+        Tss2_MU_BYTE_Marshal(TPM2_NO, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(TPM2_CAP_TPM_PROPERTIES, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(tcti_cipher->max_command_size ? 3 : 1,
+                               rsp, max, out);
+        Tss2_MU_UINT32_Marshal(TPM2_PT_INPUT_BUFFER, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(INPUT_BUFFER, rsp, max, out);
+        if (tcti_cipher->max_command_size) {
+            Tss2_MU_UINT32_Marshal(TPM2_PT_MAX_COMMAND_SIZE, rsp, max, out);
+            Tss2_MU_UINT32_Marshal(tcti_cipher->max_command_size, rsp, max,
+                                   out);
+            Tss2_MU_UINT32_Marshal(TPM2_PT_MAX_RESPONSE_SIZE, rsp, max, out);
+            Tss2_MU_UINT32_Marshal(tcti_cipher->max_response_size, rsp, max,
+                                   out);
+        }
+        break;
+    case TPM2_CC_EncryptDecrypt2:
+        assert_int_equal(mock->tag, TPM2_ST_SESSIONS);
+        offset += sizeof(TPM2_HANDLE);
+        Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &auth_size);
+        offset += auth_size;
+        Tss2_MU_TPM2B_MAX_BUFFER_Unmarshal(buffer, size, &offset, &data);
+        Tss2_MU_BYTE_Unmarshal(buffer, size, &offset, &decrypt);
+        Tss2_MU_UINT16_Unmarshal(buffer, size, &offset, &mode);
+        Tss2_MU_TPM2B_IV_Unmarshal(buffer, size, &offset, &iv);
+        assert_int_equal(offset, size);
+        assert_int_equal(mode, TPM2_ALG_CBC);
+        assert_int_equal(iv.size, 16);
+        assert_true(data.size > 0 && data.size <= CHUNK_SIZE);
+        /* Only the last chunk may be short */
+        assert_int_equal(tcti_cipher->short_count, 0);
+        if (data.size < CHUNK_SIZE)
+            tcti_cipher->short_count++;
+        tcti_cipher->cipher_count++;
+
+        for (UINT16 i = 0; i < data.size; i++)
+            data.buffer[i] ^= iv.buffer[0];
+        iv.buffer[0]++;
+        Tss2_MU_TPM2B_MAX_BUFFER_Marshal(&data, rsp, max, out);
+        Tss2_MU_TPM2B_IV_Marshal(&iv, rsp, max, out);
+        break;
+    default:
+        fail_msg("Unexpected command 0x%" PRIx32, command_code);
+    }
+
+    return TPM2_RC_SUCCESS;
+}
+
+/* Source of the data; returns at most 7 bytes per call */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+} STREAM_SOURCE;
+
+static TSS2_RC
+stream_read(void *userdata, uint8_t *buffer, size_t *size)
+{
+    STREAM_SOURCE *src = userdata;
+    size_t n = src->size - src->offset;
+
+    if (n > 7)
+        n = 7;
+    if (n > *size)
+        n = *size;
+    memcpy(buffer, &src->data[src->offset], n);
+    src->offset += n;
+    *size = n;
+    return TSS2_RC_SUCCESS;
+}
+
+/* Sink of the output; fails after fail_after calls if set */
+typedef struct {
+    uint8_t data[1024];
+    size_t size;
+    size_t calls;
+    size_t fail_after;
+} STREAM_SINK;
+
+static TSS2_RC
+stream_write(void *userdata, const uint8_t *buffer, size_t size)
+{
+    STREAM_SINK *dst = userdata;
+
+    if (dst->fail_after && dst->calls == dst->fail_after)
+        return TSS2_ESYS_RC_GENERAL_FAILURE;
+    assert_true(dst->size + size <= sizeof(dst->data));
+    memcpy(&dst->data[dst->size], buffer, size);
+    dst->size += size;
+    dst->calls++;
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_CIPHER), tcti_cipher_respond);
+}
+
+static const TPM2B_IV iv_in = { .size = 16, .buffer = { 5 } };
+
+static void
+test_cipher_stream(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_CIPHER *tcti_cipher;
+    TPM2B_IV *iv_out = NULL;
+    uint8_t data[300];
+    STREAM_SOURCE src = { .data = data, .size = sizeof(data) };
+    STREAM_SINK dst = { .size = 0 };
+    size_t i;
+
+    tcti_cipher = (TCTI_CIPHER *) tcti_mock_esys_get(esys_context);
+
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i * 3;
+
+    r = Esys_EncryptDecryptStream(esys_context, ESYS_TR_RH_OWNER,
+                                  ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, TPM2_NO, TPM2_ALG_CBC,
+                                  &iv_in, stream_read, &src,
+                                  stream_write, &dst, &iv_out);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_cipher->cipher_count,
+                     (sizeof(data) + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    assert_int_equal(dst.size, sizeof(data));
+    assert_int_equal(dst.calls, tcti_cipher->cipher_count);
+
+    /* Every chunk was processed with the ivOut of the previous one */
+    for (i = 0; i < sizeof(data); i++)
+        assert_int_equal(dst.data[i], data[i] ^ (5 + i / CHUNK_SIZE));
+    assert_non_null(iv_out);
+    assert_int_equal(iv_out->size, 16);
+    assert_int_equal(iv_out->buffer[0], 5 + tcti_cipher->cipher_count);
+    SAFE_FREE(iv_out);
+
+    /* No data, no command */
+    src.size = 0;
+    src.offset = 0;
+    dst.size = 0;
+    tcti_cipher->cipher_count = 0;
+    r = Esys_EncryptDecryptStream(esys_context, ESYS_TR_RH_OWNER,
+                                  ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, TPM2_NO, TPM2_ALG_CBC,
+                                  &iv_in, stream_read, &src,
+                                  stream_write, &dst, &iv_out);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_cipher->cipher_count, 0);
+    assert_int_equal(dst.size, 0);
+    assert_memory_equal(iv_out, &iv_in, sizeof(iv_in));
+    SAFE_FREE(iv_out);
+}
+
+static void
+test_cipher_stream_split_buffers(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_CIPHER *tcti_cipher;
+    TPM2B_IV *iv_out = NULL;
+    uint8_t data[3 * CHUNK_SIZE];
+    STREAM_SOURCE src = { .data = data, .size = sizeof(data) };
+    STREAM_SINK dst = { .size = 0 };
+    size_t i;
+
+    tcti_cipher = (TCTI_CIPHER *) tcti_mock_esys_get(esys_context);
+
+    /* Limits above TPM2_MAX_COMMAND_SIZE give the SAPI context separate
+       command and response buffers */
+    tcti_cipher->max_command_size = 2 * TPM2_MAX_COMMAND_SIZE;
+    tcti_cipher->max_response_size = TPM2_MAX_COMMAND_SIZE + 512;
+
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i * 7;
+
+    r = Esys_EncryptDecryptStream(esys_context, ESYS_TR_RH_OWNER,
+                                  ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, TPM2_NO, TPM2_ALG_CBC,
+                                  &iv_in, stream_read, &src,
+                                  stream_write, &dst, &iv_out);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(esys_context->max_command_size,
+                     2 * TPM2_MAX_COMMAND_SIZE);
+    assert_int_equal(esys_context->max_response_size,
+                     TPM2_MAX_COMMAND_SIZE + 512);
+    assert_int_equal(tcti_cipher->cipher_count, 3);
+    assert_int_equal(dst.size, sizeof(data));
+    for (i = 0; i < sizeof(data); i++)
+        assert_int_equal(dst.data[i], data[i] ^ (5 + i / CHUNK_SIZE));
+    assert_non_null(iv_out);
+    assert_int_equal(iv_out->buffer[0], 5 + 3);
+    SAFE_FREE(iv_out);
+}
+
+static void
+test_cipher_stream_write_error(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_CIPHER *tcti_cipher;
+    TPM2B_IV *iv_out = NULL;
+    uint8_t data[4 * CHUNK_SIZE] = { 0 };
+    STREAM_SOURCE src = { .data = data, .size = sizeof(data) };
+    STREAM_SINK dst = { .fail_after = 1 };
+
+    tcti_cipher = (TCTI_CIPHER *) tcti_mock_esys_get(esys_context);
+
+    r = Esys_EncryptDecryptStream(esys_context, ESYS_TR_RH_OWNER,
+                                  ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, TPM2_NO, TPM2_ALG_CBC,
+                                  &iv_in, stream_read, &src,
+                                  NULL, &dst, &iv_out);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+
+    /* The chunk in flight is collected when the callback fails */
+    r = Esys_EncryptDecryptStream(esys_context, ESYS_TR_RH_OWNER,
+                                  ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, TPM2_NO, TPM2_ALG_CBC,
+                                  &iv_in, stream_read, &src,
+                                  stream_write, &dst, &iv_out);
+    assert_int_equal(r, TSS2_ESYS_RC_GENERAL_FAILURE);
+    assert_null(iv_out);
+    assert_int_equal(tcti_cipher->cipher_count, 3);
+    assert_int_equal(dst.size, CHUNK_SIZE);
+
+    /* The context is usable afterwards */
+    src.offset = 0;
+    dst.fail_after = 0;
+    r = Esys_EncryptDecryptStream(esys_context, ESYS_TR_RH_OWNER,
+                                  ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, TPM2_NO, TPM2_ALG_CBC,
+                                  &iv_in, stream_read, &src,
+                                  stream_write, &dst, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(dst.size, CHUNK_SIZE + sizeof(data));
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_cipher_stream,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_cipher_stream_split_buffers,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_cipher_stream_write_error,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -144,8 +144,13 @@ check_random(void **state)
     TSS2_RC rc;
     size_t num_bytes = 0;
     TPM2B_NONCE nonce;
+    uint8_t buffer[1024];
     rc = iesys_crypto_random2b(&nonce, num_bytes);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (nonce.size, sizeof(TPMU_HA));
+
+    rc = iesys_crypto_random(&buffer[0], sizeof(buffer));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
 }
 
 static void
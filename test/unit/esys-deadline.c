@@ -0,0 +1,386 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that the deadline set with Esys_SetDeadline bounds
+ * the whole command including resubmissions, that commands are canceled
+ * once it has passed and that Esys_GetTimings reports the time spent
+ * waiting for the TPM. The TCTI answers TPM2_GetRandom after a configurable
+ * delay and honors the receive timeout; a canceled command is answered with
+ * TPM2_RC_CANCELED at once.
+ */
+
+#define NEVER INT64_MAX
+
+typedef struct {
+    TCTI_MOCK mock;
+    int64_t delay;                /* ms until a response is ready, or NEVER */
+    int64_t ready;                /* ms when the response is ready */
+    int retries;                  /* TPM2_RC_RETRY responses to send */
+    int transmits;
+    int cancels;
+    int canceled;                 /* the next response is TPM2_RC_CANCELED */
+    int responses;
+    int blocking_only;            /* reject timeouts like mssim */
+    int32_t max_timeout;          /* largest receive timeout seen */
+} TCTI_SLOW;
+
+static int64_t
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static TPM2_RC
+tcti_slow_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                  const uint8_t *command, size_t size,
+                  uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_SLOW *tcti_slow = (TCTI_SLOW *) mock;
+    size_t in = 10;
+    UINT16 bytes;
+
+    assert_int_equal(command_code, TPM2_CC_GetRandom);
+    Tss2_MU_UINT16_Unmarshal(command, size, &in, &bytes);
+    tcti_slow->ready = (tcti_slow->delay == NEVER) ? NEVER :
+                       now_ms() + tcti_slow->delay;
+    tcti_slow->transmits++;
+
+    if (tcti_slow->retries > 0) {
+        tcti_slow->retries--;
+        return TPM2_RC_RETRY;
+    }
+    Tss2_MU_UINT16_Marshal(bytes, response, max, offset);
+    memset(&response[*offset], 0x33, bytes);
+    *offset += bytes;
+    return TPM2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_slow_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                  size_t * response_size,
+                  uint8_t * response_buffer, int32_t timeout)
+{
+    TCTI_SLOW *tcti_slow = (TCTI_SLOW *) tcti_mock_cast(tctiContext);
+    int64_t now = now_ms();
+
+    assert_non_null(tcti_slow);
+    if (tcti_slow->blocking_only && timeout != TSS2_TCTI_TIMEOUT_BLOCK)
+        return TSS2_TCTI_RC_BAD_VALUE;
+    if (!tcti_slow->canceled &&
+        (timeout > tcti_slow->max_timeout || timeout < 0))
+        tcti_slow->max_timeout = timeout;
+
+    if (now < tcti_slow->ready) {
+        /* A silent TPM must not be waited for without limit */
+        assert_true(timeout >= 0 || tcti_slow->ready != NEVER);
+        if (timeout >= 0 && now + timeout < tcti_slow->ready) {
+            usleep(timeout * 1000);
+            return TSS2_TCTI_RC_TRY_AGAIN;
+        }
+        usleep((tcti_slow->ready - now) * 1000);
+    }
+
+    tcti_slow->canceled = 0;
+    tcti_slow->responses++;
+    return tcti_mock_receive(tctiContext, response_size, response_buffer,
+                             timeout);
+}
+
+static TSS2_RC
+tcti_slow_cancel(TSS2_TCTI_CONTEXT * tctiContext)
+{
+    TCTI_SLOW *tcti_slow = (TCTI_SLOW *) tcti_mock_cast(tctiContext);
+
+    assert_non_null(tcti_slow);
+    tcti_slow->cancels++;
+    tcti_slow->canceled = 1;
+    tcti_slow->ready = now_ms();
+    tcti_mock_set_response(&tcti_slow->mock, TPM2_ST_NO_SESSIONS,
+                           TPM2_RC_CANCELED, 10);
+    return TSS2_RC_SUCCESS;
+}
+
+/* The TCTI receives without blocking but has nothing to poll */
+static TSS2_RC
+tcti_slow_get_poll_handles(TSS2_TCTI_CONTEXT * tctiContext,
+                           TSS2_TCTI_POLL_HANDLE * handles,
+                           size_t * num_handles)
+{
+    (void)(tctiContext);
+    (void)(handles);
+    *num_handles = 0;
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti;
+
+    r = tcti_mock_setup(state, sizeof(TCTI_SLOW), tcti_slow_respond);
+    if (r)
+        return (int)r;
+    assert_int_equal(Esys_GetTcti(*state, &tcti), TSS2_RC_SUCCESS);
+    TSS2_TCTI_RECEIVE(tcti) = tcti_slow_receive;
+    TSS2_TCTI_CANCEL(tcti) = tcti_slow_cancel;
+    TSS2_TCTI_GET_POLL_HANDLES(tcti) = tcti_slow_get_poll_handles;
+    return 0;
+}
+
+static TCTI_SLOW *
+context_tcti(ESYS_CONTEXT *ectx)
+{
+    return (TCTI_SLOW *) tcti_mock_esys_get(ectx);
+}
+
+static void
+test_deadline_cancel(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_SLOW *tcti_slow = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+    int64_t start;
+
+    tcti_slow->delay = NEVER;
+    r = Esys_SetDeadline(ectx, 30);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* The blocking call returns once the deadline has passed */
+    start = now_ms();
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TPM2_RC_CANCELED);
+    assert_null(random);
+    assert_true(now_ms() - start >= 30);
+    assert_true(now_ms() - start < 1000);
+    assert_int_equal(tcti_slow->cancels, 1);
+    assert_true(tcti_slow->max_timeout >= 0 && tcti_slow->max_timeout <= 30);
+    /* The response of the canceled command was drained */
+    assert_int_equal(tcti_slow->responses, 1);
+
+    /* The context can be used again */
+    tcti_slow->delay = 0;
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(random->size, 8);
+    assert_int_equal(random->buffer[7], 0x33);
+    free(random);
+    assert_int_equal(tcti_slow->cancels, 1);
+    assert_int_equal(tcti_slow->responses, 2);
+}
+
+static void
+test_deadline_async(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_SLOW *tcti_slow = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+    ESYS_STEP step;
+
+    tcti_slow->delay = NEVER;
+    r = Esys_SetTimeout(ectx, 0);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_SetDeadline(ectx, 20);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             8);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_GetRandom_Finish(ectx, &random);
+    assert_int_equal(r, TSS2_TCTI_RC_TRY_AGAIN);
+
+    usleep(30 * 1000);
+    r = Esys_GetRandom_Finish(ectx, &random);
+    assert_int_equal(r, TPM2_RC_CANCELED);
+    assert_int_equal(tcti_slow->cancels, 1);
+
+    /* Esys_Step reports the canceled command as done */
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             8);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    usleep(30 * 1000);
+    r = Esys_Step(ectx, &step, NULL, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(step, ESYS_STEP_DONE);
+    r = Esys_GetRandom_Finish(ectx, &random);
+    assert_int_equal(r, TPM2_RC_CANCELED);
+    assert_int_equal(tcti_slow->cancels, 2);
+    assert_int_equal(tcti_slow->responses, 2);
+}
+
+static void
+test_deadline_resubmission(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_SLOW *tcti_slow = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+
+    /* Every submission fits into the budget, all of them do not */
+    tcti_slow->delay = 30;
+    tcti_slow->retries = 3;
+    r = Esys_SetDeadline(ectx, 75);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TPM2_RC_CANCELED);
+    assert_int_equal(tcti_slow->transmits, 3);
+    assert_int_equal(tcti_slow->cancels, 1);
+}
+
+static void
+test_deadline_no_cancel(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_SLOW *tcti_slow = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+
+    /* Without Tss2_Tcti_Cancel the command runs on */
+    TSS2_TCTI_CANCEL(tcti_slow) = NULL;
+    tcti_slow->delay = 40;
+    r = Esys_SetDeadline(ectx, 10);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(random->size, 8);
+    free(random);
+}
+
+static void
+test_deadline_blocking_only(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_SLOW *tcti_slow = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+
+    /* Without timeouts the command runs on */
+    tcti_slow->blocking_only = 1;
+    tcti_slow->delay = 40;
+    r = Esys_SetDeadline(ectx, 10);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(random->size, 8);
+    free(random);
+    assert_int_equal(tcti_slow->cancels, 0);
+}
+
+static void
+test_timings(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_SLOW *tcti_slow = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+    ESYS_TIMINGS timings;
+
+    tcti_slow->delay = 10;
+    tcti_slow->retries = 1;
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             8);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_GetTimings(ectx, &timings);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(timings.tpm, 0);
+
+    do {
+        r = Esys_GetRandom_Finish(ectx, &random);
+    } while ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(random);
+
+    r = Esys_GetTimings(ectx, &timings);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    /* Two submissions of about 10ms each */
+    assert_true(timings.tpm >= 15000);
+    assert_true(timings.tpm < 1000000);
+    assert_true(timings.prepare < 1000000);
+    assert_true(timings.verify < 1000000);
+}
+
+static void
+test_deadline_bad_args(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    ESYS_TIMINGS timings;
+
+    r = Esys_SetDeadline(NULL, 10);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_SetDeadline(ectx, -2);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+    r = Esys_GetTimings(ectx, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_GetTimings(NULL, &timings);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_deadline_cancel,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_deadline_async,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_deadline_resubmission,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_deadline_no_cancel,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_deadline_blocking_only,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_timings,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_deadline_bad_args,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
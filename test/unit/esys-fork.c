@@ -0,0 +1,375 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_Clone copies the objects every connection
+ * can use into a context with its own TCTI and that Esys_AfterFork lets the
+ * child of fork() continue with an inherited context on a new TCTI without
+ * reusing the connection or the random bytes of its parent. Only contexts
+ * passed to Esys_Clone or Esys_AfterFork are refused in a forked child. The
+ * TCTI answers TPM2_GetRandom and counts the commands it transmitted.
+ */
+
+#define PERSISTENT_HANDLE 0x81000001
+#define NV_HANDLE 0x01000001
+#define TRANSIENT_HANDLE 0x80000001
+#define SESSION_HANDLE 0x02000000
+
+/* Exit status of the child naming the failed check */
+#define CHILD_CHECK(x) if (!(x)) _exit(__LINE__ % 250 + 1)
+
+typedef struct {
+    TCTI_MOCK mock;
+    int transmits;
+} TCTI_COUNT;
+
+/* Also runs in the child of fork(), so errors are returned, not asserted */
+static TPM2_RC
+tcti_count_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                   const uint8_t *command, size_t size,
+                   uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_COUNT *tcti_count = (TCTI_COUNT *) mock;
+    size_t in = 10;
+    UINT16 bytes;
+
+    if (command_code != TPM2_CC_GetRandom)
+        return TPM2_RC_COMMAND_CODE;
+    Tss2_MU_UINT16_Unmarshal(command, size, &in, &bytes);
+    tcti_count->transmits++;
+
+    Tss2_MU_UINT16_Marshal(bytes, response, max, offset);
+    memset(&response[*offset], 0x33, bytes);
+    *offset += bytes;
+    return TPM2_RC_SUCCESS;
+}
+
+static TCTI_COUNT *
+tcti_count_cast(TSS2_TCTI_CONTEXT * tctiContext)
+{
+    return (TCTI_COUNT *) tcti_mock_cast(tctiContext);
+}
+
+static TSS2_TCTI_CONTEXT *
+tcti_count_new(void)
+{
+    return tcti_mock_new(sizeof(TCTI_COUNT), tcti_count_respond);
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx;
+    RSRC_NODE_T *node;
+    TPM2B_AUTH auth = { .size = 3, .buffer = { 'a', 'b', 'c' } };
+    static const struct {
+        TPM2_HANDLE handle;
+        IESYSC_RESOURCE_TYPE type;
+    } objects[] = {
+        { PERSISTENT_HANDLE, IESYSC_KEY_RSRC },
+        { NV_HANDLE, IESYSC_NV_RSRC },
+        { TRANSIENT_HANDLE, IESYSC_KEY_RSRC },
+        { SESSION_HANDLE, IESYSC_SESSION_RSRC },
+    };
+    size_t i;
+
+    r = Esys_Initialize(&ectx, tcti_count_new(), NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* One object of each kind under the handles MIN_OBJECT + i */
+    for (i = 0; i < sizeof(objects) / sizeof(objects[0]); i++) {
+        r = esys_CreateResourceObject(ectx, ESYS_TR_MIN_OBJECT + i, &node);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        node->rsrc.handle = objects[i].handle;
+        node->rsrc.rsrcType = objects[i].type;
+        node->rsrc.name.size = 34;
+        memset(&node->rsrc.name.name[0], 0x10 + i, 34);
+        node->auth = auth;
+    }
+    ectx->esys_handle_cnt = ESYS_TR_MIN_OBJECT + i;
+    r = Esys_TR_SetAuth(ectx, ESYS_TR_RH_OWNER, &auth);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    *state = (void *)ectx;
+    return 0;
+}
+
+static RSRC_NODE_T *
+find_node(ESYS_CONTEXT *ectx, ESYS_TR esys_handle)
+{
+    RSRC_NODE_T *node;
+
+    for (node = ectx->rsrc_list; node != NULL; node = node->next) {
+        if (node->esys_handle == esys_handle)
+            return node;
+    }
+    return NULL;
+}
+
+static int
+get_random(ESYS_CONTEXT *ectx)
+{
+    TSS2_RC r;
+    TPM2B_DIGEST *random = NULL;
+
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    if (r != TSS2_RC_SUCCESS)
+        return 0;
+    free(random);
+    return 1;
+}
+
+static void
+test_clone(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    ESYS_CONTEXT *clone;
+    TSS2_TCTI_CONTEXT *tcti, *tcti2 = tcti_count_new();
+    RSRC_NODE_T *node, *copy;
+    ESYS_RETRY_POLICY policy = {
+        .retry = { 3, 10, 40, 0 },
+        .yielded = { 3, 10, 40, 0 },
+        .testing = { 9, 10, 40, 0 },
+    };
+    ESYS_TR object;
+
+    r = Esys_SetTimeout(ectx, 250);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_SetRetryPolicy(ectx, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_SetRandomReservoir(ectx, 64, 16);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_Clone(ectx, tcti2, &clone);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_GetTcti(clone, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_ptr_equal(tcti, tcti2);
+
+    /* Objects of every connection are known under the same handles */
+    for (object = ESYS_TR_MIN_OBJECT; object < ESYS_TR_MIN_OBJECT + 2;
+         object++) {
+        node = find_node(ectx, object);
+        copy = find_node(clone, object);
+        assert_non_null(copy);
+        assert_ptr_not_equal(copy, node);
+        assert_int_equal(copy->rsrc.handle, node->rsrc.handle);
+        assert_int_equal(copy->auth.size, 3);
+        assert_memory_equal(&copy->rsrc.name, &node->rsrc.name,
+                            sizeof(node->rsrc.name));
+    }
+    copy = find_node(clone, ESYS_TR_RH_OWNER);
+    assert_non_null(copy);
+    assert_int_equal(copy->auth.size, 3);
+
+    /* Sessions and transient objects are not */
+    assert_null(find_node(clone, ESYS_TR_MIN_OBJECT + 2));
+    assert_null(find_node(clone, ESYS_TR_MIN_OBJECT + 3));
+    assert_int_equal(clone->esys_handle_cnt, ectx->esys_handle_cnt);
+
+    /* The settings are taken over */
+    assert_int_equal(clone->timeout, 250);
+    assert_int_equal(clone->retry_policy.testing.maxSubmissions, 9);
+    assert_int_equal(clone->random_reservoir_size, 64);
+    assert_int_equal(clone->random_reservoir_fill, 0);
+
+    /* Both contexts are refused in a forked child from now on */
+    assert_true(ectx->fork_check);
+    assert_true(clone->fork_check);
+
+    /* The clone talks through its own TCTI */
+    assert_true(get_random(clone));
+    assert_int_equal(tcti_count_cast(tcti2)->transmits, 1);
+    r = Esys_GetTcti(ectx, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_count_cast(tcti)->transmits, 0);
+
+    Esys_Finalize(&clone);
+    tcti_mock_free(tcti2);
+}
+
+static void
+test_clone_bad_args(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    ESYS_CONTEXT *clone;
+    TSS2_TCTI_CONTEXT *tcti2 = tcti_count_new();
+
+    r = Esys_Clone(ectx, tcti2, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_Clone(NULL, tcti2, &clone);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    assert_null(clone);
+
+    /* A context with a command in flight */
+    ectx->state = _ESYS_STATE_SENT;
+    r = Esys_Clone(ectx, tcti2, &clone);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+    assert_null(clone);
+    ectx->state = _ESYS_STATE_INIT;
+
+    r = Esys_AfterFork(NULL, tcti2, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    tcti_mock_free(tcti2);
+}
+
+static void
+test_after_fork(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    ESYS_CONTEXT *clone;
+    TSS2_TCTI_CONTEXT *tcti, *tcti_inherited, *tcti2 = tcti_count_new();
+    uint8_t nonce_pool[sizeof(ectx->nonce_pool)];
+    pid_t pid;
+    int status;
+
+    r = Esys_GetTcti(ectx, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_SetRandomReservoir(ectx, 64, 16);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* A context passed to Esys_Clone takes part in the fork detection */
+    r = Esys_Clone(ectx, tcti2, &clone);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    Esys_Finalize(&clone);
+
+    memset(&ectx->random_reservoir[0], 0x55, 64);
+    ectx->random_reservoir_fill = 64;
+    memset(&ectx->nonce_pool[0], 0x66, sizeof(ectx->nonce_pool));
+    ectx->nonce_pool_fill = sizeof(ectx->nonce_pool);
+    memcpy(&nonce_pool[0], &ectx->nonce_pool[0], sizeof(nonce_pool));
+
+    pid = fork();
+    assert_true(pid >= 0);
+    if (pid == 0) {
+        /* The inherited connection is refused */
+        r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE,
+                                 ESYS_TR_NONE, 8);
+        CHILD_CHECK(r == TSS2_ESYS_RC_BAD_SEQUENCE);
+
+        /* Pretend ESYS loaded the inherited TCTI, so it is handed back */
+        ectx->tcti_app_param = NULL;
+        r = Esys_AfterFork(ectx, tcti2, &tcti_inherited);
+        CHILD_CHECK(r == TSS2_RC_SUCCESS);
+        CHILD_CHECK(tcti_inherited == tcti);
+
+        /* No random bytes of the parent are left */
+        CHILD_CHECK(ectx->nonce_pool_fill == 0);
+        CHILD_CHECK(ectx->random_reservoir_fill == 0);
+        CHILD_CHECK(ectx->random_reservoir_size == 64);
+
+        /* The objects of the parent's connection are gone */
+        CHILD_CHECK(find_node(ectx, ESYS_TR_MIN_OBJECT) != NULL);
+        CHILD_CHECK(find_node(ectx, ESYS_TR_MIN_OBJECT + 1) != NULL);
+        CHILD_CHECK(find_node(ectx, ESYS_TR_MIN_OBJECT + 2) == NULL);
+        CHILD_CHECK(find_node(ectx, ESYS_TR_MIN_OBJECT + 3) == NULL);
+        CHILD_CHECK(find_node(ectx, ESYS_TR_RH_OWNER) != NULL);
+
+        /* The commands go through the new TCTI */
+        CHILD_CHECK(get_random(ectx));
+        CHILD_CHECK(tcti_count_cast(tcti2)->transmits == 1);
+        CHILD_CHECK(tcti_count_cast(tcti)->transmits == 0);
+        _exit(0);
+    }
+
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 0);
+
+    /* The parent continues untouched */
+    assert_memory_equal(&ectx->nonce_pool[0], &nonce_pool[0],
+                        sizeof(nonce_pool));
+    assert_int_equal(ectx->random_reservoir_fill, 64);
+    assert_non_null(find_node(ectx, ESYS_TR_MIN_OBJECT + 3));
+    assert_true(get_random(ectx));
+    assert_int_equal(tcti_count_cast(tcti)->transmits, 1);
+    tcti_mock_free(tcti2);
+}
+
+static void
+test_fork_unaware(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TSS2_TCTI_CONTEXT *tcti, *tcti_inherited, *tcti2 = tcti_count_new();
+    pid_t pid;
+    int status;
+
+    r = Esys_GetTcti(ectx, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_false(ectx->fork_check);
+
+    pid = fork();
+    assert_true(pid >= 0);
+    if (pid == 0) {
+        /* Programs unaware of Esys_AfterFork keep the inherited connection */
+        CHILD_CHECK(get_random(ectx));
+        CHILD_CHECK(tcti_count_cast(tcti)->transmits == 1);
+
+        /* The TCTI of the application stays with the application */
+        r = Esys_AfterFork(ectx, tcti2, &tcti_inherited);
+        CHILD_CHECK(r == TSS2_RC_SUCCESS);
+        CHILD_CHECK(tcti_inherited == NULL);
+        CHILD_CHECK(ectx->fork_check);
+        CHILD_CHECK(get_random(ectx));
+        CHILD_CHECK(tcti_count_cast(tcti2)->transmits == 1);
+        _exit(0);
+    }
+
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 0);
+    tcti_mock_free(tcti2);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_clone,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_clone_bad_args,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_after_fork,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_fork_unaware,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,235 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_HashStream feeds the data of the read
+ * callback through a hash sequence in chunks of TPM2_PT_INPUT_BUFFER and
+ * passes the last chunk to TPM2_SequenceComplete. The TCTI records the
+ * data it receives and returns its size as the digest.
+ */
+
+#define INPUT_BUFFER 64
+#define SEQUENCE_HANDLE 0x80000001
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t start_count;
+    uint32_t update_count;
+    uint32_t complete_count;
+    uint32_t flush_count;
+    uint8_t data[4096];
+    size_t data_size;
+} TCTI_HASH;
+
+/* Skip the handle and the authorization area of a command */
+static void
+skip_auths(const uint8_t *buffer, size_t size, size_t *offset)
+{
+    UINT32 auth_size;
+
+    *offset += sizeof(TPM2_HANDLE);
+    Tss2_MU_UINT32_Unmarshal(buffer, size, offset, &auth_size);
+    *offset += auth_size;
+}
+
+static TPM2_RC
+tcti_hash_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                  const uint8_t *buffer, size_t size,
+                  uint8_t *rsp, size_t max, size_t *out)
+{
+    TCTI_HASH *tcti_hash = (TCTI_HASH *) mock;
+    size_t offset = 10;
+    TPM2B_MAX_BUFFER data;
+
+    switch (command_code) {
+    case TPM2_CC_GetCapability:
+        Tss2_MU_BYTE_Marshal(TPM2_NO, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(TPM2_CAP_TPM_PROPERTIES, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(1, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(TPM2_PT_INPUT_BUFFER, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(INPUT_BUFFER, rsp, max, out);
+        break;
+    case TPM2_CC_HashSequenceStart:
+        assert_int_equal(mock->tag, TPM2_ST_NO_SESSIONS);
+        tcti_hash->start_count++;
+        tcti_hash->data_size = 0;
+        Tss2_MU_UINT32_Marshal(SEQUENCE_HANDLE, rsp, max, out);
+        break;
+    case TPM2_CC_SequenceUpdate:
+    case TPM2_CC_SequenceComplete:
+        assert_int_equal(mock->tag, TPM2_ST_SESSIONS);
+        skip_auths(buffer, size, &offset);
+        Tss2_MU_TPM2B_MAX_BUFFER_Unmarshal(buffer, size, &offset, &data);
+        assert_true(data.size <= INPUT_BUFFER);
+        assert_true(tcti_hash->data_size + data.size <=
+                    sizeof(tcti_hash->data));
+        memcpy(&tcti_hash->data[tcti_hash->data_size], &data.buffer[0],
+               data.size);
+        tcti_hash->data_size += data.size;
+        if (command_code == TPM2_CC_SequenceUpdate) {
+            assert_int_equal(data.size, INPUT_BUFFER);
+            tcti_hash->update_count++;
+        } else {
+            tcti_hash->complete_count++;
+            /* The "digest" is the number of bytes hashed */
+            Tss2_MU_UINT16_Marshal(4, rsp, max, out);
+            Tss2_MU_UINT32_Marshal(tcti_hash->data_size, rsp, max, out);
+            Tss2_MU_UINT16_Marshal(TPM2_ST_HASHCHECK, rsp, max, out);
+            Tss2_MU_UINT32_Marshal(TPM2_RH_OWNER, rsp, max, out);
+            Tss2_MU_UINT16_Marshal(0, rsp, max, out);
+        }
+        break;
+    case TPM2_CC_FlushContext:
+        tcti_hash->flush_count++;
+        break;
+    default:
+        fail_msg("Unexpected command 0x%" PRIx32, command_code);
+    }
+
+    return TPM2_RC_SUCCESS;
+}
+
+/* Source of the data; returns at most 7 bytes per call */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+    size_t fail_at;
+} STREAM_SOURCE;
+
+static TSS2_RC
+stream_read(void *userdata, uint8_t *buffer, size_t *size)
+{
+    STREAM_SOURCE *src = userdata;
+    size_t n = src->size - src->offset;
+
+    if (src->fail_at && src->offset >= src->fail_at)
+        return TSS2_ESYS_RC_GENERAL_FAILURE;
+    if (n > 7)
+        n = 7;
+    if (n > *size)
+        n = *size;
+    memcpy(buffer, &src->data[src->offset], n);
+    src->offset += n;
+    *size = n;
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_HASH), tcti_hash_respond);
+}
+
+static void
+test_hash_stream(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_HASH *tcti_hash;
+    TPM2B_DIGEST *result = NULL;
+    TPMT_TK_HASHCHECK *validation = NULL;
+    uint8_t data[1000];
+    STREAM_SOURCE src = { .data = data, .size = sizeof(data) };
+    size_t i;
+
+    tcti_hash = (TCTI_HASH *) tcti_mock_esys_get(esys_context);
+
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i * 3;
+
+    r = Esys_HashStream(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                        ESYS_TR_NONE, TPM2_ALG_SHA256, TPM2_RH_OWNER,
+                        stream_read, &src, &result, &validation);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_hash->start_count, 1);
+    assert_int_equal(tcti_hash->update_count, sizeof(data) / INPUT_BUFFER);
+    assert_int_equal(tcti_hash->complete_count, 1);
+    assert_int_equal(tcti_hash->flush_count, 0);
+    assert_int_equal(tcti_hash->data_size, sizeof(data));
+    assert_memory_equal(&tcti_hash->data[0], &data[0], sizeof(data));
+    assert_non_null(result);
+    assert_int_equal(result->size, 4);
+    assert_int_equal(result->buffer[2], sizeof(data) >> 8);
+    assert_int_equal(result->buffer[3], sizeof(data) & 0xff);
+    assert_non_null(validation);
+    assert_int_equal(validation->hierarchy, TPM2_RH_OWNER);
+    SAFE_FREE(result);
+    SAFE_FREE(validation);
+
+    /* A multiple of the chunk size completes with an empty buffer */
+    src.offset = 0;
+    src.size = 2 * INPUT_BUFFER;
+    tcti_hash->update_count = 0;
+    r = Esys_HashStream(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                        ESYS_TR_NONE, TPM2_ALG_SHA256, TPM2_RH_OWNER,
+                        stream_read, &src, &result, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_hash->update_count, 2);
+    assert_int_equal(tcti_hash->data_size, 2 * INPUT_BUFFER);
+    SAFE_FREE(result);
+}
+
+static void
+test_hash_stream_read_error(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_HASH *tcti_hash;
+    TPM2B_DIGEST *result = NULL;
+    uint8_t data[300] = { 0 };
+    STREAM_SOURCE src = { .data = data, .size = sizeof(data), .fail_at = 100 };
+
+    tcti_hash = (TCTI_HASH *) tcti_mock_esys_get(esys_context);
+
+    r = Esys_HashStream(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                        ESYS_TR_NONE, TPM2_ALG_SHA256, TPM2_RH_OWNER,
+                        NULL, &src, &result, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+
+    /* The sequence is flushed when the callback fails */
+    r = Esys_HashStream(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                        ESYS_TR_NONE, TPM2_ALG_SHA256, TPM2_RH_OWNER,
+                        stream_read, &src, &result, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_GENERAL_FAILURE);
+    assert_null(result);
+    assert_int_equal(tcti_hash->update_count, 1);
+    assert_int_equal(tcti_hash->complete_count, 0);
+    assert_int_equal(tcti_hash->flush_count, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_hash_stream,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_hash_stream_read_error,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
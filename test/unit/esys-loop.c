@@ -0,0 +1,330 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that an ESYS_LOOP dispatches the responses of
+ * several contexts to their completion callbacks, follows resubmissions and
+ * commands started from a callback, serves contexts without poll handles and
+ * reports responses that do not arrive in time. The TCTI answers
+ * TPM2_GetRandom with a byte sequence and signals the response on a pipe.
+ * Like mssim, the TCTI without poll handles only accepts blocking receives.
+ */
+
+#define CONTEXTS 8
+
+typedef struct {
+    TCTI_MOCK mock;
+    int pipe[2];
+    int silent;                   /* never signal a response */
+    int retries;                  /* TPM2_RC_RETRY responses to send */
+    uint8_t fill;
+} TCTI_LOOP;
+
+static TPM2_RC
+tcti_loop_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                  const uint8_t *command, size_t size,
+                  uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_LOOP *tcti_loop = (TCTI_LOOP *) mock;
+    size_t in = 10;
+    UINT16 bytes;
+
+    assert_int_equal(command_code, TPM2_CC_GetRandom);
+    Tss2_MU_UINT16_Unmarshal(command, size, &in, &bytes);
+
+    if (!tcti_loop->silent && tcti_loop->pipe[1] >= 0)
+        assert_int_equal(write(tcti_loop->pipe[1], "r", 1), 1);
+
+    if (tcti_loop->retries > 0) {
+        tcti_loop->retries--;
+        return TPM2_RC_RETRY;
+    }
+    Tss2_MU_UINT16_Marshal(bytes, response, max, offset);
+    memset(&response[*offset], tcti_loop->fill, bytes);
+    *offset += bytes;
+    return TPM2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_loop_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                  size_t * response_size,
+                  uint8_t * response_buffer, int32_t timeout)
+{
+    TCTI_LOOP *tcti_loop = (TCTI_LOOP *) tcti_mock_cast(tctiContext);
+    char c;
+
+    assert_non_null(tcti_loop);
+    if (tcti_loop->pipe[0] < 0) {
+        if (timeout != TSS2_TCTI_TIMEOUT_BLOCK)
+            return TSS2_TCTI_RC_BAD_VALUE;
+    } else {
+        /* The loop only asks for responses that were signaled */
+        assert_int_equal(timeout, 0);
+        if (read(tcti_loop->pipe[0], &c, 1) != 1)
+            return TSS2_TCTI_RC_TRY_AGAIN;
+    }
+    return tcti_mock_receive(tctiContext, response_size, response_buffer,
+                             timeout);
+}
+
+static TSS2_RC
+tcti_loop_get_poll_handles(TSS2_TCTI_CONTEXT * tctiContext,
+                           TSS2_TCTI_POLL_HANDLE * handles,
+                           size_t * num_handles)
+{
+    TCTI_LOOP *tcti_loop = (TCTI_LOOP *) tcti_mock_cast(tctiContext);
+
+    assert_non_null(tcti_loop);
+    if (handles != NULL) {
+        handles[0].fd = tcti_loop->pipe[0];
+        handles[0].events = POLLIN;
+    }
+    *num_handles = 1;
+    return TSS2_RC_SUCCESS;
+}
+
+static ESYS_CONTEXT *
+context_new(int poll_handles, uint8_t fill)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx;
+    TSS2_TCTI_CONTEXT *tcti = tcti_mock_new(sizeof(TCTI_LOOP),
+                                            tcti_loop_respond);
+    TCTI_LOOP *tcti_loop = (TCTI_LOOP *) tcti;
+
+    TSS2_TCTI_RECEIVE(tcti) = tcti_loop_receive;
+    tcti_loop->pipe[0] = tcti_loop->pipe[1] = -1;
+    tcti_loop->fill = fill;
+    if (poll_handles) {
+        assert_int_equal(pipe(tcti_loop->pipe), 0);
+        TSS2_TCTI_GET_POLL_HANDLES(tcti) = tcti_loop_get_poll_handles;
+    }
+
+    r = Esys_Initialize(&ectx, tcti, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_SetTimeout(ectx, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    return ectx;
+}
+
+static void
+context_free(ESYS_CONTEXT *ectx)
+{
+    TSS2_TCTI_CONTEXT *tcti;
+    TCTI_LOOP *tcti_loop;
+
+    Esys_GetTcti(ectx, &tcti);
+    Esys_Finalize(&ectx);
+    tcti_loop = (TCTI_LOOP *) tcti_mock_cast(tcti);
+    if (tcti_loop->pipe[0] >= 0) {
+        close(tcti_loop->pipe[0]);
+        close(tcti_loop->pipe[1]);
+    }
+    tcti_mock_free(tcti);
+}
+
+static TCTI_LOOP *
+context_tcti(ESYS_CONTEXT *ectx)
+{
+    return (TCTI_LOOP *) tcti_mock_esys_get(ectx);
+}
+
+/** State of a context in the tests. */
+typedef struct {
+    ESYS_LOOP *loop;
+    uint8_t fill;
+    int commands;                 /* commands still to start */
+    int completed;
+    int calls;
+    TSS2_RC rc;
+} LOOP_STATE;
+
+static void
+random_done(ESYS_CONTEXT *esys_context, TSS2_RC rc, void *userdata)
+{
+    LOOP_STATE *state = userdata;
+    TPM2B_DIGEST *random_bytes = NULL;
+    TSS2_RC r;
+
+    state->calls++;
+    state->rc = rc;
+    if (rc != TSS2_RC_SUCCESS)
+        return;
+
+    r = Esys_GetRandom_Finish(esys_context, &random_bytes);
+    if ((r & ~TSS2_RC_LAYER_MASK) == TSS2_BASE_RC_TRY_AGAIN)
+        return;
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(random_bytes->size, 16);
+    assert_int_equal(random_bytes->buffer[15], state->fill);
+    free(random_bytes);
+    state->completed++;
+
+    /* Chain the next command */
+    if (--state->commands > 0) {
+        r = Esys_GetRandom_Async(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                                 ESYS_TR_NONE, 16);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        r = Esys_Loop_Add(state->loop, esys_context, -1, random_done, state);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+}
+
+static void
+test_loop_contexts(void **unused)
+{
+    TSS2_RC r;
+    ESYS_LOOP *loop;
+    ESYS_CONTEXT *ectx[CONTEXTS];
+    LOOP_STATE state[CONTEXTS];
+    int i;
+
+    (void)(unused);
+    r = Esys_Loop_Initialize(&loop);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    for (i = 0; i < CONTEXTS; i++) {
+        /* Every other context has no poll handles */
+        ectx[i] = context_new(i % 2 == 0, 0x10 + i);
+        state[i] = (LOOP_STATE) { .loop = loop, .fill = 0x10 + i,
+                                  .commands = 3 };
+        /* Context 1 and 2 have their command resubmitted */
+        if (i == 1 || i == 2)
+            context_tcti(ectx[i])->retries = 2;
+
+        r = Esys_GetRandom_Async(ectx[i], ESYS_TR_NONE, ESYS_TR_NONE,
+                                 ESYS_TR_NONE, 16);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        r = Esys_Loop_Add(loop, ectx[i], 1000, random_done, &state[i]);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+
+    r = Esys_Loop_Run(loop, -1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    for (i = 0; i < CONTEXTS; i++) {
+        assert_int_equal(state[i].completed, 3);
+        assert_int_equal(state[i].rc, TSS2_RC_SUCCESS);
+        if (i == 1 || i == 2)
+            assert_true(state[i].calls >= 5);
+        /* The context timeout is restored */
+        assert_int_equal(ectx[i]->timeout, TSS2_TCTI_TIMEOUT_BLOCK);
+        context_free(ectx[i]);
+    }
+    Esys_Loop_Finalize(&loop);
+    assert_null(loop);
+}
+
+static void
+test_loop_timeout(void **unused)
+{
+    TSS2_RC r;
+    ESYS_LOOP *loop;
+    ESYS_CONTEXT *ectx, *ectx_slow;
+    LOOP_STATE state = { .fill = 0x33, .commands = 1 };
+    LOOP_STATE state_slow = { .fill = 0x44, .commands = 1 };
+
+    (void)(unused);
+    r = Esys_Loop_Initialize(&loop);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    ectx = context_new(1, 0x33);
+    ectx_slow = context_new(1, 0x44);
+    context_tcti(ectx_slow)->silent = 1;
+
+    /* No command in flight */
+    r = Esys_Loop_Add(loop, ectx, -1, random_done, &state);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             16);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Loop_Add(loop, ectx, -1, random_done, &state);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_GetRandom_Async(ectx_slow, ESYS_TR_NONE, ESYS_TR_NONE,
+                             ESYS_TR_NONE, 16);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Loop_Add(loop, ectx_slow, 20, random_done, &state_slow);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_Loop_Run(loop, -1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(state.completed, 1);
+    assert_int_equal(state_slow.completed, 0);
+    assert_int_equal(state_slow.calls, 1);
+    assert_int_equal(state_slow.rc, TSS2_ESYS_RC_TRY_AGAIN);
+
+    /* The command of the slow context is still in flight */
+    r = Esys_Loop_Add(loop, ectx_slow, -1, random_done, &state_slow);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Loop_Run(loop, 20);
+    assert_int_equal(r, TSS2_ESYS_RC_TRY_AGAIN);
+
+    /* Deliver the response */
+    assert_int_equal(write(context_tcti(ectx_slow)->pipe[1], "r", 1), 1);
+    r = Esys_Loop_Run(loop, -1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(state_slow.completed, 1);
+
+    Esys_Loop_Finalize(&loop);
+    context_free(ectx);
+    context_free(ectx_slow);
+}
+
+static void
+test_loop_null(void **unused)
+{
+    TSS2_RC r;
+    ESYS_LOOP *loop;
+
+    (void)(unused);
+    r = Esys_Loop_Initialize(NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_Loop_Run(NULL, 0);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+
+    r = Esys_Loop_Initialize(&loop);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Loop_Add(loop, NULL, -1, random_done, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    /* An empty loop returns at once */
+    r = Esys_Loop_Run(loop, -1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    Esys_Loop_Finalize(&loop);
+    Esys_Loop_Finalize(&loop);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_loop_contexts),
+        cmocka_unit_test(test_loop_timeout),
+        cmocka_unit_test(test_loop_null),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
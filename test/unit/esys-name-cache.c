@@ -0,0 +1,189 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that the names of NV indices are cached in their
+ * resource objects and only recomputed after their public area changed. The
+ * TCTI answers every command with success and an empty password session.
+ */
+
+#define DUMMY_TR_HANDLE_NV_INDEX ESYS_TR_MIN_OBJECT
+
+/* No response parameters; the mock adds the password session */
+static TPM2_RC
+tcti_name_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                  const uint8_t *command, size_t size,
+                  uint8_t *response, size_t max, size_t *offset)
+{
+    assert_int_equal(mock->tag, TPM2_ST_SESSIONS);
+    return TPM2_RC_SUCCESS;
+}
+
+static void
+nv_public_init(TPM2B_NV_PUBLIC *nv_public)
+{
+    memset(nv_public, 0, sizeof(*nv_public));
+    nv_public->nvPublic.nvIndex = TPM2_NV_INDEX_FIRST;
+    nv_public->nvPublic.nameAlg = TPM2_ALG_SHA256;
+    nv_public->nvPublic.attributes = TPMA_NV_AUTHREAD | TPMA_NV_AUTHWRITE;
+    nv_public->nvPublic.dataSize = 32;
+}
+
+static int
+setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx;
+    RSRC_NODE_T *node = NULL;
+
+    r = tcti_mock_setup(state, sizeof(TCTI_MOCK), tcti_name_respond);
+    if (r)
+        return (int)r;
+    ectx = (ESYS_CONTEXT *) * state;
+
+    r = esys_CreateResourceObject(ectx, DUMMY_TR_HANDLE_NV_INDEX, &node);
+    if (r)
+        return (int)r;
+    node->rsrc.rsrcType = IESYSC_NV_RSRC;
+    node->rsrc.handle = TPM2_NV_INDEX_FIRST;
+    nv_public_init(&node->rsrc.misc.rsrc_nv_pub);
+    r = iesys_nv_get_name(&node->rsrc.misc.rsrc_nv_pub, &node->rsrc.name);
+    if (r)
+        return (int)r;
+
+    return 0;
+}
+
+/* Check the name of an ESYS_TR against the name of an NV public area */
+static void
+check_name(ESYS_CONTEXT *ectx, ESYS_TR nv_index, TPM2B_NV_PUBLIC *nv_public)
+{
+    TSS2_RC r;
+    TPM2B_NAME *name, expected;
+
+    r = iesys_nv_get_name(nv_public, &expected);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_TR_GetName(ectx, nv_index, &name);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(name->size, expected.size);
+    assert_memory_equal(&name->name[0], &expected.name[0], expected.size);
+    free(name);
+}
+
+static void
+test_nv_write(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    RSRC_NODE_T *node;
+    TPM2B_NV_PUBLIC nv_public;
+    TPM2B_NAME name;
+    TPM2B_MAX_NV_BUFFER data = { .size = 4, .buffer = { 1, 2, 3, 4 } };
+
+    nv_public_init(&nv_public);
+    node = esys_context->rsrc_list;
+    assert_int_equal(node->esys_handle, DUMMY_TR_HANDLE_NV_INDEX);
+    name = node->rsrc.name;
+
+    /* The first write sets TPMA_NV_WRITTEN; the name is not computed yet */
+    r = Esys_NV_Write(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                      DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                      ESYS_TR_NONE, ESYS_TR_NONE, &data, 0);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(node->name_dirty, 1);
+    assert_memory_equal(&node->rsrc.name, &name, sizeof(name));
+
+    nv_public.nvPublic.attributes |= TPMA_NV_WRITTEN;
+    check_name(esys_context, DUMMY_TR_HANDLE_NV_INDEX, &nv_public);
+    assert_int_equal(node->name_dirty, 0);
+    name = node->rsrc.name;
+
+    /* Further writes do not change the name */
+    r = Esys_NV_Write(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                      DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                      ESYS_TR_NONE, ESYS_TR_NONE, &data, 4);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(node->name_dirty, 0);
+    assert_memory_equal(&node->rsrc.name, &name, sizeof(name));
+
+    /* The write lock changes the name again */
+    r = Esys_NV_WriteLock(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                          DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                          ESYS_TR_NONE, ESYS_TR_NONE);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(node->name_dirty, 1);
+    nv_public.nvPublic.attributes |= TPMA_NV_WRITELOCKED;
+    check_name(esys_context, DUMMY_TR_HANDLE_NV_INDEX, &nv_public);
+}
+
+static void
+test_nv_define_space(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    ESYS_TR nv_index, copy;
+    RSRC_NODE_T *node;
+    TPM2B_NV_PUBLIC nv_public;
+    TPM2B_AUTH auth = { .size = 0 };
+    uint8_t *buffer;
+    size_t size;
+
+    nv_public_init(&nv_public);
+    nv_public.nvPublic.nvIndex = TPM2_NV_INDEX_FIRST + 1;
+
+    /* The name of a new NV index is computed on its first use */
+    r = Esys_NV_DefineSpace(esys_context, ESYS_TR_RH_OWNER, ESYS_TR_PASSWORD,
+                            ESYS_TR_NONE, ESYS_TR_NONE, &auth, &nv_public,
+                            &nv_index);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    for (node = esys_context->rsrc_list; node->esys_handle != nv_index;
+         node = node->next);
+    assert_int_equal(node->name_dirty, 1);
+
+    /* Serialization stores the computed name */
+    r = Esys_TR_Serialize(esys_context, nv_index, &buffer, &size);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(node->name_dirty, 0);
+    r = Esys_TR_Deserialize(esys_context, buffer, size, &copy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(buffer);
+
+    check_name(esys_context, nv_index, &nv_public);
+    check_name(esys_context, copy, &nv_public);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_nv_write,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_nv_define_space,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
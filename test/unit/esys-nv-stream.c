@@ -0,0 +1,214 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_NV_ReadStream and Esys_NV_WriteStream
+ * split transfers into chunks of the TPM's TPM2_PT_NV_BUFFER_MAX. The TCTI
+ * emulates TPM2_GetCapability, TPM2_NV_Read and TPM2_NV_Write on a
+ * password authorized NV index.
+ */
+
+#define NV_BUFFER_MAX 100
+#define NV_SIZE 2048
+
+#define DUMMY_TR_HANDLE_NV_INDEX ESYS_TR_MIN_OBJECT
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t capability_count;
+    uint32_t read_count;
+    uint32_t write_count;
+    UINT16 short_read;
+    uint8_t nv[NV_SIZE];
+} TCTI_NV;
+
+static TPM2_RC
+tcti_nv_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                const uint8_t *buffer, size_t size,
+                uint8_t *rsp, size_t max, size_t *out)
+{
+    TCTI_NV *tcti_nv = (TCTI_NV *) mock;
+    size_t offset = 10;
+    UINT32 auth_size;
+    UINT16 nv_size, nv_offset;
+    TPM2B_MAX_NV_BUFFER data;
+
+    switch (command_code) {
+    case TPM2_CC_GetCapability:
+        tcti_nv->capability_count++;
+        Tss2_MU_BYTE_Marshal(TPM2_NO, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(TPM2_CAP_TPM_PROPERTIES, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(1, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(TPM2_PT_NV_BUFFER_MAX, rsp, max, out);
+        Tss2_MU_UINT32_Marshal(NV_BUFFER_MAX, rsp, max, out);
+        break;
+    case TPM2_CC_NV_Read:
+        assert_int_equal(mock->tag, TPM2_ST_SESSIONS);
+        offset += 2 * sizeof(TPM2_HANDLE);
+        Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &auth_size);
+        offset += auth_size;
+        Tss2_MU_UINT16_Unmarshal(buffer, size, &offset, &nv_size);
+        Tss2_MU_UINT16_Unmarshal(buffer, size, &offset, &nv_offset);
+        assert_true(nv_size <= NV_BUFFER_MAX);
+        assert_true(nv_offset + nv_size <= NV_SIZE);
+        tcti_nv->read_count++;
+        if (tcti_nv->short_read && tcti_nv->read_count == tcti_nv->short_read)
+            nv_size--;
+        Tss2_MU_UINT16_Marshal(nv_size, rsp, max, out);
+        memcpy(&rsp[*out], &tcti_nv->nv[nv_offset], nv_size);
+        *out += nv_size;
+        break;
+    case TPM2_CC_NV_Write:
+        assert_int_equal(mock->tag, TPM2_ST_SESSIONS);
+        offset += 2 * sizeof(TPM2_HANDLE);
+        Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &auth_size);
+        offset += auth_size;
+        Tss2_MU_TPM2B_MAX_NV_BUFFER_Unmarshal(buffer, size, &offset, &data);
+        Tss2_MU_UINT16_Unmarshal(buffer, size, &offset, &nv_offset);
+        assert_true(data.size <= NV_BUFFER_MAX);
+        assert_true(nv_offset + data.size <= NV_SIZE);
+        tcti_nv->write_count++;
+        memcpy(&tcti_nv->nv[nv_offset], &data.buffer[0], data.size);
+        break;
+    default:
+        fail_msg("Unexpected command 0x%" PRIx32, command_code);
+    }
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx;
+    RSRC_NODE_T *node = NULL;
+
+    r = tcti_mock_setup(state, sizeof(TCTI_NV), tcti_nv_respond);
+    if (r)
+        return (int)r;
+    ectx = (ESYS_CONTEXT *) * state;
+
+    r = esys_CreateResourceObject(ectx, DUMMY_TR_HANDLE_NV_INDEX, &node);
+    if (r)
+        return (int)r;
+    node->rsrc.rsrcType = IESYSC_NV_RSRC;
+    node->rsrc.handle = TPM2_NV_INDEX_FIRST;
+    node->rsrc.misc.rsrc_nv_pub.nvPublic.nvIndex = TPM2_NV_INDEX_FIRST;
+    node->rsrc.misc.rsrc_nv_pub.nvPublic.nameAlg = TPM2_ALG_SHA256;
+    node->rsrc.misc.rsrc_nv_pub.nvPublic.attributes =
+        TPMA_NV_AUTHREAD | TPMA_NV_AUTHWRITE;
+    node->rsrc.misc.rsrc_nv_pub.nvPublic.dataSize = NV_SIZE;
+
+    return 0;
+}
+
+static void
+test_nv_stream(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_NV *tcti_nv;
+    uint8_t data[1000], readback[1000];
+    size_t i;
+
+    tcti_nv = (TCTI_NV *) tcti_mock_esys_get(esys_context);
+
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i * 7;
+
+    r = Esys_NV_WriteStream(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                            DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                            ESYS_TR_NONE, ESYS_TR_NONE,
+                            10, sizeof(data), &data[0]);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_nv->capability_count, 1);
+    assert_int_equal(tcti_nv->write_count, 10);
+    assert_memory_equal(&tcti_nv->nv[10], &data[0], sizeof(data));
+
+    /* The chunk size is only queried once */
+    r = Esys_NV_ReadStream(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                           DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                           ESYS_TR_NONE, ESYS_TR_NONE,
+                           10, sizeof(readback) - 1, &readback[0]);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_nv->capability_count, 1);
+    assert_int_equal(tcti_nv->read_count, 10);
+    assert_memory_equal(&readback[0], &data[0], sizeof(readback) - 1);
+
+    /* Nothing to transfer */
+    r = Esys_NV_ReadStream(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                           DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                           ESYS_TR_NONE, ESYS_TR_NONE, 0, 0, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_nv->read_count, 10);
+}
+
+static void
+test_nv_stream_errors(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_NV *tcti_nv;
+    uint8_t data[300] = { 0 };
+
+    tcti_nv = (TCTI_NV *) tcti_mock_esys_get(esys_context);
+
+    r = Esys_NV_WriteStream(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                            DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                            ESYS_TR_NONE, ESYS_TR_NONE,
+                            0xffff, 2, &data[0]);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    r = Esys_NV_ReadStream(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                           DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                           ESYS_TR_NONE, ESYS_TR_NONE,
+                           0, sizeof(data), NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    assert_int_equal(tcti_nv->capability_count, 0);
+
+    /* The TPM returns one byte less for the second chunk */
+    tcti_nv->short_read = 2;
+    r = Esys_NV_ReadStream(esys_context, DUMMY_TR_HANDLE_NV_INDEX,
+                           DUMMY_TR_HANDLE_NV_INDEX, ESYS_TR_PASSWORD,
+                           ESYS_TR_NONE, ESYS_TR_NONE,
+                           0, sizeof(data), &data[0]);
+    assert_int_equal(r, TSS2_ESYS_RC_MALFORMED_RESPONSE);
+    assert_int_equal(tcti_nv->read_count, 2);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_nv_stream,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_nv_stream_errors,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
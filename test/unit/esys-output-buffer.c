@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that with an output buffer set by
+ * Esys_SetOutputBuffer the outputs of Esys_PCR_Read_Finish are placed in that
+ * buffer, are replaced by the outputs of the next response, fall back to the
+ * heap if the buffer is too small and that functions built on top of the
+ * _Finish functions work with such outputs. The TCTI returns digests holding
+ * the PCR index and the bank.
+ */
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t read_count;
+    uint32_t update_counter;
+} TCTI_PCR;
+
+static TPM2_RC
+tcti_pcr_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                 const uint8_t *buffer, size_t size,
+                 uint8_t *rsp, size_t max, size_t *rsp_offset)
+{
+    TCTI_PCR *tcti_pcr = (TCTI_PCR *) mock;
+    TPML_PCR_SELECTION in, out = { 0 };
+    TPML_DIGEST values = { 0 };
+    size_t offset = 10;
+
+    assert_int_equal(command_code, TPM2_CC_PCR_Read);
+    assert_int_equal(Tss2_MU_TPML_PCR_SELECTION_Unmarshal(buffer, size,
+                                                          &offset, &in),
+                     TSS2_RC_SUCCESS);
+
+    tcti_pcr->read_count++;
+
+    for (UINT32 b = 0; b < in.count; b++) {
+        TPMS_PCR_SELECTION *sel = &in.pcrSelections[b];
+        if (sel->hash == TPM2_ALG_SHA384)
+            continue;
+        out.pcrSelections[out.count] = *sel;
+        out.count++;
+        for (UINT32 i = 0; i < (UINT32)sel->sizeofSelect * 8; i++) {
+            if (!(sel->pcrSelect[i / 8] & (1 << (i % 8))))
+                continue;
+            assert_true(values.count < 8);
+            values.digests[values.count].size = 32;
+            values.digests[values.count].buffer[0] = i;
+            values.digests[values.count].buffer[1] = sel->hash;
+            values.count++;
+        }
+    }
+
+    Tss2_MU_UINT32_Marshal(tcti_pcr->update_counter, rsp, max, rsp_offset);
+    Tss2_MU_TPML_PCR_SELECTION_Marshal(&out, rsp, max, rsp_offset);
+    Tss2_MU_TPML_DIGEST_Marshal(&values, rsp, max, rsp_offset);
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_PCR), tcti_pcr_respond);
+}
+
+static const TPML_PCR_SELECTION pcr_0_to_7 = {
+    .count = 1,
+    .pcrSelections = {
+        { .hash = TPM2_ALG_SHA256, .sizeofSelect = 3,
+          .pcrSelect = { 0xff, 0x00, 0x00 } },
+    }
+};
+
+static int
+in_buffer(const void *ptr, const uint8_t *buffer, size_t size)
+{
+    return (uintptr_t)ptr >= (uintptr_t)buffer &&
+           (uintptr_t)ptr - (uintptr_t)buffer < size;
+}
+
+static void
+test_output_buffer(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    static uint8_t buffer[sizeof(TPML_PCR_SELECTION) + sizeof(TPML_DIGEST) +
+                          16];
+    UINT32 counter;
+    TPML_PCR_SELECTION *selection, *selection2;
+    TPML_DIGEST *values, *values2;
+
+    r = Esys_SetOutputBuffer(esys_context, &buffer[1], sizeof(buffer) - 1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_PCR_Read(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                      &pcr_0_to_7, &counter, &selection, &values);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_true(in_buffer(selection, buffer, sizeof(buffer)));
+    assert_true(in_buffer(values, buffer, sizeof(buffer)));
+    assert_int_equal((uintptr_t)selection % 8, 0);
+    assert_int_equal((uintptr_t)values % 8, 0);
+    assert_int_equal(values->count, 8);
+    assert_int_equal(values->digests[7].buffer[0], 7);
+
+    /* The next response reuses the buffer */
+    r = Esys_PCR_Read(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                      &pcr_0_to_7, &counter, &selection2, &values2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_ptr_equal(selection2, selection);
+    assert_ptr_equal(values2, values);
+
+    /* Outputs that do not fit are allocated on the heap */
+    r = Esys_SetOutputBuffer(esys_context, &buffer[0],
+                             sizeof(TPML_PCR_SELECTION));
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_PCR_Read(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                      &pcr_0_to_7, &counter, &selection, &values);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_ptr_equal(selection, &buffer[0]);
+    assert_false(in_buffer(values, buffer, sizeof(buffer)));
+    assert_int_equal(values->digests[7].buffer[0], 7);
+    /* Both are freed through the context, only values is on the heap */
+    Esys_FreeOutput(esys_context, selection);
+    Esys_FreeOutput(esys_context, values);
+    assert_int_equal(selection->count, 1);
+
+    r = Esys_SetOutputBuffer(esys_context, NULL, 0);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_PCR_Read(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                      &pcr_0_to_7, &counter, &selection, &values);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_false(in_buffer(selection, buffer, sizeof(buffer)));
+    Esys_FreeOutput(esys_context, selection);
+    Esys_FreeOutput(NULL, values);
+    Esys_FreeOutput(esys_context, NULL);
+
+    r = Esys_SetOutputBuffer(NULL, buffer, sizeof(buffer));
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+}
+
+static void
+test_output_buffer_snapshot(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    static uint8_t buffer[1024];
+    TPML_PCR_SELECTION all = pcr_0_to_7, *selection;
+    TPM2B_DIGEST *digests;
+    size_t count;
+
+    /* The PCR reads of the snapshot place their outputs in the buffer */
+    all.pcrSelections[0].pcrSelect[1] = 0xff;
+    all.pcrSelections[0].pcrSelect[2] = 0xff;
+    r = Esys_SetOutputBuffer(esys_context, buffer, sizeof(buffer));
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_PCR_ReadSnapshot(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                              ESYS_TR_NONE, &all, NULL, &selection, &digests,
+                              &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(count, 24);
+    assert_int_equal(digests[23].buffer[0], 23);
+    free(selection);
+    free(digests);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_output_buffer,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_output_buffer_snapshot,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_PCR_ExtendBatch runs one TPM2_PCR_Extend
+ * or TPM2_PCR_Event per entry, continues after TPM errors and writes the
+ * TCG_PCR_EVENT2 records of the successful entries. The TCTI answers
+ * TPM2_PCR_Event with a SHA256 digest holding the PCR index.
+ */
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t extend_count;
+    uint32_t event_count;
+    uint32_t fail_at;
+} TCTI_EXTEND;
+
+static TPM2_RC
+tcti_extend_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                    const uint8_t *buffer, size_t size,
+                    uint8_t *rsp, size_t max, size_t *out)
+{
+    TCTI_EXTEND *tcti_extend = (TCTI_EXTEND *) mock;
+    TPML_DIGEST_VALUES digests = { 0 };
+    TPM2B_EVENT event;
+    TPM2_HANDLE pcr;
+    UINT32 auth_size;
+    size_t offset = 10;
+
+    Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &pcr);
+    assert_int_equal(mock->tag, TPM2_ST_SESSIONS);
+    Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &auth_size);
+    offset += auth_size;
+
+    if (tcti_extend->extend_count + tcti_extend->event_count + 1 ==
+        tcti_extend->fail_at) {
+        tcti_extend->extend_count++;
+        return TPM2_RC_LOCALITY;
+    }
+
+    switch (command_code) {
+    case TPM2_CC_PCR_Extend:
+        assert_int_equal(Tss2_MU_TPML_DIGEST_VALUES_Unmarshal(buffer, size,
+                                                              &offset,
+                                                              &digests),
+                         TSS2_RC_SUCCESS);
+        tcti_extend->extend_count++;
+        break;
+    case TPM2_CC_PCR_Event:
+        assert_int_equal(Tss2_MU_TPM2B_EVENT_Unmarshal(buffer, size,
+                                                       &offset, &event),
+                         TSS2_RC_SUCCESS);
+        tcti_extend->event_count++;
+        digests.count = 1;
+        digests.digests[0].hashAlg = TPM2_ALG_SHA256;
+        memset(&digests.digests[0].digest.sha256[0], pcr, TPM2_SHA256_DIGEST_SIZE);
+        Tss2_MU_TPML_DIGEST_VALUES_Marshal(&digests, rsp, max, out);
+        break;
+    default:
+        fail();
+    }
+    assert_int_equal(offset, size);
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_EXTEND), tcti_extend_respond);
+}
+
+/* PCR 1: SHA1 and SHA256 extend, PCR 2: event, PCR 3: SHA1 extend */
+static void
+init_entries(ESYS_PCR_EXTEND_ENTRY *entries)
+{
+    memset(entries, 0, 3 * sizeof(*entries));
+    entries[0].pcrHandle = ESYS_TR_PCR1;
+    entries[0].eventType = 0x0d;
+    entries[0].digests.count = 2;
+    entries[0].digests.digests[0].hashAlg = TPM2_ALG_SHA1;
+    memset(&entries[0].digests.digests[0].digest.sha1[0], 0x11,
+           TPM2_SHA1_DIGEST_SIZE);
+    entries[0].digests.digests[1].hashAlg = TPM2_ALG_SHA256;
+    memset(&entries[0].digests.digests[1].digest.sha256[0], 0x22,
+           TPM2_SHA256_DIGEST_SIZE);
+    entries[0].eventData.size = 3;
+    memcpy(&entries[0].eventData.buffer[0], "abc", 3);
+
+    entries[1].pcrHandle = ESYS_TR_PCR2;
+    entries[1].eventType = 0x0e;
+    entries[1].hashEvent = TPM2_YES;
+    entries[1].eventData.size = 2;
+    memcpy(&entries[1].eventData.buffer[0], "de", 2);
+
+    entries[2].pcrHandle = ESYS_TR_PCR3;
+    entries[2].eventType = 0x0f;
+    entries[2].digests.count = 1;
+    entries[2].digests.digests[0].hashAlg = TPM2_ALG_SHA1;
+}
+
+static void
+test_extend_batch(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_EXTEND *tcti_extend;
+    ESYS_PCR_EXTEND_ENTRY entries[3];
+    TSS2_RC results[3];
+    uint8_t log[2048];
+    size_t log_offset = 0;
+
+    tcti_extend = (TCTI_EXTEND *) tcti_mock_esys_get(esys_context);
+    init_entries(entries);
+
+    r = Esys_PCR_ExtendBatch(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                             ESYS_TR_NONE, entries, 3, results, log,
+                             sizeof(log), &log_offset);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_extend->extend_count, 2);
+    assert_int_equal(tcti_extend->event_count, 1);
+    for (size_t i = 0; i < 3; i++)
+        assert_int_equal(results[i], TSS2_RC_SUCCESS);
+
+    /* First record: PCR 1, type 0x0d, SHA1 and SHA256 digests, "abc" */
+    assert_int_equal(log_offset,
+                     (16 + 2 + 20 + 2 + 32 + 3) + (16 + 2 + 32 + 2) +
+                     (16 + 2 + 20));
+    assert_memory_equal(&log[0], "\x01\0\0\0\x0d\0\0\0\x02\0\0\0\x04\0", 14);
+    assert_int_equal(log[14], 0x11);
+    assert_memory_equal(&log[34], "\x0b\0", 2);
+    assert_int_equal(log[36], 0x22);
+    assert_memory_equal(&log[68], "\x03\0\0\0abc", 7);
+
+    /* Second record carries the digest computed by the TPM */
+    assert_memory_equal(&log[75], "\x02\0\0\0\x0e\0\0\0\x01\0\0\0\x0b\0", 14);
+    assert_int_equal(log[89], TPM2_PCR_FIRST + 2);
+    assert_memory_equal(&log[121], "\x02\0\0\0de", 6);
+}
+
+static void
+test_extend_batch_errors(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_EXTEND *tcti_extend;
+    ESYS_PCR_EXTEND_ENTRY entries[3];
+    TSS2_RC results[3];
+    uint8_t log[2048];
+    size_t log_offset = 0;
+
+    tcti_extend = (TCTI_EXTEND *) tcti_mock_esys_get(esys_context);
+    init_entries(entries);
+
+    /* The TPM fails the first entry, the batch goes on */
+    tcti_extend->fail_at = 1;
+    r = Esys_PCR_ExtendBatch(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                             ESYS_TR_NONE, entries, 3, results, log,
+                             sizeof(log), &log_offset);
+    assert_int_equal(r, TPM2_RC_LOCALITY);
+    assert_int_equal(results[0], TPM2_RC_LOCALITY);
+    assert_int_equal(results[1], TSS2_RC_SUCCESS);
+    assert_int_equal(results[2], TSS2_RC_SUCCESS);
+    assert_int_equal(log_offset, (16 + 2 + 32 + 2) + (16 + 2 + 20));
+    assert_int_equal(log[0], 2);
+
+    /* The event log is too small for the last entry */
+    tcti_extend->fail_at = 0;
+    tcti_extend->extend_count = 0;
+    tcti_extend->event_count = 0;
+    log_offset = sizeof(log) - 40;
+    entries[2].eventData.size = 10;
+    r = Esys_PCR_ExtendBatch(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                             ESYS_TR_NONE, &entries[2], 1, results, log,
+                             sizeof(log), &log_offset);
+    assert_int_equal(r, TSS2_ESYS_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal(results[0], TSS2_ESYS_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal(tcti_extend->extend_count, 0);
+    assert_int_equal(log_offset, sizeof(log) - 40);
+
+    /* Without an event log any handle is accepted */
+    r = Esys_PCR_ExtendBatch(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                             ESYS_TR_NONE, &entries[2], 1, NULL, NULL, 0,
+                             NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_extend->extend_count, 1);
+
+    r = Esys_PCR_ExtendBatch(esys_context, ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                             ESYS_TR_NONE, entries, 3, NULL, log,
+                             sizeof(log), NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_extend_batch,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_extend_batch_errors,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,182 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_PCR_ReadSnapshot splits a selection into
+ * TPM2_PCR_Read commands of at most 8 PCRs, merges the results and restarts
+ * when the pcrUpdateCounter changes. The TCTI does not implement the SHA384
+ * bank and returns digests holding the PCR index and the bank.
+ */
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t read_count;
+    uint32_t update_counter;
+    uint32_t change_at;
+} TCTI_PCR;
+
+static TPM2_RC
+tcti_pcr_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                 const uint8_t *buffer, size_t size,
+                 uint8_t *rsp, size_t max, size_t *rsp_offset)
+{
+    TCTI_PCR *tcti_pcr = (TCTI_PCR *) mock;
+    TPML_PCR_SELECTION in, out = { 0 };
+    TPML_DIGEST values = { 0 };
+    size_t offset = 10;
+
+    assert_int_equal(command_code, TPM2_CC_PCR_Read);
+    assert_int_equal(Tss2_MU_TPML_PCR_SELECTION_Unmarshal(buffer, size,
+                                                          &offset, &in),
+                     TSS2_RC_SUCCESS);
+
+    tcti_pcr->read_count++;
+    if (tcti_pcr->read_count == tcti_pcr->change_at)
+        tcti_pcr->update_counter++;
+
+    for (UINT32 b = 0; b < in.count; b++) {
+        TPMS_PCR_SELECTION *sel = &in.pcrSelections[b];
+        if (sel->hash == TPM2_ALG_SHA384)
+            continue;
+        out.pcrSelections[out.count] = *sel;
+        out.count++;
+        for (UINT32 i = 0; i < (UINT32)sel->sizeofSelect * 8; i++) {
+            if (!(sel->pcrSelect[i / 8] & (1 << (i % 8))))
+                continue;
+            assert_true(values.count < 8);
+            values.digests[values.count].size = 32;
+            values.digests[values.count].buffer[0] = i;
+            values.digests[values.count].buffer[1] = sel->hash;
+            values.count++;
+        }
+    }
+
+    Tss2_MU_UINT32_Marshal(tcti_pcr->update_counter, rsp, max, rsp_offset);
+    Tss2_MU_TPML_PCR_SELECTION_Marshal(&out, rsp, max, rsp_offset);
+    Tss2_MU_TPML_DIGEST_Marshal(&values, rsp, max, rsp_offset);
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_PCR), tcti_pcr_respond);
+}
+
+static const TPML_PCR_SELECTION all_pcrs = {
+    .count = 3,
+    .pcrSelections = {
+        { .hash = TPM2_ALG_SHA1, .sizeofSelect = 3,
+          .pcrSelect = { 0xff, 0xff, 0xff } },
+        { .hash = TPM2_ALG_SHA256, .sizeofSelect = 3,
+          .pcrSelect = { 0xff, 0xff, 0xff } },
+        { .hash = TPM2_ALG_SHA384, .sizeofSelect = 3,
+          .pcrSelect = { 0xff, 0xff, 0xff } },
+    }
+};
+
+static void
+test_pcr_snapshot(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_PCR *tcti_pcr;
+    TPML_PCR_SELECTION *selection = NULL;
+    TPM2B_DIGEST *values = NULL;
+    size_t count = 0;
+    UINT32 counter = 0;
+
+    tcti_pcr = (TCTI_PCR *) tcti_mock_esys_get(esys_context);
+    tcti_pcr->update_counter = 42;
+
+    r = Esys_PCR_ReadSnapshot(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                              ESYS_TR_NONE, &all_pcrs, &counter, &selection,
+                              &values, &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_pcr->read_count, 3 * 24 / 8);
+    assert_int_equal(counter, 42);
+
+    /* The SHA384 bank is not implemented */
+    assert_int_equal(count, 2 * 24);
+    assert_non_null(selection);
+    assert_int_equal(selection->count, 2);
+    assert_int_equal(selection->pcrSelections[0].hash, TPM2_ALG_SHA1);
+    assert_int_equal(selection->pcrSelections[1].hash, TPM2_ALG_SHA256);
+    assert_memory_equal(&selection->pcrSelections[1],
+                        &all_pcrs.pcrSelections[1],
+                        sizeof(TPMS_PCR_SELECTION));
+    for (size_t i = 0; i < count; i++) {
+        assert_int_equal(values[i].size, 32);
+        assert_int_equal(values[i].buffer[0], i % 24);
+        assert_int_equal(values[i].buffer[1],
+                         (i < 24) ? TPM2_ALG_SHA1 : TPM2_ALG_SHA256);
+    }
+    SAFE_FREE(selection);
+    SAFE_FREE(values);
+}
+
+static void
+test_pcr_snapshot_retry(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_PCR *tcti_pcr;
+    TPM2B_DIGEST *values = NULL;
+    size_t count = 0;
+    UINT32 counter = 0;
+
+    tcti_pcr = (TCTI_PCR *) tcti_mock_esys_get(esys_context);
+
+    /* A PCR changes between the second and the third read */
+    tcti_pcr->change_at = 3;
+    r = Esys_PCR_ReadSnapshot(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                              ESYS_TR_NONE, &all_pcrs, &counter, NULL,
+                              &values, &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_pcr->read_count, 3 + 3 * 24 / 8);
+    assert_int_equal(counter, 1);
+    assert_int_equal(count, 2 * 24);
+    SAFE_FREE(values);
+
+    r = Esys_PCR_ReadSnapshot(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                              ESYS_TR_NONE, &all_pcrs, &counter, NULL,
+                              NULL, &count);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_pcr_snapshot,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_pcr_snapshot_retry,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
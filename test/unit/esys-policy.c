@@ -0,0 +1,417 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks the policy digests computed by Esys_PolicyCalculate
+ * against digests computed as specified for the TPM, and that
+ * Esys_PolicyExecute sends the selected branch of a policy with the
+ * TPM2_PolicyOR digest list and the approvedPolicy computed locally.
+ */
+
+#define SESSION_HANDLE 0x03000000
+#define MAX_COMMANDS 8
+
+typedef struct {
+    TCTI_MOCK mock;
+    TPM2_CC commands[MAX_COMMANDS];
+    size_t command_count;
+    TPML_DIGEST or_hashes;
+    TPM2B_DIGEST approved_policy;
+} TCTI_POLICY;
+
+static TPM2_RC
+tcti_policy_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                    const uint8_t *buffer, size_t size,
+                    uint8_t *rsp, size_t max, size_t *out)
+{
+    TCTI_POLICY *tcti_policy = (TCTI_POLICY *) mock;
+    TPM2B_NONCE nonce_tpm = { .size = 32 };
+    size_t offset = 10;
+
+    assert_int_equal(mock->tag, TPM2_ST_NO_SESSIONS);
+    assert_true(tcti_policy->command_count < MAX_COMMANDS);
+    tcti_policy->commands[tcti_policy->command_count++] = command_code;
+
+    switch (command_code) {
+    case TPM2_CC_StartAuthSession:
+        memset(&nonce_tpm.buffer[0], 0x5a, nonce_tpm.size);
+        Tss2_MU_UINT32_Marshal(SESSION_HANDLE, rsp, max, out);
+        Tss2_MU_TPM2B_NONCE_Marshal(&nonce_tpm, rsp, max, out);
+        break;
+    case TPM2_CC_PolicyOR:
+        offset += sizeof(TPM2_HANDLE);
+        Tss2_MU_TPML_DIGEST_Unmarshal(buffer, size, &offset,
+                                      &tcti_policy->or_hashes);
+        break;
+    case TPM2_CC_PolicyAuthorize:
+        offset += sizeof(TPM2_HANDLE);
+        tcti_policy->approved_policy.size = 0;
+        Tss2_MU_TPM2B_DIGEST_Unmarshal(buffer, size, &offset,
+                                       &tcti_policy->approved_policy);
+        break;
+    default:
+        break;
+    }
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_POLICY), tcti_policy_respond);
+}
+
+/* Expected policy digests, computed as specified in TPM 2.0 Part 3 */
+static const BYTE secret_endorsement[] = {
+    0x83, 0x71, 0x97, 0x67, 0x44, 0x84, 0xb3, 0xf8, 0x1a, 0x90, 0xcc, 0x8d,
+    0x46, 0xa5, 0xd7, 0x24, 0xfd, 0x52, 0xd7, 0x6e, 0x06, 0x52, 0x0b, 0x64,
+    0xf2, 0xa1, 0xda, 0x1b, 0x33, 0x14, 0x69, 0xaa
+};
+
+static const BYTE auth_value[] = {
+    0x8f, 0xcd, 0x21, 0x69, 0xab, 0x92, 0x69, 0x4e, 0x0c, 0x63, 0x3f, 0x1a,
+    0xb7, 0x72, 0x84, 0x2b, 0x82, 0x41, 0xbb, 0xc2, 0x02, 0x88, 0x98, 0x1f,
+    0xc7, 0xac, 0x1e, 0xdd, 0xc1, 0xfd, 0xdb, 0x0e
+};
+
+static const BYTE or_branch0[] = {
+    0x6e, 0xbf, 0x9c, 0xb1, 0x97, 0x2c, 0xe3, 0xf9, 0xe6, 0x41, 0xf7, 0xf3,
+    0xfe, 0x64, 0x54, 0xcf, 0x1c, 0x46, 0x7c, 0xff, 0x2e, 0xb1, 0x54, 0xa0,
+    0x6d, 0x61, 0xab, 0xf7, 0xdc, 0xe7, 0xa2, 0x9c
+};
+
+static const BYTE or_branch1[] = {
+    0xf0, 0x93, 0xdc, 0x19, 0x2d, 0xb0, 0xc9, 0xdc, 0x9f, 0x97, 0x93, 0x06,
+    0x96, 0xca, 0x90, 0xfe, 0x6f, 0xb2, 0x31, 0x52, 0x3b, 0x50, 0x56, 0x17,
+    0xfa, 0x32, 0x1f, 0xdd, 0x6d, 0xa0, 0x99, 0x60
+};
+
+static const BYTE or_policy[] = {
+    0xba, 0x77, 0xbb, 0xd3, 0x7f, 0x10, 0x9b, 0x19, 0x3f, 0x0b, 0x0c, 0xe5,
+    0x4d, 0xeb, 0xbd, 0x61, 0x60, 0x2b, 0x33, 0xbf, 0x14, 0xcc, 0x62, 0x4c,
+    0xcd, 0xab, 0x1c, 0x30, 0x10, 0xd0, 0x40, 0xbf
+};
+
+static const BYTE authorize_policy[] = {
+    0x3e, 0x47, 0xbf, 0x11, 0xdb, 0x66, 0xba, 0x61, 0xc3, 0x49, 0xd1, 0xf6,
+    0x37, 0x79, 0x84, 0x4f, 0xfa, 0x97, 0x65, 0x7a, 0xce, 0x82, 0x9a, 0x02,
+    0x4b, 0x88, 0x3e, 0xab, 0x48, 0x64, 0x2e, 0xd2
+};
+
+static const BYTE nv_policy[] = {
+    0xff, 0xca, 0x5b, 0xa7, 0xdd, 0xda, 0xed, 0x06, 0x57, 0x68, 0xc2, 0x30,
+    0xac, 0xe1, 0x72, 0x17, 0x07, 0x08, 0x15, 0xdd, 0x9f, 0xf9, 0x56, 0x54,
+    0xef, 0xc0, 0x8b, 0x7c, 0x03, 0x3b, 0x69, 0x9b
+};
+
+static const BYTE dupsel_policy[] = {
+    0xc1, 0xe2, 0x80, 0x0b, 0x01, 0xc2, 0x07, 0x01, 0xc9, 0xba, 0x86, 0xdb,
+    0xff, 0x35, 0x9a, 0xd8, 0x98, 0x36, 0x86, 0xfd, 0x64, 0x1c, 0x22, 0xbf,
+    0xb4, 0x17, 0xd9, 0x5b, 0x73, 0xaf, 0x0a, 0x55
+};
+
+static void
+set_name(TPM2B_NAME *name, BYTE fill)
+{
+    name->size = sizeof(TPMI_ALG_HASH) + TPM2_SHA256_DIGEST_SIZE;
+    name->name[0] = 0x00;
+    name->name[1] = 0x0b;
+    memset(&name->name[2], fill, TPM2_SHA256_DIGEST_SIZE);
+}
+
+static void
+test_policy_calculate(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TPM2B_DIGEST digest;
+    ESYS_POLICY_ELEMENT elements[2];
+    ESYS_POLICY policy = { .elements = elements, .count = 1 };
+
+    /* The EK policy of the default EK templates */
+    memset(elements, 0, sizeof(elements));
+    elements[0].commandCode = TPM2_CC_PolicySecret;
+    elements[0].args.policySecret.authObject.handle = ESYS_TR_RH_ENDORSEMENT;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(esys_context, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(digest.size, sizeof(secret_endorsement));
+    assert_memory_equal(&digest.buffer[0], secret_endorsement,
+                        sizeof(secret_endorsement));
+
+    /* Without a context, the name has to be given */
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    /* TPM2_PolicyPassword results in the digest of TPM2_PolicyAuthValue */
+    elements[0].commandCode = TPM2_CC_PolicyPassword;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_memory_equal(&digest.buffer[0], auth_value, sizeof(auth_value));
+
+    /* A policy continues the digest that is passed in */
+    elements[0].commandCode = TPM2_CC_PolicyNV;
+    set_name(&elements[0].args.policyNV.nvIndex.name, 0x33);
+    elements[0].args.policyNV.operandB.size = 2;
+    elements[0].args.policyNV.operandB.buffer[0] = 0x01;
+    elements[0].args.policyNV.operandB.buffer[1] = 0x02;
+    elements[0].args.policyNV.offset = 4;
+    elements[0].args.policyNV.operation = TPM2_EO_EQ;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_memory_equal(&digest.buffer[0], nv_policy, sizeof(nv_policy));
+
+    /* TPM2_PolicyAuthorize replaces the digest */
+    memset(elements, 0, sizeof(elements));
+    elements[0].commandCode = TPM2_CC_PolicyAuthValue;
+    elements[1].commandCode = TPM2_CC_PolicyAuthorize;
+    set_name(&elements[1].args.policyAuthorize.keySign.name, 0x22);
+    elements[1].args.policyAuthorize.policyRef.size = 3;
+    memcpy(&elements[1].args.policyAuthorize.policyRef.buffer[0], "ref", 3);
+    policy.count = 2;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_memory_equal(&digest.buffer[0], authorize_policy,
+                        sizeof(authorize_policy));
+
+    memset(elements, 0, sizeof(elements));
+    elements[0].commandCode = TPM2_CC_PolicyDuplicationSelect;
+    set_name(&elements[0].args.policyDuplicationSelect.objectName, 0x44);
+    set_name(&elements[0].args.policyDuplicationSelect.newParentName, 0x55);
+    elements[0].args.policyDuplicationSelect.includeObject = TPM2_YES;
+    policy.count = 1;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_memory_equal(&digest.buffer[0], dupsel_policy,
+                        sizeof(dupsel_policy));
+
+    /* The digest has to match the hash algorithm */
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA1, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    elements[0].commandCode = TPM2_CC_PolicyRestart;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_NOT_IMPLEMENTED);
+}
+
+static void
+test_policy_oversized(void **state)
+{
+    TSS2_RC r;
+    TPM2B_DIGEST digest;
+    ESYS_POLICY_ELEMENT element;
+    ESYS_POLICY policy = { .elements = &element, .count = 1 };
+
+    /* Sizes beyond the buffers of the TPM2Bs are rejected */
+    memset(&element, 0, sizeof(element));
+    element.commandCode = TPM2_CC_PolicyPCR;
+    element.args.policyPCR.pcrDigest.size = 0xffff;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    element.commandCode = TPM2_CC_PolicyCpHash;
+    element.args.policyCpHash.digest.size = sizeof(TPMU_HA) + 1;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    memset(&element, 0, sizeof(element));
+    element.commandCode = TPM2_CC_PolicySecret;
+    element.args.policySecret.authObject.name.size = 0xffff;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    set_name(&element.args.policySecret.authObject.name, 0x11);
+    element.args.policySecret.policyRef.size = 0xffff;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    memset(&element, 0, sizeof(element));
+    element.commandCode = TPM2_CC_PolicyNV;
+    set_name(&element.args.policyNV.nvIndex.name, 0x33);
+    element.args.policyNV.operandB.size = 0xffff;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    memset(&element, 0, sizeof(element));
+    element.commandCode = TPM2_CC_PolicyDuplicationSelect;
+    set_name(&element.args.policyDuplicationSelect.newParentName, 0x55);
+    element.args.policyDuplicationSelect.objectName.size = 0xffff;
+    element.args.policyDuplicationSelect.includeObject = TPM2_YES;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    /* objectName is ignored without includeObject */
+    element.args.policyDuplicationSelect.includeObject = TPM2_NO;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    element.args.policyDuplicationSelect.newParentName.size =
+        sizeof(TPMU_NAME) + 1;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(NULL, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+}
+
+/*
+ * TPM2_PolicyCommandCode(TPM2_CC_Unseal) followed by a TPM2_PolicyOR of
+ * TPM2_PolicyAuthValue and TPM2_PolicyPCR.
+ */
+static void
+init_or_policy(ESYS_POLICY_ELEMENT *elements, ESYS_POLICY *branches,
+               ESYS_POLICY_ELEMENT *branch_elements)
+{
+    memset(elements, 0, 2 * sizeof(*elements));
+    memset(branch_elements, 0, 2 * sizeof(*branch_elements));
+
+    branch_elements[0].commandCode = TPM2_CC_PolicyAuthValue;
+    branch_elements[1].commandCode = TPM2_CC_PolicyPCR;
+    branch_elements[1].args.policyPCR.pcrs.count = 1;
+    branch_elements[1].args.policyPCR.pcrs.pcrSelections[0].hash =
+        TPM2_ALG_SHA256;
+    branch_elements[1].args.policyPCR.pcrs.pcrSelections[0].sizeofSelect = 3;
+    branch_elements[1].args.policyPCR.pcrs.pcrSelections[0].pcrSelect[0] = 3;
+    branch_elements[1].args.policyPCR.pcrDigest.size =
+        TPM2_SHA256_DIGEST_SIZE;
+    memset(&branch_elements[1].args.policyPCR.pcrDigest.buffer[0], 0x11,
+           TPM2_SHA256_DIGEST_SIZE);
+    branches[0].elements = &branch_elements[0];
+    branches[0].count = 1;
+    branches[1].elements = &branch_elements[1];
+    branches[1].count = 1;
+
+    elements[0].commandCode = TPM2_CC_PolicyCommandCode;
+    elements[0].args.policyCommandCode.code = TPM2_CC_Unseal;
+    elements[1].commandCode = TPM2_CC_PolicyOR;
+    elements[1].args.policyOR.branches = branches;
+    elements[1].args.policyOR.count = 2;
+}
+
+static void
+test_policy_or(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TPM2B_DIGEST digest = { .size = 0 };
+    ESYS_POLICY_ELEMENT elements[2], branch_elements[2];
+    ESYS_POLICY branches[2];
+    ESYS_POLICY policy = { .elements = elements, .count = 2 };
+
+    init_or_policy(elements, branches, branch_elements);
+    r = Esys_PolicyCalculate(esys_context, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_memory_equal(&digest.buffer[0], or_policy, sizeof(or_policy));
+
+    elements[1].args.policyOR.count = 1;
+    digest.size = 0;
+    r = Esys_PolicyCalculate(esys_context, &policy, TPM2_ALG_SHA256, &digest);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+}
+
+static void
+test_policy_execute(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_POLICY *tcti_policy;
+    ESYS_TR session;
+    TPMT_SYM_DEF symmetric = { .algorithm = TPM2_ALG_NULL };
+    ESYS_POLICY_ELEMENT elements[3], branch_elements[2];
+    ESYS_POLICY branches[2];
+    ESYS_POLICY policy = { .elements = elements, .count = 2 };
+
+    tcti_policy = (TCTI_POLICY *) tcti_mock_esys_get(esys_context);
+
+    r = Esys_StartAuthSession(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                              ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                              NULL, TPM2_SE_POLICY, &symmetric,
+                              TPM2_ALG_SHA256, &session);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    init_or_policy(elements, branches, branch_elements);
+    elements[1].args.policyOR.selected = 1;
+    memset(&elements[2], 0, sizeof(elements[2]));
+    elements[2].commandCode = TPM2_CC_PolicyAuthorize;
+    set_name(&elements[2].args.policyAuthorize.keySign.name, 0x22);
+    elements[2].args.policyAuthorize.checkTicket.tag = TPM2_ST_VERIFIED;
+    elements[2].args.policyAuthorize.checkTicket.hierarchy = TPM2_RH_OWNER;
+    policy.count = 3;
+
+    tcti_policy->command_count = 0;
+    r = Esys_PolicyExecute(esys_context, session, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* Only the selected branch is sent */
+    assert_int_equal(tcti_policy->command_count, 4);
+    assert_int_equal(tcti_policy->commands[0], TPM2_CC_PolicyCommandCode);
+    assert_int_equal(tcti_policy->commands[1], TPM2_CC_PolicyPCR);
+    assert_int_equal(tcti_policy->commands[2], TPM2_CC_PolicyOR);
+    assert_int_equal(tcti_policy->commands[3], TPM2_CC_PolicyAuthorize);
+
+    assert_int_equal(tcti_policy->or_hashes.count, 2);
+    assert_memory_equal(&tcti_policy->or_hashes.digests[0].buffer[0],
+                        or_branch0, sizeof(or_branch0));
+    assert_memory_equal(&tcti_policy->or_hashes.digests[1].buffer[0],
+                        or_branch1, sizeof(or_branch1));
+    assert_int_equal(tcti_policy->approved_policy.size, sizeof(or_policy));
+    assert_memory_equal(&tcti_policy->approved_policy.buffer[0], or_policy,
+                        sizeof(or_policy));
+
+    elements[1].args.policyOR.selected = 2;
+    r = Esys_PolicyExecute(esys_context, session, &policy);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    r = Esys_PolicyExecute(esys_context, ESYS_TR_RH_OWNER, &policy);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_policy_calculate,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test(test_policy_oversized),
+        cmocka_unit_test_setup_teardown(test_policy_or,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_policy_execute,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,311 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_tctildr.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that an ESYS_POOL hands out every context once,
+ * takes contexts back, shares the metadata of an object with all contexts
+ * under the same ESYS_TR, skips shared objects that cannot be copied into a
+ * context and finalizes the TCTIs it loaded. The TCTI loader is replaced by
+ * the mock TCTI.
+ */
+
+#define POOL_SIZE 4
+
+static int tcti_loaded;
+
+/* Shared objects with this TPM handle fail to unmarshal */
+static TPM2_HANDLE bad_handle;
+static int bad_unmarshals;
+
+TSS2_RC
+__real_iesys_MU_IESYS_RESOURCE_Unmarshal(const uint8_t *buffer, size_t size,
+                                         size_t *offset, IESYS_RESOURCE *dst);
+
+TSS2_RC
+__wrap_iesys_MU_IESYS_RESOURCE_Unmarshal(const uint8_t *buffer, size_t size,
+                                         size_t *offset, IESYS_RESOURCE *dst)
+{
+    TSS2_RC r;
+
+    r = __real_iesys_MU_IESYS_RESOURCE_Unmarshal(buffer, size, offset, dst);
+    if (r == TSS2_RC_SUCCESS && dst != NULL && dst->handle == bad_handle) {
+        bad_unmarshals++;
+        return TSS2_SYS_RC_BAD_VALUE;
+    }
+    return r;
+}
+
+TSS2_RC
+__wrap_Tss2_TctiLdr_Initialize (const char *nameConf,
+                                TSS2_TCTI_CONTEXT **tcti)
+{
+    assert_string_equal(nameConf, "fake");
+    /* No commands are sent */
+    *tcti = tcti_mock_new(sizeof(TCTI_MOCK), NULL);
+    tcti_loaded++;
+    return TSS2_RC_SUCCESS;
+}
+
+void
+__wrap_Tss2_TctiLdr_Finalize (TSS2_TCTI_CONTEXT **tcti)
+{
+    assert_non_null(tcti_mock_cast(*tcti));
+    tcti_mock_free(*tcti);
+    *tcti = NULL;
+    tcti_loaded--;
+}
+
+static void
+test_pool_acquire(void **state)
+{
+    TSS2_RC r;
+    ESYS_POOL *pool;
+    ESYS_CONTEXT *ectx[POOL_SIZE], *other;
+    int i, j;
+
+    r = Esys_Pool_Initialize(&pool, POOL_SIZE, 0, "fake", NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_loaded, POOL_SIZE);
+
+    /* Every context is handed out once */
+    for (i = 0; i < POOL_SIZE; i++) {
+        r = Esys_Pool_Acquire(pool, &ectx[i]);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        for (j = 0; j < i; j++)
+            assert_ptr_not_equal(ectx[i], ectx[j]);
+    }
+    r = Esys_Pool_Acquire(pool, &other);
+    assert_int_equal(r, TSS2_ESYS_RC_TRY_AGAIN);
+    assert_null(other);
+
+    /* A returned context is handed out again */
+    r = Esys_Pool_Release(pool, ectx[2]);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Pool_Release(pool, ectx[2]);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+    r = Esys_Pool_Acquire(pool, &other);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_ptr_equal(other, ectx[2]);
+
+    /* A context in flight cannot be returned */
+    ectx[0]->state = _ESYS_STATE_SENT;
+    r = Esys_Pool_Release(pool, ectx[0]);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+    ectx[0]->state = _ESYS_STATE_INIT;
+
+    for (i = 0; i < POOL_SIZE; i++) {
+        r = Esys_Pool_Release(pool, ectx[i]);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+
+    Esys_Pool_Finalize(&pool);
+    assert_null(pool);
+    assert_int_equal(tcti_loaded, 0);
+}
+
+static void
+test_pool_share(void **state)
+{
+    TSS2_RC r;
+    ESYS_POOL *pool;
+    ESYS_CONTEXT *ectx, *ectx2;
+    RSRC_NODE_T *node, *shared;
+    ESYS_TR object = ESYS_TR_MIN_OBJECT, pool_handle, pool_handle2;
+    int i;
+
+    r = Esys_Pool_Initialize(&pool, POOL_SIZE, 1, "fake", NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Pool_Acquire(pool, &ectx);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* A persistent key resolved by one thread */
+    r = esys_CreateResourceObject(ectx, object, &node);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    node->rsrc.handle = 0x81000001;
+    node->rsrc.rsrcType = IESYSC_KEY_RSRC;
+    node->rsrc.name.size = 34;
+    memset(&node->rsrc.name.name[0], 0xab, 34);
+    node->rsrc.misc.rsrc_key_pub.publicArea.type = TPM2_ALG_ECC;
+    node->rsrc.misc.rsrc_key_pub.publicArea.nameAlg = TPM2_ALG_SHA256;
+
+    r = Esys_Pool_Share(pool, ectx, object, &pool_handle);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = esys_GetResourceObject(ectx, pool_handle, &shared);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(shared->rsrc.handle, 0x81000001);
+
+    /* The store is full */
+    r = Esys_Pool_Share(pool, ectx, object, &pool_handle2);
+    assert_int_equal(r, TSS2_ESYS_RC_INSUFFICIENT_BUFFER);
+
+    /* All other contexts know the object under the same handle */
+    for (i = 1; i < POOL_SIZE; i++) {
+        r = Esys_Pool_Acquire(pool, &ectx2);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_ptr_not_equal(ectx2, ectx);
+        r = esys_GetResourceObject(ectx2, pool_handle, &shared);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_int_equal(shared->rsrc.handle, 0x81000001);
+        assert_int_equal(shared->rsrc.name.size, 34);
+        assert_memory_equal(&shared->rsrc.name.name[0],
+                            &node->rsrc.name.name[0], 34);
+        assert_int_equal(shared->rsrc.misc.rsrc_key_pub.publicArea.type,
+                         TPM2_ALG_ECC);
+    }
+
+    /* The object is copied into a context only once */
+    r = Esys_Pool_Release(pool, ectx2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Pool_Acquire(pool, &ectx2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    i = 0;
+    for (node = ectx2->rsrc_list; node != NULL; node = node->next)
+        i++;
+    assert_int_equal(i, 1);
+
+    /* Only checked out contexts of the pool can share objects */
+    r = Esys_Pool_Release(pool, ectx);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Pool_Share(pool, ectx, object, &pool_handle2);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+
+    Esys_Pool_Finalize(&pool);
+    assert_int_equal(tcti_loaded, 0);
+}
+
+static void
+share_key(ESYS_POOL *pool, ESYS_CONTEXT *ectx, ESYS_TR object,
+          TPM2_HANDLE handle, ESYS_TR *pool_handle)
+{
+    TSS2_RC r;
+    RSRC_NODE_T *node;
+
+    r = esys_CreateResourceObject(ectx, object, &node);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    node->rsrc.handle = handle;
+    node->rsrc.rsrcType = IESYSC_KEY_RSRC;
+    node->rsrc.misc.rsrc_key_pub.publicArea.type = TPM2_ALG_ECC;
+    node->rsrc.misc.rsrc_key_pub.publicArea.nameAlg = TPM2_ALG_SHA256;
+
+    r = Esys_Pool_Share(pool, ectx, object, pool_handle);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+}
+
+static void
+test_pool_bad_object(void **state)
+{
+    TSS2_RC r;
+    ESYS_POOL *pool;
+    ESYS_CONTEXT *ectx, *ectx2;
+    RSRC_NODE_T *shared;
+    ESYS_TR pool_handle[3];
+    int i;
+
+    r = Esys_Pool_Initialize(&pool, 2, 3, "fake", NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Pool_Acquire(pool, &ectx);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* The second of three shared objects is broken */
+    bad_handle = 0x81000002;
+    bad_unmarshals = 0;
+    share_key(pool, ectx, ESYS_TR_MIN_OBJECT, 0x81000001, &pool_handle[0]);
+    share_key(pool, ectx, ESYS_TR_MIN_OBJECT + 1, 0x81000002,
+              &pool_handle[1]);
+    share_key(pool, ectx, ESYS_TR_MIN_OBJECT + 2, 0x81000003,
+              &pool_handle[2]);
+    assert_int_equal(bad_unmarshals, 1);
+
+    /* The other context is usable and knows the other objects */
+    for (i = 0; i < 2; i++) {
+        r = Esys_Pool_Acquire(pool, &ectx2);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_ptr_not_equal(ectx2, ectx);
+        r = esys_GetResourceObject(ectx2, pool_handle[0], &shared);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        r = esys_GetResourceObject(ectx2, pool_handle[1], &shared);
+        assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+        r = esys_GetResourceObject(ectx2, pool_handle[2], &shared);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_int_equal(shared->rsrc.handle, 0x81000003);
+        r = Esys_Pool_Release(pool, ectx2);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+
+    /* The broken object is tried once per context */
+    assert_int_equal(bad_unmarshals, 2);
+    bad_handle = 0;
+
+    Esys_Pool_Finalize(&pool);
+    assert_int_equal(tcti_loaded, 0);
+}
+
+static void
+test_pool_bad_args(void **state)
+{
+    TSS2_RC r;
+    ESYS_POOL *pool, *pool2;
+    ESYS_CONTEXT *ectx;
+
+    r = Esys_Pool_Initialize(NULL, POOL_SIZE, 0, "fake", NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_Pool_Initialize(&pool, 0, 0, "fake", NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+    assert_null(pool);
+
+    r = Esys_Pool_Initialize(&pool, 1, 0, "fake", NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Pool_Initialize(&pool2, 1, 0, "fake", NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Pool_Acquire(pool, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+
+    /* A context of another pool */
+    r = Esys_Pool_Acquire(pool2, &ectx);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Pool_Release(pool, ectx);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+    r = Esys_Pool_Release(pool2, ectx);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    Esys_Pool_Finalize(&pool);
+    Esys_Pool_Finalize(&pool2);
+    Esys_Pool_Finalize(&pool2);
+    assert_int_equal(tcti_loaded, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_pool_acquire),
+        cmocka_unit_test(test_pool_share),
+        cmocka_unit_test(test_pool_bad_object),
+        cmocka_unit_test(test_pool_bad_args),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,219 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_GetRandomBytes issues as many
+ * TPM2_GetRandom commands as needed and that the random reservoir serves
+ * small requests from memory. The TCTI returns at most RANDOM_MAX bytes
+ * per command, counting up from 0. It also checks that caller nonces are
+ * taken from the nonce pool of the context.
+ */
+
+#define RANDOM_MAX 32
+
+typedef struct {
+    TCTI_MOCK mock;
+    UINT16 requested;
+    uint32_t count;
+    uint8_t next;
+} TCTI_RANDOM;
+
+static TPM2_RC
+tcti_random_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                    const uint8_t *command, size_t size,
+                    uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_RANDOM *tcti_random = (TCTI_RANDOM *) mock;
+    size_t in = 10;
+    UINT16 n, i;
+
+    assert_int_equal(command_code, TPM2_CC_GetRandom);
+    Tss2_MU_UINT16_Unmarshal(command, size, &in, &tcti_random->requested);
+    assert_true(tcti_random->requested > 0);
+    assert_true(tcti_random->requested <= sizeof(TPMU_HA));
+    tcti_random->count++;
+
+    n = (tcti_random->requested < RANDOM_MAX) ?
+        tcti_random->requested : RANDOM_MAX;
+    Tss2_MU_UINT16_Marshal(n, response, max, offset);
+    for (i = 0; i < n; i++)
+        response[(*offset)++] = tcti_random->next++;
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_RANDOM), tcti_random_respond);
+}
+
+static void
+test_random_bytes(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_RANDOM *tcti_random;
+    uint8_t data[4096];
+    size_t i;
+
+    tcti_random = (TCTI_RANDOM *) tcti_mock_esys_get(esys_context);
+
+    r = Esys_GetRandomBytes(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                            ESYS_TR_NONE, sizeof(data) - 1, &data[0]);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_random->count, sizeof(data) / RANDOM_MAX);
+    for (i = 0; i < sizeof(data) - 1; i++)
+        assert_int_equal(data[i], i & 0xff);
+
+    r = Esys_GetRandomBytes(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                            ESYS_TR_NONE, 0, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_random->count, sizeof(data) / RANDOM_MAX);
+
+    r = Esys_GetRandomBytes(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                            ESYS_TR_NONE, 1, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+}
+
+static void
+test_random_reservoir(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_RANDOM *tcti_random;
+    uint8_t data[16];
+    int i;
+
+    tcti_random = (TCTI_RANDOM *) tcti_mock_esys_get(esys_context);
+
+    r = Esys_SetRandomReservoir(esys_context, 64, 65);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    r = Esys_SetRandomReservoir(esys_context, 8 * RANDOM_MAX, 4 * sizeof(data));
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* The first request goes to the TPM and fills the reservoir */
+    r = Esys_GetRandomBytes(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                            ESYS_TR_NONE, sizeof(data), &data[0]);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_random->count, 1 + 8);
+
+    /* Served from memory until the low-water mark is crossed */
+    for (i = 0; i < 12; i++) {
+        r = Esys_GetRandomBytes(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                                ESYS_TR_NONE, sizeof(data), &data[0]);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+    assert_int_equal(tcti_random->count, 1 + 8);
+    assert_int_equal(esys_context->random_reservoir_fill, 4 * sizeof(data));
+
+    r = Esys_GetRandomBytes(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                            ESYS_TR_NONE, sizeof(data), &data[0]);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_random->count, 1 + 8 + 7);
+    assert_int_equal(esys_context->random_reservoir_fill, 8 * RANDOM_MAX);
+
+    /* Requests with sessions neither use nor refill the reservoir; the
+       unknown session shows that the TPM path was taken */
+    r = Esys_GetRandomBytes(esys_context, ESYS_TR_MIN_OBJECT + 5, ESYS_TR_NONE,
+                            ESYS_TR_NONE, sizeof(data), &data[0]);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+    assert_int_equal(tcti_random->count, 1 + 8 + 7);
+    assert_int_equal(esys_context->random_reservoir_fill, 8 * RANDOM_MAX);
+
+    /* Disable the reservoir again */
+    r = Esys_SetRandomReservoir(esys_context, 0, 0);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_null(esys_context->random_reservoir);
+    r = Esys_GetRandomBytes(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                            ESYS_TR_NONE, sizeof(data), &data[0]);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_random->count, 1 + 8 + 7 + 1);
+}
+
+static void
+test_nonce_pool(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    RSRC_NODE_T *session = NULL;
+    TPM2B_NONCE first;
+    int i;
+
+    r = esys_CreateResourceObject(esys_context, ESYS_TR_MIN_OBJECT, &session);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    session->rsrc.rsrcType = IESYSC_SESSION_RSRC;
+    session->rsrc.misc.rsrc_session.nonceCaller.size = 32;
+    esys_context->session_tab[0] = session;
+
+    /* The first nonce fills the pool */
+    r = iesys_gen_caller_nonces(esys_context);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(esys_context->nonce_pool_fill,
+                     _ESYS_NONCE_POOL_SIZE - 32);
+    first = session->rsrc.misc.rsrc_session.nonceCaller;
+    assert_int_equal(first.size, 32);
+
+    /* Used bytes are wiped from the pool */
+    for (i = 0; i < 32; i++)
+        assert_int_equal(esys_context->nonce_pool[_ESYS_NONCE_POOL_SIZE - 32 + i],
+                         0);
+
+    r = iesys_gen_caller_nonces(esys_context);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_true(memcmp(&first.buffer[0],
+                       &session->rsrc.misc.rsrc_session.nonceCaller.buffer[0],
+                       32) != 0);
+
+    /* An exhausted pool is refilled */
+    for (i = 2; i < _ESYS_NONCE_POOL_SIZE / 32; i++) {
+        r = iesys_gen_caller_nonces(esys_context);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+    assert_int_equal(esys_context->nonce_pool_fill, 0);
+    r = iesys_gen_caller_nonces(esys_context);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(esys_context->nonce_pool_fill,
+                     _ESYS_NONCE_POOL_SIZE - 32);
+
+    esys_context->session_tab[0] = NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_random_bytes,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_random_reservoir,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_nonce_pool,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,380 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that the retry policy set with Esys_SetRetryPolicy
+ * delays the resubmissions of a command with an exponential backoff, limits
+ * their number per response code and that Esys_GetRetryStats reports them.
+ * The TCTI answers TPM2_GetRandom with a configurable number of busy
+ * responses and records when the command was transmitted.
+ */
+
+#define MAX_TRANSMITS 16
+
+typedef struct {
+    TCTI_MOCK mock;
+    TPM2_RC busy_rc;              /* the busy response code */
+    int busy;                     /* busy responses to send */
+    int transmits;
+    int64_t sent[MAX_TRANSMITS];  /* ms when the command was transmitted */
+} TCTI_BUSY;
+
+static int64_t
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static TPM2_RC
+tcti_busy_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                  const uint8_t *command, size_t size,
+                  uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_BUSY *tcti_busy = (TCTI_BUSY *) mock;
+    size_t in = 10;
+    UINT16 bytes;
+
+    assert_int_equal(command_code, TPM2_CC_GetRandom);
+    Tss2_MU_UINT16_Unmarshal(command, size, &in, &bytes);
+    assert_true(tcti_busy->transmits < MAX_TRANSMITS);
+    tcti_busy->sent[tcti_busy->transmits++] = now_ms();
+
+    if (tcti_busy->busy > 0) {
+        tcti_busy->busy--;
+        return tcti_busy->busy_rc;
+    }
+    Tss2_MU_UINT16_Marshal(bytes, response, max, offset);
+    memset(&response[*offset], 0x33, bytes);
+    *offset += bytes;
+    return TPM2_RC_SUCCESS;
+}
+
+/* The TCTI receives without blocking but has nothing to poll */
+static TSS2_RC
+tcti_busy_get_poll_handles(TSS2_TCTI_CONTEXT * tctiContext,
+                           TSS2_TCTI_POLL_HANDLE * handles,
+                           size_t * num_handles)
+{
+    (void)(tctiContext);
+    (void)(handles);
+    *num_handles = 0;
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    TSS2_RC r;
+    TSS2_TCTI_CONTEXT *tcti;
+
+    r = tcti_mock_setup(state, sizeof(TCTI_BUSY), tcti_busy_respond);
+    if (r)
+        return (int)r;
+    assert_int_equal(Esys_GetTcti(*state, &tcti), TSS2_RC_SUCCESS);
+    TSS2_TCTI_GET_POLL_HANDLES(tcti) = tcti_busy_get_poll_handles;
+    ((TCTI_BUSY *) tcti)->busy_rc = TPM2_RC_RETRY;
+    return 0;
+}
+
+static TCTI_BUSY *
+context_tcti(ESYS_CONTEXT *ectx)
+{
+    return (TCTI_BUSY *) tcti_mock_esys_get(ectx);
+}
+
+static void
+test_retry_default(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_BUSY *tcti_busy = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+    ESYS_RETRY_STATS stats;
+
+    /* Without a policy the command is resubmitted immediately */
+    tcti_busy->busy = 2;
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(random);
+    assert_int_equal(tcti_busy->transmits, 3);
+
+    r = Esys_GetRetryStats(ectx, TPM2_CC_GetRandom, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.retries, 2);
+    assert_int_equal(stats.delay, 0);
+    assert_int_equal(stats.exhausted, 0);
+
+    /* Other commands have their own statistics */
+    r = Esys_GetRetryStats(ectx, TPM2_CC_Hash, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.retries, 0);
+}
+
+static void
+test_retry_backoff(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_BUSY *tcti_busy = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+    ESYS_RETRY_STATS stats;
+    ESYS_RETRY_POLICY policy = {
+        .retry = { 5, 10, 25, 0 },
+        .yielded = { 1, 0, 0, 0 },
+        .testing = { 1, 0, 0, 0 },
+    };
+
+    r = Esys_SetRetryPolicy(ectx, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* Waits of 10, 20 and 25 ms before the resubmissions */
+    tcti_busy->busy = 3;
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(random->size, 8);
+    free(random);
+    assert_int_equal(tcti_busy->transmits, 4);
+    assert_true(tcti_busy->sent[1] - tcti_busy->sent[0] >= 9);
+    assert_true(tcti_busy->sent[2] - tcti_busy->sent[1] >= 19);
+    assert_true(tcti_busy->sent[3] - tcti_busy->sent[2] >= 24);
+    assert_true(tcti_busy->sent[3] - tcti_busy->sent[0] < 1000);
+
+    r = Esys_GetRetryStats(ectx, TPM2_CC_GetRandom, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.retries, 3);
+    assert_int_equal(stats.delay, 55);
+    assert_int_equal(stats.exhausted, 0);
+
+    /* The submissions are used up */
+    tcti_busy->transmits = 0;
+    tcti_busy->busy = 10;
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TPM2_RC_RETRY);
+    assert_int_equal(tcti_busy->transmits, 5);
+
+    r = Esys_GetRetryStats(ectx, TPM2_CC_GetRandom, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.retries, 7);
+    assert_int_equal(stats.delay, 55 + 80);
+    assert_int_equal(stats.exhausted, 1);
+}
+
+static void
+test_retry_rules(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_BUSY *tcti_busy = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+    ESYS_RETRY_STATS stats;
+    ESYS_RETRY_POLICY policy = {
+        .retry = { 2, 0, 0, 0 },
+        .yielded = { 2, 0, 0, 0 },
+        .testing = { 8, 1, 4, 50 },
+    };
+
+    r = Esys_SetRetryPolicy(ectx, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* A TPM in self test is waited for longer than a busy one */
+    tcti_busy->busy_rc = TPM2_RC_TESTING;
+    tcti_busy->busy = 6;
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(random);
+    assert_int_equal(tcti_busy->transmits, 7);
+
+    /* Waits of 1, 2, 4, 4, 4 and 4 ms less up to half of the jitter */
+    r = Esys_GetRetryStats(ectx, TPM2_CC_GetRandom, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.retries, 6);
+    assert_true(stats.delay >= 10 && stats.delay <= 19);
+
+    tcti_busy->transmits = 0;
+    tcti_busy->busy_rc = TPM2_RC_YIELDED;
+    tcti_busy->busy = 6;
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TPM2_RC_YIELDED);
+    assert_int_equal(tcti_busy->transmits, 2);
+
+    /* NULL restores the default */
+    r = Esys_SetRetryPolicy(ectx, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    tcti_busy->transmits = 0;
+    tcti_busy->busy = 6;
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TPM2_RC_YIELDED);
+    assert_int_equal(tcti_busy->transmits, _ESYS_MAX_SUBMISSIONS);
+}
+
+static void
+test_retry_async(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_BUSY *tcti_busy = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+    ESYS_STEP step;
+    size_t count = 4;
+    TSS2_TCTI_POLL_HANDLE handles[4];
+    ESYS_RETRY_POLICY policy = {
+        .retry = { 3, 30, 30, 0 },
+        .yielded = { 3, 30, 30, 0 },
+        .testing = { 3, 30, 30, 0 },
+    };
+
+    r = Esys_SetRetryPolicy(ectx, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_SetTimeout(ectx, 0);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* The backoff does not block the _Finish function */
+    tcti_busy->busy = 1;
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             8);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_GetRandom_Finish(ectx, &random);
+    assert_int_equal(r, TSS2_ESYS_RC_TRY_AGAIN);
+    assert_int_equal(tcti_busy->transmits, 1);
+    r = Esys_GetRandom_Finish(ectx, &random);
+    assert_int_equal(r, TSS2_ESYS_RC_TRY_AGAIN);
+    assert_int_equal(tcti_busy->transmits, 1);
+
+    /* Esys_Step reports the delayed resubmission with no poll handles */
+    r = Esys_Step(ectx, &step, handles, &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(step, ESYS_STEP_NEED_READ);
+    assert_int_equal(count, 0);
+    assert_int_equal(tcti_busy->transmits, 1);
+
+    usleep(40 * 1000);
+    r = Esys_Step(ectx, &step, NULL, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(step, ESYS_STEP_DONE);
+    assert_int_equal(tcti_busy->transmits, 2);
+    r = Esys_GetRandom_Finish(ectx, &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(random->size, 8);
+    free(random);
+}
+
+static void
+test_retry_deadline(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    TCTI_BUSY *tcti_busy = context_tcti(ectx);
+    TPM2B_DIGEST *random = NULL;
+    ESYS_RETRY_POLICY policy = {
+        .retry = { 3, 500, 500, 0 },
+        .yielded = { 3, 500, 500, 0 },
+        .testing = { 3, 500, 500, 0 },
+    };
+    int64_t start;
+
+    r = Esys_SetRetryPolicy(ectx, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_SetDeadline(ectx, 50);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* A backoff beyond the deadline is not waited for */
+    tcti_busy->busy = 1;
+    start = now_ms();
+    r = Esys_GetRandom(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, 8,
+                       &random);
+    assert_int_equal(r, TPM2_RC_CANCELED);
+    assert_true(now_ms() - start < 400);
+    assert_int_equal(tcti_busy->transmits, 1);
+}
+
+static void
+test_retry_bad_args(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+    ESYS_RETRY_STATS stats;
+    ESYS_RETRY_POLICY policy = {
+        .retry = { 1, 0, 0, 0 },
+        .yielded = { 1, 0, 0, 0 },
+        .testing = { 1, 0, 0, 0 },
+    };
+
+    r = Esys_SetRetryPolicy(NULL, &policy);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    policy.testing.maxSubmissions = 0;
+    r = Esys_SetRetryPolicy(ectx, &policy);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+    policy.testing.maxSubmissions = 1;
+    policy.yielded.jitter = 101;
+    r = Esys_SetRetryPolicy(ectx, &policy);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    r = Esys_GetRetryStats(NULL, TPM2_CC_GetRandom, &stats);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_GetRetryStats(ectx, TPM2_CC_GetRandom, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_GetRetryStats(ectx, 0x20000000, &stats);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(stats.retries, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_retry_default,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_retry_backoff,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_retry_rules,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_retry_async,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_retry_deadline,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_retry_bad_args,
+                                        esys_unit_setup,
+                                        tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,239 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_SignBatch sends one TPM2_Sign per digest
+ * with the same key and sessions, returns the signatures in order and stops
+ * at the first error, reporting how many digests were signed. The TCTI returns the signed digest as RSASSA
+ * signature.
+ */
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t sign_count;
+    uint32_t fail_at;
+    uint32_t send_count;
+    uint32_t send_fail_at;
+    TSS2_TCTI_TRANSMIT_FCN transmit;
+} TCTI_SIGN;
+
+static TSS2_RC
+tcti_sign_transmit(TSS2_TCTI_CONTEXT * tctiContext,
+                   size_t size, const uint8_t * buffer)
+{
+    TCTI_SIGN *tcti_sign = (TCTI_SIGN *) tcti_mock_cast(tctiContext);
+
+    assert_non_null(tcti_sign);
+    if (++tcti_sign->send_count == tcti_sign->send_fail_at)
+        return TSS2_TCTI_RC_IO_ERROR;
+    return tcti_sign->transmit(tctiContext, size, buffer);
+}
+
+static TPM2_RC
+tcti_sign_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                  const uint8_t *buffer, size_t size,
+                  uint8_t *rsp, size_t max, size_t *out)
+{
+    TCTI_SIGN *tcti_sign = (TCTI_SIGN *) mock;
+    TPM2B_DIGEST digest;
+    TPMT_SIG_SCHEME scheme;
+    TPMT_TK_HASHCHECK validation;
+    TPMT_SIGNATURE signature = { 0 };
+    TPM2_HANDLE key;
+    UINT32 auth_size;
+    size_t offset = 10;
+
+    assert_int_equal(command_code, TPM2_CC_Sign);
+    Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &key);
+    assert_int_equal(key, TPM2_RH_OWNER);
+    assert_int_equal(mock->tag, TPM2_ST_SESSIONS);
+    Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &auth_size);
+    offset += auth_size;
+    Tss2_MU_TPM2B_DIGEST_Unmarshal(buffer, size, &offset, &digest);
+    Tss2_MU_TPMT_SIG_SCHEME_Unmarshal(buffer, size, &offset, &scheme);
+    Tss2_MU_TPMT_TK_HASHCHECK_Unmarshal(buffer, size, &offset, &validation);
+    assert_int_equal(offset, size);
+    assert_int_equal(validation.hierarchy, TPM2_RH_NULL);
+
+    tcti_sign->sign_count++;
+    if (tcti_sign->sign_count == tcti_sign->fail_at)
+        return TPM2_RC_SCHEME + TPM2_RC_P + TPM2_RC_2;
+
+    signature.sigAlg = TPM2_ALG_RSASSA;
+    signature.signature.rsassa.hash = scheme.details.rsassa.hashAlg;
+    signature.signature.rsassa.sig.size = digest.size;
+    memcpy(&signature.signature.rsassa.sig.buffer[0], &digest.buffer[0],
+           digest.size);
+    Tss2_MU_TPMT_SIGNATURE_Marshal(&signature, rsp, max, out);
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    int r;
+    TCTI_SIGN *tcti_sign;
+
+    r = tcti_mock_setup(state, sizeof(TCTI_SIGN), tcti_sign_respond);
+    if (r)
+        return r;
+    tcti_sign = (TCTI_SIGN *) tcti_mock_esys_get((ESYS_CONTEXT *) * state);
+    tcti_sign->transmit = TSS2_TCTI_TRANSMIT(&tcti_sign->mock.common);
+    TSS2_TCTI_TRANSMIT(&tcti_sign->mock.common) = tcti_sign_transmit;
+    return 0;
+}
+
+static const TPMT_SIG_SCHEME scheme = {
+    .scheme = TPM2_ALG_RSASSA,
+    .details = { .rsassa = { .hashAlg = TPM2_ALG_SHA256 } }
+};
+
+static void
+init_digests(TPM2B_DIGEST *digests, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        digests[i].size = TPM2_SHA256_DIGEST_SIZE;
+        memset(&digests[i].buffer[0], i + 1, TPM2_SHA256_DIGEST_SIZE);
+    }
+}
+
+static void
+test_sign_batch(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_SIGN *tcti_sign;
+    TPM2B_DIGEST digests[5];
+    TPMT_SIGNATURE signatures[5];
+    size_t signed_count;
+
+    tcti_sign = (TCTI_SIGN *) tcti_mock_esys_get(esys_context);
+    init_digests(digests, 5);
+
+    r = Esys_SignBatch(esys_context, ESYS_TR_RH_OWNER, ESYS_TR_PASSWORD,
+                       ESYS_TR_NONE, ESYS_TR_NONE, digests, 5, &scheme, NULL,
+                       signatures, &signed_count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_sign->sign_count, 5);
+    assert_int_equal(signed_count, 5);
+    for (size_t i = 0; i < 5; i++) {
+        assert_int_equal(signatures[i].sigAlg, TPM2_ALG_RSASSA);
+        assert_int_equal(signatures[i].signature.rsassa.hash, TPM2_ALG_SHA256);
+        assert_int_equal(signatures[i].signature.rsassa.sig.size,
+                         TPM2_SHA256_DIGEST_SIZE);
+        assert_memory_equal(&signatures[i].signature.rsassa.sig.buffer[0],
+                            &digests[i].buffer[0], TPM2_SHA256_DIGEST_SIZE);
+    }
+
+    r = Esys_SignBatch(esys_context, ESYS_TR_RH_OWNER, ESYS_TR_PASSWORD,
+                       ESYS_TR_NONE, ESYS_TR_NONE, digests, 0, &scheme, NULL,
+                       NULL, &signed_count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(signed_count, 0);
+    assert_int_equal(tcti_sign->sign_count, 5);
+}
+
+static void
+test_sign_batch_error(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_SIGN *tcti_sign;
+    TPM2B_DIGEST digests[5];
+    TPMT_SIGNATURE signatures[5];
+    size_t signed_count;
+
+    tcti_sign = (TCTI_SIGN *) tcti_mock_esys_get(esys_context);
+    init_digests(digests, 5);
+    memset(signatures, 0, sizeof(signatures));
+
+    /* The batch stops at the third digest */
+    tcti_sign->fail_at = 3;
+    r = Esys_SignBatch(esys_context, ESYS_TR_RH_OWNER, ESYS_TR_PASSWORD,
+                       ESYS_TR_NONE, ESYS_TR_NONE, digests, 5, &scheme, NULL,
+                       signatures, &signed_count);
+    assert_int_equal(r, TPM2_RC_SCHEME + TPM2_RC_P + TPM2_RC_2);
+    assert_int_equal(tcti_sign->sign_count, 3);
+    assert_int_equal(signed_count, 2);
+    assert_int_equal(signatures[1].signature.rsassa.sig.buffer[0], 2);
+    assert_int_equal(signatures[2].sigAlg, 0);
+
+    /* The context is usable afterwards */
+    tcti_sign->fail_at = 0;
+    r = Esys_SignBatch(esys_context, ESYS_TR_RH_OWNER, ESYS_TR_PASSWORD,
+                       ESYS_TR_NONE, ESYS_TR_NONE, &digests[2], 3, &scheme,
+                       NULL, &signatures[2], NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(signatures[4].signature.rsassa.sig.buffer[0], 5);
+
+    r = Esys_SignBatch(esys_context, ESYS_TR_RH_OWNER, ESYS_TR_PASSWORD,
+                       ESYS_TR_NONE, ESYS_TR_NONE, digests, 5, NULL, NULL,
+                       signatures, &signed_count);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    assert_int_equal(signed_count, 0);
+}
+
+static void
+test_sign_batch_send_error(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_SIGN *tcti_sign;
+    TPM2B_DIGEST digests[5];
+    TPMT_SIGNATURE signatures[5];
+    size_t signed_count;
+
+    tcti_sign = (TCTI_SIGN *) tcti_mock_esys_get(esys_context);
+    init_digests(digests, 5);
+    memset(signatures, 0, sizeof(signatures));
+
+    /* The signature received before the failing send is kept */
+    tcti_sign->send_fail_at = 4;
+    r = Esys_SignBatch(esys_context, ESYS_TR_RH_OWNER, ESYS_TR_PASSWORD,
+                       ESYS_TR_NONE, ESYS_TR_NONE, digests, 5, &scheme, NULL,
+                       signatures, &signed_count);
+    assert_int_equal(r, TSS2_TCTI_RC_IO_ERROR);
+    assert_int_equal(tcti_sign->sign_count, 3);
+    assert_int_equal(signed_count, 3);
+    assert_int_equal(signatures[2].signature.rsassa.sig.buffer[0], 3);
+    assert_int_equal(signatures[3].sigAlg, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_sign_batch,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_sign_batch_error,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_sign_batch_send_error,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
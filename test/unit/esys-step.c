@@ -0,0 +1,392 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_Step reports when to wait for the poll
+ * handles, when a resubmission is due and when the _Finish function can be
+ * called without blocking, and that many commands can be driven this way
+ * from a single thread. The TCTI answers TPM2_GetRandom once the test
+ * signals the response; the signal is also written to a pipe.
+ */
+
+#define CONTEXTS 32
+
+typedef struct {
+    TCTI_MOCK mock;
+    int pipe[2];
+    int pending;                  /* signaled responses */
+    int retries;                  /* TPM2_RC_RETRY responses to send */
+    int transmits;
+    int receives;
+    uint8_t fill;
+} TCTI_STEP;
+
+static TPM2_RC
+tcti_step_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                  const uint8_t *command, size_t size,
+                  uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_STEP *tcti_step = (TCTI_STEP *) mock;
+    size_t in = 10;
+    UINT16 bytes;
+
+    assert_int_equal(command_code, TPM2_CC_GetRandom);
+    Tss2_MU_UINT16_Unmarshal(command, size, &in, &bytes);
+    tcti_step->transmits++;
+
+    if (tcti_step->retries > 0) {
+        tcti_step->retries--;
+        return TPM2_RC_RETRY;
+    }
+    Tss2_MU_UINT16_Marshal(bytes, response, max, offset);
+    memset(&response[*offset], tcti_step->fill, bytes);
+    *offset += bytes;
+    return TPM2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_step_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                  size_t * response_size,
+                  uint8_t * response_buffer, int32_t timeout)
+{
+    TCTI_STEP *tcti_step = (TCTI_STEP *) tcti_mock_cast(tctiContext);
+    char c;
+
+    assert_non_null(tcti_step);
+    /* Esys_Step never blocks; like mssim, the TCTI without poll handles
+       only receives blocking */
+    if (tcti_step->pipe[0] < 0)
+        assert_int_equal(timeout, TSS2_TCTI_TIMEOUT_BLOCK);
+    else
+        assert_int_equal(timeout, 0);
+    if (tcti_step->pending == 0)
+        return TSS2_TCTI_RC_TRY_AGAIN;
+    tcti_step->pending--;
+    tcti_step->receives++;
+    if (tcti_step->pipe[0] >= 0)
+        assert_int_equal(read(tcti_step->pipe[0], &c, 1), 1);
+
+    return tcti_mock_receive(tctiContext, response_size, response_buffer,
+                             timeout);
+}
+
+static TSS2_RC
+tcti_step_get_poll_handles(TSS2_TCTI_CONTEXT * tctiContext,
+                           TSS2_TCTI_POLL_HANDLE * handles,
+                           size_t * num_handles)
+{
+    TCTI_STEP *tcti_step = (TCTI_STEP *) tcti_mock_cast(tctiContext);
+
+    assert_non_null(tcti_step);
+    if (handles != NULL) {
+        if (*num_handles < 1)
+            return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+        handles[0].fd = tcti_step->pipe[0];
+        handles[0].events = POLLIN;
+    }
+    *num_handles = 1;
+    return TSS2_RC_SUCCESS;
+}
+
+static TCTI_STEP *
+context_tcti(ESYS_CONTEXT *ectx)
+{
+    return (TCTI_STEP *) tcti_mock_esys_get(ectx);
+}
+
+/* Let the response of the command in flight arrive */
+static void
+context_signal(ESYS_CONTEXT *ectx)
+{
+    TCTI_STEP *tcti_step = context_tcti(ectx);
+
+    tcti_step->pending++;
+    if (tcti_step->pipe[1] >= 0)
+        assert_int_equal(write(tcti_step->pipe[1], "r", 1), 1);
+}
+
+static ESYS_CONTEXT *
+context_new(int poll_handles, uint8_t fill)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx;
+    TSS2_TCTI_CONTEXT *tcti = tcti_mock_new(sizeof(TCTI_STEP),
+                                            tcti_step_respond);
+    TCTI_STEP *tcti_step = (TCTI_STEP *) tcti;
+
+    TSS2_TCTI_RECEIVE(tcti) = tcti_step_receive;
+    tcti_step->pipe[0] = tcti_step->pipe[1] = -1;
+    tcti_step->fill = fill;
+    if (poll_handles) {
+        assert_int_equal(pipe(tcti_step->pipe), 0);
+        TSS2_TCTI_GET_POLL_HANDLES(tcti) = tcti_step_get_poll_handles;
+    }
+
+    r = Esys_Initialize(&ectx, tcti, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    return ectx;
+}
+
+static void
+context_free(ESYS_CONTEXT **ectx)
+{
+    TSS2_TCTI_CONTEXT *tcti;
+    TCTI_STEP *tcti_step;
+
+    assert_int_equal(Esys_GetTcti(*ectx, &tcti), TSS2_RC_SUCCESS);
+    Esys_Finalize(ectx);
+    tcti_step = (TCTI_STEP *) tcti_mock_cast(tcti);
+    if (tcti_step->pipe[0] >= 0) {
+        close(tcti_step->pipe[0]);
+        close(tcti_step->pipe[1]);
+    }
+    tcti_mock_free(tcti);
+}
+
+static void
+test_step_read(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = context_new(1, 0x5a);
+    TCTI_STEP *tcti_step = context_tcti(ectx);
+    TSS2_TCTI_POLL_HANDLE handles[2];
+    size_t count = 2;
+    ESYS_STEP step;
+    TPM2B_DIGEST *random = NULL;
+
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             16);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_Step(ectx, &step, &handles[0], &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(step, ESYS_STEP_NEED_READ);
+    assert_int_equal(count, 1);
+    assert_int_equal(handles[0].fd, tcti_step->pipe[0]);
+
+    /* The poll handles are optional */
+    r = Esys_Step(ectx, &step, NULL, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(step, ESYS_STEP_NEED_READ);
+
+    context_signal(ectx);
+    r = Esys_Step(ectx, &step, &handles[0], &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(step, ESYS_STEP_DONE);
+
+    /* The response is received only once */
+    r = Esys_Step(ectx, &step, &handles[0], &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(step, ESYS_STEP_DONE);
+    assert_int_equal(tcti_step->receives, 1);
+
+    r = Esys_GetRandom_Finish(ectx, &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(random->size, 16);
+    assert_int_equal(random->buffer[0], 0x5a);
+    assert_int_equal(tcti_step->receives, 1);
+    free(random);
+
+    r = Esys_Step(ectx, &step, &handles[0], &count);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+    assert_int_equal(step, ESYS_STEP_ERROR);
+
+    context_free(&ectx);
+}
+
+static void
+test_step_resubmission(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = context_new(1, 0x11);
+    TCTI_STEP *tcti_step = context_tcti(ectx);
+    ESYS_STEP step;
+    TPM2B_DIGEST *random = NULL;
+    int writes = 0;
+
+    tcti_step->retries = 2;
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             8);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    for (;;) {
+        r = Esys_Step(ectx, &step, NULL, NULL);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        if (step == ESYS_STEP_NEED_READ) {
+            context_signal(ectx);
+            continue;
+        }
+        r = Esys_GetRandom_Finish(ectx, &random);
+        if (step == ESYS_STEP_DONE)
+            break;
+        assert_int_equal(step, ESYS_STEP_NEED_WRITE);
+        assert_int_equal(r, TSS2_ESYS_RC_TRY_AGAIN);
+        writes++;
+    }
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(writes, 2);
+    assert_int_equal(tcti_step->transmits, 3);
+    assert_int_equal(random->size, 8);
+    free(random);
+
+    context_free(&ectx);
+}
+
+static void
+test_step_no_poll_handles(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = context_new(0, 0x22);
+    TSS2_TCTI_POLL_HANDLE handles[1];
+    size_t count = 1;
+    ESYS_STEP step;
+    TPM2B_DIGEST *random = NULL;
+
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             4);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Step(ectx, &step, &handles[0], &count);
+    assert_int_equal(r, TSS2_ESYS_RC_NOT_IMPLEMENTED);
+    assert_int_equal(step, ESYS_STEP_ERROR);
+    r = Esys_Step(ectx, &step, NULL, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_NOT_IMPLEMENTED);
+
+    /* The command is still in flight */
+    context_signal(ectx);
+    r = Esys_SetTimeout(ectx, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_GetRandom_Finish(ectx, &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(random);
+
+    context_free(&ectx);
+}
+
+/* Drive many commands from one thread, waiting on all poll handles */
+static void
+test_step_multiplex(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx[CONTEXTS];
+    struct pollfd fds[CONTEXTS];
+    TSS2_TCTI_POLL_HANDLE handle;
+    size_t count;
+    ESYS_STEP step;
+    TPM2B_DIGEST *random;
+    int done = 0, i;
+
+    for (i = 0; i < CONTEXTS; i++) {
+        ectx[i] = context_new(1, (uint8_t) i);
+        context_tcti(ectx[i])->retries = i % 3;
+        r = Esys_GetRandom_Async(ectx[i], ESYS_TR_NONE, ESYS_TR_NONE,
+                                 ESYS_TR_NONE, 4);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+
+    /* Responses arrive in reverse order */
+    for (i = CONTEXTS - 1; i >= 0; i--)
+        context_signal(ectx[i]);
+
+    while (done < CONTEXTS) {
+        for (i = 0; i < CONTEXTS; i++) {
+            fds[i].fd = -1;
+            fds[i].events = 0;
+            if (ectx[i] == NULL)
+                continue;
+            count = 1;
+            r = Esys_Step(ectx[i], &step, &handle, &count);
+            assert_int_equal(r, TSS2_RC_SUCCESS);
+            if (step == ESYS_STEP_NEED_READ) {
+                fds[i].fd = handle.fd;
+                fds[i].events = handle.events;
+                continue;
+            }
+            random = NULL;
+            r = Esys_GetRandom_Finish(ectx[i], &random);
+            if (step == ESYS_STEP_NEED_WRITE) {
+                assert_int_equal(r, TSS2_ESYS_RC_TRY_AGAIN);
+                /* The resubmitted command is answered right away */
+                context_signal(ectx[i]);
+                fds[i].fd = context_tcti(ectx[i])->pipe[0];
+                fds[i].events = POLLIN;
+                continue;
+            }
+            assert_int_equal(r, TSS2_RC_SUCCESS);
+            assert_int_equal(random->buffer[0], (uint8_t) i);
+            free(random);
+            context_free(&ectx[i]);
+            done++;
+        }
+        if (done < CONTEXTS)
+            assert_true(poll(fds, CONTEXTS, 1000) > 0);
+    }
+}
+
+static void
+test_step_bad_args(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx = context_new(1, 0);
+    TSS2_TCTI_POLL_HANDLE handles[1];
+    ESYS_STEP step;
+    size_t count = 0;
+
+    r = Esys_Step(ectx, NULL, NULL, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_Step(NULL, &step, NULL, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    assert_int_equal(step, ESYS_STEP_ERROR);
+
+    r = Esys_Step(ectx, &step, NULL, &count);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+    assert_int_equal(step, ESYS_STEP_ERROR);
+
+    /* The poll handles do not fit */
+    r = Esys_GetRandom_Async(ectx, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                             4);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_Step(ectx, &step, &handles[0], &count);
+    assert_int_equal(r, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal(step, ESYS_STEP_ERROR);
+
+    context_free(&ectx);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_step_read),
+        cmocka_unit_test(test_step_resubmission),
+        cmocka_unit_test(test_step_no_poll_handles),
+        cmocka_unit_test(test_step_multiplex),
+        cmocka_unit_test(test_step_bad_args),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
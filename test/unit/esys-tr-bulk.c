@@ -0,0 +1,499 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_TR_FromTPMPublicList and
+ * Esys_TR_FromTPMHandleRange create the ESYS_TRs of persistent objects and NV
+ * indices, spread the commands over the shard contexts, reject names that do
+ * not match the public area and create no ESYS_TR if a handle fails. The
+ * TCTI emulates a TPM with some persistent objects and NV indices that
+ * answers after a delay. The first shard has poll handles; the other
+ * contexts have none and, like mssim, only receive blocking.
+ */
+
+#define PERSISTENT_COUNT 10
+#define NV_COUNT 4
+#define SHARD_COUNT 2
+
+/* Handles returned by one TPM2_GetCapability */
+#define CAP_HANDLES 3
+
+typedef struct {
+    TCTI_MOCK mock;
+    int pipe[2];                  /* signals responses, if polled */
+    int64_t ready;                /* ms when the response is ready */
+    int transmits;
+} TCTI_TPM;
+
+/* The delay of every response in ms */
+static int64_t delay = 2;
+
+/* A handle whose name is reported wrongly */
+static TPM2_HANDLE bad_name;
+
+static int64_t
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool
+tpm_has_handle(TPM2_HANDLE handle)
+{
+    return (handle >= TPM2_PERSISTENT_FIRST &&
+            handle < TPM2_PERSISTENT_FIRST + PERSISTENT_COUNT) ||
+           (handle >= TPM2_NV_INDEX_FIRST &&
+            handle < TPM2_NV_INDEX_FIRST + NV_COUNT);
+}
+
+static void
+tpm_public(TPM2_HANDLE handle, TPM2B_PUBLIC *public)
+{
+    memset(public, 0, sizeof(*public));
+    public->publicArea.type = TPM2_ALG_RSA;
+    public->publicArea.nameAlg = TPM2_ALG_SHA256;
+    public->publicArea.objectAttributes = TPMA_OBJECT_RESTRICTED |
+        TPMA_OBJECT_DECRYPT | TPMA_OBJECT_FIXEDTPM | TPMA_OBJECT_FIXEDPARENT;
+    public->publicArea.parameters.rsaDetail.symmetric.algorithm =
+        TPM2_ALG_NULL;
+    public->publicArea.parameters.rsaDetail.scheme.scheme = TPM2_ALG_NULL;
+    public->publicArea.parameters.rsaDetail.keyBits = 2048;
+    public->publicArea.unique.rsa.size = sizeof(handle);
+    memcpy(&public->publicArea.unique.rsa.buffer[0], &handle, sizeof(handle));
+}
+
+static void
+tpm_nv_public(TPM2_HANDLE handle, TPM2B_NV_PUBLIC *nv_public)
+{
+    memset(nv_public, 0, sizeof(*nv_public));
+    nv_public->nvPublic.nvIndex = handle;
+    nv_public->nvPublic.nameAlg = TPM2_ALG_SHA256;
+    nv_public->nvPublic.attributes = TPMA_NV_OWNERWRITE | TPMA_NV_OWNERREAD;
+    nv_public->nvPublic.dataSize = 32;
+}
+
+/* Marshal the response parameters of a command */
+static TPM2_RC
+tpm_execute(TPM2_CC command_code, const uint8_t *cmd, size_t cmd_size,
+            uint8_t *rsp, size_t max, size_t *offset)
+{
+    TPM2_HANDLE handle;
+    TPM2B_PUBLIC public;
+    TPM2B_NV_PUBLIC nv_public;
+    TPM2B_NAME name;
+    TPMS_CAPABILITY_DATA capability_data = { .capability = TPM2_CAP_HANDLES };
+    TPML_HANDLE *handles = &capability_data.data.handles;
+    UINT32 capability, property, count, last;
+    size_t in = 10;
+
+    if (command_code == TPM2_CC_GetCapability) {
+        Tss2_MU_UINT32_Unmarshal(cmd, cmd_size, &in, &capability);
+        Tss2_MU_UINT32_Unmarshal(cmd, cmd_size, &in, &property);
+        Tss2_MU_UINT32_Unmarshal(cmd, cmd_size, &in, &count);
+        assert_int_equal(capability, TPM2_CAP_HANDLES);
+        last = (property >> TPM2_HR_SHIFT == TPM2_HT_PERSISTENT) ?
+            TPM2_PERSISTENT_FIRST + PERSISTENT_COUNT :
+            TPM2_NV_INDEX_FIRST + NV_COUNT;
+        for (; property < last && handles->count < count &&
+             handles->count < CAP_HANDLES; property++)
+            handles->handle[handles->count++] = property;
+        Tss2_MU_BYTE_Marshal(property < last ? TPM2_YES : TPM2_NO, rsp, max, offset);
+        Tss2_MU_TPMS_CAPABILITY_DATA_Marshal(&capability_data, rsp, max,
+                                             offset);
+        return TPM2_RC_SUCCESS;
+    }
+
+    Tss2_MU_UINT32_Unmarshal(cmd, cmd_size, &in, &handle);
+    if (!tpm_has_handle(handle))
+        return TPM2_RC_HANDLE | TPM2_RC_1;
+
+    if (command_code == TPM2_CC_NV_ReadPublic) {
+        tpm_nv_public(handle, &nv_public);
+        assert_int_equal(iesys_nv_get_name(&nv_public, &name), TSS2_RC_SUCCESS);
+        Tss2_MU_TPM2B_NV_PUBLIC_Marshal(&nv_public, rsp, max, offset);
+    } else {
+        assert_int_equal(command_code, TPM2_CC_ReadPublic);
+        tpm_public(handle, &public);
+        assert_int_equal(iesys_get_name(&public, &name), TSS2_RC_SUCCESS);
+        Tss2_MU_TPM2B_PUBLIC_Marshal(&public, rsp, max, offset);
+    }
+    if (handle == bad_name)
+        name.name[name.size - 1] ^= 0xff;
+    Tss2_MU_TPM2B_NAME_Marshal(&name, rsp, max, offset);
+    if (command_code == TPM2_CC_ReadPublic)
+        Tss2_MU_TPM2B_NAME_Marshal(&name, rsp, max, offset);
+    return TPM2_RC_SUCCESS;
+}
+
+static TPM2_RC
+tcti_tpm_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                 const uint8_t *command, size_t size,
+                 uint8_t *response, size_t max, size_t *offset)
+{
+    TCTI_TPM *tcti_tpm = (TCTI_TPM *) mock;
+
+    tcti_tpm->ready = now_ms() + delay;
+    tcti_tpm->transmits++;
+    if (tcti_tpm->pipe[1] >= 0)
+        assert_int_equal(write(tcti_tpm->pipe[1], "r", 1), 1);
+    return tpm_execute(command_code, command, size, response, max, offset);
+}
+
+static TSS2_RC
+tcti_tpm_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                 size_t * response_size,
+                 uint8_t * response_buffer, int32_t timeout)
+{
+    TCTI_TPM *tcti_tpm = (TCTI_TPM *) tcti_mock_cast(tctiContext);
+    int64_t now = now_ms();
+    char c;
+
+    assert_non_null(tcti_tpm);
+    if (tcti_tpm->pipe[0] < 0 && timeout != TSS2_TCTI_TIMEOUT_BLOCK)
+        return TSS2_TCTI_RC_BAD_VALUE;
+    if (now < tcti_tpm->ready) {
+        if (timeout >= 0 && now + timeout < tcti_tpm->ready) {
+            usleep(timeout * 1000);
+            return TSS2_TCTI_RC_TRY_AGAIN;
+        }
+        usleep((tcti_tpm->ready - now) * 1000);
+    }
+    if (tcti_tpm->pipe[0] >= 0)
+        assert_int_equal(read(tcti_tpm->pipe[0], &c, 1), 1);
+
+    return tcti_mock_receive(tctiContext, response_size, response_buffer,
+                             timeout);
+}
+
+static TSS2_RC
+tcti_tpm_get_poll_handles(TSS2_TCTI_CONTEXT * tctiContext,
+                          TSS2_TCTI_POLL_HANDLE * handles,
+                          size_t * num_handles)
+{
+    TCTI_TPM *tcti_tpm = (TCTI_TPM *) tcti_mock_cast(tctiContext);
+
+    assert_non_null(tcti_tpm);
+    if (handles != NULL) {
+        handles[0].fd = tcti_tpm->pipe[0];
+        handles[0].events = POLLIN;
+    }
+    *num_handles = 1;
+    return TSS2_RC_SUCCESS;
+}
+
+static ESYS_CONTEXT *
+context_new(int poll_handles)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx;
+    TSS2_TCTI_CONTEXT *tcti = tcti_mock_new(sizeof(TCTI_TPM),
+                                            tcti_tpm_respond);
+    TCTI_TPM *tcti_tpm = (TCTI_TPM *) tcti;
+
+    TSS2_TCTI_RECEIVE(tcti) = tcti_tpm_receive;
+    tcti_tpm->pipe[0] = tcti_tpm->pipe[1] = -1;
+    if (poll_handles) {
+        assert_int_equal(pipe(tcti_tpm->pipe), 0);
+        TSS2_TCTI_GET_POLL_HANDLES(tcti) = tcti_tpm_get_poll_handles;
+    }
+
+    r = Esys_Initialize(&ectx, tcti, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    return ectx;
+}
+
+static TCTI_TPM *
+context_tcti(ESYS_CONTEXT *ectx)
+{
+    return (TCTI_TPM *) tcti_mock_esys_get(ectx);
+}
+
+static void
+context_free(ESYS_CONTEXT *ectx)
+{
+    TSS2_TCTI_CONTEXT *tcti;
+    TCTI_TPM *tcti_tpm;
+
+    Esys_GetTcti(ectx, &tcti);
+    Esys_Finalize(&ectx);
+    tcti_tpm = (TCTI_TPM *) tcti_mock_cast(tcti);
+    if (tcti_tpm->pipe[0] >= 0) {
+        close(tcti_tpm->pipe[0]);
+        close(tcti_tpm->pipe[1]);
+    }
+    tcti_mock_free(tcti);
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    ESYS_CONTEXT **ectx = calloc(SHARD_COUNT + 1, sizeof(ESYS_CONTEXT *));
+    int i;
+
+    assert_non_null(ectx);
+    for (i = 0; i <= SHARD_COUNT; i++)
+        ectx[i] = context_new(i == 1);
+    bad_name = 0;
+    *state = (void *)ectx;
+    return 0;
+}
+
+static int
+esys_unit_teardown(void **state)
+{
+    ESYS_CONTEXT **ectx = (ESYS_CONTEXT **) * state;
+    int i;
+
+    for (i = 0; i <= SHARD_COUNT; i++)
+        context_free(ectx[i]);
+    free(ectx);
+    return 0;
+}
+
+static size_t
+count_nodes(ESYS_CONTEXT *ectx)
+{
+    RSRC_NODE_T *node;
+    size_t n = 0;
+
+    for (node = ectx->rsrc_list; node != NULL; node = node->next)
+        n++;
+    return n;
+}
+
+/* Check an ESYS_TR against the emulated TPM */
+static void
+check_object(ESYS_CONTEXT *ectx, ESYS_TR object, TPM2_HANDLE handle)
+{
+    TSS2_RC r;
+    TPM2B_NAME *name;
+    TPM2B_NAME expected;
+    TPM2B_PUBLIC public;
+    TPM2B_NV_PUBLIC nv_public;
+    RSRC_NODE_T *node;
+
+    r = esys_GetResourceObject(ectx, object, &node);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(node->rsrc.handle, handle);
+
+    if (handle >> TPM2_HR_SHIFT == TPM2_HT_NV_INDEX) {
+        tpm_nv_public(handle, &nv_public);
+        assert_int_equal(iesys_nv_get_name(&nv_public, &expected),
+                         TSS2_RC_SUCCESS);
+    } else {
+        tpm_public(handle, &public);
+        assert_int_equal(iesys_get_name(&public, &expected), TSS2_RC_SUCCESS);
+    }
+    r = Esys_TR_GetName(ectx, object, &name);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(name->size, expected.size);
+    assert_memory_equal(&name->name[0], &expected.name[0], expected.size);
+    free(name);
+}
+
+static void
+test_bulk_list(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT **ectx = (ESYS_CONTEXT **) * state;
+    TPM2_HANDLE handles[PERSISTENT_COUNT + NV_COUNT];
+    ESYS_TR objects[PERSISTENT_COUNT + NV_COUNT];
+    size_t i, n = 0;
+    int transmits = 0;
+    int32_t timeout = ectx[2]->timeout;
+
+    for (i = 0; i < PERSISTENT_COUNT; i++)
+        handles[n++] = TPM2_PERSISTENT_FIRST + i;
+    for (i = 0; i < NV_COUNT; i++)
+        handles[n++] = TPM2_NV_INDEX_FIRST + i;
+
+    r = Esys_SetTimeout(ectx[0], 7);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Esys_TR_FromTPMPublicList(ectx[0], &ectx[1], SHARD_COUNT, handles, n,
+                                  objects);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    for (i = 0; i < n; i++)
+        check_object(ectx[0], objects[i], handles[i]);
+    /* The timeouts are restored */
+    assert_int_equal(ectx[0]->timeout, 7);
+    assert_int_equal(ectx[2]->timeout, timeout);
+
+    /* Every context sent commands and the shards keep no ESYS_TRs */
+    for (i = 0; i <= SHARD_COUNT; i++) {
+        assert_true(context_tcti(ectx[i])->transmits > 0);
+        transmits += context_tcti(ectx[i])->transmits;
+    }
+    assert_int_equal(transmits, n);
+    for (i = 1; i <= SHARD_COUNT; i++)
+        assert_int_equal(count_nodes(ectx[i]), 0);
+    assert_int_equal(count_nodes(ectx[0]), n);
+
+    /* Without shards the handles are resolved on the context alone */
+    r = Esys_TR_FromTPMPublicList(ectx[0], NULL, 0, handles, 3, objects);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    for (i = 0; i < 3; i++)
+        check_object(ectx[0], objects[i], handles[i]);
+}
+
+static void
+test_bulk_range(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT **ectx = (ESYS_CONTEXT **) * state;
+    ESYS_TR *objects;
+    size_t i, count;
+
+    r = Esys_TR_FromTPMHandleRange(ectx[0], &ectx[1], SHARD_COUNT,
+                                   TPM2_PERSISTENT_FIRST, TPM2_MAX_CAP_HANDLES,
+                                   &objects, &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(count, PERSISTENT_COUNT);
+    for (i = 0; i < count; i++)
+        check_object(ectx[0], objects[i], TPM2_PERSISTENT_FIRST + i);
+    free(objects);
+
+    /* The range is cut at maxCount */
+    r = Esys_TR_FromTPMHandleRange(ectx[0], NULL, 0, TPM2_NV_INDEX_FIRST + 1,
+                                   2, &objects, &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(count, 2);
+    check_object(ectx[0], objects[0], TPM2_NV_INDEX_FIRST + 1);
+    check_object(ectx[0], objects[1], TPM2_NV_INDEX_FIRST + 2);
+    free(objects);
+
+    /* An empty range */
+    r = Esys_TR_FromTPMHandleRange(ectx[0], NULL, 0,
+                                   TPM2_NV_INDEX_FIRST + NV_COUNT, 8,
+                                   &objects, &count);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(count, 0);
+    assert_null(objects);
+}
+
+static void
+test_bulk_errors(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT **ectx = (ESYS_CONTEXT **) * state;
+    TPM2_HANDLE handles[PERSISTENT_COUNT];
+    ESYS_TR objects[PERSISTENT_COUNT];
+    size_t i;
+
+    for (i = 0; i < PERSISTENT_COUNT; i++)
+        handles[i] = TPM2_PERSISTENT_FIRST + i;
+
+    /* A name that does not match the public area */
+    bad_name = TPM2_PERSISTENT_FIRST + 5;
+    r = Esys_TR_FromTPMPublicList(ectx[0], &ectx[1], SHARD_COUNT, handles,
+                                  PERSISTENT_COUNT, objects);
+    assert_int_equal(r, TSS2_ESYS_RC_MALFORMED_RESPONSE);
+    for (i = 0; i < PERSISTENT_COUNT; i++)
+        assert_int_equal(objects[i], ESYS_TR_NONE);
+    for (i = 0; i <= SHARD_COUNT; i++)
+        assert_int_equal(count_nodes(ectx[i]), 0);
+    bad_name = 0;
+
+    /* A handle unknown to the TPM */
+    handles[3] = TPM2_PERSISTENT_FIRST + PERSISTENT_COUNT;
+    r = Esys_TR_FromTPMPublicList(ectx[0], &ectx[1], SHARD_COUNT, handles,
+                                  PERSISTENT_COUNT, objects);
+    assert_int_equal(r, TPM2_RC_HANDLE | TPM2_RC_1);
+    for (i = 0; i <= SHARD_COUNT; i++) {
+        assert_int_equal(count_nodes(ectx[i]), 0);
+        assert_int_equal(ectx[i]->state, _ESYS_STATE_INIT);
+    }
+
+    /* The contexts can be used again */
+    handles[3] = TPM2_PERSISTENT_FIRST + 3;
+    r = Esys_TR_FromTPMPublicList(ectx[0], &ectx[1], SHARD_COUNT, handles,
+                                  PERSISTENT_COUNT, objects);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+}
+
+static void
+test_bulk_bad_args(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT **ectx = (ESYS_CONTEXT **) * state;
+    TPM2_HANDLE handles[2] = { TPM2_PERSISTENT_FIRST, TPM2_NV_INDEX_FIRST };
+    ESYS_TR objects[2], *list;
+    ESYS_CONTEXT *self[1] = { ectx[0] };
+    size_t count;
+
+    r = Esys_TR_FromTPMPublicList(NULL, NULL, 0, handles, 2, objects);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_TR_FromTPMPublicList(ectx[0], NULL, 1, handles, 2, objects);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+    r = Esys_TR_FromTPMPublicList(ectx[0], self, 1, handles, 2, objects);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+
+    /* Sessions, transient objects and PCRs are not resolved in bulk */
+    handles[1] = TPM2_TRANSIENT_FIRST;
+    r = Esys_TR_FromTPMPublicList(ectx[0], NULL, 0, handles, 2, objects);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+    r = Esys_TR_FromTPMHandleRange(ectx[0], NULL, 0, TPM2_HMAC_SESSION_FIRST,
+                                   8, &list, &count);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_VALUE);
+    r = Esys_TR_FromTPMHandleRange(ectx[0], NULL, 0, TPM2_PERSISTENT_FIRST,
+                                   8, NULL, &count);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+
+    /* A shard with a command in flight */
+    handles[1] = TPM2_NV_INDEX_FIRST;
+    ectx[2]->state = _ESYS_STATE_SENT;
+    r = Esys_TR_FromTPMPublicList(ectx[0], &ectx[1], SHARD_COUNT, handles, 2,
+                                  objects);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+    ectx[2]->state = _ESYS_STATE_INIT;
+    assert_int_equal(count_nodes(ectx[0]), 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_bulk_list,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_bulk_range,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_bulk_errors,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_bulk_bad_args,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,407 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+#include "tcti-mock-util.h"
+
+/**
+ * This unit test checks that Esys_VerifySignatureLocal verifies RSASSA,
+ * RSAPSS and ECDSA signatures with the public area ESYS holds for a key and
+ * only sends TPM2_VerifySignature if a ticket is requested or the scheme is
+ * not supported locally. Signatures that do not match the scheme of the key
+ * or the size of the digest are rejected like the TPM does. The keys are loaded with TPM2_LoadExternal.
+ */
+
+#define OBJECT_HANDLE 0x80000001
+
+typedef struct {
+    TCTI_MOCK mock;
+    uint32_t verify_count;
+} TCTI_VERIFY;
+
+static TPM2_RC
+tcti_verify_respond(TCTI_MOCK *mock, TPM2_CC command_code,
+                    const uint8_t *buffer, size_t size,
+                    uint8_t *rsp, size_t max, size_t *out)
+{
+    TCTI_VERIFY *tcti_verify = (TCTI_VERIFY *) mock;
+    UINT16 private_size;
+    TPM2B_PUBLIC in_public = { .size = 0 };
+    TPMI_RH_HIERARCHY hierarchy;
+    TPM2B_NAME name;
+    TPMT_TK_VERIFIED ticket = {
+        .tag = TPM2_ST_VERIFIED,
+        .hierarchy = TPM2_RH_OWNER,
+        .digest = { .size = 0 }
+    };
+    size_t offset = 10;
+
+    assert_int_equal(mock->tag, TPM2_ST_NO_SESSIONS);
+
+    switch (command_code) {
+    case TPM2_CC_LoadExternal:
+        /* The keys are loaded without a private part */
+        Tss2_MU_UINT16_Unmarshal(buffer, size, &offset, &private_size);
+        assert_int_equal(private_size, 0);
+        Tss2_MU_TPM2B_PUBLIC_Unmarshal(buffer, size, &offset, &in_public);
+        Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &hierarchy);
+        assert_int_equal(iesys_get_name(&in_public, &name), TSS2_RC_SUCCESS);
+        Tss2_MU_UINT32_Marshal(OBJECT_HANDLE, rsp, max, out);
+        Tss2_MU_TPM2B_NAME_Marshal(&name, rsp, max, out);
+        break;
+    case TPM2_CC_VerifySignature:
+        tcti_verify->verify_count++;
+        Tss2_MU_TPMT_TK_VERIFIED_Marshal(&ticket, rsp, max, out);
+        break;
+    default:
+        fail_msg("Unexpected command 0x%" PRIx32, command_code);
+    }
+
+    return TPM2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    return tcti_mock_setup(state, sizeof(TCTI_VERIFY), tcti_verify_respond);
+}
+
+/*
+ * An RSA 1024 and a NIST P-256 key with signatures of the SHA256 digest of
+ * "test message". The RSAPSS signature uses a salt of 32 bytes.
+ */
+static const BYTE rsa_n[] = {
+    0xf5, 0x16, 0xe9, 0x46, 0x29, 0x7a, 0xb0, 0x59, 0xb5, 0x2c, 0x9e, 0x1e,
+    0x90, 0xed, 0x65, 0xcd, 0x0f, 0xfc, 0x66, 0x19, 0x1c, 0x2b, 0xb5, 0xd8,
+    0x19, 0x8f, 0x21, 0x32, 0x33, 0x7c, 0xea, 0x63, 0x46, 0x93, 0x32, 0x64,
+    0xaa, 0x6c, 0xbe, 0x65, 0x2b, 0xce, 0xba, 0xd2, 0xf2, 0x09, 0x23, 0x07,
+    0xd3, 0xbc, 0x33, 0xa4, 0x68, 0x68, 0x2d, 0x2e, 0xb3, 0xab, 0xf2, 0xea,
+    0x14, 0x86, 0x78, 0x84, 0xa9, 0x80, 0xc5, 0x29, 0x7f, 0x7c, 0xad, 0x5e,
+    0x82, 0xd2, 0x04, 0x12, 0xab, 0xfd, 0x75, 0xb2, 0xe1, 0x6c, 0xcf, 0x89,
+    0x93, 0x0b, 0x3a, 0xd9, 0x23, 0x77, 0x6f, 0x9f, 0x5e, 0x96, 0xd7, 0x18,
+    0xf3, 0xa3, 0x48, 0x52, 0x4c, 0x44, 0xf1, 0xd5, 0xee, 0x0f, 0x09, 0x84,
+    0x77, 0x9f, 0xdb, 0xc2, 0xa7, 0xa9, 0x74, 0xc5, 0x5e, 0x61, 0xb6, 0x05,
+    0xb7, 0x56, 0x78, 0x58, 0x37, 0x90, 0x97, 0x99,
+};
+
+static const BYTE rsassa_sig[] = {
+    0xab, 0x0e, 0xeb, 0xc3, 0x40, 0x51, 0xad, 0xb6, 0x0a, 0x77, 0xc5, 0x8e,
+    0xdc, 0x7c, 0x5c, 0xc3, 0x7b, 0x9d, 0x1f, 0x75, 0x53, 0xf8, 0x83, 0xa7,
+    0x94, 0xa8, 0x9a, 0xf4, 0x91, 0x86, 0x04, 0x2f, 0xd4, 0xcc, 0x91, 0x3f,
+    0x45, 0x5b, 0x38, 0xab, 0xec, 0x58, 0xa0, 0xa2, 0xfa, 0xf9, 0xf7, 0x43,
+    0x2f, 0xcb, 0x29, 0x75, 0x33, 0xb9, 0x60, 0xf1, 0x84, 0x42, 0x40, 0xe9,
+    0xe5, 0x12, 0xcb, 0x3a, 0x0b, 0x2d, 0x74, 0x53, 0x32, 0x77, 0x77, 0x0c,
+    0xff, 0x84, 0xb5, 0x62, 0xed, 0xd6, 0x19, 0xe2, 0x38, 0x15, 0x76, 0xb8,
+    0x3e, 0xd3, 0x4d, 0xd8, 0x63, 0xd0, 0xb5, 0xbd, 0x3b, 0x0e, 0x49, 0x06,
+    0x99, 0xe6, 0x93, 0xdd, 0xb2, 0x98, 0x62, 0x08, 0xc0, 0x48, 0x49, 0xfc,
+    0x3d, 0xee, 0x4f, 0x11, 0xa7, 0x1d, 0x09, 0x65, 0x43, 0x41, 0xb8, 0xcd,
+    0x22, 0x3e, 0x4a, 0xbc, 0x70, 0x1d, 0xcb, 0xd3,
+};
+
+static const BYTE rsapss_sig[] = {
+    0x28, 0x49, 0x1e, 0xd6, 0x86, 0x3d, 0x05, 0x4e, 0xdf, 0xf9, 0xad, 0xb7,
+    0xe3, 0x8b, 0x8a, 0x40, 0x12, 0xf9, 0x37, 0xff, 0xb4, 0x96, 0x7f, 0x49,
+    0xf6, 0xa8, 0x2a, 0x58, 0x20, 0x54, 0x9e, 0xc9, 0xed, 0xa9, 0xdb, 0x49,
+    0x37, 0x4e, 0x19, 0xff, 0xe3, 0xb0, 0xf1, 0xac, 0xf2, 0x01, 0x32, 0xec,
+    0x34, 0x94, 0xea, 0x5c, 0x5b, 0x0c, 0xae, 0x54, 0xef, 0xc8, 0xee, 0xac,
+    0xf0, 0xbf, 0x3d, 0x16, 0x36, 0x30, 0x0d, 0x14, 0x39, 0xb0, 0x1a, 0xc0,
+    0x10, 0x95, 0x18, 0xb6, 0xf9, 0x8e, 0x73, 0xd3, 0x9b, 0x69, 0x6b, 0xe8,
+    0xe1, 0xb9, 0x83, 0xeb, 0xd1, 0x1e, 0xa5, 0x1e, 0x44, 0xec, 0xc7, 0xf8,
+    0xb5, 0x72, 0xc2, 0x81, 0xbc, 0xfb, 0x4d, 0x6c, 0x94, 0xdd, 0x26, 0x21,
+    0x7c, 0x7b, 0x75, 0xa5, 0x9f, 0xfe, 0xf0, 0x3a, 0x32, 0x9a, 0xf0, 0x10,
+    0x4b, 0x70, 0x1a, 0x95, 0xe3, 0xd5, 0x54, 0xc2,
+};
+
+static const BYTE ecc_x[] = {
+    0xec, 0x93, 0x29, 0xfe, 0x42, 0x44, 0xfa, 0x7e, 0x3a, 0x2d, 0x26, 0x4b,
+    0xc0, 0x10, 0x15, 0x93, 0xc7, 0x63, 0x08, 0x9d, 0xee, 0x69, 0x21, 0x3b,
+    0x19, 0x87, 0x48, 0xb2, 0xe4, 0x78, 0xd7, 0x13,
+};
+
+static const BYTE ecc_y[] = {
+    0xfd, 0xb2, 0xe3, 0xac, 0x06, 0x62, 0xeb, 0xda, 0x36, 0x05, 0x59, 0x5f,
+    0x11, 0xef, 0xdc, 0xa8, 0xbc, 0x61, 0xb0, 0x14, 0x3b, 0x81, 0xc3, 0x5a,
+    0x99, 0x0f, 0xc1, 0x12, 0xab, 0x07, 0x99, 0xe0,
+};
+
+static const BYTE ecdsa_r[] = {
+    0x04, 0xea, 0x04, 0x9d, 0xab, 0x78, 0x45, 0x17, 0xcf, 0xa9, 0xc2, 0x40,
+    0x07, 0xce, 0xe9, 0x36, 0x21, 0x12, 0x83, 0x0c, 0x16, 0xc1, 0x78, 0x72,
+    0xf5, 0xc6, 0xb6, 0x34, 0x7c, 0xec, 0xe0, 0xdf,
+};
+
+static const BYTE ecdsa_s[] = {
+    0xfa, 0x58, 0x33, 0x1c, 0x8f, 0x2d, 0x8f, 0xfc, 0x7d, 0x70, 0xb9, 0x2b,
+    0xfa, 0x00, 0x62, 0x87, 0x5e, 0xcf, 0x6d, 0x4d, 0x90, 0xb3, 0xaa, 0x70,
+    0xa0, 0x9f, 0xd6, 0xb9, 0x44, 0xc3, 0xcd, 0x22,
+};
+
+static const BYTE digest[] = {
+    0x3f, 0x0a, 0x37, 0x7b, 0xa0, 0xa4, 0xa4, 0x60, 0xec, 0xb6, 0x16, 0xf6,
+    0x50, 0x7c, 0xe0, 0xd8, 0xcf, 0xa3, 0xe7, 0x04, 0x02, 0x5d, 0x4f, 0xda,
+    0x3e, 0xd0, 0xc5, 0xca, 0x05, 0x46, 0x87, 0x28,
+};
+
+static void
+load_key(ESYS_CONTEXT *esys_context, TPMI_ALG_PUBLIC type,
+         TPMI_ALG_SIG_SCHEME scheme, ESYS_TR *key)
+{
+    TSS2_RC r;
+    TPM2B_PUBLIC pub = {
+        .publicArea = {
+            .type = type,
+            .nameAlg = TPM2_ALG_SHA256,
+            .objectAttributes = TPMA_OBJECT_SIGN_ENCRYPT |
+                                TPMA_OBJECT_USERWITHAUTH,
+        }
+    };
+
+    if (type == TPM2_ALG_RSA) {
+        pub.publicArea.parameters.rsaDetail.symmetric.algorithm =
+            TPM2_ALG_NULL;
+        pub.publicArea.parameters.rsaDetail.scheme.scheme = scheme;
+        pub.publicArea.parameters.rsaDetail.scheme.details.anySig.hashAlg =
+            TPM2_ALG_SHA256;
+        pub.publicArea.parameters.rsaDetail.keyBits = 1024;
+        pub.publicArea.unique.rsa.size = sizeof(rsa_n);
+        memcpy(&pub.publicArea.unique.rsa.buffer[0], rsa_n, sizeof(rsa_n));
+    } else {
+        pub.publicArea.parameters.eccDetail.symmetric.algorithm =
+            TPM2_ALG_NULL;
+        pub.publicArea.parameters.eccDetail.scheme.scheme = scheme;
+        pub.publicArea.parameters.eccDetail.scheme.details.anySig.hashAlg =
+            TPM2_ALG_SHA256;
+        pub.publicArea.parameters.eccDetail.curveID = TPM2_ECC_NIST_P256;
+        pub.publicArea.parameters.eccDetail.kdf.scheme = TPM2_ALG_NULL;
+        pub.publicArea.unique.ecc.x.size = sizeof(ecc_x);
+        memcpy(&pub.publicArea.unique.ecc.x.buffer[0], ecc_x, sizeof(ecc_x));
+        pub.publicArea.unique.ecc.y.size = sizeof(ecc_y);
+        memcpy(&pub.publicArea.unique.ecc.y.buffer[0], ecc_y, sizeof(ecc_y));
+    }
+
+    r = Esys_LoadExternal(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                          ESYS_TR_NONE, NULL, &pub, TPM2_RH_OWNER, key);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+}
+
+static void
+init_digest(TPM2B_DIGEST *d)
+{
+    d->size = sizeof(digest);
+    memcpy(&d->buffer[0], digest, sizeof(digest));
+}
+
+static void
+test_verify_rsa(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_VERIFY *tcti_verify;
+    ESYS_TR key;
+    TPM2B_DIGEST d;
+    TPMT_SIGNATURE sig = {
+        .sigAlg = TPM2_ALG_RSASSA,
+        .signature = { .rsassa = { .hash = TPM2_ALG_SHA256 } }
+    };
+    TPMT_TK_VERIFIED *ticket = NULL;
+
+    tcti_verify = (TCTI_VERIFY *) tcti_mock_esys_get(esys_context);
+    load_key(esys_context, TPM2_ALG_RSA, TPM2_ALG_NULL, &key);
+    init_digest(&d);
+
+    sig.signature.rsassa.sig.size = sizeof(rsassa_sig);
+    memcpy(&sig.signature.rsassa.sig.buffer[0], rsassa_sig,
+           sizeof(rsassa_sig));
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    sig.sigAlg = TPM2_ALG_RSAPSS;
+    memcpy(&sig.signature.rsapss.sig.buffer[0], rsapss_sig,
+           sizeof(rsapss_sig));
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_verify->verify_count, 0);
+
+    /* A bad signature is rejected without asking the TPM */
+    d.buffer[0] ^= 1;
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig,
+                                  &ticket);
+    assert_int_equal(r, TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2);
+    assert_null(ticket);
+    assert_int_equal(tcti_verify->verify_count, 0);
+
+    /* A ticket is created by the TPM */
+    d.buffer[0] ^= 1;
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig,
+                                  &ticket);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_verify->verify_count, 1);
+    assert_non_null(ticket);
+    assert_int_equal(ticket->tag, TPM2_ST_VERIFIED);
+    SAFE_FREE(ticket);
+}
+
+static void
+test_verify_ecdsa(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_VERIFY *tcti_verify;
+    ESYS_TR key;
+    TPM2B_DIGEST d;
+    TPMT_SIGNATURE sig = {
+        .sigAlg = TPM2_ALG_ECDSA,
+        .signature = { .ecdsa = { .hash = TPM2_ALG_SHA256 } }
+    };
+
+    tcti_verify = (TCTI_VERIFY *) tcti_mock_esys_get(esys_context);
+    load_key(esys_context, TPM2_ALG_ECC, TPM2_ALG_NULL, &key);
+    init_digest(&d);
+
+    sig.signature.ecdsa.signatureR.size = sizeof(ecdsa_r);
+    memcpy(&sig.signature.ecdsa.signatureR.buffer[0], ecdsa_r,
+           sizeof(ecdsa_r));
+    sig.signature.ecdsa.signatureS.size = sizeof(ecdsa_s);
+    memcpy(&sig.signature.ecdsa.signatureS.buffer[0], ecdsa_s,
+           sizeof(ecdsa_s));
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    sig.signature.ecdsa.signatureS.buffer[5] ^= 1;
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TPM2_RC_SIGNATURE + TPM2_RC_P + TPM2_RC_2);
+    assert_int_equal(tcti_verify->verify_count, 0);
+
+    /* Schemes that are not supported locally are verified by the TPM */
+    sig.sigAlg = TPM2_ALG_ECSCHNORR;
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(tcti_verify->verify_count, 1);
+
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, NULL, &sig, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+}
+
+static void
+test_verify_scheme(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_VERIFY *tcti_verify;
+    ESYS_TR key;
+    TPM2B_DIGEST d;
+    TPMT_SIGNATURE sig = {
+        .sigAlg = TPM2_ALG_RSASSA,
+        .signature = { .rsassa = { .hash = TPM2_ALG_SHA256 } }
+    };
+
+    tcti_verify = (TCTI_VERIFY *) tcti_mock_esys_get(esys_context);
+    load_key(esys_context, TPM2_ALG_RSA, TPM2_ALG_RSASSA, &key);
+    init_digest(&d);
+
+    sig.signature.rsassa.sig.size = sizeof(rsassa_sig);
+    memcpy(&sig.signature.rsassa.sig.buffer[0], rsassa_sig,
+           sizeof(rsassa_sig));
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* A valid signature in another scheme than the key's is rejected */
+    sig.sigAlg = TPM2_ALG_RSAPSS;
+    memcpy(&sig.signature.rsapss.sig.buffer[0], rsapss_sig,
+           sizeof(rsapss_sig));
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TPM2_RC_SCHEME + TPM2_RC_P + TPM2_RC_2);
+
+    /* So is another hash */
+    sig.sigAlg = TPM2_ALG_RSASSA;
+    sig.signature.rsassa.hash = TPM2_ALG_SHA384;
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TPM2_RC_SCHEME + TPM2_RC_P + TPM2_RC_2);
+    assert_int_equal(tcti_verify->verify_count, 0);
+}
+
+static void
+test_verify_digest_size(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TCTI_VERIFY *tcti_verify;
+    ESYS_TR key;
+    TPM2B_DIGEST d;
+    TPMT_SIGNATURE sig = {
+        .sigAlg = TPM2_ALG_ECDSA,
+        .signature = { .ecdsa = { .hash = TPM2_ALG_SHA256 } }
+    };
+
+    tcti_verify = (TCTI_VERIFY *) tcti_mock_esys_get(esys_context);
+    load_key(esys_context, TPM2_ALG_ECC, TPM2_ALG_NULL, &key);
+    init_digest(&d);
+
+    sig.signature.ecdsa.signatureR.size = sizeof(ecdsa_r);
+    memcpy(&sig.signature.ecdsa.signatureR.buffer[0], ecdsa_r,
+           sizeof(ecdsa_r));
+    sig.signature.ecdsa.signatureS.size = sizeof(ecdsa_s);
+    memcpy(&sig.signature.ecdsa.signatureS.buffer[0], ecdsa_s,
+           sizeof(ecdsa_s));
+
+    /* ECDSA only uses a prefix of the digest, but the TPM checks its size */
+    d.size = TPM2_SHA1_DIGEST_SIZE;
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TPM2_RC_SIZE + TPM2_RC_P + TPM2_RC_1);
+
+    d.size = sizeof(digest);
+    sig.signature.ecdsa.hash = TPM2_ALG_SHA1;
+    r = Esys_VerifySignatureLocal(esys_context, key, ESYS_TR_NONE,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, &d, &sig, NULL);
+    assert_int_equal(r, TPM2_RC_SIZE + TPM2_RC_P + TPM2_RC_1);
+    assert_int_equal(tcti_verify->verify_count, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_verify_rsa,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_verify_ecdsa,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_verify_scheme,
+                                        setup, tcti_mock_teardown),
+        cmocka_unit_test_setup_teardown(test_verify_digest_size,
+                                        setup, tcti_mock_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Intel Corporation
+ *
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_sys.h"
+#include "sysapi_util.h"
+#include "tss2-tcti/tcti-common.h"
+
+/**
+ * Test executing a batch of prepared GetRandom commands. The TCTI answers
+ * each command with as many bytes as requested, or with TPM2_RC_RETRY if
+ * fail_next is set.
+ */
+
+#define NUM_COMMANDS 3
+
+const uint8_t retry_response[] = {
+    0x80, 0x01,                 /* TPM_ST_NO_SESSION */
+    0x00, 0x00, 0x00, 0x0A,     /* Response Size 10 */
+    0x00, 0x00, 0x09, 0x22      /* TPM2_RC_RETRY */
+};
+
+static uint16_t requested;
+static int fail_next;
+static int transmitted;
+
+static TSS2_RC
+tcti_transmit(
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t size,
+    uint8_t const *command)
+{
+    if (size != 12)
+        return TSS2_TCTI_RC_BAD_VALUE;
+
+    requested = (command[10] << 8) | command[11];
+    transmitted++;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_receive(
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    uint8_t *response,
+    int32_t timeout)
+{
+    size_t rsp_size = 12 + requested;
+
+    if (fail_next) {
+        fail_next = 0;
+        rsp_size = sizeof(retry_response);
+        if (response)
+            memcpy(response, retry_response, rsp_size);
+        *size = rsp_size;
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (response == NULL) {
+        *size = rsp_size;
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (*size < rsp_size)
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+
+    memset(response, 0, rsp_size);
+    response[0] = 0x80;
+    response[1] = 0x01;
+    response[5] = rsp_size;
+    response[11] = requested;
+    memset(&response[12], 0xa5, requested);
+    *size = rsp_size;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_ABI_VERSION ver = TSS2_ABI_VERSION_CURRENT;
+static TSS2_TCTI_CONTEXT_COMMON_V1 _tcti_v1_ctx;
+
+typedef struct {
+    TSS2_SYS_CONTEXT *sys_ctx;
+    TSS2_SYS_BATCH_CONTEXT *batch_ctx;
+    TSS2_SYS_PREPARED_COMMAND *cmds[NUM_COMMANDS];
+} test_ctx;
+
+static int
+setup(void **state)
+{
+    TSS2_TCTI_CONTEXT *tcti_ctx = (TSS2_TCTI_CONTEXT *) &_tcti_v1_ctx;
+    test_ctx *ctx;
+    size_t size;
+    TSS2_RC r;
+    int i;
+
+    ctx = calloc (1, sizeof(*ctx));
+    assert_non_null (ctx);
+    _tcti_v1_ctx.version = 1;
+    _tcti_v1_ctx.transmit = tcti_transmit;
+    _tcti_v1_ctx.receive = tcti_receive;
+
+    size = Tss2_Sys_GetContextSize(0);
+    ctx->sys_ctx = calloc (1, size);
+    assert_non_null (ctx->sys_ctx);
+    r = Tss2_Sys_Initialize(ctx->sys_ctx, size, tcti_ctx, &ver);
+    assert_int_equal (r, TSS2_RC_SUCCESS);
+
+    size = Tss2_Sys_Batch_GetContextSize(NUM_COMMANDS, 0);
+    ctx->batch_ctx = calloc (1, size);
+    assert_non_null (ctx->batch_ctx);
+    r = Tss2_Sys_Batch_Initialize(ctx->batch_ctx, size, NUM_COMMANDS,
+                                  tcti_ctx);
+    assert_int_equal (r, TSS2_RC_SUCCESS);
+
+    size = Tss2_Sys_PreparedCommand_GetSize(0);
+    for (i = 0; i < NUM_COMMANDS; i++) {
+        ctx->cmds[i] = calloc (1, size);
+        assert_non_null (ctx->cmds[i]);
+        r = Tss2_Sys_GetRandom_Prepare(ctx->sys_ctx, 8 * (i + 1));
+        assert_int_equal (r, TSS2_RC_SUCCESS);
+        r = Tss2_Sys_PreparedCommand_Save(ctx->sys_ctx, ctx->cmds[i], size);
+        assert_int_equal (r, TSS2_RC_SUCCESS);
+        r = Tss2_Sys_Batch_Add(ctx->batch_ctx, ctx->cmds[i]);
+        assert_int_equal (r, TSS2_RC_SUCCESS);
+    }
+    transmitted = 0;
+    fail_next = 0;
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    test_ctx *ctx = (test_ctx *)*state;
+    int i;
+
+    for (i = 0; i < NUM_COMMANDS; i++)
+        free (ctx->cmds[i]);
+    free (ctx->batch_ctx);
+    free (ctx->sys_ctx);
+    free (ctx);
+
+    return 0;
+}
+
+static void
+test_batch_execute(void **state)
+{
+    test_ctx *ctx = (test_ctx *)*state;
+    TPM2B_DIGEST random;
+    size_t executed;
+    TSS2_RC rc;
+    int i;
+
+    rc = Tss2_Sys_Batch_Add(ctx->batch_ctx, ctx->cmds[0]);
+    assert_int_equal (rc, TSS2_SYS_RC_INSUFFICIENT_CONTEXT);
+
+    rc = Tss2_Sys_Batch_Execute(ctx->batch_ctx, &executed);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (executed, NUM_COMMANDS);
+    assert_int_equal (transmitted, NUM_COMMANDS);
+
+    /* Responses can be completed in any order */
+    for (i = NUM_COMMANDS - 1; i >= 0; i--) {
+        rc = Tss2_Sys_Batch_GetResponse(ctx->batch_ctx, i, ctx->sys_ctx);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        rc = Tss2_Sys_GetRandom_Complete(ctx->sys_ctx, &random);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_int_equal (random.size, 8 * (i + 1));
+        assert_int_equal (random.buffer[0], 0xa5);
+    }
+
+    rc = Tss2_Sys_Batch_GetResponse(ctx->batch_ctx, NUM_COMMANDS,
+                                    ctx->sys_ctx);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_VALUE);
+
+    Tss2_Sys_Batch_Reset(ctx->batch_ctx);
+    rc = Tss2_Sys_Batch_Execute(ctx->batch_ctx, &executed);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (executed, 0);
+}
+
+static void
+test_batch_abort(void **state)
+{
+    test_ctx *ctx = (test_ctx *)*state;
+    TPM2B_DIGEST random;
+    size_t executed;
+    TSS2_RC rc;
+
+    fail_next = 1;
+    rc = Tss2_Sys_Batch_Execute(ctx->batch_ctx, &executed);
+    assert_int_equal (rc, TPM2_RC_RETRY);
+    assert_int_equal (executed, 0);
+    assert_int_equal (transmitted, 1);
+
+    /* The failed command is loaded for reissue */
+    rc = Tss2_Sys_Batch_GetResponse(ctx->batch_ctx, 0, ctx->sys_ctx);
+    assert_int_equal (rc, TPM2_RC_RETRY);
+    rc = Tss2_Sys_GetRandom_Complete(ctx->sys_ctx, &random);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_SEQUENCE);
+
+    /* Commands that did not run have no response */
+    rc = Tss2_Sys_Batch_GetResponse(ctx->batch_ctx, 1, ctx->sys_ctx);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_SEQUENCE);
+
+    /* Execution resumes with the failed command */
+    rc = Tss2_Sys_Batch_Execute(ctx->batch_ctx, &executed);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (executed, NUM_COMMANDS);
+    assert_int_equal (transmitted, 1 + NUM_COMMANDS);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown (test_batch_execute,
+                                         setup, teardown),
+        cmocka_unit_test_setup_teardown (test_batch_abort,
+                                         setup, teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Intel Corporation
+ *
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_sys.h"
+#include "tss2_mu.h"
+
+static void
+test_command_info_lookup(void **state)
+{
+    const TSS2_SYS_COMMAND_INFO *info;
+
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_NV_UndefineSpaceSpecial);
+    assert_non_null (info);
+    assert_int_equal (info->commandCode, TPM2_CC_NV_UndefineSpaceSpecial);
+    assert_int_equal (info->numCommandHandles, 2);
+    assert_int_equal (info->authRoles[0], TSS2_SYS_AUTH_ROLE_ADMIN);
+    assert_int_equal (info->authRoles[1], TSS2_SYS_AUTH_ROLE_USER);
+
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_CreatePrimary);
+    assert_non_null (info);
+    assert_int_equal (info->numCommandHandles, 1);
+    assert_int_equal (info->numResponseHandles, 1);
+    assert_true (info->attributes & TSS2_SYS_CMD_DECRYPT);
+    assert_true (info->attributes & TSS2_SYS_CMD_ENCRYPT);
+    assert_false (info->attributes & TSS2_SYS_CMD_READ_ONLY);
+    assert_false (info->attributes & TSS2_SYS_CMD_IDEMPOTENT);
+
+    /* Changes TPM state, but repeating it changes nothing more */
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_NV_Write);
+    assert_non_null (info);
+    assert_false (info->attributes & TSS2_SYS_CMD_READ_ONLY);
+    assert_true (info->attributes & TSS2_SYS_CMD_IDEMPOTENT);
+
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_NV_Increment);
+    assert_non_null (info);
+    assert_false (info->attributes & TSS2_SYS_CMD_IDEMPOTENT);
+
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_PCR_Read);
+    assert_non_null (info);
+    assert_int_equal (info->numCommandHandles, 0);
+    assert_true (info->attributes & TSS2_SYS_CMD_READ_ONLY);
+    assert_true (info->attributes & TSS2_SYS_CMD_IDEMPOTENT);
+    assert_false (info->attributes & TSS2_SYS_CMD_DECRYPT);
+    assert_int_equal (info->maxResponseSize, 10 + 4 +
+                      TSS2_MU_TPML_PCR_SELECTION_MAX_SIZE +
+                      TSS2_MU_TPML_DIGEST_MAX_SIZE);
+
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_ContextLoad);
+    assert_non_null (info);
+    assert_false (info->attributes & TSS2_SYS_CMD_SESSIONS);
+    assert_int_equal (info->maxResponseSize, 14);
+
+    /* Not capped at the size of the default buffer */
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_ContextSave);
+    assert_non_null (info);
+    assert_int_equal (info->maxResponseSize, 10 +
+                      TSS2_MU_TPMS_CONTEXT_MAX_SIZE);
+    assert_true (info->maxResponseSize > TPM2_MAX_COMMAND_SIZE);
+
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_GetCapability);
+    assert_non_null (info);
+    assert_int_equal (info->maxResponseSize, 10 + 1 +
+                      TSS2_MU_TPMS_CAPABILITY_DATA_MAX_SIZE);
+
+    info = Tss2_Sys_GetCommandInfo(TPM2_CC_Vendor_TCG_Test);
+    assert_non_null (info);
+    assert_int_equal (info->commandCode, TPM2_CC_Vendor_TCG_Test);
+}
+
+static void
+test_command_info_unknown(void **state)
+{
+    assert_null (Tss2_Sys_GetCommandInfo(0));
+    assert_null (Tss2_Sys_GetCommandInfo(TPM2_CC_FIRST - 1));
+    assert_null (Tss2_Sys_GetCommandInfo(TPM2_CC_LAST + 1));
+    /* Unassigned code within the TCG range */
+    assert_null (Tss2_Sys_GetCommandInfo(0x123));
+    assert_null (Tss2_Sys_GetCommandInfo(TPM2_CC_Vendor_TCG_Test + 1));
+}
+
+static void
+test_command_info_consistent(void **state)
+{
+    const TSS2_SYS_COMMAND_INFO *info;
+    TPM2_CC cc;
+    int i, count = 0;
+
+    for (cc = TPM2_CC_FIRST; cc <= TPM2_CC_LAST; cc++) {
+        info = Tss2_Sys_GetCommandInfo(cc);
+        if (!info)
+            continue;
+        count++;
+        assert_int_equal (info->commandCode, cc);
+        assert_true (info->numCommandHandles <= TSS2_SYS_MAX_CMD_HANDLES);
+        for (i = info->numCommandHandles; i < TSS2_SYS_MAX_CMD_HANDLES; i++)
+            assert_int_equal (info->authRoles[i], TSS2_SYS_AUTH_ROLE_NONE);
+        assert_true (info->maxResponseSize >= 10);
+        if (info->attributes & TSS2_SYS_CMD_READ_ONLY)
+            assert_true (info->attributes & TSS2_SYS_CMD_IDEMPOTENT);
+    }
+    assert_int_equal (count, 115);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (test_command_info_lookup),
+        cmocka_unit_test (test_command_info_unknown),
+        cmocka_unit_test (test_command_info_consistent),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -43,12 +43,24 @@ const uint8_t ok_response[] = {
     0xde, 0xad, 0xbe, 0xef,
 };
 
+const uint8_t encrypt_decrypt2_response[] = {
+    0x80, 0x01,                 /* TPM_ST_NO_SESSION */
+    0x00, 0x00, 0x00, 0x14,     /* Response Size 10 + 6 + 4 */
+    0x00, 0x00, 0x00, 0x00,     /* TPM_RC_SUCCESS */
+    0x00, 0x04,                 /* size of outData */
+    0xde, 0xad, 0xbe, 0xef,
+    0x00, 0x02,                 /* size of ivOut */
+    0xca, 0xfe,
+};
+
 const uint8_t retry_response[] = {
     0x80, 0x01,                 /* TPM_ST_NO_SESSION */
     0x00, 0x00, 0x00, 0x0A,     /* Response Size 10 */
     0x00, 0x00, 0x09, 0x22      /* TPM2_RC_RETRY */
 };
 
+static TPM2_CC command_code;
+
 static TSS2_RC
 tcti_transmit(
     TSS2_TCTI_CONTEXT *tctiContext,
@@ -67,14 +79,20 @@ tcti_transmit(
     LOG_DEBUG ("%s request_hdr.size  = %x", __func__, hdr.size);
     LOG_DEBUG ("%s request_hdr.code  = %x", __func__, hdr.code);
 
-    if (hdr.tag != TPM2_ST_NO_SESSIONS || hdr.size != 0xC || hdr.code != 0x17B)
+    if (hdr.tag != TPM2_ST_NO_SESSIONS)
         return TSS2_TCTI_RC_BAD_VALUE;
+    if (hdr.code != TPM2_CC_EncryptDecrypt2 &&
+        (hdr.size != 0xC || hdr.code != 0x17B))
+        return TSS2_TCTI_RC_BAD_VALUE;
+    command_code = hdr.code;
 
     return r;
 }
 
 #define NUM_OF_RETRIES 4
 
+static int i;
+
 static TSS2_RC
 tcti_receive(
     TSS2_TCTI_CONTEXT *tctiContext,
@@ -82,8 +100,6 @@ tcti_receive(
     uint8_t *response,
     int32_t timeout)
 {
-    static int i;
-
     LOG_DEBUG ("%s: receiving response, size %zu, buff %p",
                __func__, sizeof(ok_response), response);
 
@@ -92,6 +108,13 @@ tcti_receive(
         return TPM2_RC_SUCCESS;
     }
 
+    if (command_code == TPM2_CC_EncryptDecrypt2) {
+        memcpy(response, encrypt_decrypt2_response,
+               sizeof(encrypt_decrypt2_response));
+        *size = sizeof(encrypt_decrypt2_response);
+        return TPM2_RC_SUCCESS;
+    }
+
     if (i++ < NUM_OF_RETRIES) {
         LOG_DEBUG ("%s: return RC_RETRY", __func__);
         memcpy(response, retry_response, sizeof(retry_response));
@@ -124,6 +147,32 @@ setup(void **state)
     r = Tss2_Sys_Initialize(sys_ctx, size_ctx, tcti_ctx, &ver);
     assert_int_equal (r, TSS2_RC_SUCCESS);
 
+    i = 0;
+    *state = sys_ctx;
+
+    return 0;
+}
+
+/* Context with separate command and response buffers */
+static int
+setup_split(void **state)
+{
+    TSS2_SYS_CONTEXT  *sys_ctx;
+    TSS2_TCTI_CONTEXT *tcti_ctx = (TSS2_TCTI_CONTEXT *) &_tcti_v1_ctx;
+    size_t size_ctx;
+    TSS2_RC r;
+
+    size_ctx = Tss2_Sys_GetContextSizeEx(64, sizeof(ok_response));
+    sys_ctx = calloc (1, size_ctx);
+    assert_non_null (sys_ctx);
+    _tcti_v1_ctx.version = 1;
+    _tcti_v1_ctx.transmit = tcti_transmit;
+    _tcti_v1_ctx.receive = tcti_receive;
+
+    r = Tss2_Sys_InitializeEx(sys_ctx, size_ctx, 64, tcti_ctx, &ver);
+    assert_int_equal (r, TSS2_RC_SUCCESS);
+
+    i = 0;
     *state = sys_ctx;
 
     return 0;
@@ -158,11 +207,70 @@ test_resubmit(void **state)
     return;
 }
 
+static void
+test_split_buffers(void **state)
+{
+    TSS2_RC r = 0;
+    TSS2_SYS_CONTEXT *sys_ctx = (TSS2_SYS_CONTEXT *)*state;
+    _TSS2_SYS_CONTEXT_BLOB *ctx = syscontext_cast(sys_ctx);
+    TPM2B_DIGEST random = { 0 };
+    TPM2B_MAX_BUFFER in_data = { .size = 4, .buffer = { 1, 2, 3, 4 } };
+    TPM2B_IV iv_in = { .size = 2, .buffer = { 5, 6 } };
+    TPM2B_MAX_BUFFER out_data = { 0 };
+    TPM2B_IV iv_out = { 0 };
+    uint8_t command[0xC];
+    int ctr = 0;
+
+    assert_int_equal(ctx->maxCmdSize, 64);
+    assert_int_equal(ctx->maxRspSize, sizeof(ok_response));
+    assert_ptr_equal(ctx->rspBuffer, ctx->cmdBuffer + 64);
+
+    r = Tss2_Sys_GetRandom_Prepare(sys_ctx, 32);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    memcpy(command, ctx->cmdBuffer, sizeof(command));
+    do {
+        r = Tss2_Sys_Execute(sys_ctx);
+    } while (r == TPM2_RC_RETRY && ctr++ < 10);
+
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(ctr, NUM_OF_RETRIES);
+
+    /* The response did not overwrite the command */
+    assert_memory_equal(ctx->cmdBuffer, command, sizeof(command));
+
+    r = Tss2_Sys_GetRandom_Complete(sys_ctx, &random);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(random.size, 32);
+    assert_int_equal(random.buffer[0], 0xde);
+
+    /* Every _Complete unmarshals the response buffer, not the command */
+
+    r = Tss2_Sys_EncryptDecrypt2_Prepare(sys_ctx, 0x80000000, &in_data,
+                                         TPM2_NO, TPM2_ALG_CFB, &iv_in);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Tss2_Sys_Execute(sys_ctx);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = Tss2_Sys_EncryptDecrypt2_Complete(sys_ctx, &out_data, &iv_out);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(out_data.size, 4);
+    assert_memory_equal(out_data.buffer, &encrypt_decrypt2_response[12], 4);
+    assert_int_equal(iv_out.size, 2);
+    assert_int_equal(iv_out.buffer[0], 0xca);
+    assert_int_equal(iv_out.buffer[1], 0xfe);
+
+    /* Contexts too small for the requested command buffer are rejected */
+    r = Tss2_Sys_InitializeEx(sys_ctx, Tss2_Sys_GetContextSizeEx(64, 0), 128,
+                              ctx->tctiContext, &ver);
+    assert_int_equal(r, TSS2_SYS_RC_INSUFFICIENT_CONTEXT);
+}
+
 int
 main(int argc, char *argv[])
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_resubmit, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_split_buffers, setup_split,
+                                        teardown),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,216 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Intel Corporation
+ *
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_sys.h"
+#include "sysapi_util.h"
+#include "tss2-tcti/tcti-common.h"
+
+/**
+ * Test saving a prepared GetRandom command, changing its parameter and
+ * executing it repeatedly without going through Tss2_Sys_GetRandom_Prepare.
+ */
+
+const uint8_t ok_response[] = {
+    0x80, 0x01,                 /* TPM_ST_NO_SESSION */
+    0x00, 0x00, 0x00, 0x10,     /* Response Size 10 + 2 + 4 */
+    0x00, 0x00, 0x00, 0x00,     /* TPM_RC_SUCCESS */
+    0x00, 0x04,                 /* size of buffer */
+    0xde, 0xad, 0xbe, 0xef,
+};
+
+static uint8_t last_command[TPM2_MAX_COMMAND_SIZE];
+static size_t last_command_size;
+
+static TSS2_RC
+tcti_transmit(
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t size,
+    uint8_t const *command)
+{
+    if (size > sizeof(last_command))
+        return TSS2_TCTI_RC_BAD_VALUE;
+
+    memcpy(last_command, command, size);
+    last_command_size = size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_receive(
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    uint8_t *response,
+    int32_t timeout)
+{
+    if (response == NULL) {
+        *size = sizeof(ok_response);
+        return TSS2_RC_SUCCESS;
+    }
+
+    memcpy(response, ok_response, sizeof(ok_response));
+    *size = sizeof(ok_response);
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_ABI_VERSION ver = TSS2_ABI_VERSION_CURRENT;
+static TSS2_TCTI_CONTEXT_COMMON_V1 _tcti_v1_ctx;
+
+static int
+setup(void **state)
+{
+    TSS2_SYS_CONTEXT  *sys_ctx;
+    TSS2_TCTI_CONTEXT *tcti_ctx = (TSS2_TCTI_CONTEXT *) &_tcti_v1_ctx;
+    UINT32 size_ctx;
+    TSS2_RC r;
+
+    size_ctx = Tss2_Sys_GetContextSize(0);
+    sys_ctx = calloc (1, size_ctx);
+    assert_non_null (sys_ctx);
+    _tcti_v1_ctx.version = 1;
+    _tcti_v1_ctx.transmit = tcti_transmit;
+    _tcti_v1_ctx.receive = tcti_receive;
+
+    r = Tss2_Sys_Initialize(sys_ctx, size_ctx, tcti_ctx, &ver);
+    assert_int_equal (r, TSS2_RC_SUCCESS);
+
+    *state = sys_ctx;
+
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    TSS2_SYS_CONTEXT *sys_ctx = (TSS2_SYS_CONTEXT *)*state;
+
+    if (sys_ctx)
+        free (sys_ctx);
+
+    return 0;
+}
+
+static void
+test_prepared_command_execute(void **state)
+{
+    TSS2_SYS_CONTEXT *sys_ctx = (TSS2_SYS_CONTEXT *)*state;
+    TSS2_SYS_PREPARED_COMMAND *cmd;
+    TPM2B_DIGEST random = { 0 };
+    const uint8_t *cp_buffer;
+    size_t cp_size, cmd_size;
+    uint8_t bytes[] = { 0x00, 0x08 };
+    uint8_t expected[] = {
+        0x80, 0x01,                 /* TPM_ST_NO_SESSION */
+        0x00, 0x00, 0x00, 0x0C,     /* Command Size */
+        0x00, 0x00, 0x01, 0x7B,     /* TPM2_CC_GetRandom */
+        0x00, 0x08,                 /* bytesRequested */
+    };
+    TSS2_RC rc;
+    int i;
+
+    cmd_size = Tss2_Sys_PreparedCommand_GetSize(0);
+    cmd = calloc(1, cmd_size);
+    assert_non_null (cmd);
+
+    rc = Tss2_Sys_GetRandom_Prepare(sys_ctx, 4);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_Sys_PreparedCommand_Save(sys_ctx, cmd, cmd_size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_Sys_PreparedCommand_GetCpBuffer(cmd, &cp_size, &cp_buffer);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (cp_size, 2);
+    assert_int_equal (cp_buffer[1], 4);
+
+    rc = Tss2_Sys_PreparedCommand_SetParam(cmd, 0, sizeof(bytes), bytes);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    for (i = 0; i < 3; i++) {
+        rc = Tss2_Sys_PreparedCommand_Execute(sys_ctx, cmd);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_int_equal (last_command_size, sizeof(expected));
+        assert_memory_equal (last_command, expected, sizeof(expected));
+
+        rc = Tss2_Sys_GetRandom_Complete(sys_ctx, &random);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_int_equal (random.size, 4);
+        assert_int_equal (random.buffer[0], 0xde);
+    }
+
+    free(cmd);
+}
+
+static void
+test_prepared_command_errors(void **state)
+{
+    TSS2_SYS_CONTEXT *sys_ctx = (TSS2_SYS_CONTEXT *)*state;
+    TSS2_SYS_PREPARED_COMMAND *cmd;
+    uint8_t bytes[] = { 0x00, 0x08, 0x00 };
+    size_t cmd_size;
+    TSS2_RC rc;
+
+    cmd_size = Tss2_Sys_PreparedCommand_GetSize(0);
+    cmd = calloc(1, cmd_size);
+    assert_non_null (cmd);
+
+    /* Nothing has been prepared yet */
+    rc = Tss2_Sys_PreparedCommand_Save(sys_ctx, cmd, cmd_size);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_SEQUENCE);
+
+    rc = Tss2_Sys_GetRandom_Prepare(sys_ctx, 4);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_Sys_PreparedCommand_Save(sys_ctx, cmd,
+                                       Tss2_Sys_PreparedCommand_GetSize(1));
+    assert_int_equal (rc, TSS2_SYS_RC_INSUFFICIENT_CONTEXT);
+
+    rc = Tss2_Sys_PreparedCommand_Save(sys_ctx, cmd, cmd_size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    /* Parameters can not grow beyond the prepared command */
+    rc = Tss2_Sys_PreparedCommand_SetParam(cmd, 0, sizeof(bytes), bytes);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_SIZE);
+
+    rc = Tss2_Sys_PreparedCommand_SetParam(cmd, 3, 0, bytes);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_SIZE);
+
+    rc = Tss2_Sys_PreparedCommand_Load(NULL, cmd);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_REFERENCE);
+
+    rc = Tss2_Sys_ExecuteAsync(sys_ctx);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    /* A command is in flight */
+    rc = Tss2_Sys_PreparedCommand_Load(sys_ctx, cmd);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_SEQUENCE);
+
+    free(cmd);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown (test_prepared_command_execute,
+                                         setup, teardown),
+        cmocka_unit_test_setup_teardown (test_prepared_command_errors,
+                                         setup, teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
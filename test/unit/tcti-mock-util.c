@@ -0,0 +1,186 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_mu.h"
+
+#include "tcti-mock-util.h"
+#define LOGMODULE tests
+#include "util/log.h"
+
+TCTI_MOCK *
+tcti_mock_cast(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TCTI_MOCK *mock = (TCTI_MOCK *) tctiContext;
+    if (mock == NULL || mock->common.magic != TCTI_MOCK_MAGIC) {
+        LOG_ERROR("Bad tcti passed.");
+        return NULL;
+    }
+    return mock;
+}
+
+/* Write the response header and set the size of the response */
+void
+tcti_mock_set_response(TCTI_MOCK *mock, TPM2_ST tag, TPM2_RC rc, size_t size)
+{
+    size_t hdr = 0;
+
+    Tss2_MU_TPM2_ST_Marshal(tag, mock->response, sizeof(mock->response), &hdr);
+    Tss2_MU_UINT32_Marshal(size, mock->response, sizeof(mock->response), &hdr);
+    Tss2_MU_UINT32_Marshal(rc, mock->response, sizeof(mock->response), &hdr);
+    mock->response_size = size;
+}
+
+static TSS2_RC
+tcti_mock_transmit(TSS2_TCTI_CONTEXT *tctiContext,
+                   size_t size, const uint8_t *buffer)
+{
+    TCTI_MOCK *mock = tcti_mock_cast(tctiContext);
+    uint8_t *rsp;
+    size_t max, offset = 0, ps = 10;
+    UINT32 command_size;
+    TPM2_RC rc;
+
+    assert_non_null(mock);
+    rsp = mock->response;
+    max = sizeof(mock->response);
+    memset(rsp, 0, max);
+
+    assert_int_equal(Tss2_MU_TPM2_ST_Unmarshal(buffer, size, &offset,
+                                               &mock->tag), TSS2_RC_SUCCESS);
+    Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &command_size);
+    Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &mock->command_code);
+    assert_int_equal(command_size, size);
+
+    /* Leave room for the header and the parameterSize */
+    offset = (mock->tag == TPM2_ST_SESSIONS) ? 14 : 10;
+    rc = mock->respond(mock, mock->command_code, buffer, size, rsp, max,
+                       &offset);
+    if (rc != TPM2_RC_SUCCESS) {
+        tcti_mock_set_response(mock, TPM2_ST_NO_SESSIONS, rc, 10);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (mock->tag == TPM2_ST_SESSIONS) {
+        Tss2_MU_UINT32_Marshal(offset - 14, rsp, max, &ps);
+        Tss2_MU_UINT16_Marshal(0, rsp, max, &offset);
+        Tss2_MU_UINT8_Marshal(TPMA_SESSION_CONTINUESESSION, rsp, max, &offset);
+        Tss2_MU_UINT16_Marshal(0, rsp, max, &offset);
+    }
+    tcti_mock_set_response(mock, mock->tag, TPM2_RC_SUCCESS, offset);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+tcti_mock_receive(TSS2_TCTI_CONTEXT *tctiContext,
+                  size_t *response_size,
+                  uint8_t *response_buffer, int32_t timeout)
+{
+    TCTI_MOCK *mock = tcti_mock_cast(tctiContext);
+
+    assert_non_null(mock);
+    if (response_buffer != NULL) {
+        if (*response_size < mock->response_size)
+            return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+        memcpy(response_buffer, mock->response, mock->response_size);
+    }
+    *response_size = mock->response_size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static void
+tcti_mock_finalize(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TCTI_MOCK *mock = tcti_mock_cast(tctiContext);
+
+    if (mock != NULL)
+        memset(mock, 0, mock->size);
+}
+
+TSS2_TCTI_CONTEXT *
+tcti_mock_new(size_t size, TCTI_MOCK_RESPOND_FCN respond)
+{
+    TSS2_TCTI_CONTEXT *tctiContext;
+    TCTI_MOCK *mock;
+
+    assert_true(size >= sizeof(TCTI_MOCK));
+    mock = calloc(1, size);
+    assert_non_null(mock);
+
+    tctiContext = (TSS2_TCTI_CONTEXT *) mock;
+    TSS2_TCTI_MAGIC(tctiContext) = TCTI_MOCK_MAGIC;
+    TSS2_TCTI_VERSION(tctiContext) = TCTI_MOCK_VERSION;
+    TSS2_TCTI_TRANSMIT(tctiContext) = tcti_mock_transmit;
+    TSS2_TCTI_RECEIVE(tctiContext) = tcti_mock_receive;
+    TSS2_TCTI_FINALIZE(tctiContext) = tcti_mock_finalize;
+    TSS2_TCTI_CANCEL(tctiContext) = NULL;
+    TSS2_TCTI_GET_POLL_HANDLES(tctiContext) = NULL;
+    TSS2_TCTI_SET_LOCALITY(tctiContext) = NULL;
+    mock->size = size;
+    mock->respond = respond;
+
+    return tctiContext;
+}
+
+void
+tcti_mock_free(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    if (tctiContext == NULL)
+        return;
+    Tss2_Tcti_Finalize(tctiContext);
+    free(tctiContext);
+}
+
+TCTI_MOCK *
+tcti_mock_esys_get(ESYS_CONTEXT *esys_context)
+{
+    TSS2_TCTI_CONTEXT *tcti;
+
+    assert_int_equal(Esys_GetTcti(esys_context, &tcti), TSS2_RC_SUCCESS);
+    return tcti_mock_cast(tcti);
+}
+
+/* cmocka setup creating an ESYS context on top of a new mock TCTI */
+int
+tcti_mock_setup(void **state, size_t size, TCTI_MOCK_RESPOND_FCN respond)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx;
+    TSS2_TCTI_CONTEXT *tcti = tcti_mock_new(size, respond);
+
+    r = Esys_Initialize(&ectx, tcti, NULL);
+    if (r) {
+        tcti_mock_free(tcti);
+        return (int)r;
+    }
+    *state = (void *)ectx;
+    return 0;
+}
+
+int
+tcti_mock_teardown(void **state)
+{
+    TSS2_TCTI_CONTEXT *tcti;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+
+    Esys_GetTcti(ectx, &tcti);
+    Esys_Finalize(&ectx);
+    tcti_mock_free(tcti);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+#ifndef TCTI_MOCK_UTIL_H
+#define TCTI_MOCK_UTIL_H
+
+#include "tss2_tcti.h"
+#include "tss2_esys.h"
+
+/**
+ * Mock TCTI shared by the ESYS unit tests. The mock answers each command
+ * in its transmit function by calling the respond function of the test and
+ * returns the response on the next receive.
+ *
+ * Tests that need state of their own embed TCTI_MOCK as the first member
+ * of a larger structure and pass its size to tcti_mock_new. The receive,
+ * cancel and get_poll_handles functions can be replaced after creation;
+ * replacement receive functions call tcti_mock_receive to deliver the
+ * response.
+ */
+
+#define TCTI_MOCK_MAGIC 0x4d4f434b54435449ULL        /* 'MOCKTCTI' */
+#define TCTI_MOCK_VERSION 0x1
+
+#define TCTI_MOCK_RESPONSE_SIZE 8192
+
+typedef struct TCTI_MOCK TCTI_MOCK;
+
+/**
+ * Generate the response to a command. The parameters of the response are
+ * marshaled into response starting at *offset and *offset is advanced past
+ * them. The header, the parameterSize and a password session response are
+ * added by the mock if the command carries sessions.
+ * @retval The response code of the TPM; responses with a response code other
+ *         than TPM2_RC_SUCCESS consist of the header only.
+ */
+typedef TPM2_RC (*TCTI_MOCK_RESPOND_FCN) (TCTI_MOCK *mock,
+                                          TPM2_CC command_code,
+                                          const uint8_t *command, size_t size,
+                                          uint8_t *response, size_t max,
+                                          size_t *offset);
+
+struct TCTI_MOCK {
+    TSS2_TCTI_CONTEXT_COMMON_V1 common;
+    size_t size;
+    TCTI_MOCK_RESPOND_FCN respond;
+    TPM2_ST tag;
+    TPM2_CC command_code;
+    uint8_t response[TCTI_MOCK_RESPONSE_SIZE];
+    size_t response_size;
+};
+
+TSS2_TCTI_CONTEXT *tcti_mock_new(size_t size, TCTI_MOCK_RESPOND_FCN respond);
+void tcti_mock_free(TSS2_TCTI_CONTEXT *tctiContext);
+TCTI_MOCK *tcti_mock_cast(TSS2_TCTI_CONTEXT *tctiContext);
+TCTI_MOCK *tcti_mock_esys_get(ESYS_CONTEXT *esys_context);
+void tcti_mock_set_response(TCTI_MOCK *mock, TPM2_ST tag, TPM2_RC rc,
+                            size_t size);
+
+TSS2_RC tcti_mock_receive(TSS2_TCTI_CONTEXT *tctiContext,
+                          size_t *response_size, uint8_t *response_buffer,
+                          int32_t timeout);
+
+int tcti_mock_setup(void **state, size_t size, TCTI_MOCK_RESPOND_FCN respond);
+int tcti_mock_teardown(void **state);
+
+#endif                          /* TCTI_MOCK_UTIL_H */